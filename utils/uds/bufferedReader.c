@@ -27,11 +27,195 @@
 #include "memoryAlloc.h"
 #include "numeric.h"
 
+/**
+ * This is the driver function for the read-ahead thread of an asynchronous
+ * buffered reader. It reads each queued buffer from the region in order,
+ * until told to stop.
+ *
+ * @param arg  The buffered reader
+ **/
+static void readBuffers(void *arg)
+{
+  BufferedReader *reader = arg;
+  lockMutex(&reader->mutex);
+  for (;;) {
+    while ((reader->done == reader->queued) && !reader->stop) {
+      waitCond(&reader->cond, &reader->mutex);
+    }
+    if (reader->stop) {
+      break;
+    }
+    ReadSlot *slot = &reader->slots[(reader->head + reader->done)
+                                    % reader->depth];
+    if (reader->end) {
+      // Don't read past the end of the data.
+      slot->length = 0;
+      slot->result = UDS_SUCCESS;
+    } else {
+      unlockMutex(&reader->mutex);
+      size_t n = 0;
+      int result = readFromRegion(reader->region, slot->pos, slot->buf,
+                                  reader->bufsize, &n);
+      lockMutex(&reader->mutex);
+      slot->length = n;
+      slot->result = result;
+      if ((result != UDS_SUCCESS) || (n < reader->bufsize)) {
+        reader->end = true;
+      }
+    }
+    reader->done++;
+    broadcastCond(&reader->cond);
+  }
+  unlockMutex(&reader->mutex);
+}
+
+/**
+ * Queue as many read-ahead buffers as are free. The reader mutex must be
+ * held.
+ *
+ * @param reader  The buffered reader
+ **/
+static void queueReadAhead(BufferedReader *reader)
+{
+  while (!reader->end && (reader->queued < reader->depth - 1)) {
+    ReadSlot *slot = &reader->slots[(reader->head + reader->queued)
+                                    % reader->depth];
+    slot->pos        = reader->nextPos;
+    reader->nextPos += reader->bufsize;
+    reader->queued++;
+  }
+  broadcastCond(&reader->cond);
+}
+
+/**
+ * Discard any read-ahead of an asynchronous buffered reader, waiting for
+ * reads already in progress to finish.
+ *
+ * @param reader  The buffered reader
+ **/
+static void cancelReadAhead(BufferedReader *reader)
+{
+  if (reader->depth == 1) {
+    return;
+  }
+  lockMutex(&reader->mutex);
+  while (reader->done < reader->queued) {
+    waitCond(&reader->cond, &reader->mutex);
+  }
+  reader->head   = (reader->head + reader->queued) % reader->depth;
+  reader->queued = 0;
+  reader->done   = 0;
+  reader->end    = false;
+  reader->buffer = reader->slots[(reader->head + reader->depth - 1)
+                                 % reader->depth].buf;
+  unlockMutex(&reader->mutex);
+}
+
+/**
+ * Refill the buffer of a buffered reader with the next bufsize bytes of the
+ * region, taking them from the read-ahead if the reader is asynchronous.
+ *
+ * @param [in]  reader  The buffered reader
+ * @param [out] count   The number of bytes now in the buffer
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int readNextBuffer(BufferedReader *reader, size_t *count)
+{
+  size_t n = 0;
+  int result;
+  if (reader->depth == 1) {
+    result = readFromRegion(reader->region, reader->offset, reader->buffer,
+                            reader->bufsize, &n);
+  } else {
+    lockMutex(&reader->mutex);
+    if (reader->queued == 0) {
+      reader->end     = false;
+      reader->nextPos = reader->offset;
+      queueReadAhead(reader);
+    }
+    while (reader->done == 0) {
+      waitCond(&reader->cond, &reader->mutex);
+    }
+    ReadSlot *slot = &reader->slots[reader->head];
+    result         = slot->result;
+    n              = slot->length;
+    reader->buffer = slot->buf;
+    reader->head   = (reader->head + 1) % reader->depth;
+    reader->queued--;
+    reader->done--;
+    queueReadAhead(reader);
+    unlockMutex(&reader->mutex);
+  }
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  reader->offset += n;
+  reader->bufpos =  reader->buffer;
+  reader->extent =  reader->buffer + n;
+  if (n < reader->bufsize) {
+    reader->eof = true;
+  }
+  *count = n;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Start an asynchronous buffered reader by allocating its extra buffers and
+ * starting its read-ahead thread.
+ *
+ * @param reader  The buffered reader
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int startAsyncReader(BufferedReader *reader)
+{
+  for (unsigned int i = 1; i < reader->depth; i++) {
+    int result = ALLOCATE_IO_ALIGNED(reader->bufsize, byte,
+                                     "buffered reader buffer",
+                                     &reader->slots[i].buf);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+
+  int result = initMutex(&reader->mutex);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = initCond(&reader->cond);
+  if (result != UDS_SUCCESS) {
+    destroyMutex(&reader->mutex);
+    return result;
+  }
+  result = createThread(readBuffers, reader, "bufferedReader",
+                        &reader->thread);
+  if (result != UDS_SUCCESS) {
+    destroyCond(&reader->cond);
+    destroyMutex(&reader->mutex);
+    return result;
+  }
+  // The current buffer is the slot just before the head of the queue.
+  reader->head = 1;
+  return UDS_SUCCESS;
+}
+
+/*****************************************************************************/
+static void freeReaderBuffers(BufferedReader *reader)
+{
+  for (unsigned int i = 0; i < reader->depth; i++) {
+    FREE(reader->slots[i].buf);
+  }
+}
+
 /*****************************************************************************/
 int makeBufferedReader(IORegion *region, BufferedReader **readerPtr)
 {
+  unsigned int depth = getBufferedIODepth();
   BufferedReader *reader = NULL;
-  int result = ALLOCATE(1, BufferedReader, "buffered reader", &reader);
+  int result = ALLOCATE_EXTENDED(BufferedReader, depth, ReadSlot,
+                                 "buffered reader", &reader);
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -41,15 +225,31 @@ int makeBufferedReader(IORegion *region, BufferedReader **readerPtr)
     FREE(reader);
     return result;
   }
+  if ((depth > 1) && (reader->bufsize < ASYNC_IO_BUFFER_SIZE)) {
+    // Handing tiny buffers to another thread costs more than it saves.
+    reader->bufsize *= ((ASYNC_IO_BUFFER_SIZE + reader->bufsize - 1)
+                        / reader->bufsize);
+  }
 
   result = ALLOCATE_IO_ALIGNED(reader->bufsize, byte, "buffered reader buffer",
-                               &reader->buffer);
+                               &reader->slots[0].buf);
   if (result != UDS_SUCCESS) {
     FREE(reader);
     return result;
   }
 
   reader->region = region;
+  reader->depth  = depth;
+  if (depth > 1) {
+    result = startAsyncReader(reader);
+    if (result != UDS_SUCCESS) {
+      freeReaderBuffers(reader);
+      FREE(reader);
+      return result;
+    }
+  }
+
+  reader->buffer = reader->slots[0].buf;
   reader->offset = 0;
   reader->extent = reader->bufpos = reader->buffer;
   reader->eof    = false;
@@ -62,10 +262,20 @@ int makeBufferedReader(IORegion *region, BufferedReader **readerPtr)
 void freeBufferedReader(BufferedReader *reader)
 {
   if (reader != NULL) {
+    if (reader->depth > 1) {
+      cancelReadAhead(reader);
+      lockMutex(&reader->mutex);
+      reader->stop = true;
+      broadcastCond(&reader->cond);
+      unlockMutex(&reader->mutex);
+      joinThreads(reader->thread);
+      destroyCond(&reader->cond);
+      destroyMutex(&reader->mutex);
+    }
     if (reader->close) {
       closeIORegion(&reader->region);
     }
-    FREE(reader->buffer);
+    freeReaderBuffers(reader);
     FREE(reader);
   }
 }
@@ -97,7 +307,8 @@ int readBufferedData(BufferedReader *reader,
     result = UDS_END_OF_FILE;
   }
 
-  bool alwaysCopy = false;
+  // Reading around the read-ahead would defeat it.
+  bool alwaysCopy = (reader->depth > 1);
   while ((length > 0) && (result == UDS_SUCCESS)) {
     // then read whole bufsize chunks directly, bypassing the buffer
     if ((length >= reader->bufsize) && !alwaysCopy) {
@@ -128,20 +339,13 @@ int readBufferedData(BufferedReader *reader,
     }
 
     // then read a buffers' worth and copy some of it
-    n = 0;
-    result = readFromRegion(reader->region, reader->offset, reader->buffer,
-                            reader->bufsize, &n);
+    result = readNextBuffer(reader, &n);
     if (result != UDS_SUCCESS) {
       logWarningWithStringError(result, "%s got readFromRegion error",
                                 __func__);
       break;
     }
-
-    reader->offset += n;
-    reader->bufpos =  reader->buffer;
-    reader->extent =  reader->buffer + n;
-    if (n < reader->bufsize) {
-      reader->eof = true;
+    if (reader->eof) {
       result = UDS_END_OF_FILE;
     }
 
@@ -215,6 +419,7 @@ static int repositionReader(BufferedReader *reader, off_t position)
     return UDS_SUCCESS;
   } // else before current buffer
 
+  cancelReadAhead(reader);
   size_t phase = position % reader->bufsize;
   if (phase == 0) {
     reader->bufpos = reader->extent = reader->buffer;
@@ -273,9 +478,7 @@ int verifyBufferedData(BufferedReader *reader,
                                        "%s got unexpected EOF", __func__);
     }
 
-    n = 0;
-    result = readFromRegion(reader->region, reader->offset,
-                            reader->buffer, reader->bufsize, &n);
+    result = readNextBuffer(reader, &n);
     if (result != UDS_SUCCESS) {
       repositionReader(reader, origOffset);
       return logWarningWithStringError(result, "%s got readFromRegion error",
@@ -286,13 +489,6 @@ int verifyBufferedData(BufferedReader *reader,
                                        __func__);
     }
 
-    reader->offset += n;
-    reader->bufpos =  reader->buffer;
-    reader->extent =  reader->buffer + n;
-
-    if (n < reader->bufsize) {
-      reader->eof = true;
-    }
     n = minSizeT(n, length);
     if (memcmp(vp, reader->bufpos, n) != 0) {
       repositionReader(reader, origOffset);
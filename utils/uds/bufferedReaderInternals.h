@@ -23,21 +23,47 @@
 #define BUFFERED_READER_INTERNALS_H
 
 #include "bufferedReader.h"
+#include "threads.h"
+
+/**
+ * A buffer which an asynchronous buffered reader is reading ahead into.
+ **/
+typedef struct readSlot {
+  byte   *buf;              // the buffer
+  off_t   pos;              // the offset the buffer is read from
+  size_t  length;           // the amount of data read into the buffer
+  int     result;           // the result of reading the buffer
+} ReadSlot;
 
 struct bufferedReader {
-  IORegion *region;     // the region to read from
-  size_t    bufsize;    // size of buffer
-  off_t     offset;     // offset of last byte in the buffer
-  byte     *buffer;     // buffer
-  byte     *extent;     // extent of the data in the buffer
-  byte     *bufpos;     // the next unread byte in the buffer
-  bool      eof;        // short read or eof encountered
-  bool      close;      // close the IO region when done
+  IORegion     *region;     // the region to read from
+  size_t        bufsize;    // size of buffer
+  off_t         offset;     // offset of last byte in the buffer
+  byte         *buffer;     // buffer
+  byte         *extent;     // extent of the data in the buffer
+  byte         *bufpos;     // the next unread byte in the buffer
+  bool          eof;        // short read or eof encountered
+  bool          close;      // close the IO region when done
+  unsigned int  depth;      // the number of buffers
+  // The remaining fields are used only when depth > 1
+  Thread        thread;     // the thread reading ahead
+  Mutex         mutex;      // protects the fields below
+  CondVar       cond;       // signalled when a slot changes state
+  bool          stop;       // tells the read-ahead thread to exit
+  bool          end;        // a read-ahead hit the end of the data
+  off_t         nextPos;    // the offset of the next read-ahead to queue
+  unsigned int  head;       // the oldest slot queued for read-ahead
+  unsigned int  queued;     // the number of slots queued for read-ahead
+  unsigned int  done;       // the number of queued slots already read
+  ReadSlot      slots[];    // the buffers
 };
 
 // Invariants:
 //   eof || offset % bufsize == 0
 //   buffer <= bufpos <= extent
 //   extent - buffer <= bufsize
+// and when depth > 1:
+//   done <= queued < depth
+//   buffer is slots[(head + depth - 1) % depth].buf
 
 #endif // BUFFERED_READER_INTERNALS_H
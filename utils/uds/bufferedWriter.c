@@ -28,18 +28,147 @@
 #include "memoryAlloc.h"
 #include "numeric.h"
 
+/**
+ * This is the driver function for the IO thread of an asynchronous buffered
+ * writer. It writes each filled buffer to the region in the order the
+ * buffers were queued, until told to stop.
+ *
+ * @param arg  The buffered writer
+ **/
+static void writeBuffers(void *arg)
+{
+  BufferedWriter *bw = arg;
+  lockMutex(&bw->bw_mutex);
+  for (;;) {
+    while ((bw->bw_pending == 0) && !bw->bw_stop) {
+      waitCond(&bw->bw_cond, &bw->bw_mutex);
+    }
+    if (bw->bw_pending == 0) {
+      break;
+    }
+    WriteSlot *slot = &bw->bw_slots[bw->bw_head];
+    int ioErr = bw->bw_ioErr;
+    unlockMutex(&bw->bw_mutex);
+
+    // Once a write has failed, the remaining buffers are just discarded.
+    int result = UDS_SUCCESS;
+    if (ioErr == UDS_SUCCESS) {
+      result = writeToRegion(bw->bw_region, slot->ws_pos, slot->ws_buf,
+                             bw->bw_size, slot->ws_length);
+      if (result != UDS_SUCCESS) {
+        logWarningWithStringError(result, "failed in buffered writer thread");
+      }
+    }
+
+    lockMutex(&bw->bw_mutex);
+    if (bw->bw_ioErr == UDS_SUCCESS) {
+      bw->bw_ioErr = result;
+    }
+    bw->bw_head = (bw->bw_head + 1) % bw->bw_depth;
+    bw->bw_pending--;
+    broadcastCond(&bw->bw_cond);
+  }
+  unlockMutex(&bw->bw_mutex);
+}
+
+/**
+ * Wait until the IO thread of an asynchronous buffered writer has no more
+ * than a given number of buffers queued, and pick up any error it has seen.
+ *
+ * @param bw       The buffered writer
+ * @param pending  The number of queued buffers to wait for
+ *
+ * @return UDS_SUCCESS or the sticky error of the writer
+ **/
+static int waitForPendingWrites(BufferedWriter *bw, unsigned int pending)
+{
+  lockMutex(&bw->bw_mutex);
+  while (bw->bw_pending > pending) {
+    waitCond(&bw->bw_cond, &bw->bw_mutex);
+  }
+  if (bw->bw_err == UDS_SUCCESS) {
+    bw->bw_err = bw->bw_ioErr;
+  }
+  unlockMutex(&bw->bw_mutex);
+  return bw->bw_err;
+}
+
+/**
+ * Stop the IO thread of an asynchronous buffered writer, after it has
+ * written any buffers already queued.
+ *
+ * @param bw  The buffered writer
+ **/
+static void stopWriterThread(BufferedWriter *bw)
+{
+  lockMutex(&bw->bw_mutex);
+  bw->bw_stop = true;
+  broadcastCond(&bw->bw_cond);
+  unlockMutex(&bw->bw_mutex);
+  joinThreads(bw->bw_thread);
+}
+
+/**
+ * Start an asynchronous buffered writer by allocating its extra buffers and
+ * starting its IO thread.
+ *
+ * @param bw  The buffered writer
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int startAsyncWriter(BufferedWriter *bw)
+{
+  for (unsigned int i = 1; i < bw->bw_depth; i++) {
+    int result = ALLOCATE_IO_ALIGNED(bw->bw_size, char, "buffer writer buffer",
+                                     &bw->bw_slots[i].ws_buf);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+
+  int result = initMutex(&bw->bw_mutex);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = initCond(&bw->bw_cond);
+  if (result != UDS_SUCCESS) {
+    destroyMutex(&bw->bw_mutex);
+    return result;
+  }
+  result = createThread(writeBuffers, bw, "bufferedWriter", &bw->bw_thread);
+  if (result != UDS_SUCCESS) {
+    destroyCond(&bw->bw_cond);
+    destroyMutex(&bw->bw_mutex);
+    return result;
+  }
+  return UDS_SUCCESS;
+}
+
+/*****************************************************************************/
+static void freeWriterBuffers(BufferedWriter *bw)
+{
+  for (unsigned int i = 0; i < bw->bw_depth; i++) {
+    FREE(bw->bw_slots[i].ws_buf);
+  }
+}
+
 /******************************************************************************/
 int makeBufferedWriter(IORegion        *region,
                        size_t           bufSize,
                        BufferedWriter **writerPtr)
 {
   int result = UDS_SUCCESS;
+  unsigned int depth = getBufferedIODepth();
 
   if (bufSize == 0) {
     result = getRegionBestBufferSize(region, &bufSize);
     if (result != UDS_SUCCESS) {
       return result;
     }
+    if ((depth > 1) && (bufSize < ASYNC_IO_BUFFER_SIZE)) {
+      // Handing tiny buffers to another thread costs more than it saves.
+      bufSize *= (ASYNC_IO_BUFFER_SIZE + bufSize - 1) / bufSize;
+    }
   } else {
     size_t blockSize;
     result = getRegionBlockSize(region, &blockSize);
@@ -54,27 +183,37 @@ int makeBufferedWriter(IORegion        *region,
   }
 
   BufferedWriter *writer;
-  result = ALLOCATE(1, BufferedWriter, "buffered writer", &writer);
+  result = ALLOCATE_EXTENDED(BufferedWriter, depth, WriteSlot,
+                             "buffered writer", &writer);
   if (result != UDS_SUCCESS) {
     return result;
   }
 
-  *writer = (BufferedWriter) {
-    .bw_region = region,
-    .bw_size   = bufSize,
-    .bw_pos    = 0,
-    .bw_err    = UDS_SUCCESS,
-    .bw_used   = false,
-    .bw_close  = false,
-  };
+  writer->bw_region = region;
+  writer->bw_size   = bufSize;
+  writer->bw_pos    = 0;
+  writer->bw_err    = UDS_SUCCESS;
+  writer->bw_used   = false;
+  writer->bw_close  = false;
+  writer->bw_depth  = depth;
 
   result = ALLOCATE_IO_ALIGNED(bufSize, char, "buffer writer buffer",
-                               &writer->bw_buf);
+                               &writer->bw_slots[0].ws_buf);
   if (result != UDS_SUCCESS) {
     FREE(writer);
     return result;
   }
 
+  if (depth > 1) {
+    result = startAsyncWriter(writer);
+    if (result != UDS_SUCCESS) {
+      freeWriterBuffers(writer);
+      FREE(writer);
+      return result;
+    }
+  }
+
+  writer->bw_buf = writer->bw_slots[0].ws_buf;
   writer->bw_ptr = writer->bw_buf;
   *writerPtr = writer;
   return UDS_SUCCESS;
@@ -84,10 +223,15 @@ int makeBufferedWriter(IORegion        *region,
 void freeBufferedWriter(BufferedWriter *bw)
 {
   if (bw) {
+    if (bw->bw_depth > 1) {
+      stopWriterThread(bw);
+      destroyCond(&bw->bw_cond);
+      destroyMutex(&bw->bw_mutex);
+    }
     if (bw->bw_close) {
       syncAndCloseRegion(&bw->bw_region, NULL);
     }
-    FREE(bw->bw_buf);
+    freeWriterBuffers(bw);
     FREE(bw);
   }
 }
@@ -104,6 +248,53 @@ size_t spaceRemainingInWriteBuffer(BufferedWriter *bw)
   return bw->bw_size - spaceUsedInBuffer(bw);
 }
 
+/**
+ * Write out the current buffer, or hand it to the IO thread if the writer
+ * is asynchronous, and prepare an empty buffer for more data.
+ *
+ * @param bw  The buffered writer
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int writeBuffer(BufferedWriter *bw)
+{
+  if (bw->bw_err != UDS_SUCCESS) {
+    return bw->bw_err;
+  }
+
+  size_t n = spaceUsedInBuffer(bw);
+  if (n == 0) {
+    return UDS_SUCCESS;
+  }
+
+  if (bw->bw_depth == 1) {
+    int result = writeToRegion(bw->bw_region, bw->bw_pos, bw->bw_buf,
+                               bw->bw_size, n);
+    if (result != UDS_SUCCESS) {
+      return bw->bw_err = result;
+    }
+    bw->bw_ptr =  bw->bw_buf;
+    bw->bw_pos += bw->bw_size;
+    return UDS_SUCCESS;
+  }
+
+  lockMutex(&bw->bw_mutex);
+  unsigned int fill = (bw->bw_head + bw->bw_pending) % bw->bw_depth;
+  bw->bw_slots[fill].ws_pos    = bw->bw_pos;
+  bw->bw_slots[fill].ws_length = n;
+  bw->bw_pending++;
+  broadcastCond(&bw->bw_cond);
+  unlockMutex(&bw->bw_mutex);
+  bw->bw_pos += bw->bw_size;
+
+  // Wait for a free buffer to fill next.
+  int result = waitForPendingWrites(bw, bw->bw_depth - 1);
+  fill = (fill + 1) % bw->bw_depth;
+  bw->bw_buf = bw->bw_slots[fill].ws_buf;
+  bw->bw_ptr = bw->bw_buf;
+  return result;
+}
+
 /*****************************************************************************/
 int writeToBufferedWriter(BufferedWriter *bw, const void *data, size_t len)
 {
@@ -116,6 +307,13 @@ int writeToBufferedWriter(BufferedWriter *bw, const void *data, size_t len)
   int result = UDS_SUCCESS;
   while ((len > 0) && (result == UDS_SUCCESS)) {
     if ((len >= bw->bw_size) && !alwaysCopy && (spaceUsedInBuffer(bw) == 0)) {
+      if (bw->bw_depth > 1) {
+        // Not all regions allow concurrent writes, so drain the queue.
+        result = waitForPendingWrites(bw, 0);
+        if (result != UDS_SUCCESS) {
+          break;
+        }
+      }
       size_t n = len / bw->bw_size * bw->bw_size;
       int result = writeToRegion(bw->bw_region, bw->bw_pos, dp, n, n);
       if (result == UDS_INCORRECT_ALIGNMENT) {
@@ -143,7 +341,7 @@ int writeToBufferedWriter(BufferedWriter *bw, const void *data, size_t len)
     bw->bw_ptr   += chunk;
 
     if (spaceRemainingInWriteBuffer(bw) == 0) {
-      result = flushBufferedWriter(bw);
+      result = writeBuffer(bw);
     }
   }
 
@@ -154,22 +352,11 @@ int writeToBufferedWriter(BufferedWriter *bw, const void *data, size_t len)
 /*****************************************************************************/
 int flushBufferedWriter(BufferedWriter *bw)
 {
-  if (bw->bw_err != UDS_SUCCESS) {
-    return bw->bw_err;
-  }
-
-  size_t n = spaceUsedInBuffer(bw);
-  if (n > 0) {
-    int result = writeToRegion(bw->bw_region, bw->bw_pos, bw->bw_buf,
-                               bw->bw_size, n);
-    if (result != UDS_SUCCESS) {
-      return bw->bw_err = result;
-    } else {
-      bw->bw_ptr =  bw->bw_buf;
-      bw->bw_pos += bw->bw_size;
-    }
+  int result = writeBuffer(bw);
+  if ((result != UDS_SUCCESS) || (bw->bw_depth == 1)) {
+    return result;
   }
-  return UDS_SUCCESS;
+  return waitForPendingWrites(bw, 0);
 }
 
 /*****************************************************************************/
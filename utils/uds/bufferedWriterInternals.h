@@ -23,16 +23,42 @@
 #define BUFFERED_WRITER_INTERNALS_H
 
 #include "bufferedWriter.h"
+#include "threads.h"
+
+/**
+ * A buffer which has been filled and handed to the IO thread of an
+ * asynchronous buffered writer.
+ **/
+typedef struct writeSlot {
+  char   *ws_buf;                  ///< the buffer
+  off_t   ws_pos;                  ///< offset at which to write the buffer
+  size_t  ws_length;               ///< length of the data in the buffer
+} WriteSlot;
 
 struct bufferedWriter {
-  IORegion *bw_region;             ///< region to write to
-  off_t     bw_pos;                ///< offset of start of buffer
-  size_t    bw_size;               ///< size of buffer
-  char     *bw_buf;                ///< start of buffer
-  char     *bw_ptr;                ///< end of written data
-  int       bw_err;                ///< error code
-  bool      bw_used;               ///< have writes been done?
-  bool      bw_close;              ///< do we have to close the region?
+  IORegion     *bw_region;         ///< region to write to
+  off_t         bw_pos;            ///< offset of start of buffer
+  size_t        bw_size;           ///< size of buffer
+  char         *bw_buf;            ///< start of buffer
+  char         *bw_ptr;            ///< end of written data
+  int           bw_err;            ///< error code
+  bool          bw_used;           ///< have writes been done?
+  bool          bw_close;          ///< do we have to close the region?
+  unsigned int  bw_depth;          ///< number of buffers
+  // The remaining fields are used only when bw_depth > 1
+  Thread        bw_thread;         ///< the thread writing filled buffers
+  Mutex         bw_mutex;          ///< protects the fields below
+  CondVar       bw_cond;           ///< signalled when a slot changes state
+  bool          bw_stop;           ///< tells the IO thread to exit
+  int           bw_ioErr;          ///< first error seen by the IO thread
+  unsigned int  bw_head;           ///< the oldest slot queued for writing
+  unsigned int  bw_pending;        ///< number of slots queued for writing
+  WriteSlot     bw_slots[];        ///< the buffers
 };
 
+// Invariants when bw_depth > 1:
+//   bw_pending <= bw_depth
+//   slot (bw_head + bw_pending) % bw_depth holds bw_buf while
+//   bw_pending < bw_depth
+
 #endif // BUFFERED_WRITER_INTERNALS_H
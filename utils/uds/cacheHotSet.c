@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/cacheHotSet.c#1 $
+ */
+
+#include "cacheHotSet.h"
+
+#include "buffer.h"
+#include "compiler.h"
+#include "logger.h"
+#include "memoryAlloc.h"
+#include "numeric.h"
+#include "permassert.h"
+#include "sparseCache.h"
+
+static int readCacheHotSet(ReadPortal *portal);
+static int writeCacheHotSet(IndexComponent *component,
+                            BufferedWriter *writer,
+                            unsigned int    zone);
+
+const IndexComponentInfo CACHE_HOT_SET_INFO = {
+  .kind        = RL_KIND_CACHE_HOT_SET,
+  .name        = "cache hot set",
+  .fileName    = "cache_hot_set",
+  .saveOnly    = true,
+  .chapterSync = false,
+  .multiZone   = false,
+  .optional    = true,
+  .loader      = readCacheHotSet,
+  .saver       = writeCacheHotSet,
+  .incremental = NULL,
+};
+
+static const byte CACHE_HOT_SET_MAGIC[]   = "ALBHS";
+static const byte CACHE_HOT_SET_VERSION[] = "01.00";
+
+enum {
+  CACHE_HOT_SET_MAGIC_LENGTH   = sizeof(CACHE_HOT_SET_MAGIC) - 1,
+  CACHE_HOT_SET_VERSION_LENGTH = sizeof(CACHE_HOT_SET_VERSION) - 1,
+  CACHE_HOT_SET_HEADER_LENGTH  = (CACHE_HOT_SET_MAGIC_LENGTH
+                                  + CACHE_HOT_SET_VERSION_LENGTH
+                                  + 2 * sizeof(uint32_t)),
+  MAX_HOT_SET_PAGES            = VOLUME_CACHE_MAX_ENTRIES,
+  MAX_HOT_SET_CHAPTERS         = UINT8_MAX,
+};
+
+/**********************************************************************/
+void freeCacheHotSet(CacheHotSet *hotSet)
+{
+  if (hotSet == NULL) {
+    return;
+  }
+  FREE(hotSet->pages);
+  FREE(hotSet->chapters);
+  FREE(hotSet);
+}
+
+/**********************************************************************/
+uint64_t computeSavedCacheHotSetSize(void)
+{
+  return (CACHE_HOT_SET_HEADER_LENGTH
+          + MAX_HOT_SET_PAGES * sizeof(uint32_t)
+          + MAX_HOT_SET_CHAPTERS * sizeof(uint64_t));
+}
+
+/**********************************************************************/
+static int encodeCacheHotSet(Buffer            *buffer,
+                             const CacheHotSet *hotSet)
+{
+  int result = putBytes(buffer, CACHE_HOT_SET_MAGIC_LENGTH,
+                        CACHE_HOT_SET_MAGIC);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putBytes(buffer, CACHE_HOT_SET_VERSION_LENGTH,
+                    CACHE_HOT_SET_VERSION);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putUInt32LEIntoBuffer(buffer, hotSet->pageCount);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putUInt32LEIntoBuffer(buffer, hotSet->chapterCount);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  for (unsigned int i = 0; i < hotSet->pageCount; i++) {
+    result = putUInt32LEIntoBuffer(buffer, hotSet->pages[i]);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+  return putUInt64LEsIntoBuffer(buffer, hotSet->chapterCount,
+                                hotSet->chapters);
+}
+
+/**********************************************************************/
+static int writeCacheHotSet(IndexComponent *component,
+                            BufferedWriter *writer,
+                            unsigned int    zone)
+{
+  int result = ASSERT((zone == 0), "cache hot set write not zoned");
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  Index *index = indexComponentData(component);
+  Volume *volume = index->volume;
+
+  CacheHotSet hotSet = { .pageCount = 0, .chapterCount = 0 };
+  result = ALLOCATE(MAX_HOT_SET_PAGES, unsigned int, "hot set pages",
+                    &hotSet.pages);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = ALLOCATE(MAX_HOT_SET_CHAPTERS, uint64_t, "hot set chapters",
+                    &hotSet.chapters);
+  if (result != UDS_SUCCESS) {
+    FREE(hotSet.pages);
+    return result;
+  }
+  hotSet.pageCount = getCachedPhysicalPages(volume->pageCache, hotSet.pages,
+                                            MAX_HOT_SET_PAGES);
+  if (volume->sparseCache != NULL) {
+    hotSet.chapterCount = getSparseCacheChapters(volume->sparseCache,
+                                                 hotSet.chapters,
+                                                 MAX_HOT_SET_CHAPTERS);
+  }
+
+  Buffer *buffer;
+  result = makeBuffer(computeSavedCacheHotSetSize(), &buffer);
+  if (result == UDS_SUCCESS) {
+    result = encodeCacheHotSet(buffer, &hotSet);
+    if (result == UDS_SUCCESS) {
+      result = writeToBufferedWriter(writer, getBufferContents(buffer),
+                                     contentLength(buffer));
+    }
+    freeBuffer(&buffer);
+  }
+  FREE(hotSet.pages);
+  FREE(hotSet.chapters);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  logDebug("saved cache hot set of %u pages and %u sparse chapters",
+           hotSet.pageCount, hotSet.chapterCount);
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+static int decodeCacheHotSet(BufferedReader *reader, CacheHotSet *hotSet)
+{
+  byte header[CACHE_HOT_SET_HEADER_LENGTH];
+  int result = readFromBufferedReader(reader, header, sizeof(header));
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  if (memcmp(header, CACHE_HOT_SET_MAGIC, CACHE_HOT_SET_MAGIC_LENGTH) != 0) {
+    return logWarningWithStringError(UDS_CORRUPT_COMPONENT,
+                                     "cache hot set magic is incorrect");
+  }
+  if (memcmp(header + CACHE_HOT_SET_MAGIC_LENGTH, CACHE_HOT_SET_VERSION,
+             CACHE_HOT_SET_VERSION_LENGTH) != 0) {
+    return logWarningWithStringError(UDS_UNSUPPORTED_VERSION,
+                                     "unknown cache hot set version: %.*s",
+                                     CACHE_HOT_SET_VERSION_LENGTH,
+                                     header + CACHE_HOT_SET_MAGIC_LENGTH);
+  }
+
+  const byte *counts = (header + CACHE_HOT_SET_MAGIC_LENGTH
+                        + CACHE_HOT_SET_VERSION_LENGTH);
+  hotSet->pageCount    = getUInt32LE(counts);
+  hotSet->chapterCount = getUInt32LE(counts + sizeof(uint32_t));
+  if ((hotSet->pageCount > MAX_HOT_SET_PAGES)
+      || (hotSet->chapterCount > MAX_HOT_SET_CHAPTERS)) {
+    return logWarningWithStringError(UDS_CORRUPT_COMPONENT,
+                                     "cache hot set counts %u and %u are"
+                                     " too large",
+                                     hotSet->pageCount, hotSet->chapterCount);
+  }
+
+  size_t length = (hotSet->pageCount * sizeof(uint32_t)
+                   + hotSet->chapterCount * sizeof(uint64_t));
+  Buffer *buffer;
+  result = makeBuffer(length, &buffer);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = readFromBufferedReader(reader, getBufferContents(buffer), length);
+  if (result == UDS_SUCCESS) {
+    result = resetBufferEnd(buffer, length);
+  }
+  if ((result == UDS_SUCCESS) && (hotSet->pageCount > 0)) {
+    result = ALLOCATE(hotSet->pageCount, unsigned int, "hot set pages",
+                      &hotSet->pages);
+  }
+  for (unsigned int i = 0;
+       (result == UDS_SUCCESS) && (i < hotSet->pageCount);
+       i++) {
+    uint32_t page;
+    result = getUInt32LEFromBuffer(buffer, &page);
+    hotSet->pages[i] = page;
+  }
+  if ((result == UDS_SUCCESS) && (hotSet->chapterCount > 0)) {
+    result = ALLOCATE(hotSet->chapterCount, uint64_t, "hot set chapters",
+                      &hotSet->chapters);
+    if (result == UDS_SUCCESS) {
+      result = getUInt64LEsFromBuffer(buffer, hotSet->chapterCount,
+                                      hotSet->chapters);
+    }
+  }
+  freeBuffer(&buffer);
+  return result;
+}
+
+/**********************************************************************/
+static int readCacheHotSet(ReadPortal *portal)
+{
+  Index *index = componentDataForPortal(portal);
+
+  BufferedReader *reader;
+  int result = getBufferedReaderForPortal(portal, 0, &reader);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  CacheHotSet *hotSet;
+  result = ALLOCATE(1, CacheHotSet, "cache hot set", &hotSet);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = decodeCacheHotSet(reader, hotSet);
+  if (result != UDS_SUCCESS) {
+    freeCacheHotSet(hotSet);
+    return result;
+  }
+
+  // Pages beyond the end of the volume can only come from a damaged save.
+  unsigned int pagesPerVolume = index->volume->geometry->pagesPerVolume;
+  for (unsigned int i = 0; i < hotSet->pageCount; i++) {
+    if ((hotSet->pages[i] == 0) || (hotSet->pages[i] > pagesPerVolume)
+        || ((i > 0) && (hotSet->pages[i] <= hotSet->pages[i - 1]))) {
+      freeCacheHotSet(hotSet);
+      return logWarningWithStringError(UDS_CORRUPT_COMPONENT,
+                                       "cache hot set page list is invalid");
+    }
+  }
+
+  freeCacheHotSet(index->hotSet);
+  index->hotSet = hotSet;
+  return UDS_SUCCESS;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/cacheHotSet.h#1 $
+ */
+
+#ifndef CACHE_HOT_SET_H
+#define CACHE_HOT_SET_H 1
+
+#include "common.h"
+#include "index.h"
+#include "indexComponent.h"
+
+extern const IndexComponentInfo CACHE_HOT_SET_INFO;
+
+/**
+ * The cache hot set records which volume pages were resident in the page
+ * cache, and which chapter indexes were in the sparse cache, when the index
+ * was saved, so that a restarted index can bring them back into memory
+ * instead of faulting them in one query at a time.
+ **/
+typedef struct cacheHotSet {
+  /** the number of physical volume pages in the hot set */
+  unsigned int  pageCount;
+  /** the physical volume page numbers, in ascending order */
+  unsigned int *pages;
+  /** the number of sparse chapters in the hot set */
+  unsigned int  chapterCount;
+  /** the sparse virtual chapter numbers, most recently used first */
+  uint64_t     *chapters;
+} CacheHotSet;
+
+/**
+ * Free a cache hot set.
+ *
+ * @param hotSet  the hot set to free (may be NULL)
+ **/
+void freeCacheHotSet(CacheHotSet *hotSet);
+
+/**
+ * Compute the number of bytes required to save the cache hot set of any
+ * index.
+ *
+ * @return the number of bytes required to save a cache hot set
+ **/
+uint64_t computeSavedCacheHotSetSize(void);
+
+#endif /* CACHE_HOT_SET_H */
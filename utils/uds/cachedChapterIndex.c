@@ -21,6 +21,7 @@
 
 #include "cachedChapterIndex.h"
 
+#include "atomicDefs.h"
 #include "memoryAlloc.h"
 
 /**********************************************************************/
@@ -28,6 +29,7 @@ int initializeCachedChapterIndex(CachedChapterIndex *chapter,
                                  const Geometry     *geometry)
 {
   chapter->virtualChapter  = UINT64_MAX;
+  chapter->decoded         = NULL;
 
   unsigned int pages = geometry->indexPagesPerChapter;
   int result = ALLOCATE(pages, ChapterIndexPage, "sparse ChapterIndexPages",
@@ -71,6 +73,7 @@ int cacheChapterIndex(CachedChapterIndex *chapter,
   // Mark the entry as valid--it's now in the cache.
   chapter->virtualChapter = virtualChapter;
   chapter->skipSearch     = false;
+  chapter->undecodable    = false;
 
   return UDS_SUCCESS;
 }
@@ -82,6 +85,15 @@ int searchCachedChapterIndex(CachedChapterIndex *chapter,
                              const UdsChunkName *name,
                              int                *recordPagePtr)
 {
+  const DecodedChapterIndex *decoded = READ_ONCE(chapter->decoded);
+  smp_read_barrier_depends();
+  if (decoded != NULL) {
+    // The decoded chapter is indexed by delta list, so the index page map
+    // isn't needed.
+    *recordPagePtr = searchDecodedChapterIndex(decoded, geometry, name);
+    return UDS_SUCCESS;
+  }
+
   // Find the indexPageNumber in the chapter that would have the chunk name.
   unsigned int physicalChapter
     = mapToPhysicalChapter(geometry, chapter->virtualChapter);
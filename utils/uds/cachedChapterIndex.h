@@ -56,8 +56,8 @@ typedef struct cachedIndexCounters CachedIndexCounters;
 struct __attribute__((aligned(CACHE_LINE_BYTES))) cachedChapterIndex {
   /**
    * The virtual chapter number of the cached chapter index. UINT64_MAX means
-   * this cache entry is unused. Must only be modified in the critical section
-   * in updateSparseCache().
+   * this cache entry is unused. Must only be modified by updateSparseCache()
+   * while no cache directory in use names this entry.
    **/
   uint64_t          virtualChapter;
 
@@ -82,6 +82,16 @@ struct __attribute__((aligned(CACHE_LINE_BYTES))) cachedChapterIndex {
   /** pointer to a cache-aligned array of raw index page data */
   byte             *pageData;
 
+  /**
+   * the decoded form of the index pages, or NULL. The sparse cache lends its
+   * few decoded chapter indexes to its hottest entries; this is only changed
+   * under the cache update mutex.
+   **/
+  DecodedChapterIndex *decoded;
+
+  /** set if the chapter has too many collisions to be decoded */
+  bool              undecodable;
+
   // The cache-aligned counters change often and are placed at the end of the
   // structure to prevent false sharing with the more stable fields above.
 
@@ -21,11 +21,16 @@
 
 #include "chapterIndex.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "compiler.h"
 #include "errors.h"
 #include "hashUtils.h"
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "numeric.h"
 #include "permassert.h"
 #include "uds.h"
 
@@ -301,6 +306,241 @@ int searchChapterIndexPage(ChapterIndexPage   *chapterIndexPage,
   return UDS_SUCCESS;
 }
 
+enum {
+  // The number of keys compared at once when searching a decoded delta list.
+  DECODED_KEY_BATCH = 4,
+  // The fraction of the entries of a decoded chapter which may be collisions.
+  DECODED_COLLISION_RATIO = 64,
+};
+
+/**********************************************************************/
+int initializeDecodedChapterIndex(DecodedChapterIndex *decoded,
+                                  const Geometry      *geometry)
+{
+  memset(decoded, 0, sizeof(*decoded));
+  // The batched key comparison is signed, and values are stored in 16 bits.
+  if ((geometry->chapterAddressBits >= 31)
+      || (geometry->chapterPayloadBits > 16)) {
+    return UDS_SUCCESS;
+  }
+
+  decoded->listCount     = geometry->deltaListsPerChapter;
+  decoded->maxEntries    = geometry->recordsPerChapter;
+  decoded->maxCollisions
+    = maxUInt(1, geometry->recordsPerChapter / DECODED_COLLISION_RATIO);
+
+  int result = ALLOCATE(decoded->listCount + 1, uint32_t,
+                        "decoded delta list starts", &decoded->listStarts);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  // Pad the keys so a batch starting at the last entry stays in bounds.
+  result = ALLOCATE(decoded->maxEntries + DECODED_KEY_BATCH, uint32_t,
+                    "decoded chapter index keys", &decoded->keys);
+  if (result != UDS_SUCCESS) {
+    destroyDecodedChapterIndex(decoded);
+    return result;
+  }
+  result = ALLOCATE(decoded->maxEntries, uint16_t,
+                    "decoded chapter index values", &decoded->values);
+  if (result != UDS_SUCCESS) {
+    destroyDecodedChapterIndex(decoded);
+    return result;
+  }
+  result = ALLOCATE(decoded->maxCollisions, uint32_t,
+                    "decoded chapter index collisions",
+                    &decoded->collisionEntries);
+  if (result != UDS_SUCCESS) {
+    destroyDecodedChapterIndex(decoded);
+    return result;
+  }
+  result = ALLOCATE(decoded->maxCollisions * COLLISION_BYTES, byte,
+                    "decoded chapter index collision names",
+                    &decoded->collisionNames);
+  if (result != UDS_SUCCESS) {
+    destroyDecodedChapterIndex(decoded);
+    return result;
+  }
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+void destroyDecodedChapterIndex(DecodedChapterIndex *decoded)
+{
+  FREE(decoded->listStarts);
+  FREE(decoded->keys);
+  FREE(decoded->values);
+  FREE(decoded->collisionEntries);
+  FREE(decoded->collisionNames);
+  memset(decoded, 0, sizeof(*decoded));
+}
+
+/**********************************************************************/
+size_t getDecodedChapterIndexSize(const Geometry *geometry)
+{
+  if ((geometry->chapterAddressBits >= 31)
+      || (geometry->chapterPayloadBits > 16)) {
+    return 0;
+  }
+  size_t collisions
+    = maxUInt(1, geometry->recordsPerChapter / DECODED_COLLISION_RATIO);
+  return (((geometry->deltaListsPerChapter + 1) * sizeof(uint32_t))
+          + ((geometry->recordsPerChapter + DECODED_KEY_BATCH)
+             * sizeof(uint32_t))
+          + (geometry->recordsPerChapter * sizeof(uint16_t))
+          + (collisions * (sizeof(uint32_t) + COLLISION_BYTES)));
+}
+
+/**********************************************************************/
+int decodeChapterIndexPages(DecodedChapterIndex    *decoded,
+                            const Geometry         *geometry,
+                            const ChapterIndexPage  pages[])
+{
+  decoded->valid = false;
+  if (decoded->keys == NULL) {
+    return UDS_SUCCESS;
+  }
+
+  unsigned int count      = 0;
+  unsigned int collisions = 0;
+  unsigned int nextList   = 0;
+  for (unsigned int i = 0; i < geometry->indexPagesPerChapter; i++) {
+    const DeltaIndex *deltaIndex = &pages[i].deltaIndex;
+    unsigned int lowestList = getDeltaIndexLowestListNumber(deltaIndex);
+    unsigned int listCount
+      = getDeltaIndexHighestListNumber(deltaIndex) + 1 - lowestList;
+    if ((lowestList < nextList)
+        || (lowestList + listCount > decoded->listCount)) {
+      // Each delta list must be on exactly one page.
+      return UDS_SUCCESS;
+    }
+    while (nextList < lowestList) {
+      decoded->listStarts[nextList++] = count;
+    }
+
+    for (unsigned int list = 0; list < listCount; list++) {
+      decoded->listStarts[nextList++] = count;
+      DeltaIndexEntry entry;
+      int result = startDeltaIndexSearch(deltaIndex, list, 0, true, &entry);
+      if (result != UDS_SUCCESS) {
+        return result;
+      }
+      for (;;) {
+        result = nextDeltaIndexEntry(&entry);
+        if (result != UDS_SUCCESS) {
+          return result;
+        }
+        if (entry.atEnd) {
+          break;
+        }
+        if (count >= decoded->maxEntries) {
+          return UDS_SUCCESS;
+        }
+        if (entry.isCollision) {
+          if (collisions >= decoded->maxCollisions) {
+            return UDS_SUCCESS;
+          }
+          decoded->collisionEntries[collisions] = count;
+          result = getDeltaEntryCollision(&entry,
+                                          &decoded->collisionNames[
+                                            collisions * COLLISION_BYTES]);
+          if (result != UDS_SUCCESS) {
+            return result;
+          }
+          collisions++;
+        }
+        decoded->keys[count]   = entry.key;
+        decoded->values[count] = getDeltaEntryValue(&entry);
+        count++;
+      }
+    }
+  }
+  while (nextList <= decoded->listCount) {
+    decoded->listStarts[nextList++] = count;
+  }
+
+  decoded->collisionCount = collisions;
+  decoded->valid          = true;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Find the first entry of a decoded delta list whose key is not less than a
+ * given key. Since the keys of a list are in ascending order, the keys less
+ * than the given key form a prefix of each batch compared.
+ *
+ * @param keys   The decoded keys
+ * @param start  The first entry of the delta list
+ * @param end    The entry after the last entry of the delta list
+ * @param key    The key to find
+ *
+ * @return the entry number of the first key not less than the given key, or
+ *         end if there is none
+ **/
+static INLINE unsigned int findDecodedKey(const uint32_t *keys,
+                                          unsigned int    start,
+                                          unsigned int    end,
+                                          uint32_t        key)
+{
+#if defined(__SSE2__)
+  __m128i target = _mm_set1_epi32((int) key);
+  for (unsigned int i = start; i < end; i += DECODED_KEY_BATCH) {
+    __m128i batch = _mm_loadu_si128((const __m128i *) &keys[i]);
+    unsigned int less
+      = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(batch, target)));
+    if (less != 0xF) {
+      // Any lanes past the end of the list are ignored by the clamp.
+      unsigned int position = i + __builtin_ctz(~less);
+      return ((position < end) ? position : end);
+    }
+  }
+  return end;
+#else
+  unsigned int i = start;
+  while ((i < end) && (keys[i] < key)) {
+    i++;
+  }
+  return i;
+#endif
+}
+
+/**********************************************************************/
+int searchDecodedChapterIndex(const DecodedChapterIndex *decoded,
+                              const Geometry            *geometry,
+                              const UdsChunkName        *name)
+{
+  unsigned int address = hashToChapterDeltaAddress(name, geometry);
+  unsigned int list    = hashToChapterDeltaList(name, geometry);
+  unsigned int end     = decoded->listStarts[list + 1];
+  unsigned int entry   = findDecodedKey(decoded->keys,
+                                        decoded->listStarts[list], end,
+                                        address);
+  if ((entry == end) || (decoded->keys[entry] != address)) {
+    return NO_CHAPTER_INDEX_ENTRY;
+  }
+
+  // Any collision entries for the same address follow the first entry, and
+  // one whose full name matches takes precedence.
+  if (decoded->collisionCount > 0) {
+    unsigned int c = 0;
+    while ((c < decoded->collisionCount)
+           && (decoded->collisionEntries[c] <= entry)) {
+      c++;
+    }
+    for (unsigned int next = entry + 1;
+         (next < end) && (decoded->keys[next] == address)
+           && (c < decoded->collisionCount)
+           && (decoded->collisionEntries[c] == next);
+         next++, c++) {
+      if (memcmp(&decoded->collisionNames[c * COLLISION_BYTES], name->name,
+                 COLLISION_BYTES) == 0) {
+        return decoded->values[next];
+      }
+    }
+  }
+  return decoded->values[entry];
+}
+
 /**********************************************************************/
 uint64_t getChapterIndexVirtualChapterNumber(const ChapterIndexPage *page)
 {
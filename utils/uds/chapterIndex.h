@@ -42,6 +42,35 @@ typedef struct chapterIndexPage {
   DeltaMemory deltaMemory;
 } ChapterIndexPage;
 
+/**
+ * The entries of all the index pages of a chapter, decoded from their delta
+ * lists into flat arrays. The keys of each delta list are kept in ascending
+ * order, so a search needs no bit-level decoding and can compare a batch of
+ * keys at once.
+ **/
+typedef struct decodedChapterIndex {
+  /** whether the arrays hold a complete decoded chapter */
+  bool          valid;
+  /** the number of delta lists in a chapter */
+  unsigned int  listCount;
+  /** the largest number of entries the arrays can hold */
+  unsigned int  maxEntries;
+  /** the largest number of collision entries the arrays can hold */
+  unsigned int  maxCollisions;
+  /** the number of collision entries in the decoded chapter */
+  unsigned int  collisionCount;
+  /** the first entry of each delta list, followed by the entry count */
+  uint32_t     *listStarts;
+  /** the key (address) of each entry */
+  uint32_t     *keys;
+  /** the value (record page number) of each entry */
+  uint16_t     *values;
+  /** the entry number of each collision entry, in ascending order */
+  uint32_t     *collisionEntries;
+  /** the full chunk name of each collision entry */
+  byte         *collisionNames;
+} DecodedChapterIndex;
+
 
 /**
  * Make a new open chapter index.
@@ -184,6 +213,68 @@ int searchChapterIndexPage(ChapterIndexPage   *chapterIndexPage,
                            int                *recordPagePtr)
   __attribute__((warn_unused_result));
 
+/**
+ * Allocate the arrays of a decoded chapter index. If the geometry does not
+ * allow a chapter to be decoded, no arrays are allocated and the decoded
+ * chapter index will never become valid.
+ *
+ * @param decoded   The decoded chapter index to initialize
+ * @param geometry  The geometry of the volume
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int initializeDecodedChapterIndex(DecodedChapterIndex *decoded,
+                                  const Geometry      *geometry)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free the arrays of a decoded chapter index.
+ *
+ * @param decoded  The decoded chapter index to destroy
+ **/
+void destroyDecodedChapterIndex(DecodedChapterIndex *decoded);
+
+/**
+ * Get the number of bytes of memory used by a decoded chapter index.
+ *
+ * @param geometry  The geometry of the volume
+ *
+ * @return the size of the arrays allocated for a decoded chapter index
+ **/
+size_t getDecodedChapterIndexSize(const Geometry *geometry);
+
+/**
+ * Decode all the index pages of a chapter. If the chapter has more collision
+ * entries than the decoded chapter index can hold, it is left invalid, and
+ * the index pages must be searched instead.
+ *
+ * @param decoded   The decoded chapter index to fill in
+ * @param geometry  The geometry of the volume
+ * @param pages     The initialized index pages of the chapter
+ *
+ * @return UDS_SUCCESS or an error code if a delta list could not be decoded
+ **/
+int decodeChapterIndexPages(DecodedChapterIndex    *decoded,
+                            const Geometry         *geometry,
+                            const ChapterIndexPage  pages[])
+  __attribute__((warn_unused_result));
+
+/**
+ * Search a valid decoded chapter index for a chunk name, returning the record
+ * page number that may contain the name. This finds the same entry as
+ * searchChapterIndexPage() on the index page holding the name's delta list.
+ *
+ * @param decoded   The decoded chapter index
+ * @param geometry  The geometry of the volume
+ * @param name      The chunk name
+ *
+ * @return the record page number or NO_CHAPTER_INDEX_ENTRY if not found
+ **/
+int searchDecodedChapterIndex(const DecodedChapterIndex *decoded,
+                              const Geometry            *geometry,
+                              const UdsChunkName        *name)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the virtual chapter number from an immutable chapter index page.
  *
@@ -282,6 +282,11 @@ bool areUdsConfigurationsEqual(UdsConfiguration a, UdsConfiguration b)
              a->nonce, b->nonce);
     result = false;
   }
+  if (a->packedMetadataBytes != b->packedMetadataBytes) {
+    logError("Packed metadata bytes (%u) does not match (%u)",
+             a->packedMetadataBytes, b->packedMetadataBytes);
+    result = false;
+  }
   return result;
 }
 
@@ -298,7 +303,8 @@ int printUdsConfiguration(UdsConfiguration conf, int indent, char **output)
                             "%*sMaster index mean delta:    %10u\n"
                             "%*sBytes per page:             %10u\n"
                             "%*sSparse sample rate:         %10u\n"
-                            "%*sNonce:                      %" PRIu64,
+                            "%*sNonce:                      %" PRIu64 "\n"
+                            "%*sPacked metadata bytes:      %10u",
                             indent, "", conf->recordPagesPerChapter,
                             indent, "", conf->chaptersPerVolume,
                             indent, "", conf->sparseChaptersPerVolume,
@@ -307,7 +313,8 @@ int printUdsConfiguration(UdsConfiguration conf, int indent, char **output)
                             indent, "", conf->masterIndexMeanDelta,
                             indent, "", conf->bytesPerPage,
                             indent, "", conf->sparseSampleRate,
-                            indent, "", conf->nonce);
+                            indent, "", conf->nonce,
+                            indent, "", conf->packedMetadataBytes);
   if (result != UDS_SUCCESS) {
     return result;
   }
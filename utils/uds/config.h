@@ -55,6 +55,8 @@ struct udsConfiguration {
   unsigned int sparseSampleRate;
   /** Index Owner's nonce */
   UdsNonce     nonce;
+  /** Bytes of metadata offset in a packed record, or 0 if not packed */
+  unsigned int packedMetadataBytes;
 };
 
 /**
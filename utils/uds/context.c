@@ -27,6 +27,7 @@
 #include "hashUtils.h"
 #include "indexSession.h"
 #include "logger.h"
+#include "lookupCache.h"
 #include "memoryAlloc.h"
 #include "parameter.h"
 #include "permassert.h"
@@ -163,6 +164,7 @@ void freeContext(UdsContext *context)
   if (context->indexSession != NULL) {
     releaseIndexSession(context->indexSession);
   }
+  freeLookupCache(context->lookupCache);
   FREE(context);
 }
 
@@ -201,8 +203,18 @@ int makeBaseContext(IndexSession *indexSession, UdsContext **contextPtr)
     return result;
   }
 
+  unsigned int lookupCacheSize = getLookupCacheSize();
+  if (lookupCacheSize > 0) {
+    result = makeLookupCache(lookupCacheSize, &context->lookupCache);
+    if (result != UDS_SUCCESS) {
+      FREE(context);
+      return result;
+    }
+  }
+
   context->indexSession = indexSession;
   context->contextState = UDS_CS_READY;
+  context->priority     = UDS_PRIORITY_NORMAL;
   *contextPtr = context;
   return UDS_SUCCESS;
 }
@@ -228,6 +240,32 @@ int flushContext(unsigned int contextId)
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+int setContextPriority(unsigned int contextId, UdsRequestPriority priority)
+{
+  if ((unsigned int) priority >= UDS_PRIORITY_CLASS_COUNT) {
+    return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                   "invalid request priority %d", priority);
+  }
+
+  UdsContext *context;
+  int result = getBaseContext(contextId, &context);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  WRITE_ONCE(context->priority, priority);
+  releaseBaseContext(context);
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+int udsSetBlockContextPriority(UdsBlockContext    context,
+                               UdsRequestPriority priority)
+{
+  return setContextPriority(context.id, priority);
+}
+
 /**********************************************************************/
 int getContextIndexStats(unsigned int contextId, UdsIndexStats *stats)
 {
@@ -254,6 +292,12 @@ int getContextIndexStats(unsigned int contextId, UdsIndexStats *stats)
   stats->collisions       = routerStats.collisions;
   stats->entriesDiscarded = routerStats.entriesDiscarded;
   stats->checkpoints      = routerStats.checkpoints;
+  memcpy(stats->queueClasses, routerStats.queueClasses,
+         sizeof(stats->queueClasses));
+  stats->scrub            = routerStats.scrub;
+  memcpy(stats->dedupeWindows, routerStats.dedupeWindows,
+         sizeof(stats->dedupeWindows));
+  stats->sampling         = routerStats.sampling;
 
   return handleErrorAndReleaseBaseContext(context, result);
 }
@@ -308,6 +352,7 @@ static void collectStats(const UdsContext *context, UdsContextStats *stats)
   stats->deletionsNotFound  = sessionStats->deletionsNotFound;
   stats->queriesFound       = sessionStats->queriesFound;
   stats->queriesNotFound    = sessionStats->queriesNotFound;
+  stats->lookupCacheHits    = sessionStats->lookupCacheHits;
   stats->requests           = sessionStats->requests;
 }
 
@@ -47,6 +47,10 @@ typedef struct udsContext {
   UdsContextState  contextState;
   /* The index and session which own this context */
   IndexSession    *indexSession;
+  /* The priority class of requests started on this context */
+  UdsRequestPriority priority;
+  /* The recent query results of this context, if it keeps any */
+  struct lookupCache *lookupCache;
   Session          session;
 } UdsContext;
 
@@ -137,6 +141,17 @@ void freeContext(UdsContext *context);
  **/
 int flushContext(unsigned int contextId) __attribute__((warn_unused_result));
 
+/**
+ * Set the priority class of the requests started on a given context.
+ *
+ * @param contextId   The id of the context
+ * @param priority    The priority class for the context's requests
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int setContextPriority(unsigned int contextId, UdsRequestPriority priority)
+  __attribute__((warn_unused_result));
+
 /**
  * Close a context.
  *
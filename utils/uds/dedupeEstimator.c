@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/dedupeEstimator.c#1 $
+ */
+
+
+#include "dedupeEstimator.h"
+
+#include <math.h>
+
+#include "hashUtils.h"
+#include "memoryAlloc.h"
+#include "seqLock.h"
+
+// The number of times a merge may find that the zone started a new epoch
+// while it was copying the sketches before it excludes the zone instead.
+enum { MAX_OPTIMISTIC_MERGES = 8 };
+
+struct dedupeEstimator {
+  /** Held by the zone while it clears the sketch of a new epoch */
+  SeqLock      lock;
+  /** The epoch receiving new names */
+  unsigned int currentEpoch;
+  /** The number of epochs started, so young windows are not overcounted */
+  uint64_t     epochCount;
+  /** The number of names recorded in each epoch */
+  uint64_t     epochNames[DEDUPE_EPOCHS];
+  /** The number of names recorded since the zone was made */
+  uint64_t     lifetimeNames;
+  /** The sketch of every name recorded since the zone was made */
+  HyperLogLog  lifetime;
+  /** The sketches of the names recorded in each epoch */
+  HyperLogLog  epochs[DEDUPE_EPOCHS];
+};
+
+/*
+ * The number of chapters covered by each reported window; zero means the
+ * lifetime of the zone.
+ */
+static const unsigned int windowChapters[UDS_DEDUPE_WINDOW_COUNT] = {
+  1, 8, DEDUPE_EPOCHS, 0,
+};
+
+/**********************************************************************/
+int makeDedupeEstimator(DedupeEstimator **estimatorPtr)
+{
+  DedupeEstimator *estimator;
+  int result = ALLOCATE(1, DedupeEstimator, "dedupe estimator", &estimator);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = initSeqLock(&estimator->lock);
+  if (result != UDS_SUCCESS) {
+    FREE(estimator);
+    return result;
+  }
+  estimator->epochCount = 1;
+  *estimatorPtr = estimator;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+void freeDedupeEstimator(DedupeEstimator *estimator)
+{
+  if (estimator == NULL) {
+    return;
+  }
+  destroySeqLock(&estimator->lock);
+  FREE(estimator);
+}
+
+/**********************************************************************/
+static INLINE void addToHyperLogLog(HyperLogLog *sketch,
+                                    unsigned int index,
+                                    byte         rank)
+{
+  if (sketch->registers[index] < rank) {
+    sketch->registers[index] = rank;
+  }
+}
+
+/**********************************************************************/
+void recordDedupeName(DedupeEstimator *estimator, const UdsChunkName *name)
+{
+  uint64_t hash = extractEstimatorBytes(name);
+  // The top bits choose the register, and the rank is the position of the
+  // first one bit in the rest. The sentinel bit bounds the rank.
+  unsigned int index = hash >> (64 - HLL_PRECISION);
+  uint64_t rest = (hash << HLL_PRECISION) | (1ULL << (HLL_PRECISION - 1));
+  byte rank = __builtin_clzll(rest) + 1;
+
+  addToHyperLogLog(&estimator->epochs[estimator->currentEpoch], index, rank);
+  addToHyperLogLog(&estimator->lifetime, index, rank);
+  estimator->epochNames[estimator->currentEpoch]++;
+  estimator->lifetimeNames++;
+}
+
+/**********************************************************************/
+void advanceDedupeEpoch(DedupeEstimator *estimator)
+{
+  unsigned int next = (estimator->currentEpoch + 1) % DEDUPE_EPOCHS;
+  writeLockSeqLock(&estimator->lock);
+  memset(&estimator->epochs[next], 0, sizeof(HyperLogLog));
+  estimator->epochNames[next] = 0;
+  estimator->currentEpoch = next;
+  estimator->epochCount++;
+  writeUnlockSeqLock(&estimator->lock);
+}
+
+/**********************************************************************/
+unsigned int getDedupeWindowChapters(unsigned int window)
+{
+  return windowChapters[window];
+}
+
+/**********************************************************************/
+static void mergeHyperLogLog(HyperLogLog *merged, const HyperLogLog *sketch)
+{
+  for (unsigned int i = 0; i < HLL_REGISTERS; i++) {
+    addToHyperLogLog(merged, i, sketch->registers[i]);
+  }
+}
+
+/**
+ * Merge the sketches of one window of an estimator into a sketch, without
+ * regard to the zone thread.
+ *
+ * @param estimator  The estimator of the zone
+ * @param window     The window number
+ * @param merged     The sketch to merge into
+ *
+ * @return the number of names recorded by the zone in the window
+ **/
+static uint64_t copyDedupeWindow(const DedupeEstimator *estimator,
+                                 unsigned int           window,
+                                 HyperLogLog           *merged)
+{
+  unsigned int chapters = windowChapters[window];
+  if (chapters == 0) {
+    mergeHyperLogLog(merged, &estimator->lifetime);
+    return estimator->lifetimeNames;
+  }
+
+  if (chapters > estimator->epochCount) {
+    chapters = estimator->epochCount;
+  }
+  uint64_t names = 0;
+  unsigned int epoch = estimator->currentEpoch;
+  for (unsigned int i = 0; i < chapters; i++) {
+    mergeHyperLogLog(merged, &estimator->epochs[epoch]);
+    names += estimator->epochNames[epoch];
+    epoch = (epoch + DEDUPE_EPOCHS - 1) % DEDUPE_EPOCHS;
+  }
+  return names;
+}
+
+/**********************************************************************/
+uint64_t estimateHyperLogLog(const HyperLogLog *sketch)
+{
+  const double registers = HLL_REGISTERS;
+  double sum = 0.0;
+  unsigned int zeros = 0;
+  for (unsigned int i = 0; i < HLL_REGISTERS; i++) {
+    sum += ldexp(1.0, -sketch->registers[i]);
+    if (sketch->registers[i] == 0) {
+      zeros++;
+    }
+  }
+
+  double alpha = 0.7213 / (1.0 + 1.079 / registers);
+  double estimate = alpha * registers * registers / sum;
+  if ((estimate <= 2.5 * registers) && (zeros > 0)) {
+    // Linear counting is more accurate while many registers are empty.
+    estimate = registers * log(registers / zeros);
+  }
+  return (uint64_t) (estimate + 0.5);
+}
+
+/**********************************************************************/
+uint64_t mergeDedupeWindow(DedupeEstimator *estimator,
+                           unsigned int     window,
+                           HyperLogLog     *scratch,
+                           HyperLogLog     *merged)
+{
+  // Recording a name only raises registers of the current epoch, so a
+  // copy which races with it is merely missing the newest names. Only a
+  // copy which races with the clearing of a new epoch must be redone.
+  uint64_t names;
+  for (unsigned int attempt = 0; ; attempt++) {
+    memset(scratch, 0, sizeof(HyperLogLog));
+    if (attempt == MAX_OPTIMISTIC_MERGES) {
+      readLockSeqLock(&estimator->lock);
+      names = copyDedupeWindow(estimator, window, scratch);
+      readUnlockSeqLock(&estimator->lock);
+      break;
+    }
+    int sequence;
+    if (!beginReadSeqLock(&estimator->lock, &sequence)) {
+      continue;
+    }
+    names = copyDedupeWindow(estimator, window, scratch);
+    if (endReadSeqLock(&estimator->lock, sequence)) {
+      break;
+    }
+  }
+  mergeHyperLogLog(merged, scratch);
+  return names;
+}
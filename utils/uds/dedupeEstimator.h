@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/dedupeEstimator.h#1 $
+ */
+
+
+#ifndef DEDUPE_ESTIMATOR_H
+#define DEDUPE_ESTIMATOR_H
+
+#include "common.h"
+#include "uds.h"
+
+/**
+ * A dedupe estimator counts the chunk names posted to one index zone with
+ * HyperLogLog sketches, so that the number of distinct names, and hence the
+ * dedupe ratio, can be estimated for spans much longer than the index
+ * remembers. A zone keeps one sketch for each of its most recent chapters
+ * (epochs) plus one for its whole lifetime. Recording a name costs a hash
+ * mix and one byte update; all of the merging and estimation happens when
+ * statistics are requested. The zone thread is the only writer. It starts
+ * each new epoch under a sequence lock, so that statistics readers never
+ * merge a sketch which is being cleared.
+ **/
+enum {
+  /** log2 of the number of registers, for a standard error of 1.6% */
+  HLL_PRECISION = 12,
+  HLL_REGISTERS = 1 << HLL_PRECISION,
+  /** The number of chapter epochs kept */
+  DEDUPE_EPOCHS = 64,
+};
+
+typedef struct hyperLogLog {
+  byte registers[HLL_REGISTERS];
+} HyperLogLog;
+
+typedef struct dedupeEstimator DedupeEstimator;
+
+/**
+ * Make a dedupe estimator.
+ *
+ * @param estimatorPtr  A pointer to hold the new estimator
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int makeDedupeEstimator(DedupeEstimator **estimatorPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a dedupe estimator.
+ *
+ * @param estimator  The estimator to free
+ **/
+void freeDedupeEstimator(DedupeEstimator *estimator);
+
+/**
+ * Record a chunk name which was posted to the zone.
+ *
+ * @param estimator  The estimator of the zone
+ * @param name       The chunk name
+ **/
+void recordDedupeName(DedupeEstimator *estimator, const UdsChunkName *name);
+
+/**
+ * Start a new epoch when the zone opens a new chapter, discarding the
+ * oldest epoch.
+ *
+ * @param estimator  The estimator of the zone
+ **/
+void advanceDedupeEpoch(DedupeEstimator *estimator);
+
+/**
+ * Get the number of chapters covered by a dedupe window.
+ *
+ * @param window  The window number, less than UDS_DEDUPE_WINDOW_COUNT
+ *
+ * @return the number of chapters, or 0 for the lifetime window
+ **/
+unsigned int getDedupeWindowChapters(unsigned int window);
+
+/**
+ * Merge the sketches of one window of a zone's estimator into a sketch.
+ * This may be called from any thread while the zone is running.
+ *
+ * @param estimator  The estimator of the zone
+ * @param window     The window number, less than UDS_DEDUPE_WINDOW_COUNT
+ * @param scratch    A sketch to copy the window into before merging it
+ * @param merged     The sketch to merge into
+ *
+ * @return the number of names recorded by the zone in the window
+ **/
+uint64_t mergeDedupeWindow(DedupeEstimator *estimator,
+                           unsigned int     window,
+                           HyperLogLog     *scratch,
+                           HyperLogLog     *merged);
+
+/**
+ * Estimate the number of distinct names recorded in a sketch.
+ *
+ * @param sketch  The sketch
+ *
+ * @return the estimated number of distinct names
+ **/
+uint64_t estimateHyperLogLog(const HyperLogLog *sketch);
+
+#endif /* DEDUPE_ESTIMATOR_H */
@@ -587,9 +587,11 @@ int initializeDeltaIndex(DeltaIndex *deltaIndex, unsigned int numZones,
       }
       numListsInZone = deltaIndex->numLists - firstListInZone;
     }
+    UdsMemoryComponent previous = setMemoryComponent(UDS_MEMORY_DELTA_MEMORY);
     int result = initializeDeltaMemory(&deltaIndex->deltaZones[z], memSize,
                                        firstListInZone, numListsInZone,
                                        meanDelta, numPayloadBits);
+    setMemoryComponent(previous);
     if (result != UDS_SUCCESS) {
       uninitializeDeltaIndex(deltaIndex);
       return result;
@@ -961,6 +963,14 @@ int startRestoringDeltaIndex(const DeltaIndex  *deltaIndex,
                                      collisionCount, recordCount);
   }
 
+  // The saved zones need not match the current ones.  Each delta list is
+  // restored into whichever zone now owns its list number, so the index
+  // can be loaded with a different zone count than it was saved with.
+  if (numZones != deltaIndex->numZones) {
+    logInfo("re-partitioning delta index '%c' from %u zones to %u zones",
+            deltaIndex->tag, numZones, deltaIndex->numZones);
+  }
+
   emptyDeltaIndex(deltaIndex);
   deltaIndex->deltaZones[0].recordCount    = recordCount;
   deltaIndex->deltaZones[0].collisionCount = collisionCount;
@@ -1317,16 +1327,22 @@ int rememberDeltaIndexOffset(const DeltaIndexEntry *deltaEntry)
   return UDS_SUCCESS;
 }
 
-/**********************************************************************/
-int getDeltaIndexEntry(const DeltaIndex *deltaIndex, unsigned int listNumber,
-                       unsigned int key, const byte *name, bool readOnly,
-                       DeltaIndexEntry *deltaEntry)
+/**
+ * Finish a search started by startDeltaIndexSearch(), finding the delta
+ * index entry or the insertion point for a delta index entry.
+ *
+ * @param key         The key field being looked for
+ * @param name        The 256 bit full name
+ * @param deltaEntry  The search in progress, updated to describe the entry
+ *                    being looked for
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int findDeltaIndexEntry(unsigned int     key,
+                               const byte      *name,
+                               DeltaIndexEntry *deltaEntry)
 {
-  int result = startDeltaIndexSearch(deltaIndex, listNumber, key, readOnly,
-                                     deltaEntry);
-  if (result != UDS_SUCCESS) {
-    return result;
-  }
+  int result;
   do {
     result = nextDeltaIndexEntry(deltaEntry);
     if (result != UDS_SUCCESS) {
@@ -1363,6 +1379,79 @@ int getDeltaIndexEntry(const DeltaIndex *deltaIndex, unsigned int listNumber,
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+int getDeltaIndexEntry(const DeltaIndex *deltaIndex, unsigned int listNumber,
+                       unsigned int key, const byte *name, bool readOnly,
+                       DeltaIndexEntry *deltaEntry)
+{
+  int result = startDeltaIndexSearch(deltaIndex, listNumber, key, readOnly,
+                                     deltaEntry);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  return findDeltaIndexEntry(key, name, deltaEntry);
+}
+
+/**********************************************************************/
+int snapshotDeltaList(const DeltaIndex  *deltaIndex,
+                      unsigned int       listNumber,
+                      DeltaListSnapshot *snapshot)
+{
+  unsigned int zoneNumber = getDeltaIndexZone(deltaIndex, listNumber);
+  const DeltaMemory *deltaZone = &deltaIndex->deltaZones[zoneNumber];
+  listNumber -= deltaZone->firstList;
+  if (!deltaIndex->isMutable || (listNumber >= deltaZone->numLists)) {
+    return UDS_CORRUPT_DATA;
+  }
+
+  // Copy the header once; a concurrent writer may change it at any time.
+  DeltaList header = deltaZone->deltaLists[listNumber + 1];
+  uint64_t memoryBits
+    = (deltaZone->size - POST_FIELD_GUARD_BYTES) * (uint64_t) CHAR_BIT;
+  if ((header.startOffset > memoryBits)
+      || (header.size > memoryBits - header.startOffset)) {
+    return UDS_CORRUPT_DATA;
+  }
+
+  unsigned int bitOffset = header.startOffset % CHAR_BIT;
+  size_t byteCount = (bitOffset + header.size + CHAR_BIT - 1) / CHAR_BIT;
+  memcpy(snapshot->bytes, deltaZone->memory + header.startOffset / CHAR_BIT,
+         byteCount);
+  // Guard the copy so that decoding stops even if the copy is inconsistent.
+  memset(snapshot->bytes + byteCount, ~0, POST_FIELD_GUARD_BYTES);
+
+  snapshot->deltaList = (DeltaList) {
+    .startOffset = bitOffset,
+    .size        = header.size,
+  };
+  snapshot->deltaZone = (DeltaMemory) {
+    .memory    = snapshot->bytes,
+    .size      = byteCount + POST_FIELD_GUARD_BYTES,
+    .minBits   = deltaZone->minBits,
+    .minKeys   = deltaZone->minKeys,
+    .incrKeys  = deltaZone->incrKeys,
+    .valueBits = deltaZone->valueBits,
+    .firstList = deltaZone->firstList + listNumber,
+    .numLists  = 1,
+    .tag       = deltaZone->tag,
+  };
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+int getDeltaListSnapshotEntry(DeltaListSnapshot *snapshot,
+                              unsigned int       key,
+                              const byte        *name,
+                              DeltaIndexEntry   *deltaEntry)
+{
+  *deltaEntry = (DeltaIndexEntry) {
+    .deltaZone = &snapshot->deltaZone,
+    .deltaList = &snapshot->deltaList,
+    .valueBits = snapshot->deltaZone.valueBits,
+  };
+  return findDeltaIndexEntry(key, name, deltaEntry);
+}
+
 /**********************************************************************/
 int getDeltaEntryCollision(const DeltaIndexEntry *deltaEntry, byte *name)
 {
@@ -88,6 +88,18 @@ typedef struct deltaIndexEntry {
   DeltaList      tempDeltaList; // Temporary delta list for immutable indices
 } DeltaIndexEntry;
 
+/**
+ * A private copy of one delta list of a mutable delta index. A snapshot can
+ * be taken while another thread is modifying the index, in which case its
+ * contents may be inconsistent, so the caller must use some other means of
+ * detecting concurrent modification (such as a SeqLock) before searching it.
+ **/
+typedef struct deltaListSnapshot {
+  DeltaMemory deltaZone;   // The coding parameters, with memory == bytes
+  DeltaList   deltaList;   // The list header, relative to bytes
+  byte        bytes[DELTA_LIST_MAX_BYTE_COUNT + POST_FIELD_GUARD_BYTES];
+} DeltaListSnapshot;
+
 typedef struct {
   size_t memoryAllocated;  // Number of bytes allocated
   RelTime rebalanceTime;   // The time spent rebalancing
@@ -373,6 +385,43 @@ int getDeltaIndexEntry(const DeltaIndex *deltaIndex, unsigned int listNumber,
                        DeltaIndexEntry *deltaEntry)
   __attribute__((warn_unused_result));
 
+/**
+ * Copy a delta list of a mutable delta index into a snapshot. This reads
+ * the delta list without writing to any shared memory, and is safe to call
+ * while another thread is modifying the delta index: the result is then
+ * merely inconsistent. No errors are logged, since a failure may only be
+ * the result of such a race.
+ *
+ * @param deltaIndex  The delta index
+ * @param listNumber  The delta list number
+ * @param snapshot    The snapshot to fill in
+ *
+ * @return UDS_SUCCESS, or UDS_CORRUPT_DATA if the delta list header does
+ *         not describe a list within the delta memory
+ **/
+int snapshotDeltaList(const DeltaIndex  *deltaIndex,
+                      unsigned int       listNumber,
+                      DeltaListSnapshot *snapshot)
+  __attribute__((warn_unused_result));
+
+/**
+ * Find a delta index entry, or the insertion point for a delta index entry,
+ * in a snapshot of a delta list. The entry refers to the snapshot, so it
+ * may only be examined, not used to modify the delta index.
+ *
+ * @param snapshot    A snapshot taken by snapshotDeltaList()
+ * @param key         The key field being looked for
+ * @param name        The 256 bit full name
+ * @param deltaEntry  Updated to describe the entry being looked for
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int getDeltaListSnapshotEntry(DeltaListSnapshot *snapshot,
+                              unsigned int       key,
+                              const byte        *name,
+                              DeltaIndexEntry   *deltaEntry)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the full name from a collision DeltaIndexEntry
  *
@@ -366,7 +366,12 @@ int startRestoringDeltaMemory(DeltaMemory *deltaMemory)
   // Extend and balance memory to receive the delta lists
   int result = extendDeltaMemory(deltaMemory, 0, 0, false);
   if (result != UDS_SUCCESS) {
-    return UDS_SUCCESS;
+    return logWarningWithStringError(result,
+                                     "delta lists %u to %u do not fit in"
+                                     " their zone memory",
+                                     deltaMemory->firstList,
+                                     deltaMemory->firstList
+                                     + deltaMemory->numLists - 1);
   }
 
   // The tail guard list needs to be set to ones
@@ -29,6 +29,7 @@
 typedef struct fileIORegion {
   IORegion common;
   int      fd;
+  int      directFd;
   bool     close;
   bool     reading;
   bool     writing;
@@ -93,6 +94,23 @@ void setFileRegionCloseBehavior(IORegion *region, bool closeFile)
   fior->close = closeFile;
 }
 
+/*****************************************************************************/
+int setFileRegionDirectReads(IORegion *region, const char *path)
+{
+  FileIORegion *fior = asFileIORegion(region);
+  if (fior->directFd >= 0) {
+    return UDS_SUCCESS;
+  }
+
+  int fd = -1;
+  int result = openFile(path, FU_READ_ONLY_DIRECT, &fd);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  fior->directFd = fd;
+  return UDS_SUCCESS;
+}
+
 /*****************************************************************************/
 static int validateIO(FileIORegion *fior,
                       off_t         offset,
@@ -137,6 +155,9 @@ static int fior_close(IORegion *region)
   if (fior->close) {
     result = closeFile(fior->fd, NULL);
   }
+  if (fior->directFd >= 0) {
+    tryCloseFile(fior->directFd);
+  }
   FREE(fior);
   return result;
 }
@@ -205,6 +226,14 @@ static int fior_read(IORegion *region,
   }
 
   if (length == NULL) {
+    // Whole aligned pages bypass the kernel page cache when direct reads
+    // have been enabled; anything else takes the buffered path.
+    if ((fior->directFd >= 0)
+        && ((uintptr_t) buffer % IO_BUFFER_ALIGNMENT == 0)
+        && (offset % IO_BUFFER_ALIGNMENT == 0)
+        && (size % IO_BUFFER_ALIGNMENT == 0)) {
+      return readBufferAtOffset(fior->directFd, offset, buffer, size);
+    }
     return readBufferAtOffset(fior->fd, offset, buffer, size);
   }
 
@@ -277,6 +306,7 @@ int makeFileRegion(int fd, FileAccess access, IORegion **regionPtr)
   fior->common.syncContents = fior_syncContents;
   fior->common.write        = fior_write;
   fior->fd          = fd;
+  fior->directFd    = -1;
   fior->close       = false;
   fior->reading     = (access <= FU_CREATE_READ_WRITE);
   fior->writing     = (access >= FU_READ_WRITE);
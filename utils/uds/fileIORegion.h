@@ -71,4 +71,22 @@ int setFileRegionLimit(IORegion *region, off_t limit)
  **/
 void setFileRegionCloseBehavior(IORegion *region, bool closeFile);
 
+/**
+ * Enable O_DIRECT reads on a file IO region. A second descriptor for the
+ * file is opened with O_DIRECT, and subsequent full reads whose buffer,
+ * offset, and size are all multiples of IO_BUFFER_ALIGNMENT are served
+ * through it, bypassing the kernel page cache. All other reads, and all
+ * writes, continue to use the original descriptor.
+ *
+ * @param region                An IORegion created by makeFileRegion() or
+ *                                openFileRegion().
+ * @param path                  The pathname of the file underlying the
+ *                                region.
+ *
+ * @return UDS_SUCCESS or an error code, in which case the region is
+ *         unchanged and continues to use buffered reads.
+ **/
+int setFileRegionDirectReads(IORegion *region, const char *path)
+  __attribute__((warn_unused_result));
+
 #endif // FILE_IO_REGION_H
@@ -383,7 +383,8 @@ int makeAbsPath(const char *path, char **absPath)
       return errno;
     }
     result = allocSprintf(__func__, &tmp, "%s/%s", cwd, path);
-    FREE(cwd);
+    // get_current_dir_name() uses malloc(), not allocateMemory().
+    free(cwd);
   }
   if (result == UDS_SUCCESS) {
     *absPath = tmp;
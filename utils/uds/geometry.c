@@ -34,12 +34,33 @@ static int initializeGeometry(Geometry    *geometry,
                               size_t       bytesPerPage,
                               unsigned int recordPagesPerChapter,
                               unsigned int chaptersPerVolume,
-                              unsigned int sparseChaptersPerVolume)
+                              unsigned int sparseChaptersPerVolume,
+                              unsigned int packedMetadataBytes)
 {
-  int result = ASSERT_WITH_ERROR_CODE(bytesPerPage >= BYTES_PER_RECORD,
-                                      UDS_BAD_STATE,
-                                      "page is smaller than a record: %zu",
-                                      bytesPerPage);
+  int result = ASSERT_WITH_ERROR_CODE(packedMetadataBytes
+                                      < UDS_MAX_BLOCK_DATA_SIZE,
+                                      UDS_INVALID_ARGUMENT,
+                                      "packed metadata (%u bytes) must be"
+                                      " smaller than metadata (%u bytes)",
+                                      packedMetadataBytes,
+                                      UDS_MAX_BLOCK_DATA_SIZE);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  if (packedMetadataBytes > 0) {
+    geometry->recordPageHeaderBytes = PACKED_RECORD_PAGE_HEADER_BYTES;
+    geometry->bytesPerRecord = UDS_CHUNK_NAME_SIZE + packedMetadataBytes;
+  } else {
+    geometry->recordPageHeaderBytes = 0;
+    geometry->bytesPerRecord = BYTES_PER_RECORD;
+  }
+  result = ASSERT_WITH_ERROR_CODE((bytesPerPage
+                                   >= (geometry->recordPageHeaderBytes
+                                       + geometry->bytesPerRecord)),
+                                  UDS_BAD_STATE,
+                                  "page is smaller than a record: %zu",
+                                  bytesPerPage);
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -58,11 +79,14 @@ static int initializeGeometry(Geometry    *geometry,
   geometry->recordPagesPerChapter   = recordPagesPerChapter;
   geometry->chaptersPerVolume       = chaptersPerVolume;
   geometry->sparseChaptersPerVolume = sparseChaptersPerVolume;
+  geometry->packedMetadataBytes     = packedMetadataBytes;
   geometry->denseChaptersPerVolume  =
     chaptersPerVolume - sparseChaptersPerVolume;
 
   // Calculate the number of records in a page, chapter, and volume.
-  geometry->recordsPerPage = bytesPerPage / BYTES_PER_RECORD;
+  geometry->recordsPerPage
+    = ((bytesPerPage - geometry->recordPageHeaderBytes)
+       / geometry->bytesPerRecord);
   geometry->recordsPerChapter
     = geometry->recordsPerPage * recordPagesPerChapter;
   geometry->recordsPerVolume
@@ -108,6 +132,7 @@ int makeGeometry(size_t       bytesPerPage,
                  unsigned int recordPagesPerChapter,
                  unsigned int chaptersPerVolume,
                  unsigned int sparseChaptersPerVolume,
+                 unsigned int packedMetadataBytes,
                  Geometry   **geometryPtr)
 {
   Geometry *geometry;
@@ -116,7 +141,8 @@ int makeGeometry(size_t       bytesPerPage,
     return result;
   }
   result = initializeGeometry(geometry, bytesPerPage, recordPagesPerChapter,
-                              chaptersPerVolume, sparseChaptersPerVolume);
+                              chaptersPerVolume, sparseChaptersPerVolume,
+                              packedMetadataBytes);
   if (result != UDS_SUCCESS) {
     freeGeometry(geometry);
     return result;
@@ -133,6 +159,7 @@ int copyGeometry(Geometry *source, Geometry **geometryPtr)
                       source->recordPagesPerChapter,
                       source->chaptersPerVolume,
                       source->sparseChaptersPerVolume,
+                      source->packedMetadataBytes,
                       geometryPtr);
 }
 
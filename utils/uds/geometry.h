@@ -48,6 +48,11 @@
  * allow us to store 2^28 entries (indexing 1TB of 4K blocks) in an
  * approximately 16.5 MByte volume using fourteen index pages in each
  * chapter.
+ *
+ * <p>A volume may instead use packed record pages, in which each record
+ * stores its metadata as an offset of a few bytes from a base value kept at
+ * the start of the page. Packed pages hold more, smaller records, so that
+ * each chapter, and thus the whole volume, covers more blocks.
  **/
 typedef struct geometry {
   /** Length of a page in a chapter, in bytes */
@@ -60,6 +65,8 @@ typedef struct geometry {
   unsigned int sparseChaptersPerVolume;
   /** Number of bits used to determine delta list numbers */
   unsigned int chapterDeltaListBits;
+  /** Bytes of metadata offset in a packed record, or 0 if not packed */
+  unsigned int packedMetadataBytes;
 
   // These are derived properties, expressed as fields for convenience.
   /** Total number of pages in a volume, excluding header */
@@ -76,6 +83,10 @@ typedef struct geometry {
   unsigned int indexPagesPerChapter;
   /** The minimum ratio of hash slots to records in an open chapter */
   unsigned int openChapterLoadRatio;
+  /** Number of bytes in the header of a record page */
+  unsigned int recordPageHeaderBytes;
+  /** Number of bytes in a record as stored on a record page */
+  unsigned int bytesPerRecord;
   /** Number of records that fit on a page */
   unsigned int recordsPerPage;
   /** Number of records that fit in a chapter */
@@ -100,6 +111,9 @@ enum {
   /* The number of bytes in a record (name + metadata) */
   BYTES_PER_RECORD = (UDS_CHUNK_NAME_SIZE + UDS_MAX_BLOCK_DATA_SIZE),
 
+  /* The number of bytes in the header (the base metadata) of a packed page */
+  PACKED_RECORD_PAGE_HEADER_BYTES = UDS_MAX_BLOCK_DATA_SIZE,
+
   /* The default length of a page in a chapter, in bytes */
   DEFAULT_BYTES_PER_PAGE = 1024 * BYTES_PER_RECORD,
 
@@ -142,6 +156,8 @@ enum {
  * @param recordPagesPerChapter   The number of pages in a chapter
  * @param chaptersPerVolume       The number of chapters in a volume
  * @param sparseChaptersPerVolume The number of sparse chapters in a volume
+ * @param packedMetadataBytes     The number of bytes of metadata offset in a
+ *                                packed record, or 0 for unpacked records
  * @param geometryPtr             A pointer to hold the new geometry
  *
  * @return UDS_SUCCESS or an error code
@@ -150,6 +166,7 @@ int makeGeometry(size_t       bytesPerPage,
                  unsigned int recordPagesPerChapter,
                  unsigned int chaptersPerVolume,
                  unsigned int sparseChaptersPerVolume,
+                 unsigned int packedMetadataBytes,
                  Geometry   **geometryPtr)
   __attribute__((warn_unused_result));
 
@@ -25,16 +25,28 @@
 #include "localIndexRouter.h"
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "numeric.h"
+#include "requestQueue.h"
 #include "threads.h"
 
-// Data exchanged with per-router filling threads.
-struct fillData {
-  // Router to fill from this thread
-  IndexRouter *router;
-  // Seed value for PRNG
-  int          seed;
+// Data exchanged with per-shard router creation threads.
+struct shardData {
+  // Layout of the shard
+  IndexLayout          *layout;
+  // Index configuration shared by all shards
+  const Configuration  *config;
+  // How to load the shard
+  LoadType              loadType;
+  // Callback handler for index requests
+  IndexRouterCallback   indexCallback;
+  // Where to put the new router
+  IndexRouter         **router;
+  // Thread making the router
+  Thread                thread;
+  // Whether the thread was started
+  bool                  started;
   // UDS_SUCCESS or error from router
-  int          result;
+  int                   result;
 };
 
 /**********************************************************************/
@@ -52,12 +64,131 @@ static int printUserConfiguration(Grid *grid)
 }
 
 /**********************************************************************/
-int makeLocalGrid(IndexLayout          *layout,
+static int writeOrReadShardConfigs(Grid          *grid,
+                                   IndexLayout  **layouts,
+                                   unsigned int   numLayouts,
+                                   LoadType       loadType)
+{
+  for (unsigned int i = 0; i < numLayouts; i++) {
+    if (loadType == LOAD_CREATE) {
+      int result = writeIndexConfig(layouts[i], &grid->userConfig);
+      if (result != UDS_SUCCESS) {
+        return result;
+      }
+      continue;
+    }
+
+    if (i == 0) {
+      int result = readIndexConfig(layouts[0], &grid->userConfig);
+      if (result != UDS_SUCCESS) {
+        return result;
+      }
+      continue;
+    }
+
+    struct udsConfiguration shardConfig;
+    memset(&shardConfig, 0, sizeof(shardConfig));
+    int result = readIndexConfig(layouts[i], &shardConfig);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    if (!areUdsConfigurationsEqual(&grid->userConfig, &shardConfig)) {
+      return logErrorWithStringError(UDS_CORRUPT_COMPONENT,
+                                     "configuration of index shard %u does"
+                                     " not match shard 0", i);
+    }
+  }
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+static void makeShardRouter(void *arg)
+{
+  struct shardData *shard = arg;
+  shard->result = makeLocalIndexRouter(shard->layout, shard->config,
+                                       shard->loadType, shard->indexCallback,
+                                       shard->router);
+}
+
+/**
+ * Make the local index routers for all the shards of a grid. When there is
+ * more than one shard, each router is made on its own thread so that the
+ * shards are created, loaded, or rebuilt in parallel.
+ *
+ * @param grid           The grid
+ * @param layouts        The layouts of the shards, one per router
+ * @param config         The index configuration for every shard
+ * @param loadType       How to load the index
+ * @param indexCallback  The callback handler for index requests
+ *
+ * @return UDS_SUCCESS or the first error from any shard
+ **/
+static int makeShardRouters(Grid                *grid,
+                            IndexLayout        **layouts,
+                            const Configuration *config,
+                            LoadType             loadType,
+                            IndexRouterCallback  indexCallback)
+{
+  struct shardData *shards;
+  int result = ALLOCATE(grid->numRouters, struct shardData, "shard data",
+                        &shards);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  for (unsigned int i = 0; i < grid->numRouters; i++) {
+    shards[i] = (struct shardData) {
+      .layout        = layouts[i],
+      .config        = config,
+      .loadType      = loadType,
+      .indexCallback = indexCallback,
+      .router        = &grid->routers[i],
+      .result        = UDS_SUCCESS,
+    };
+  }
+
+  if (grid->numRouters == 1) {
+    makeShardRouter(&shards[0]);
+  } else {
+    for (unsigned int i = 0; i < grid->numRouters; i++) {
+      char name[16];
+      snprintf(name, sizeof(name), "shard%u", i);
+      shards[i].result = createThread(makeShardRouter, &shards[i], name,
+                                      &shards[i].thread);
+      shards[i].started = (shards[i].result == UDS_SUCCESS);
+    }
+    for (unsigned int i = 0; i < grid->numRouters; i++) {
+      if (shards[i].started) {
+        joinThreads(shards[i].thread);
+      }
+    }
+  }
+
+  for (unsigned int i = 0; i < grid->numRouters; i++) {
+    if (shards[i].result != UDS_SUCCESS) {
+      result = logErrorWithStringError(shards[i].result,
+                                       "Failed to make router for shard %u",
+                                       i);
+      break;
+    }
+  }
+  FREE(shards);
+  return result;
+}
+
+/**********************************************************************/
+int makeLocalGrid(IndexLayout         **layouts,
+                  unsigned int          numLayouts,
                   LoadType              loadType,
                   UdsConfiguration      userConfig,
                   IndexRouterCallback   indexCallback,
                   Grid                **grid)
 {
+  if (numLayouts == 0) {
+    return logErrorWithStringError(UDS_GRID_NO_SERVERS,
+                                   "No index layouts specified");
+  }
+
   Grid *newGrid;
   int result = ALLOCATE(1, struct grid, "grid", &newGrid);
   if (result != UDS_SUCCESS) {
@@ -68,19 +199,14 @@ int makeLocalGrid(IndexLayout          *layout,
     newGrid->userConfig = *userConfig;
   }
 
-  if (loadType == LOAD_CREATE) {
-    result = writeIndexConfig(layout, &newGrid->userConfig);
-  } else {
-    result = readIndexConfig(layout, &newGrid->userConfig);
-  }
-
+  result = writeOrReadShardConfigs(newGrid, layouts, numLayouts, loadType);
   if (result != UDS_SUCCESS) {
     freeGrid(newGrid);
     return result;
   }
 
-  newGrid->numRouters = 1;
-  result = ALLOCATE(1,
+  newGrid->numRouters = numLayouts;
+  result = ALLOCATE(numLayouts,
                     IndexRouter *,
                     "create routers",
                     &newGrid->routers);
@@ -98,14 +224,10 @@ int makeLocalGrid(IndexLayout          *layout,
     return result;
   }
 
-  result = makeLocalIndexRouter(layout,
-                                indexConfig,
-                                loadType,
-                                indexCallback,
-                                &newGrid->routers[0]);
+  result = makeShardRouters(newGrid, layouts, indexConfig, loadType,
+                            indexCallback);
   freeConfiguration(indexConfig);
   if (result != UDS_SUCCESS) {
-    logErrorWithStringError(result, "Failed to make router");
     freeGrid(newGrid);
     return result;
   }
@@ -116,20 +238,58 @@ int makeLocalGrid(IndexLayout          *layout,
     return result;
   }
 
-  // Do this last so that freeGrid does not free the layout until and unless
+  result = ALLOCATE(numLayouts, IndexLayout *, "grid layouts",
+                    &newGrid->layouts);
+  if (result != UDS_SUCCESS) {
+    freeGrid(newGrid);
+    return result;
+  }
+
+  // Do this last so that freeGrid does not free the layouts until and unless
   // this function returns successfully.
-  newGrid->layout = layout;
+  for (unsigned int i = 0; i < numLayouts; i++) {
+    newGrid->layouts[i] = layouts[i];
+  }
+  newGrid->numLayouts = numLayouts;
+  if (numLayouts > 1) {
+    logInfo("Index is sharded across %u local indexes", numLayouts);
+  }
   *grid = newGrid;
   return UDS_SUCCESS;
 }
 
 /**********************************************************************/
-IndexRouter *selectGridRouter(Grid *grid, UdsChunkName *name)
+static void freeGridLayouts(Grid *grid)
+{
+  if (grid->layouts != NULL) {
+    for (unsigned int i = 0; i < grid->numLayouts; i++) {
+      freeIndexLayout(&grid->layouts[i]);
+    }
+  }
+  FREE(grid->layouts);
+  grid->layouts = NULL;
+}
+
+/**
+ * Select the number of the router which handles a name.
+ *
+ * @param grid  The index grid to use
+ * @param name  The name to dispatch
+ *
+ * @return The number of the router for the name
+ **/
+static unsigned int selectGridRouterNumber(const Grid         *grid,
+                                           const UdsChunkName *name)
 {
   unsigned int gridBytes = extractGridRouterBytes(name);
   unsigned int numRouters = grid->numRouters;
-  unsigned int routerNumber = (numRouters == 1) ? 0 : (gridBytes % numRouters);
-  return grid->routers[routerNumber];
+  return (numRouters == 1) ? 0 : (gridBytes % numRouters);
+}
+
+/**********************************************************************/
+IndexRouter *selectGridRouter(Grid *grid, UdsChunkName *name)
+{
+  return grid->routers[selectGridRouterNumber(grid, name)];
 }
 
 /**********************************************************************/
@@ -150,6 +310,29 @@ int getGridStatistics(Grid *grid, IndexRouterStatCounters *counters)
     counters->entriesDiscarded += routerStats.entriesDiscarded;
     counters->checkpoints      += routerStats.checkpoints;
     addCacheCounters(&counters->volumeCache, &routerStats.volumeCache);
+    addQueueClassStats(counters->queueClasses, routerStats.queueClasses);
+    counters->scrub.chaptersScrubbed += routerStats.scrub.chaptersScrubbed;
+    counters->scrub.passes           += routerStats.scrub.passes;
+    counters->scrub.errors           += routerStats.scrub.errors;
+    counters->scrub.badChapters      += routerStats.scrub.badChapters;
+    // Routers index disjoint sets of names, so their estimates add.
+    for (unsigned int w = 0; w < UDS_DEDUPE_WINDOW_COUNT; w++) {
+      UdsDedupeWindow *window = &counters->dedupeWindows[w];
+      window->chapters        = routerStats.dedupeWindows[w].chapters;
+      window->chunks         += routerStats.dedupeWindows[w].chunks;
+      window->distinctChunks += routerStats.dedupeWindows[w].distinctChunks;
+    }
+    // Every router has the same configuration but adapts its own rate, so
+    // report the sparsest current rate.
+    UdsSparseSamplingStats *sampling = &counters->sampling;
+    sampling->baseRate     = routerStats.sampling.baseRate;
+    sampling->currentRate  = maxUInt64(sampling->currentRate,
+                                       routerStats.sampling.currentRate);
+    sampling->rateChanges += routerStats.sampling.rateChanges;
+    sampling->sparseHits  += routerStats.sampling.sparseHits;
+    sampling->dedupeHits  += routerStats.sampling.dedupeHits;
+    sampling->hookEntries += routerStats.sampling.hookEntries;
+    sampling->hooksPruned += routerStats.sampling.hooksPruned;
   }
   return UDS_SUCCESS;
 }
@@ -172,6 +355,38 @@ void waitForIdleGrid(Grid *grid)
   }
 }
 
+/**********************************************************************/
+int bulkLoadGrid(Grid *grid, const UdsBulkRecord *records, size_t count)
+{
+  if (grid->numRouters == 1) {
+    return bulkLoadIndexRouter(grid->routers[0], records, count);
+  }
+
+  // Gather the records for each router together, keeping them in order.
+  UdsBulkRecord *shares;
+  int result = ALLOCATE(count, UdsBulkRecord, "bulk load shares", &shares);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  size_t shareStart = 0;
+  for (unsigned int i = 0; i < grid->numRouters; i++) {
+    size_t shareCount = 0;
+    for (size_t j = 0; j < count; j++) {
+      if (selectGridRouterNumber(grid, &records[j].name) == i) {
+        shares[shareStart + shareCount++] = records[j];
+      }
+    }
+    result = bulkLoadIndexRouter(grid->routers[i], &shares[shareStart],
+                                 shareCount);
+    if (result != UDS_SUCCESS) {
+      break;
+    }
+    shareStart += shareCount;
+  }
+  FREE(shares);
+  return result;
+}
+
 /**********************************************************************/
 int saveAndFreeGrid(Grid *grid)
 {
@@ -191,7 +406,7 @@ int saveAndFreeGrid(Grid *grid)
       }
     }
   }
-  freeIndexLayout(&grid->layout);
+  freeGridLayouts(grid);
   FREE(grid->routers);
   FREE(grid);
   return result;
@@ -230,7 +445,7 @@ void freeGrid(Grid *grid)
       freeIndexRouter(grid->routers[i]);
     }
   }
-  freeIndexLayout(&grid->layout);
+  freeGridLayouts(grid);
   FREE(grid->routers);
   FREE(grid);
 }
@@ -32,13 +32,21 @@ struct grid {
   struct udsConfiguration   userConfig;
   unsigned int              numRouters;
   IndexRouter             **routers;
-  IndexLayout              *layout;
+  unsigned int              numLayouts;
+  IndexLayout             **layouts;
 };
 
 /**
- * Create a local grid structure from the given configuration.
- *
- * @param layout         The index layout for the new index.
+ * Create a local grid structure from the given configuration. The grid has
+ * one local index router for each layout, and chunk names are sharded
+ * across the routers by selectGridRouter(). Each router has its own volume,
+ * page cache, and zone threads, so the layouts should normally reside on
+ * separate devices.
+ *
+ * @param layouts        The index layouts for the new index, one per shard.
+ *                       The layouts must be given in the same order every
+ *                       time the index is loaded.
+ * @param numLayouts     The number of layouts
  * @param loadType       How to load the index
  * @param userConfig     The udsConfiguration to use
  * @param indexCallback  The callback handler for index requests
@@ -46,10 +54,11 @@ struct grid {
  *
  * @return               Either UDS_SUCCESS or an error code.
  *
- * @note The layout becomes owned by the grid and will be destroyed
+ * @note The layouts become owned by the grid and will be destroyed
  *       when the grid is freed.
  **/
-int makeLocalGrid(IndexLayout          *layout,
+int makeLocalGrid(IndexLayout         **layouts,
+                  unsigned int          numLayouts,
                   LoadType              loadType,
                   UdsConfiguration      userConfig,
                   IndexRouterCallback   indexCallback,
@@ -111,6 +120,23 @@ int setGridCheckpointFrequency(Grid *grid, unsigned int frequency)
  **/
 void waitForIdleGrid(Grid *grid);
 
+/**
+ * Add a batch of records to the index grid without a request for each of
+ * them, sending each router the records for the names it handles.
+ *
+ * It is the responsibility of the caller to ensure that there are no index
+ * requests from any block context nor any attempt to save the grid until
+ * after a call to bulkLoadGrid returns.
+ *
+ * @param grid     The index grid
+ * @param records  The records to add
+ * @param count    The number of records
+ *
+ * @return Either UDS_SUCCESS or an error code
+ **/
+int bulkLoadGrid(Grid *grid, const UdsBulkRecord *records, size_t count)
+  __attribute__((warn_unused_result));
+
 /**
  * Flush all the routers, save and free all components of the grid.
  *
@@ -71,6 +71,18 @@ static INLINE uint64_t extractChapterIndexBytes(const UdsChunkName *name)
   }
 }
 
+/**
+ * Extract the portion of a block name used by the master index.
+ *
+ * @param name The block name
+ *
+ * @return The master index portion of the block name
+ **/
+static INLINE uint64_t extractMasterIndexBytes(const UdsChunkName *name)
+{
+  return getUInt64BE(&name->name[MASTER_INDEX_BYTES_OFFSET]);
+}
+
 /**
  * Extract the portion of a block name used by the grid router.
  *
@@ -78,26 +90,41 @@ static INLINE uint64_t extractChapterIndexBytes(const UdsChunkName *name)
  *
  * @return The grid router portion of the block name
  **/
-static INLINE uint32_t extractGridRouterBytes(const UdsChunkName *name
-                                              __attribute__((unused)))
+static INLINE uint32_t extractGridRouterBytes(const UdsChunkName *name)
 {
 #if UDS_CHUNK_NAME_SIZE == 16
-  return 0;
+  // Every byte of a 16 byte name is already used by some part of the index,
+  // and a shard must not select on any one of those fields or it would
+  // skew that field within each shard. Mix all of the bits with a
+  // multiplicative hash and use the high order bits of the product.
+  uint64_t bits = (extractMasterIndexBytes(name)
+                   ^ getUInt64BE(&name->name[CHAPTER_INDEX_BYTES_OFFSET]));
+  return (uint32_t) ((bits * 0x9E3779B97F4A7C15ULL) >> 32);
 #else
   return getUInt32BE(&name->name[GRID_BYTES_OFFSET]);
 #endif
 }
 
 /**
- * Extract the portion of a block name used by the master index.
+ * Extract well mixed bits of a block name for the dedupe estimator. Every
+ * field of the name selects something in the index, such as the zone, so
+ * the fields are mixed together rather than used directly.
  *
  * @param name The block name
  *
- * @return The master index portion of the block name
+ * @return 64 hash bits
  **/
-static INLINE uint64_t extractMasterIndexBytes(const UdsChunkName *name)
+static INLINE uint64_t extractEstimatorBytes(const UdsChunkName *name)
 {
-  return getUInt64BE(&name->name[MASTER_INDEX_BYTES_OFFSET]);
+  uint64_t bits = (extractMasterIndexBytes(name)
+                   ^ extractChapterIndexBytes(name));
+  // The MurmurHash3 64-bit finalizer.
+  bits ^= bits >> 33;
+  bits *= 0xFF51AFD7ED558CCDULL;
+  bits ^= bits >> 33;
+  bits *= 0xC4CEB9FE1A85EC53ULL;
+  bits ^= bits >> 33;
+  return bits;
 }
 
 /**
@@ -21,10 +21,15 @@
 
 #include "index.h"
 
+#include "cacheHotSet.h"
 #include "hashUtils.h"
 #include "indexCheckpoint.h"
 #include "indexInternals.h"
 #include "logger.h"
+#include "memoryAlloc.h"
+#include "recordPage.h"
+#include "requestTrace.h"
+#include "sparseCachePrefetch.h"
 
 static const uint64_t NO_LAST_CHECKPOINT = UINT_MAX;
 
@@ -195,7 +200,9 @@ int makeIndex(IndexLayout          *layout,
   }
 
   uint64_t nonce = getVolumeNonce(layout);
+  UdsMemoryComponent previous = setMemoryComponent(UDS_MEMORY_MASTER_INDEX);
   result = makeMasterIndex(config, zoneCount, nonce, &index->masterIndex);
+  setMemoryComponent(previous);
   if (result != UDS_SUCCESS) {
     freeIndex(index);
     return logErrorWithStringError(result, "could not make master index");
@@ -215,7 +222,16 @@ int makeIndex(IndexLayout          *layout,
     return result;
   }
 
+  result = addIndexStateComponent(index->state, &CACHE_HOT_SET_INFO,
+                                  index, NULL);
+  if (result != UDS_SUCCESS) {
+    freeIndex(index);
+    return result;
+  }
+
+  previous = setMemoryComponent(UDS_MEMORY_CHAPTER_WRITER);
   result = makeChapterWriter(index, &index->chapterWriter);
+  setMemoryComponent(previous);
   if (result != UDS_SUCCESS) {
     freeIndex(index);
     return result;
@@ -247,6 +263,20 @@ int makeIndex(IndexLayout          *layout,
   }
 
   index->hasSavedOpenChapter = index->loadedType == LOAD_LOAD;
+  if ((index->loadedType == LOAD_LOAD) && (index->hotSet != NULL)) {
+    // A failed warmup only costs the speed it was meant to buy.
+    result = startVolumeWarmup(index->volume, index->hotSet->pages,
+                               index->hotSet->pageCount);
+    if (result != UDS_SUCCESS) {
+      logWarningWithStringError(result, "cannot warm up page cache");
+    }
+  }
+  // Verification is a background service, so the index runs without it.
+  result = startVolumeScrubber(index->volume, index->oldestVirtualChapter,
+                               index->newestVirtualChapter);
+  if (result != UDS_SUCCESS) {
+    logWarningWithStringError(result, "cannot start volume scrubber");
+  }
   *newIndex = index;
   return UDS_SUCCESS;
 }
@@ -334,6 +364,7 @@ static int searchIndexZone(IndexZone *zone, Request *request)
   if (result != UDS_SUCCESS) {
     return result;
   }
+  traceRequest(request, TRACE_MASTER_INDEX_PROBE, record.isFound);
 
   bool found = false;
   if (record.isFound) {
@@ -374,9 +405,12 @@ static int searchIndexZone(IndexZone *zone, Request *request)
     }
   } else {
     // The record wasn't in the master index, so check whether the name
-    // is in a cached sparse chapter.
-    if (!isMasterIndexSample(zone->index->masterIndex, &request->hash)
-        && isSparse(zone->index->volume->geometry)) {
+    // is in a cached sparse chapter.  A hook can only be there if it was
+    // not a sample at the rate chosen for its chapter.
+    MasterIndex *masterIndex = zone->index->masterIndex;
+    if (isSparse(zone->index->volume->geometry)
+        && (!isMasterIndexSample(masterIndex, &request->hash)
+            || hasThinnedMasterIndexChapters(masterIndex))) {
       // Passing UINT64_MAX triggers a search of the entire sparse cache.
       result = searchSparseCacheInZone(zone, request, UINT64_MAX, &found);
       if (result != UDS_SUCCESS) {
@@ -506,20 +540,25 @@ static int simulateIndexZoneBarrierMessage(IndexZone *zone, Request *request)
   }
 
   // Check if the index request is for a sampled name in a sparse chapter.
-  uint64_t sparseVirtualChapter = triageIndexRequest(zone->index, request);
-  if (sparseVirtualChapter == UINT64_MAX) {
-    // Not indexed, not a hook, or in a chapter that is still dense, which
-    // means there should be no change to the sparse chapter index cache.
-    return UDS_SUCCESS;
-  }
+  uint64_t chapters[MAX_SPARSE_CACHE_BARRIERS];
+  unsigned int count = triageSparseCacheBarriers(zone->index, request,
+                                                 chapters);
 
   /*
-   * The triage queue would have generated and enqueued a barrier message
+   * The triage queue would have generated and enqueued barrier messages
    * preceding this request, which we simulate by directly invoking the
-   * execution hook for an equivalent message.
+   * execution hook for equivalent messages. No messages means the request is
+   * not indexed, not a hook, or in a chapter that is still dense, so there
+   * should be no change to the sparse chapter index cache.
    */
-  BarrierMessageData barrier = { .virtualChapter = sparseVirtualChapter };
-  return executeSparseCacheBarrierMessage(zone, &barrier);
+  for (unsigned int i = 0; i < count; i++) {
+    BarrierMessageData barrier = { .virtualChapter = chapters[i] };
+    int result = executeSparseCacheBarrierMessage(zone, &barrier);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+  return UDS_SUCCESS;
 }
 
 /**********************************************************************/
@@ -532,6 +571,10 @@ static int dispatchIndexZoneRequest(IndexZone *zone, Request *request)
     if (result != UDS_SUCCESS) {
       return result;
     }
+    if ((request->action == REQUEST_INDEX)
+        || (request->action == REQUEST_UPDATE)) {
+      recordDedupeName(zone->dedupeEstimator, &request->hash);
+    }
   }
 
   // Set the default location. It will be overwritten if we find the chunk.
@@ -543,6 +586,10 @@ static int dispatchIndexZoneRequest(IndexZone *zone, Request *request)
   case REQUEST_UPDATE:
   case REQUEST_QUERY:
     result = makeUnrecoverable(searchIndexZone(zone, request));
+    if ((result == UDS_SUCCESS) && (request->location != LOC_UNAVAILABLE)) {
+      recordMasterIndexDedupe(zone->index->masterIndex, zone->id,
+                              request->location == LOC_IN_SPARSE);
+    }
     break;
 
   case REQUEST_DELETE:
@@ -614,9 +661,11 @@ static int replayRecord(Index              *index,
                         uint64_t            virtualChapter,
                         bool                willBeSparseChapter)
 {
-  if (willBeSparseChapter && !isMasterIndexSample(index->masterIndex, name)) {
+  if (willBeSparseChapter
+      && !isMasterIndexChapterSample(index->masterIndex, name,
+                                     virtualChapter)) {
     // This entry will be in a sparse chapter after the rebuild completes,
-    // and it is not a sample, so just skip over it.
+    // and it is not a sample of that chapter, so just skip over it.
     return UDS_SUCCESS;
   }
 
@@ -759,7 +808,7 @@ int replayVolume(Index *index, uint64_t fromVCN)
                                 recordPageNumber);
       }
       for (unsigned int k = 0; k < geometry->recordsPerPage; k++) {
-        const byte *nameBytes = recordPage + (k * BYTES_PER_RECORD);
+        const byte *nameBytes = getRecordPageRecord(recordPage, geometry, k);
 
         UdsChunkName name;
         memcpy(&name.name, nameBytes, UDS_CHUNK_NAME_SIZE);
@@ -793,6 +842,38 @@ int replayVolume(Index *index, uint64_t fromVCN)
   return UDS_SUCCESS;
 }
 
+/**
+ * Estimate the dedupe windows of an index by merging the sketches of all
+ * of its zones. The zones index disjoint sets of names, but merging is
+ * more accurate than adding their estimates.
+ *
+ * @param index    The index
+ * @param windows  The windows to fill in
+ **/
+static void getDedupeEstimates(Index           *index,
+                               UdsDedupeWindow  windows[])
+{
+  HyperLogLog *sketches;
+  if (ALLOCATE(2, HyperLogLog, "dedupe estimate", &sketches) != UDS_SUCCESS) {
+    // The estimates are left at zero.
+    return;
+  }
+  HyperLogLog *merged  = &sketches[0];
+  HyperLogLog *scratch = &sketches[1];
+  for (unsigned int w = 0; w < UDS_DEDUPE_WINDOW_COUNT; w++) {
+    memset(merged, 0, sizeof(*merged));
+    uint64_t chunks = 0;
+    for (unsigned int z = 0; z < index->zoneCount; z++) {
+      chunks += mergeDedupeWindow(index->zones[z]->dedupeEstimator, w,
+                                  scratch, merged);
+    }
+    windows[w].chapters       = getDedupeWindowChapters(w);
+    windows[w].chunks         = chunks;
+    windows[w].distinctChunks = estimateHyperLogLog(merged);
+  }
+  FREE(sketches);
+}
+
 /**********************************************************************/
 void getIndexStats(Index *index, IndexRouterStatCounters *counters)
 {
@@ -817,6 +898,16 @@ void getIndexStats(Index *index, IndexRouterStatCounters *counters)
   counters->entriesDiscarded = (denseStats.discardCount
                                 + sparseStats.discardCount);
   counters->checkpoints      = getCheckpointCount(index->checkpoint);
+  getVolumeScrubStats(index->volume, &counters->scrub);
+  getDedupeEstimates(index, counters->dedupeWindows);
+
+  getMasterIndexSamplingStats(index->masterIndex, &counters->sampling);
+  if (counters->sampling.baseRate > 0) {
+    counters->sampling.hookEntries = sparseStats.recordCount;
+    for (unsigned int z = 0; z < index->zoneCount; z++) {
+      counters->sampling.hooksPruned += index->zones[z]->hooksPruned;
+    }
+  }
 }
 
 /**********************************************************************/
@@ -845,9 +936,24 @@ uint64_t triageIndexRequest(Index *index, Request *request)
     return UINT64_MAX;
   }
 
-  // XXX Optimize for a common case by remembering the chapter from the most
-  // recent barrier message and skipping this chapter if is it the same.
-
   // Return the sparse chapter number to trigger the barrier messages.
   return triage.virtualChapter;
 }
+
+/**********************************************************************/
+unsigned int triageSparseCacheBarriers(Index    *index,
+                                       Request  *request,
+                                       uint64_t *chapters)
+{
+  uint64_t sparseVirtualChapter = triageIndexRequest(index, request);
+  if (sparseVirtualChapter == UINT64_MAX) {
+    return 0;
+  }
+  if (index->prefetcher == NULL) {
+    chapters[0] = sparseVirtualChapter;
+    return 1;
+  }
+  return planSparseCacheBarriers(index->prefetcher,
+                                 getRequestZone(index, request),
+                                 sparseVirtualChapter, chapters);
+}
@@ -64,6 +64,12 @@ typedef struct index {
 
   // checkpoint state used by indexCheckpoint.c
   IndexCheckpoint *checkpoint;
+
+  // the page cache hot set read by the last load, if any
+  struct cacheHotSet *hotSet;
+
+  // sparse cache barrier planning, owned by the thread doing triage
+  struct sparseCachePrefetcher *prefetcher;
 } Index;
 
 /**
@@ -214,4 +220,22 @@ void advanceActiveChapters(Index *index);
 uint64_t triageIndexRequest(Index *index, Request *request)
   __attribute__((warn_unused_result));
 
+/**
+ * Triage an index request and decide which sparse cache barrier messages
+ * must precede it. Barriers for chapters predicted to be needed soon may be
+ * added ahead of the barrier for the sparse chapter of the request.
+ *
+ * @param index     the index that will process the request
+ * @param request   the index request containing the chunk name to triage
+ * @param chapters  an array of MAX_SPARSE_CACHE_BARRIERS entries to receive
+ *                  the sparse chapters needing barrier messages, in the
+ *                  order the messages should be sent
+ *
+ * @return the number of barrier messages to send
+ **/
+unsigned int triageSparseCacheBarriers(Index    *index,
+                                       Request  *request,
+                                       uint64_t *chapters)
+  __attribute__((warn_unused_result));
+
 #endif /* INDEX_H */
@@ -105,6 +105,7 @@ typedef struct {
   bool                saveOnly;     //< Used for saves but not checkpoints
   bool                chapterSync;  //< Saved by the chapter writer
   bool                multiZone;    //< Does this component have multiple zones?
+  bool                optional;     //< May be absent without harm to the index
   Loader              loader;       //< The function load this component
   Saver               saver;        //< The function to store this component
   IncrementalWriter   incremental;  //< The function for incremental writing
@@ -173,6 +174,16 @@ deferIndexComponentCheckpointToChapterWriter(IndexComponent *component);
 static inline bool
 missingIndexComponentRequiresReplay(IndexComponent *component);
 
+/**
+ * Determine whether a component may be absent from a save, in which case
+ * failing to load or save it is neither fatal nor a reason to replay.
+ *
+ * @param component     the component
+ *
+ * @return whether the component is optional
+ **/
+static inline bool isIndexComponentOptional(IndexComponent *component);
+
 /**
  * Read a component's state.
  *
@@ -120,6 +120,12 @@ missingIndexComponentRequiresReplay(IndexComponent *component)
   return component->info->saveOnly;
 }
 
+/*****************************************************************************/
+static INLINE bool isIndexComponentOptional(IndexComponent *component)
+{
+  return component->info->optional;
+}
+
 /*****************************************************************************/
 static INLINE int discardIndexComponent(IndexComponent *component)
 {
@@ -26,15 +26,27 @@
 #include "memoryAlloc.h"
 
 static const byte INDEX_CONFIG_MAGIC[]        = "ALBIC";
-static const byte INDEX_CONFIG_VERSION[]      = "06.02";
+static const byte INDEX_CONFIG_VERSION[]      = "06.03";
+static const byte INDEX_CONFIG_VERSION_6_02[] = "06.02";
 static const byte INDEX_CONFIG_VERSION_6_01[] = "06.01";
 
 enum {
   INDEX_CONFIG_MAGIC_LENGTH   = sizeof(INDEX_CONFIG_MAGIC) - 1,
-  INDEX_CONFIG_VERSION_LENGTH = sizeof(INDEX_CONFIG_VERSION) - 1
+  INDEX_CONFIG_VERSION_LENGTH = sizeof(INDEX_CONFIG_VERSION) - 1,
+  /** The encoded size of a 6.02 config, which has no packed metadata size */
+  INDEX_CONFIG_6_02_SIZE      = 8 * sizeof(uint32_t) + sizeof(uint64_t),
+  INDEX_CONFIG_SIZE           = INDEX_CONFIG_6_02_SIZE + sizeof(uint32_t)
 };
 
-/**********************************************************************/
+/**
+ * Decode the contents of an index config of the current version or of
+ * version 6.02, which is the current version without its final field.
+ *
+ * @param buffer  The buffer holding the encoded config
+ * @param config  The config to fill in
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
 __attribute__((warn_unused_result))
 static int decodeIndexConfig(Buffer *buffer, UdsConfiguration config)
 {
@@ -74,6 +86,13 @@ static int decodeIndexConfig(Buffer *buffer, UdsConfiguration config)
   if (result != UDS_SUCCESS) {
     return result;
   }
+  config->packedMetadataBytes = 0;
+  if (bufferLength(buffer) == INDEX_CONFIG_SIZE) {
+    result = getUInt32LEFromBuffer(buffer, &config->packedMetadataBytes);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
   result = ASSERT_LOG_ONLY(contentLength(buffer) == 0,
                            "%zu bytes decoded of %zu expected",
                            bufferLength(buffer) - contentLength(buffer),
@@ -95,9 +114,13 @@ static int readVersion(BufferedReader    *reader,
   if (result != UDS_SUCCESS) {
     return logErrorWithStringError(result, "cannot read index config version");
   }
-  if (memcmp(INDEX_CONFIG_VERSION, buffer, INDEX_CONFIG_VERSION_LENGTH) == 0) {
+  bool current
+    = (memcmp(INDEX_CONFIG_VERSION, buffer, INDEX_CONFIG_VERSION_LENGTH) == 0);
+  if (current || (memcmp(INDEX_CONFIG_VERSION_6_02, buffer,
+                         INDEX_CONFIG_VERSION_LENGTH) == 0)) {
     Buffer *buffer;
-    result = makeBuffer(sizeof(*conf), &buffer);
+    result = makeBuffer(current ? INDEX_CONFIG_SIZE : INDEX_CONFIG_6_02_SIZE,
+                        &buffer);
     if (result != UDS_SUCCESS) {
       return result;
     }
@@ -114,7 +137,7 @@ static int readVersion(BufferedReader    *reader,
       return result;
     }
     if (versionPtr != NULL) {
-      *versionPtr = "current";
+      *versionPtr = current ? "current" : "6.02";
     }
     return result;
   } else if (memcmp(INDEX_CONFIG_VERSION_6_01, buffer,
@@ -169,7 +192,16 @@ int readConfigContents(BufferedReader   *reader,
   return result;
 }
 
-/**********************************************************************/
+/**
+ * Encode the contents of an index config. A config which does not use
+ * packed record pages is encoded as version 6.02 so that it remains
+ * readable by older versions.
+ *
+ * @param buffer  The buffer to hold the encoded config
+ * @param config  The config to encode
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
 __attribute__((warn_unused_result))
 static int encodeIndexConfig(Buffer *buffer, UdsConfiguration config)
 {
@@ -209,9 +241,15 @@ static int encodeIndexConfig(Buffer *buffer, UdsConfiguration config)
   if (result != UDS_SUCCESS) {
     return result;
   }
-  result = ASSERT_LOG_ONLY(contentLength(buffer) == sizeof(*config),
+  if (config->packedMetadataBytes > 0) {
+    result = putUInt32LEIntoBuffer(buffer, config->packedMetadataBytes);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+  result = ASSERT_LOG_ONLY(contentLength(buffer) == bufferLength(buffer),
                            "%zu bytes encoded, of %zu expected",
-                           contentLength(buffer), sizeof(*config));
+                           contentLength(buffer), bufferLength(buffer));
   return result;
 }
 
@@ -224,13 +262,18 @@ int writeConfigContents(BufferedWriter   *writer,
   if (result != UDS_SUCCESS) {
     return result;
   }
-  result = writeToBufferedWriter(writer, INDEX_CONFIG_VERSION,
+  bool packed = (config->packedMetadataBytes > 0);
+  result = writeToBufferedWriter(writer,
+                                 (packed
+                                  ? INDEX_CONFIG_VERSION
+                                  : INDEX_CONFIG_VERSION_6_02),
                                  INDEX_CONFIG_VERSION_LENGTH);
   if (result != UDS_SUCCESS) {
     return result;
   }
   Buffer *buffer;
-  result = makeBuffer(sizeof(*config), &buffer);
+  result = makeBuffer(packed ? INDEX_CONFIG_SIZE : INDEX_CONFIG_6_02_SIZE,
+                      &buffer);
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -264,6 +307,7 @@ int makeConfiguration(UdsConfiguration conf, Configuration **configPtr)
                         conf->recordPagesPerChapter,
                         conf->chaptersPerVolume,
                         conf->sparseChaptersPerVolume,
+                        conf->packedMetadataBytes,
                         &config->geometry);
   if (result != UDS_SUCCESS) {
     freeConfiguration(config);
@@ -21,6 +21,7 @@
 
 #include "indexInternals.h"
 
+#include "cacheHotSet.h"
 #include "errors.h"
 #include "indexCheckpoint.h"
 #include "indexStateData.h"
@@ -30,6 +31,7 @@
 #include "openChapter.h"
 #include "readOnlyVolume.h"
 #include "request.h"
+#include "sparseCachePrefetch.h"
 #include "stringUtils.h"
 #include "threads.h"
 #include "typeDefs.h"
@@ -38,7 +40,7 @@
 
 const bool READ_ONLY_INDEX = true;
 
-static const unsigned int MAX_COMPONENT_COUNT = 4;
+static const unsigned int MAX_COMPONENT_COUNT = 5;
 
 /**********************************************************************/
 int allocateIndex(IndexLayout          *layout,
@@ -112,8 +114,7 @@ int allocateIndex(IndexLayout          *layout,
   if (readOnly) {
     result = makeReadOnlyVolume(config, index->layout, &index->volume);
   } else {
-    result = makeVolume(config, index->layout,
-                        VOLUME_CACHE_DEFAULT_MAX_QUEUED_READS,
+    result = makeVolume(config, index->layout, getVolumeReadQueueDepth(),
                         index->zoneCount, &index->volume);
   }
 
@@ -138,6 +139,15 @@ int allocateIndex(IndexLayout          *layout,
     return logErrorWithStringError(result, "Could not create open chapter");
   }
 
+  if (!readOnly && isSparse(config->geometry)) {
+    result = makeSparseCachePrefetcher(config->cacheChapters,
+                                       &index->prefetcher);
+    if (result != UDS_SUCCESS) {
+      freeIndex(index);
+      return result;
+    }
+  }
+
   *newIndex = index;
   return UDS_SUCCESS;
 }
@@ -160,5 +170,7 @@ void releaseIndex(Index *index)
 
   freeIndexState(&index->state);
   freeIndexCheckpoint(index->checkpoint);
+  freeCacheHotSet(index->hotSet);
+  freeSparseCachePrefetcher(index->prefetcher);
   FREE(index);
 }
@@ -26,8 +26,114 @@
 #include "logger.h"
 #include "memoryAlloc.h"
 #include "singleFileLayout.h"
+#include "stringUtils.h"
+#include "stripedIORegion.h"
 #include "uds.h"
 
+/**
+ * Open one of the files or devices holding an index.
+ *
+ * @param [in]  path       The name of the file or device
+ * @param [in]  newLayout  Whether the index is being created
+ * @param [in]  limit      The size the file must have, if it is new
+ * @param [in]  direct     Whether to try to use O_DIRECT reads
+ * @param [out] regionPtr  The region for the file
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int openIndexFile(const char  *path,
+                         bool         newLayout,
+                         off_t        limit,
+                         bool         direct,
+                         IORegion   **regionPtr)
+{
+  IORegion *region = NULL;
+  int result;
+  if (newLayout) {
+    result = openFileRegion(path, FU_CREATE_READ_WRITE, &region);
+    if (result == UDS_SUCCESS) {
+      result = setFileRegionLimit(region, limit);
+    }
+  } else {
+    result = openFileRegion(path, FU_READ_WRITE, &region);
+  }
+
+  if ((result == UDS_SUCCESS) && direct) {
+    int directResult = setFileRegionDirectReads(region, path);
+    if (directResult != UDS_SUCCESS) {
+      logWarningWithStringError(directResult,
+                                "cannot use O_DIRECT reads for %s,"
+                                " using buffered reads", path);
+    }
+  }
+
+  if (result != UDS_SUCCESS) {
+    closeIORegion(&region);
+    return result;
+  }
+  *regionPtr = region;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Open the files or devices of an index striped across several of them.
+ *
+ * @param [in]  files       The comma-separated list of names, which will be
+ *                            altered by tokenizing it
+ * @param [in]  newLayout   Whether the index is being created
+ * @param [in]  limit       The size of the index, including any offset
+ * @param [in]  direct      Whether to try to use O_DIRECT reads
+ * @param [in]  stripeSize  The number of bytes in each stripe
+ * @param [out] regionPtr   The striped region
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int openStripedFiles(char         *files,
+                            bool          newLayout,
+                            off_t         limit,
+                            bool          direct,
+                            size_t        stripeSize,
+                            IORegion    **regionPtr)
+{
+  unsigned int count = 1;
+  for (const char *p = files; *p != '\0'; p++) {
+    if (*p == ',') {
+      count++;
+    }
+  }
+  if (count > MAX_STRIPE_MEMBERS) {
+    return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                   "cannot stripe an index across %u files",
+                                   count);
+  }
+  if ((files[0] == ',') || (files[strlen(files) - 1] == ',')
+      || (strstr(files, ",,") != NULL)) {
+    return logErrorWithStringError(UDS_INDEX_NAME_REQUIRED,
+                                   "empty file name in index file list %s",
+                                   files);
+  }
+
+  off_t memberLimit = computeStripedMemberLimit(limit, count, stripeSize);
+  IORegion *members[MAX_STRIPE_MEMBERS];
+  unsigned int opened = 0;
+  char *data = NULL;
+  for (char *path = nextToken(files, ",", &data);
+       path != NULL;
+       path = nextToken(NULL, ",", &data)) {
+    int result = openIndexFile(path, newLayout, memberLimit, direct,
+                               &members[opened]);
+    if (result != UDS_SUCCESS) {
+      while (opened > 0) {
+        closeIORegion(&members[--opened]);
+      }
+      return result;
+    }
+    opened++;
+  }
+  return makeStripedRegion(members, count, stripeSize, newLayout,
+                           regionPtr);
+}
+
 /*****************************************************************************/
 int makeIndexLayout(const char              *name,
                     bool                     newLayout,
@@ -37,11 +143,15 @@ int makeIndexLayout(const char              *name,
   char     *file   = NULL;
   uint64_t  offset = 0;
   uint64_t  size   = 0;
+  uint64_t  direct = 0;
+  uint64_t  stripe = DEFAULT_STRIPE_SIZE;
 
   LayoutParameter parameterTable[] = {
     { "file",   LP_STRING | LP_DEFAULT, { .str = &file   }, false },
     { "size",   LP_UINT64,              { .num = &size   }, false },
     { "offset", LP_UINT64,              { .num = &offset }, false },
+    { "direct", LP_UINT64,              { .num = &direct }, false },
+    { "stripe", LP_UINT64,              { .num = &stripe }, false },
   };
 
   char *params = NULL;
@@ -73,13 +183,12 @@ int makeIndexLayout(const char              *name,
   }
 
   IORegion *region = NULL;
-  if (newLayout) {
-    result = openFileRegion(file, FU_CREATE_READ_WRITE, &region);
-    if (result == UDS_SUCCESS) {
-      result = setFileRegionLimit(region, offset + size);
-    }
+  if (strchr(file, ',') == NULL) {
+    result = openIndexFile(file, newLayout, offset + size, direct != 0,
+                           &region);
   } else {
-    result = openFileRegion(file, FU_READ_WRITE, &region);
+    result = openStripedFiles(file, newLayout, offset + size, direct != 0,
+                              stripe, &region);
   }
 
   FREE(params);
@@ -21,6 +21,10 @@
 
 #include "indexPageMap.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "buffer.h"
 #include "bufferedWriter.h"
 #include "compiler.h"
@@ -42,6 +46,8 @@ static int writeIndexPageMap(IndexComponent *component,
 static const byte INDEX_PAGE_MAP_MAGIC[] = "ALBIPM02";
 enum {
   INDEX_PAGE_MAP_MAGIC_LENGTH = sizeof(INDEX_PAGE_MAP_MAGIC) - 1,
+  // The number of entries compared at once when finding an index page.
+  ENTRY_BATCH = 8,
 };
 
 const IndexComponentInfo INDEX_PAGE_MAP_INFO = {
@@ -83,7 +89,7 @@ int makeIndexPageMap(const Geometry *geometry, IndexPageMap **mapPtr)
 
   map->geometry = geometry;
 
-  result = ALLOCATE(numEntries(geometry),
+  result = ALLOCATE(numEntries(geometry) + ENTRY_BATCH,
                     IndexPageMapEntry,
                     "Index Page Map Entries",
                     &map->entries);
@@ -171,17 +177,34 @@ int findIndexPageNumber(const IndexPageMap *map,
   }
 
   unsigned int deltaListNumber = hashToChapterDeltaList(name, geometry);
-  unsigned int slot = (chapterNumber * (geometry->indexPagesPerChapter - 1));
-  unsigned int limit = slot + (geometry->indexPagesPerChapter - 1);
+  unsigned int count = geometry->indexPagesPerChapter - 1;
+  const IndexPageMapEntry *entries
+    = &map->entries[chapterNumber * count];
   unsigned int indexPageNumber = 0;
-  for (; slot < limit; indexPageNumber++, slot++) {
-    if (deltaListNumber <= map->entries[slot]) {
-      break;
+#if defined(__SSE2__)
+  // An entry is less than the list number exactly when the saturating
+  // difference (list number - entry) is non-zero.
+  __m128i list = _mm_set1_epi16((short) deltaListNumber);
+  __m128i zero = _mm_setzero_si128();
+  for (unsigned int i = 0; i < count; i += ENTRY_BATCH) {
+    __m128i batch = _mm_loadu_si128((const __m128i *) &entries[i]);
+    __m128i notLess = _mm_cmpeq_epi16(_mm_subs_epu16(list, batch), zero);
+    // Two mask bits per entry; drop the ones past this chapter's entries.
+    unsigned int less = ~_mm_movemask_epi8(notLess) & 0xFFFF;
+    unsigned int valid = count - i;
+    if (valid < ENTRY_BATCH) {
+      less &= (1U << (2 * valid)) - 1;
     }
+    indexPageNumber += __builtin_popcount(less) / 2;
+  }
+#else
+  for (unsigned int i = 0; i < count; i++) {
+    indexPageNumber += (entries[i] < deltaListNumber);
   }
+#endif
 
-  // This should be a clear post-condition of the loop above, but just in case
-  // it's not obvious, the check is cheap.
+  // This should be a clear post-condition of the count above, but just in
+  // case it's not obvious, the check is cheap.
   int result = ASSERT((indexPageNumber < geometry->indexPagesPerChapter),
                       "index page number too large");
   if (result != UDS_SUCCESS) {
@@ -46,6 +46,12 @@ typedef struct {
  *  of the last delta list on that index page.  In order to save memory, the
  *  information for the last page in each chapter is not recorded, as it is
  *  known from the geometry.
+ *
+ *  The entries for a chapter are in ascending order, so the index page
+ *  holding a delta list is the number of the chapter's entries which are
+ *  less than the list number. The lookup counts them with batched compares
+ *  instead of a data-dependent loop. The entries array is padded so that a
+ *  batch starting in the last chapter stays in bounds.
  */
 
 typedef uint16_t IndexPageMapEntry;
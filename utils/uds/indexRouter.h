@@ -121,6 +121,21 @@ struct indexRouterMethods {
    * @param router  The index router.
    **/
   void (*waitForIdle)(IndexRouter *router);
+
+  /**
+   * Add a batch of records to the index without a request for each of
+   * them, waiting until all of them have been added. There must be no other
+   * requests for the index during a call to this method.
+   *
+   * @param router   The index router.
+   * @param records  The records to add.
+   * @param count    The number of records.
+   *
+   * @return UDS_SUCCESS or an error code
+   **/
+  int (*bulkLoad)(IndexRouter         *router,
+                  const UdsBulkRecord *records,
+                  size_t               count);
 };
 
 /**
@@ -169,4 +184,21 @@ static INLINE void waitForIdleIndexRouter(IndexRouter *router)
   router->methods->waitForIdle(router);
 }
 
+/**
+ * Add a batch of records to the index without a request for each of them.
+ *
+ * @param router   The index router.
+ * @param records  The records to add.
+ * @param count    The number of records.
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+__attribute__((warn_unused_result))
+static INLINE int bulkLoadIndexRouter(IndexRouter         *router,
+                                      const UdsBulkRecord *records,
+                                      size_t               count)
+{
+  return router->methods->bulkLoad(router, records, count);
+}
+
 #endif /* INDEX_ROUTER_H */
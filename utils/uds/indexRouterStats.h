@@ -23,6 +23,7 @@
 #define INDEX_ROUTER_STATS_H
 
 #include "cacheCounters.h"
+#include "uds.h"
 
 struct indexRouterStatCounters {
   uint64_t      entriesIndexed;
@@ -32,6 +33,10 @@ struct indexRouterStatCounters {
   uint64_t      entriesDiscarded;
   uint64_t      checkpoints;
   CacheCounters volumeCache;
+  UdsQueueClassStats queueClasses[UDS_PRIORITY_CLASS_COUNT];
+  UdsScrubStats      scrub;
+  UdsDedupeWindow    dedupeWindows[UDS_DEDUPE_WINDOW_COUNT];
+  UdsSparseSamplingStats sampling;
 };
 
 #endif /* INDEX_ROUTER_STATS_H */
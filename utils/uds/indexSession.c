@@ -23,7 +23,9 @@
 
 #include "grid.h"
 #include "logger.h"
+#include "lookupCache.h"
 #include "memoryAlloc.h"
+#include "requestTrace.h"
 #include "udsState.h"
 
 /**********************************************************************/
@@ -44,6 +46,14 @@ static void handleCallbacks(Request *request)
     // Measure the turnaround time of this request and include that time,
     // along with the rest of the request, in the context's StatCounters.
     updateRequestContextStats(request);
+
+    LookupCache *lookupCache = request->context->lookupCache;
+    if ((lookupCache != NULL) && (request->action == REQUEST_QUERY)
+        && !request->lookupCacheHit) {
+      updateLookupCache(lookupCache, &request->hash,
+                        request->lookupCacheEpoch, &request->oldMetadata,
+                        request->location);
+    }
   }
 
   if (request->callback != NULL) {
@@ -53,6 +63,7 @@ static void handleCallbacks(Request *request)
     request->serverContext = NULL;
     UdsContext *context = request->context;
     request->found = (request->location != LOC_UNAVAILABLE);
+    traceRequest(request, TRACE_CALLBACK, request->status);
     request->callback((UdsRequest *) request);
     releaseBaseContext(context);
     return;
@@ -188,6 +199,29 @@ int udsSaveIndex(UdsIndexSession session)
   return result;
 }
 
+/**********************************************************************/
+int udsBulkLoadChunks(UdsIndexSession      session,
+                      const UdsBulkRecord *records,
+                      size_t               count)
+{
+  if ((records == NULL) && (count > 0)) {
+    return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                   "received a NULL bulk record pointer");
+  }
+  IndexSession *indexSession;
+  int result = getIndexSession(session.id, &indexSession);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  result = bulkLoadGrid(indexSession->grid, records, count);
+  releaseIndexSession(indexSession);
+  if (result != UDS_SUCCESS) {
+    return logErrorWithStringError(result, "%s failed", __func__);
+  }
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 int udsSetCheckpointFrequency(UdsIndexSession session, unsigned int frequency)
 {
@@ -246,5 +280,11 @@ int udsGetIndexStats(UdsIndexSession session, UdsIndexStats *stats)
   stats->collisions       = routerStats.collisions;
   stats->entriesDiscarded = routerStats.entriesDiscarded;
   stats->checkpoints      = routerStats.checkpoints;
+  memcpy(stats->queueClasses, routerStats.queueClasses,
+         sizeof(stats->queueClasses));
+  stats->scrub            = routerStats.scrub;
+  memcpy(stats->dedupeWindows, routerStats.dedupeWindows,
+         sizeof(stats->dedupeWindows));
+  stats->sampling         = routerStats.sampling;
   return UDS_SUCCESS;
 }
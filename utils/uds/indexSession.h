@@ -46,6 +46,7 @@ typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) sessionStats {
   uint64_t deletionsNotFound;     /* Delete calls that did not find an entry */
   uint64_t queriesFound;          /* Query calls that found an entry */
   uint64_t queriesNotFound;       /* Query calls that did not find an entry */
+  uint64_t lookupCacheHits;       /* Query calls answered by lookup caches */
   uint64_t requests;              /* Total number of requests */
 } SessionStats;
 
@@ -169,6 +169,13 @@ int genericLoadIndexState(IndexState *state,
     IndexComponent *component = state->entries[i];
     int result = readIndexComponent(component);
     if (result != UDS_SUCCESS) {
+      if (isIndexComponentOptional(component)) {
+        if (result != UDS_UNSUPPORTED) {
+          logWarningWithStringError(result, "ignoring index component %s",
+                                    indexComponentName(component));
+        }
+        continue;
+      }
       if (!missingIndexComponentRequiresReplay(component)) {
         return logErrorWithStringError(result,
                                        "index component %s",
@@ -191,6 +198,11 @@ int genericSaveIndexState(IndexState *state)
   for (unsigned int i = 0; i < state->count; ++i) {
     IndexComponent *component = state->entries[i];
     result = writeIndexComponent(component);
+    if ((result == UDS_UNSUPPORTED) && isIndexComponentOptional(component)) {
+      // the layout has no room for this component
+      result = UDS_SUCCESS;
+      continue;
+    }
     if (result != UDS_SUCCESS) {
       break;
     }
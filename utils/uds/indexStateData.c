@@ -43,11 +43,26 @@ typedef struct {
   uint32_t padding;
 } IndexStateData301;
 
+/* The sparse sampling state which follows the 301 state in version 302 */
+typedef struct {
+  uint64_t samplingChapter;
+  uint64_t thinnedChapter;
+  uint32_t thinnedCount;
+  uint32_t thinnedShift;
+  uint32_t currentShift;
+  uint32_t padding;
+} IndexStateSampling302;
+
 static const IndexStateVersion INDEX_STATE_VERSION_301 = {
   .signature = -1,
   .versionID = 301,
 };
 
+static const IndexStateVersion INDEX_STATE_VERSION_302 = {
+  .signature = -1,
+  .versionID = 302,
+};
+
 static int readIndexStateData(ReadPortal *portal);
 static int writeIndexStateData(IndexComponent *component,
                                BufferedWriter *writer,
@@ -106,6 +121,55 @@ static int decodeIndexStateData(Buffer *buffer, IndexStateData301 *state)
   return result;
 }
 
+/**********************************************************************/
+__attribute__((warn_unused_result))
+static int decodeIndexStateSampling(Buffer *buffer, MasterIndexSampling *state)
+{
+  IndexStateSampling302 sampling;
+  int result = getUInt64LEFromBuffer(buffer, &sampling.samplingChapter);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = getUInt64LEFromBuffer(buffer, &sampling.thinnedChapter);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = getUInt32LEFromBuffer(buffer, &sampling.thinnedCount);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = getUInt32LEFromBuffer(buffer, &sampling.thinnedShift);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = getUInt32LEFromBuffer(buffer, &sampling.currentShift);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = getUInt32LEFromBuffer(buffer, &sampling.padding);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  if (sampling.padding != 0) {
+    return UDS_CORRUPT_COMPONENT;
+  }
+  result = ASSERT_LOG_ONLY(contentLength(buffer) == 0,
+                           "%zu bytes decoded of %zu expected",
+                           bufferLength(buffer) - contentLength(buffer),
+                           bufferLength(buffer));
+  if (result != UDS_SUCCESS) {
+    return UDS_CORRUPT_COMPONENT;
+  }
+  *state = (MasterIndexSampling) {
+    .samplingChapter = sampling.samplingChapter,
+    .thinnedChapter  = sampling.thinnedChapter,
+    .thinnedCount    = sampling.thinnedCount,
+    .thinnedShift    = sampling.thinnedShift,
+    .currentShift    = sampling.currentShift,
+  };
+  return UDS_SUCCESS;
+}
+
 /**
  * The index state index component reader.
  *
@@ -131,7 +195,9 @@ static int readIndexStateData(ReadPortal *portal)
   size_t offset = 0;
   decodeInt32LE(versionBuffer, &offset, &fileVersion.signature);
   decodeInt32LE(versionBuffer, &offset, &fileVersion.versionID);
-  if (fileVersion.signature != -1 || fileVersion.versionID != 301) {
+  if ((fileVersion.signature != -1)
+      || ((fileVersion.versionID != INDEX_STATE_VERSION_301.versionID)
+          && (fileVersion.versionID != INDEX_STATE_VERSION_302.versionID))) {
     return logErrorWithStringError(UDS_UNSUPPORTED_VERSION,
                                    "Index state version %d,%d is unsupported",
                                    fileVersion.signature,
@@ -162,7 +228,36 @@ static int readIndexStateData(ReadPortal *portal)
     return result;
   }
 
+  // An index saved before the sparse sample rate could adapt sampled every
+  // chapter at the configured rate.
+  MasterIndexSampling sampling;
+  memset(&sampling, 0, sizeof(sampling));
+  if (fileVersion.versionID == INDEX_STATE_VERSION_302.versionID) {
+    result = makeBuffer(sizeof(IndexStateSampling302), &buffer);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    result = readFromBufferedReader(reader, getBufferContents(buffer),
+                                    bufferLength(buffer));
+    if (result == UDS_SUCCESS) {
+      result = resetBufferEnd(buffer, bufferLength(buffer));
+    }
+    if (result == UDS_SUCCESS) {
+      result = decodeIndexStateSampling(buffer, &sampling);
+    }
+    freeBuffer(&buffer);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+
   Index *index = componentDataForPortal(portal);
+  if (index->masterIndex != NULL) {
+    result = setMasterIndexSampling(index->masterIndex, &sampling);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
   index->newestVirtualChapter = state.newestChapter;
   index->oldestVirtualChapter = state.oldestChapter;
   index->lastCheckpoint       = state.lastCheckpoint;
@@ -199,6 +294,43 @@ static int encodeIndexStateData(Buffer *buffer, IndexStateData301 *state)
   return result;
 }
 
+/**********************************************************************/
+__attribute__((warn_unused_result))
+static int encodeIndexStateSampling(Buffer                    *buffer,
+                                    const MasterIndexSampling *state)
+{
+  int result = putUInt64LEIntoBuffer(buffer, state->samplingChapter);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putUInt64LEIntoBuffer(buffer, state->thinnedChapter);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putUInt32LEIntoBuffer(buffer, state->thinnedCount);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putUInt32LEIntoBuffer(buffer, state->thinnedShift);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putUInt32LEIntoBuffer(buffer, state->currentShift);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putUInt32LEIntoBuffer(buffer, 0);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = ASSERT_LOG_ONLY(contentLength(buffer)
+                           == sizeof(IndexStateSampling302),
+                           "%zu bytes encoded, of %zu expected",
+                           contentLength(buffer),
+                           sizeof(IndexStateSampling302));
+  return result;
+}
+
 /**
  * The index state index component writer.
  *
@@ -217,20 +349,30 @@ static int writeIndexStateData(IndexComponent *component,
     return result;
   }
 
+  Index *index = indexComponentData(component);
+  MasterIndexSampling sampling;
+  memset(&sampling, 0, sizeof(sampling));
+  if (index->masterIndex != NULL) {
+    getMasterIndexSampling(index->masterIndex, &sampling);
+  }
+  // Only an index whose sample rate has adapted needs the newer version,
+  // so any other index can still be loaded by older code.
+  bool adapted = ((sampling.thinnedCount > 0) || (sampling.currentShift > 0));
+  const IndexStateVersion *version
+    = (adapted ? &INDEX_STATE_VERSION_302 : &INDEX_STATE_VERSION_301);
+
   size_t versionSize = sizeof(IndexStateVersion);
   Buffer *buffer;
   result = makeBuffer(versionSize, &buffer);
   if (result != UDS_SUCCESS) {
     return result;
   }
-  result
-    = putUInt32LEIntoBuffer(buffer, INDEX_STATE_VERSION_301.signature);
+  result = putUInt32LEIntoBuffer(buffer, version->signature);
   if (result != UDS_SUCCESS) {
     freeBuffer(&buffer);
     return result;
   }
-  result
-    = putUInt32LEIntoBuffer(buffer, INDEX_STATE_VERSION_301.versionID);
+  result = putUInt32LEIntoBuffer(buffer, version->versionID);
   if (result != UDS_SUCCESS) {
     freeBuffer(&buffer);
     return result;
@@ -249,7 +391,6 @@ static int writeIndexStateData(IndexComponent *component,
     return result;
   }
 
-  Index *index = indexComponentData(component);
   IndexStateData301 state = {
     .newestChapter  = index->newestVirtualChapter,
     .oldestChapter  = index->oldestVirtualChapter,
@@ -267,5 +408,21 @@ static int writeIndexStateData(IndexComponent *component,
   result = writeToBufferedWriter(writer, getBufferContents(buffer),
                                  contentLength(buffer));
   freeBuffer(&buffer);
+  if ((result != UDS_SUCCESS) || !adapted) {
+    return result;
+  }
+
+  result = makeBuffer(sizeof(IndexStateSampling302), &buffer);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = encodeIndexStateSampling(buffer, &sampling);
+  if (result != UDS_SUCCESS) {
+    freeBuffer(&buffer);
+    return result;
+  }
+  result = writeToBufferedWriter(writer, getBufferContents(buffer),
+                                 contentLength(buffer));
+  freeBuffer(&buffer);
   return result;
 }
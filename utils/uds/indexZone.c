@@ -29,9 +29,15 @@
 #include "memoryAlloc.h"
 #include "permassert.h"
 #include "request.h"
+#include "requestTrace.h"
 #include "sparseCache.h"
 #include "uds.h"
 
+enum {
+  /** The number of delta lists swept of expired entries per request */
+  SWEEP_LISTS_PER_REQUEST = 64,
+};
+
 /**********************************************************************/
 int makeIndexZone(struct index *index, unsigned int zoneNumber, bool readOnly)
 {
@@ -41,16 +47,34 @@ int makeIndexZone(struct index *index, unsigned int zoneNumber, bool readOnly)
     return result;
   }
 
+  UdsMemoryComponent previous = setMemoryComponent(UDS_MEMORY_OPEN_CHAPTER);
   result = makeOpenChapter(index->volume->geometry, index->zoneCount,
                            &zone->openChapter);
+  if ((result == UDS_SUCCESS) && !readOnly) {
+    result = makeOpenChapter(index->volume->geometry, index->zoneCount,
+                             &zone->writingChapter);
+  }
+  setMemoryComponent(previous);
   if (result != UDS_SUCCESS) {
     freeIndexZone(zone);
     return result;
   }
 
-  if (!readOnly) {
-    result = makeOpenChapter(index->volume->geometry, index->zoneCount,
-                             &zone->writingChapter);
+  result = makeDedupeEstimator(&zone->dedupeEstimator);
+  if (result != UDS_SUCCESS) {
+    freeIndexZone(zone);
+    return result;
+  }
+
+  const Geometry *geometry = index->volume->geometry;
+  if (isSparse(geometry) && !readOnly) {
+    // A chapter is queued when it closes and is dequeued when it becomes
+    // sparse, by which time every other dense chapter may have closed.
+    zone->deferredCapacity = geometry->denseChaptersPerVolume + 1;
+    previous = setMemoryComponent(UDS_MEMORY_MASTER_INDEX);
+    result = ALLOCATE(zone->deferredCapacity, DeferredHooks,
+                      "deferred hooks", &zone->deferredHooks);
+    setMemoryComponent(previous);
     if (result != UDS_SUCCESS) {
       freeIndexZone(zone);
       return result;
@@ -73,6 +97,13 @@ void freeIndexZone(IndexZone *zone)
 
   freeOpenChapter(zone->openChapter);
   freeOpenChapter(zone->writingChapter);
+  freeDedupeEstimator(zone->dedupeEstimator);
+  if (zone->deferredHooks != NULL) {
+    for (unsigned int i = 0; i < zone->deferredCapacity; i++) {
+      FREE(zone->deferredHooks[i].names);
+    }
+    FREE(zone->deferredHooks);
+  }
   FREE(zone);
 }
 
@@ -145,14 +176,119 @@ static int reapOldestChapter(IndexZone *zone)
   return UDS_SUCCESS;
 }
 
+/**
+ * Remove from the master index the deferred hooks of the chapters which
+ * have become sparse, unless a hook has since moved to a newer chapter.
+ * Deferred hooks of chapters which have expired altogether are simply
+ * forgotten.
+ *
+ * @param zone  The zone whose deferred hooks are to be pruned
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int pruneDeferredHooks(IndexZone *zone)
+{
+  MasterIndex *masterIndex = zone->index->masterIndex;
+  while (zone->deferredCount > 0) {
+    DeferredHooks *deferred = &zone->deferredHooks[zone->deferredFirst];
+    uint64_t chapter = deferred->virtualChapter;
+    bool expired = (chapter < zone->oldestVirtualChapter);
+    if (!expired && !isZoneChapterSparse(zone, chapter)) {
+      break;
+    }
+
+    for (unsigned int i = 0; !expired && (i < deferred->count); i++) {
+      MasterIndexRecord record;
+      int result = getMasterIndexRecord(masterIndex, &deferred->names[i],
+                                        &record);
+      if (result != UDS_SUCCESS) {
+        return result;
+      }
+      if (record.isFound && (record.virtualChapter == chapter)) {
+        result = removeMasterIndexRecord(&record);
+        if (result != UDS_SUCCESS) {
+          return result;
+        }
+        zone->hooksPruned++;
+      }
+    }
+
+    FREE(deferred->names);
+    deferred->names = NULL;
+    deferred->count = 0;
+    zone->deferredFirst = (zone->deferredFirst + 1) % zone->deferredCapacity;
+    zone->deferredCount--;
+  }
+  return UDS_SUCCESS;
+}
+
+/**
+ * Remember the hooks of a closed chapter which are not samples at the rate
+ * chosen for that chapter, so that they can be removed from the master
+ * index once the chapter becomes sparse.
+ *
+ * @param zone           The zone which closed the chapter
+ * @param closedChapter  The virtual chapter number of the closed chapter
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int deferChapterHooks(IndexZone *zone, uint64_t closedChapter)
+{
+  MasterIndex *masterIndex = zone->index->masterIndex;
+  const OpenChapterZone *chapter = zone->writingChapter;
+  unsigned int count = 0;
+  for (unsigned int i = 1; i <= chapter->size; i++) {
+    const UdsChunkName *name = &chapter->records[i].name;
+    if (isMasterIndexSample(masterIndex, name)
+        && !isMasterIndexChapterSample(masterIndex, name, closedChapter)) {
+      count++;
+    }
+  }
+  if (count == 0) {
+    return UDS_SUCCESS;
+  }
+
+  if (zone->deferredCount == zone->deferredCapacity) {
+    // Only a chapter which cannot become sparse could still be queued, so
+    // its hooks can be kept.
+    DeferredHooks *oldest = &zone->deferredHooks[zone->deferredFirst];
+    FREE(oldest->names);
+    oldest->names = NULL;
+    oldest->count = 0;
+    zone->deferredFirst = (zone->deferredFirst + 1) % zone->deferredCapacity;
+    zone->deferredCount--;
+  }
+
+  DeferredHooks *deferred
+    = &zone->deferredHooks[(zone->deferredFirst + zone->deferredCount)
+                           % zone->deferredCapacity];
+  UdsMemoryComponent previous = setMemoryComponent(UDS_MEMORY_MASTER_INDEX);
+  int result = ALLOCATE(count, UdsChunkName, "deferred hook names",
+                        &deferred->names);
+  setMemoryComponent(previous);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  deferred->virtualChapter = closedChapter;
+  deferred->count          = 0;
+  for (unsigned int i = 1; i <= chapter->size; i++) {
+    const UdsChunkName *name = &chapter->records[i].name;
+    if (isMasterIndexSample(masterIndex, name)
+        && !isMasterIndexChapterSample(masterIndex, name, closedChapter)) {
+      deferred->names[deferred->count++] = *name;
+    }
+  }
+  zone->deferredCount++;
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 int executeSparseCacheBarrierMessage(IndexZone          *zone,
                                      BarrierMessageData *barrier)
 {
   /*
    * Check if the chapter index for the virtual chapter is already in the
-   * cache, and if it's not, rendezvous with the other zone threads to add the
-   * chapter index to the sparse index cache.
+   * cache, and if it's not, add the chapter index to the sparse index cache.
    */
   return updateSparseCache(zone, barrier->virtualChapter);
 }
@@ -163,17 +299,153 @@ int executeSparseCacheBarrierMessage(IndexZone          *zone,
  * close it now in order to minimize skew.
  *
  * @param zone          The zone receiving the notification
+ * @param request       The notification request (may be NULL)
  * @param chapterClosed The notification
  *
  * @return UDS_SUCCESS or an error code
  **/
 static int handleChapterClosed(IndexZone                *zone,
+                               Request                  *request,
                                ChapterClosedMessageData *chapterClosed)
 {
   if (zone->newestVirtualChapter == chapterClosed->virtualChapter) {
-    return openNextChapter(zone, NULL);
+    return openNextChapter(zone, request);
+  }
+
+  return UDS_SUCCESS;
+}
+
+/**
+ * Queue a sweep of the master index entries of expired chapters for a
+ * zone, unless one is already queued.
+ *
+ * @param zone     The zone to sweep
+ * @param request  The request being processed by the zone (may be NULL)
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int queueExpiredEntrySweep(IndexZone *zone, Request *request)
+{
+  if (zone->sweepQueued || (request == NULL)) {
+    // Without zone queues, entries are still flushed as lookups find them.
+    return UDS_SUCCESS;
+  }
+
+  ZoneMessage zoneMessage = { .index = zone->index };
+  int result = launchZoneControlMessage(REQUEST_SWEEP_EXPIRED_ENTRIES,
+                                        zoneMessage, zone->id,
+                                        request->router);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  zone->sweepQueued = true;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Remove the master index entries of expired chapters from the next few
+ * delta lists of a zone, and queue the sweep to continue after the client
+ * requests queued behind it if there is more to do.
+ *
+ * @param zone     The zone to sweep
+ * @param request  The sweep request
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int sweepExpiredEntries(IndexZone *zone, Request *request)
+{
+  zone->sweepQueued = false;
+  bool finished = false;
+  int result = sweepMasterIndexZone(zone->index->masterIndex, zone->id,
+                                    SWEEP_LISTS_PER_REQUEST, &finished);
+  if ((result != UDS_SUCCESS) || finished) {
+    return result;
+  }
+  return queueExpiredEntrySweep(zone, request);
+}
+
+/**
+ * Find or make the master index entry which will reference the open
+ * chapter for a bulk loaded record. The chapters of the volume are not
+ * searched, so an entry for a name which merely shares the master index
+ * address of the record is not reused, and the record gets a collision
+ * entry of its own instead.
+ *
+ * @param zone    The zone adding the record
+ * @param name    The name of the record
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int indexBulkRecord(IndexZone *zone, const UdsChunkName *name)
+{
+  MasterIndexRecord record;
+  int result = getMasterIndexRecord(zone->index->masterIndex, name, &record);
+  if (result != UDS_SUCCESS) {
+    return result;
   }
 
+  uint64_t chapter = zone->newestVirtualChapter;
+  if (!record.isFound) {
+    return putMasterIndexRecord(&record, chapter);
+  }
+
+  if (record.isCollision) {
+    // A collision entry is only found for exactly this name.
+    if (record.virtualChapter == chapter) {
+      return UDS_SUCCESS;
+    }
+    return setMasterIndexRecordChapter(&record, chapter);
+  }
+
+  if (record.virtualChapter == chapter) {
+    bool found = false;
+    searchOpenChapter(zone->openChapter, name, NULL, &found);
+    if (found) {
+      return UDS_SUCCESS;
+    }
+  }
+  return putMasterIndexRecord(&record, chapter);
+}
+
+/**
+ * Add a batch of bulk loaded records to the open chapter of a zone,
+ * closing the chapter whenever it fills.
+ *
+ * @param zone      The zone to which the records belong
+ * @param request   The bulk load request
+ * @param bulkLoad  The records to add
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int bulkLoadIntoZone(IndexZone                 *zone,
+                            Request                   *request,
+                            const BulkLoadMessageData *bulkLoad)
+{
+  for (size_t i = 0; i < bulkLoad->count; i++) {
+    const UdsBulkRecord *record = &bulkLoad->records[i];
+    int result = indexBulkRecord(zone, &record->name);
+    if (result == UDS_OVERFLOW) {
+      // The overflow was logged, so go on without this record just as
+      // searchIndexZone() would.
+      continue;
+    }
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+
+    unsigned int remaining;
+    result = putOpenChapter(zone->openChapter, &record->name,
+                            &record->metadata, &remaining);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    if (remaining == 0) {
+      result = openNextChapter(zone, request);
+      if (result != UDS_SUCCESS) {
+        return result;
+      }
+    }
+  }
   return UDS_SUCCESS;
 }
 
@@ -188,7 +460,13 @@ int dispatchIndexZoneControlRequest(Request *request)
     return executeSparseCacheBarrierMessage(zone, &message->data.barrier);
 
   case REQUEST_ANNOUNCE_CHAPTER_CLOSED:
-    return handleChapterClosed(zone, &message->data.chapterClosed);
+    return handleChapterClosed(zone, request, &message->data.chapterClosed);
+
+  case REQUEST_SWEEP_EXPIRED_ENTRIES:
+    return sweepExpiredEntries(zone, request);
+
+  case REQUEST_BULK_LOAD:
+    return bulkLoadIntoZone(zone, request, &message->data.bulkLoad);
 
   default:
     return ASSERT_FALSE("valid control message type: %d", request->action);
@@ -229,7 +507,7 @@ static int announceChapterClosed(Request   *request,
     } else {
       // We're in a test which doesn't have zone queues, so we can just
       // call the message function directly.
-      result = handleChapterClosed(zone->index->zones[i],
+      result = handleChapterClosed(zone->index->zones[i], NULL,
                                    &zoneMessage.data.chapterClosed);
     }
     if (result != UDS_SUCCESS) {
@@ -253,13 +531,28 @@ int openNextChapter(IndexZone *zone, Request *request)
   }
 
   uint64_t closedChapter = zone->newestVirtualChapter++;
+  advanceDedupeEpoch(zone->dedupeEstimator);
   result = reapOldestChapter(zone);
   if (result != UDS_SUCCESS) {
     return logUnrecoverable(result, "reapOldestChapter failed");
   }
+  result = queueExpiredEntrySweep(zone, request);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
 
   resetOpenChapter(zone->openChapter);
 
+  if (zone->deferredHooks != NULL) {
+    result = deferChapterHooks(zone, closedChapter);
+    if (result == UDS_SUCCESS) {
+      result = pruneDeferredHooks(zone);
+    }
+    if (result != UDS_SUCCESS) {
+      return logUnrecoverable(result, "pruning sparse hooks failed");
+    }
+  }
+
   // begin, continue, or finish the checkpoint processing
   // moved above startClosingChapter because some of the
   // checkpoint processing now done by the chapter writer thread
@@ -386,9 +679,13 @@ int searchSparseCacheInZone(IndexZone *zone,
   int recordPageNumber;
   int result = searchSparseCache(zone, &request->hash, &virtualChapter,
                                  &recordPageNumber);
-  if ((result != UDS_SUCCESS) || (virtualChapter == UINT64_MAX)) {
+  if (result != UDS_SUCCESS) {
     return result;
   }
+  traceRequest(request, TRACE_SPARSE_CACHE, (virtualChapter != UINT64_MAX));
+  if (virtualChapter == UINT64_MAX) {
+    return UDS_SUCCESS;
+  }
 
   Volume *volume = zone->index->volume;
   // XXX map to physical chapter and validate. It would be nice to just pass
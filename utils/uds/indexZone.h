@@ -23,16 +23,38 @@
 #define INDEX_ZONE_H
 
 #include "common.h"
+#include "dedupeEstimator.h"
 #include "openChapterZone.h"
 #include "request.h"
 
+/**
+ * The hooks of a closed chapter which are not samples at the rate chosen
+ * for it, and so are to be removed from the master index when the chapter
+ * becomes sparse.
+ **/
+typedef struct {
+  uint64_t      virtualChapter;
+  unsigned int  count;
+  UdsChunkName *names;
+} DeferredHooks;
+
 typedef struct {
   struct index    *index;
   OpenChapterZone *openChapter;
   OpenChapterZone *writingChapter;
+  DedupeEstimator *dedupeEstimator;
   uint64_t         oldestVirtualChapter;
   uint64_t         newestVirtualChapter;
   unsigned int     id;
+  // The queue of dense chapters with hooks to remove, oldest first.  It is
+  // not saved, since the dense chapters of a loaded index have no shift.
+  DeferredHooks   *deferredHooks;
+  unsigned int     deferredCapacity;
+  unsigned int     deferredFirst;
+  unsigned int     deferredCount;
+  uint64_t         hooksPruned;
+  // Whether a sweep of expired master index entries is queued
+  bool             sweepQueued;
 } IndexZone;
 
 /**
@@ -90,8 +112,8 @@ int dispatchIndexZoneControlRequest(Request *request)
 
 /**
  * Execute a sparse chapter index cache barrier control request on the zone
- * worker thread. This call into the sparse cache to coordinate the cache
- * update with the other zones.
+ * worker thread. This calls into the sparse cache to make sure the chapter is
+ * cached before the zone handles the request which needs it.
  *
  * @param zone     The index zone receiving the barrier message
  * @param barrier  The barrier control message data
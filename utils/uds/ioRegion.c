@@ -21,7 +21,61 @@
 
 #include "ioRegion.h"
 
+#include "featureDefs.h"
 #include "logger.h"
+#include "parameter.h"
+#include "stringUtils.h"
+
+enum {
+  BUFFERED_IO_DEPTH = 2      // Default number of buffers in flight
+};
+
+static const NumericValidationData validRange = {
+  .minValue = 1,
+  .maxValue = MAX_BUFFERED_IO_DEPTH,
+};
+
+/*****************************************************************************/
+static UdsParameterValue getDefaultBufferedIODepth(void)
+{
+  UdsParameterValue value;
+#if ENVIRONMENT
+  char *env = getenv(UDS_BUFFERED_IO_DEPTH);
+  if (env != NULL) {
+    UdsParameterValue tmp = {
+      .type = UDS_PARAM_TYPE_STRING,
+      .value.u_string = env,
+    };
+    if (validateNumericRange(&tmp, &validRange, &value) == UDS_SUCCESS) {
+      return value;
+    }
+  }
+#endif // ENVIRONMENT
+  value.type = UDS_PARAM_TYPE_UNSIGNED_INT;
+  value.value.u_uint = BUFFERED_IO_DEPTH;
+  return value;
+}
+
+/*****************************************************************************/
+int defineBufferedIODepth(ParameterDefinition *pd)
+{
+  pd->validate       = validateNumericRange;
+  pd->validationData = &validRange;
+  pd->currentValue   = getDefaultBufferedIODepth();
+  pd->update         = NULL;
+  return UDS_SUCCESS;
+}
+
+/*****************************************************************************/
+unsigned int getBufferedIODepth(void)
+{
+  UdsParameterValue value;
+  if ((udsGetParameter(UDS_BUFFERED_IO_DEPTH, &value) == UDS_SUCCESS) &&
+      (value.type == UDS_PARAM_TYPE_UNSIGNED_INT)) {
+    return value.value.u_uint;
+  }
+  return BUFFERED_IO_DEPTH;
+}
 
 /*****************************************************************************/
 int syncAndCloseRegion(IORegion **regionPtr, const char *failureMsg)
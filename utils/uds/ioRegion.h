@@ -26,6 +26,13 @@
 #include "typeDefs.h"
 #include "uds-error.h"
 
+enum {
+  /** The maximum number of buffers a buffered reader or writer may use */
+  MAX_BUFFERED_IO_DEPTH = 8,
+  /** The minimum buffer size used when buffered IO is asynchronous */
+  ASYNC_IO_BUFFER_SIZE  = 256 * 1024,
+};
+
 /**
  * The IORegion type is an abstraction which represents a specific place which
  * can be read or written. There are file-based implementations as well as
@@ -224,4 +231,13 @@ static INLINE int writeToRegion(IORegion   *region,
  **/
 int syncAndCloseRegion(IORegion **regionPtr, const char *failureMsg);
 
+/**
+ * Get the number of buffers that buffered readers and writers should keep in
+ * flight, as set by the UDS_BUFFERED_IO_DEPTH parameter. A depth of one
+ * means that all buffered IO is done synchronously by the calling thread.
+ *
+ * @return the buffered IO depth
+ **/
+unsigned int getBufferedIODepth(void) __attribute__((warn_unused_result));
+
 #endif // IO_REGION_H
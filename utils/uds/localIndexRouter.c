@@ -21,13 +21,23 @@
 
 #include "localIndexRouter.h"
 
+#include "cacheHotSet.h"
 #include "compiler.h"
+#include "hashUtils.h"
 #include "indexCheckpoint.h"
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "numeric.h"
 #include "requestQueue.h"
+#include "sparseCachePrefetch.h"
+#include "util/radixSort.h"
 #include "zone.h"
 
+enum {
+  /** The largest number of bulk loaded records sorted into zones at once */
+  BULK_LOAD_BATCH_SIZE = 1 << 18,
+};
+
 static int saveAndFreeLocalIndexRouter(IndexRouter *header,
                                        bool         saveFlag,
                                        bool         freeFlag);
@@ -40,6 +50,9 @@ static int getRouterStatistics(IndexRouter *header,
 static void setCheckpointFrequency(IndexRouter *header,
                                    unsigned int frequency);
 static void waitForIdle(IndexRouter *header);
+static int bulkLoad(IndexRouter         *header,
+                    const UdsBulkRecord *records,
+                    size_t               count);
 
 static const IndexRouterMethods methods = {
   .saveAndFree            = saveAndFreeLocalIndexRouter,
@@ -48,6 +61,7 @@ static const IndexRouterMethods methods = {
   .getStatistics          = getRouterStatistics,
   .setCheckpointFrequency = setCheckpointFrequency,
   .waitForIdle            = waitForIdle,
+  .bulkLoad               = bulkLoad,
 };
 
 /*
@@ -72,16 +86,20 @@ static void executeZoneRequest(Request *request)
 }
 
 /**
- * Construct and enqueue asynchronous control messages to add the chapter
- * index for a given virtual chapter to the sparse chapter index cache.
+ * Construct and enqueue an asynchronous control message to add the chapter
+ * index for a given virtual chapter to the sparse chapter index cache. Only
+ * the zone which will need the chapter is sent the message; the other zones
+ * keep searching the cache while that zone updates it.
  *
  * @param router          the router containing the relevant queues
  * @param index           the index with the relevant cache and chapter
+ * @param zone            the zone which will need the chapter
  * @param virtualChapter  the virtual chapter number of the chapter to cache
  **/
-static void enqueueBarrierMessages(LocalIndexRouter *router,
-                                   Index            *index,
-                                   uint64_t          virtualChapter)
+static void enqueueBarrierMessage(LocalIndexRouter *router,
+                                  Index            *index,
+                                  unsigned int      zone,
+                                  uint64_t          virtualChapter)
 {
   ZoneMessage barrier = {
     .index = index,
@@ -91,20 +109,17 @@ static void enqueueBarrierMessages(LocalIndexRouter *router,
       }
     }
   };
-  for (unsigned int zone = 0; zone < router->zoneCount; zone++) {
-    int result = launchZoneControlMessage(REQUEST_SPARSE_CACHE_BARRIER,
-                                          barrier, zone,
-                                          asIndexRouter(router));
-    ASSERT_LOG_ONLY((result == UDS_SUCCESS), "barrier message allocation");
-  }
+  int result = launchZoneControlMessage(REQUEST_SPARSE_CACHE_BARRIER,
+                                        barrier, zone, asIndexRouter(router));
+  ASSERT_LOG_ONLY((result == UDS_SUCCESS), "barrier message allocation");
 }
 
 /**
  * This is the request processing function for the triage stage queue. Each
  * request is resolved in the master index, determining if it is a hook or
  * not, and if a hook, what virtual chapter (if any) it might be found in. If
- * a virtual chapter is found, this enqueues a sparse chapter cache barrier in
- * every zone before enqueueing the request in its zone.
+ * a virtual chapter is found, this enqueues a sparse chapter cache message in
+ * the request's zone before enqueueing the request there.
  *
  * @param request  the request to triage
  **/
@@ -114,10 +129,13 @@ static void triageRequest(Request *request)
   Index *index = router->index;
 
   // Check if the name is a hook in the index pointing at a sparse chapter.
-  uint64_t sparseVirtualChapter = triageIndexRequest(index, request);
-  if (sparseVirtualChapter != UINT64_MAX) {
-    // Generate and place a barrier request on every zone queue.
-    enqueueBarrierMessages(router, index, sparseVirtualChapter);
+  request->zoneNumber = getMasterIndexZone(index->masterIndex, &request->hash);
+  uint64_t chapters[MAX_SPARSE_CACHE_BARRIERS];
+  unsigned int count = triageSparseCacheBarriers(index, request, chapters);
+  for (unsigned int i = 0; i < count; i++) {
+    // Have the request's zone make sure the chapter is cached before it
+    // handles the request.
+    enqueueBarrierMessage(router, index, request->zoneNumber, chapters[i]);
   }
 
   enqueueRequest(request, STAGE_INDEX);
@@ -194,6 +212,20 @@ int makeLocalIndexRouter(IndexLayout          *layout,
     return logErrorWithStringError(result, "failed to create index");
   }
 
+  CacheHotSet *hotSet = router->index->hotSet;
+  if (hotSet != NULL) {
+    if (router->index->loadedType == LOAD_LOAD) {
+      // Reload the sparse cache least recently used chapter first, so the
+      // search order matches the one the index was saved with.
+      for (unsigned int i = hotSet->chapterCount; i > 0; i--) {
+        enqueueBarrierMessage(router, router->index, 0,
+                              hotSet->chapters[i - 1]);
+      }
+    }
+    router->index->hotSet = NULL;
+    freeCacheHotSet(hotSet);
+  }
+
   router->needToSave = (router->index->loadedType != LOAD_LOAD);
   *newRouter = asIndexRouter(router);
   return UDS_SUCCESS;
@@ -301,6 +333,12 @@ static int getRouterStatistics(IndexRouter             *header,
 {
   LocalIndexRouter *router = asLocalIndexRouter(header);
   getIndexStats(router->index, counters);
+  if (router->triageQueue != NULL) {
+    getRequestQueueStats(router->triageQueue, counters->queueClasses);
+  }
+  for (unsigned int i = 0; i < router->zoneCount; i++) {
+    getRequestQueueStats(router->zoneQueues[i], counters->queueClasses);
+  }
   return UDS_SUCCESS;
 }
 
@@ -317,3 +355,225 @@ static void waitForIdle(IndexRouter *header)
   LocalIndexRouter *router = asLocalIndexRouter(header);
   waitForIdleChapterWriter(router->index->chapterWriter);
 }
+
+/**
+ * Convert a radix sort key back into the bulk record containing it. The
+ * keys are the master index bytes of the record names, and the name is the
+ * first field of a record.
+ *
+ * @param key  the key of a record
+ *
+ * @return the record
+ **/
+static INLINE const UdsBulkRecord *keyToBulkRecord(const byte *key)
+{
+  return (const UdsBulkRecord *) (key - MASTER_INDEX_BYTES_OFFSET);
+}
+
+/**
+ * Drop all but the last record given for each name from a batch of keys
+ * sorted by master index bytes. The records are indexed as updates in the
+ * order given, so only the last metadata for a name may survive, but the
+ * radix sort does not preserve the order of equal keys.
+ *
+ * @param sorter  a radix sorter for a full batch
+ * @param keys    the sorted keys of the batch (modified in place)
+ * @param count   the number of keys, updated to the number kept
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int dropDuplicateBulkRecords(RadixSorter   *sorter,
+                                    const byte   **keys,
+                                    unsigned int  *count)
+{
+  unsigned int kept = 0;
+  unsigned int runEnd;
+  for (unsigned int runStart = 0; runStart < *count; runStart = runEnd) {
+    for (runEnd = runStart + 1; runEnd < *count; runEnd++) {
+      if (memcmp(keys[runStart], keys[runEnd],
+                 MASTER_INDEX_BYTES_COUNT) != 0) {
+        break;
+      }
+    }
+
+    unsigned int runCount = runEnd - runStart;
+    if (runCount > 1) {
+      // Different names rarely share master index bytes, so only these
+      // short runs need sorting by the whole name to gather duplicates.
+      const byte **run = &keys[runStart];
+      for (unsigned int i = 0; i < runCount; i++) {
+        run[i] = keyToBulkRecord(run[i])->name.name;
+      }
+      int result = radixSort(sorter, run, runCount, UDS_CHUNK_NAME_SIZE);
+      for (unsigned int i = 0; i < runCount; i++) {
+        run[i] += MASTER_INDEX_BYTES_OFFSET;
+      }
+      if (result != UDS_SUCCESS) {
+        return result;
+      }
+    }
+
+    unsigned int next;
+    for (unsigned int i = runStart; i < runEnd; i = next) {
+      // The keys point into the records array, so the highest address of
+      // a name is the last record given for it.
+      const UdsChunkName *name = &keyToBulkRecord(keys[i])->name;
+      const byte *last = keys[i];
+      for (next = i + 1; next < runEnd; next++) {
+        if (memcmp(&keyToBulkRecord(keys[next])->name, name,
+                   UDS_CHUNK_NAME_SIZE) != 0) {
+          break;
+        }
+        if (keys[next] > last) {
+          last = keys[next];
+        }
+      }
+      keys[kept++] = last;
+    }
+  }
+  *count = kept;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Sort a batch of bulk loaded records by the zone which owns them, in
+ * master index order within each zone, keeping only the last record for
+ * each name, and have all the zones add their shares of the batch in
+ * parallel.
+ *
+ * @param router   the router for the index
+ * @param sorter   a radix sorter for a full batch
+ * @param keys     space for the sort key of each record of a full batch
+ * @param sorted   space to hold a full batch of records
+ * @param records  the records to add
+ * @param count    the number of records, at most BULK_LOAD_BATCH_SIZE
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int bulkLoadBatch(LocalIndexRouter     *router,
+                         RadixSorter          *sorter,
+                         const byte          **keys,
+                         UdsBulkRecord        *sorted,
+                         const UdsBulkRecord  *records,
+                         unsigned int          count)
+{
+  for (unsigned int i = 0; i < count; i++) {
+    keys[i] = &records[i].name.name[MASTER_INDEX_BYTES_OFFSET];
+  }
+  int result = radixSort(sorter, keys, count, sizeof(uint64_t));
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = dropDuplicateBulkRecords(sorter, keys, &count);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  MasterIndex *masterIndex = router->index->masterIndex;
+  unsigned int zoneStarts[MAX_ZONES + 1];
+  memset(zoneStarts, 0, sizeof(zoneStarts));
+  for (unsigned int i = 0; i < count; i++) {
+    const UdsBulkRecord *record = keyToBulkRecord(keys[i]);
+    zoneStarts[getMasterIndexZone(masterIndex, &record->name) + 1]++;
+  }
+  for (unsigned int zone = 1; zone <= router->zoneCount; zone++) {
+    zoneStarts[zone] += zoneStarts[zone - 1];
+  }
+
+  // Distributing the records in sorted order keeps each share sorted.
+  unsigned int zoneNext[MAX_ZONES];
+  memcpy(zoneNext, zoneStarts, sizeof(zoneNext));
+  for (unsigned int i = 0; i < count; i++) {
+    const UdsBulkRecord *record = keyToBulkRecord(keys[i]);
+    unsigned int zone = getMasterIndexZone(masterIndex, &record->name);
+    sorted[zoneNext[zone]++] = *record;
+  }
+
+  SynchronousCallback synchronous[MAX_ZONES];
+  Request *requests[MAX_ZONES];
+  unsigned int launched;
+  for (launched = 0; launched < router->zoneCount; launched++) {
+    unsigned int zone = launched;
+    requests[zone] = NULL;
+    unsigned int share = zoneStarts[zone + 1] - zoneStarts[zone];
+    if (share == 0) {
+      continue;
+    }
+    ZoneMessage message = {
+      .index = router->index,
+      .data = {
+        .bulkLoad = {
+          .records = &sorted[zoneStarts[zone]],
+          .count   = share,
+        }
+      }
+    };
+    result = startSynchronousZoneControlMessage(REQUEST_BULK_LOAD, message,
+                                                zone, asIndexRouter(router),
+                                                &synchronous[zone],
+                                                &requests[zone]);
+    if (result != UDS_SUCCESS) {
+      break;
+    }
+  }
+
+  // Wait for every zone which was sent a share, even after an error, since
+  // the zones are reading the sorted records.
+  for (unsigned int zone = 0; zone < launched; zone++) {
+    if (requests[zone] == NULL) {
+      continue;
+    }
+    awaitSynchronousRequest(&synchronous[zone]);
+    if (result == UDS_SUCCESS) {
+      result = requests[zone]->status;
+    }
+    freeRequest(requests[zone]);
+  }
+  return result;
+}
+
+/**********************************************************************/
+static int bulkLoad(IndexRouter         *header,
+                    const UdsBulkRecord *records,
+                    size_t               count)
+{
+  LocalIndexRouter *router = asLocalIndexRouter(header);
+  if (count == 0) {
+    return UDS_SUCCESS;
+  }
+
+  unsigned int batchSize = minSizeT(count, BULK_LOAD_BATCH_SIZE);
+  RadixSorter *sorter;
+  int result = makeRadixSorter(batchSize, &sorter);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  const byte **keys;
+  result = ALLOCATE(batchSize, const byte *, "bulk load keys", &keys);
+  if (result != UDS_SUCCESS) {
+    freeRadixSorter(sorter);
+    return result;
+  }
+  UdsBulkRecord *sorted;
+  result = ALLOCATE(batchSize, UdsBulkRecord, "bulk load records", &sorted);
+  if (result != UDS_SUCCESS) {
+    FREE(keys);
+    freeRadixSorter(sorter);
+    return result;
+  }
+
+  router->needToSave = true;
+  for (size_t done = 0; done < count; done += batchSize) {
+    unsigned int batch = minSizeT(count - done, batchSize);
+    result = bulkLoadBatch(router, sorter, keys, sorted, &records[done],
+                           batch);
+    if (result != UDS_SUCCESS) {
+      break;
+    }
+  }
+
+  FREE(sorted);
+  FREE(keys);
+  freeRadixSorter(sorter);
+  return result;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/lookupCache.c#1 $
+ */
+
+#include "lookupCache.h"
+
+#include "atomicDefs.h"
+#include "featureDefs.h"
+#include "hashUtils.h"
+#include "memoryAlloc.h"
+#include "parameter.h"
+#include "timeUtils.h"
+
+enum {
+  /** The largest number of slots in a lookup cache */
+  MAX_LOOKUP_CACHE_SIZE = 65536,
+};
+
+typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) lookupCacheSlot {
+  /** odd while the callback thread is storing a result in the slot */
+  atomic_t     sequence;
+  /** advanced by each request which may change a name in the slot */
+  atomic_t     invalidations;
+  /** the value of invalidations when the cached query was started */
+  unsigned int epoch;
+  /** where the name was found, or LOC_UNAVAILABLE */
+  IndexRegion  location;
+  /** when the result was stored; an unused slot is always too old */
+  AbsTime      stored;
+  UdsChunkName name;
+  UdsChunkData metadata;
+} LookupCacheSlot;
+
+struct lookupCache {
+  unsigned int     slotCount;
+  LookupCacheSlot *slots;
+};
+
+static const NumericValidationData lookupCacheSizeRange = {
+  .minValue = 0,
+  .maxValue = MAX_LOOKUP_CACHE_SIZE,
+};
+
+/**********************************************************************/
+static UdsParameterValue getDefaultLookupCacheSize(void)
+{
+  UdsParameterValue value;
+#if ENVIRONMENT
+  char *env = getenv(UDS_LOOKUP_CACHE_SIZE);
+  if (env != NULL) {
+    UdsParameterValue tmp = {
+      .type = UDS_PARAM_TYPE_STRING,
+      .value.u_string = env,
+    };
+    if (validateNumericRange(&tmp, &lookupCacheSizeRange, &value)
+        == UDS_SUCCESS) {
+      return value;
+    }
+  }
+#endif // ENVIRONMENT
+  value.type = UDS_PARAM_TYPE_UNSIGNED_INT;
+  value.value.u_uint = 0;
+  return value;
+}
+
+/**********************************************************************/
+int defineLookupCacheSize(ParameterDefinition *pd)
+{
+  pd->validate       = validateNumericRange;
+  pd->validationData = &lookupCacheSizeRange;
+  pd->currentValue   = getDefaultLookupCacheSize();
+  pd->update         = NULL;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+unsigned int getLookupCacheSize(void)
+{
+  UdsParameterValue value;
+  if ((udsGetParameter(UDS_LOOKUP_CACHE_SIZE, &value) == UDS_SUCCESS) &&
+      (value.type == UDS_PARAM_TYPE_UNSIGNED_INT)) {
+    return value.value.u_uint;
+  }
+  return 0;
+}
+
+/**********************************************************************/
+int makeLookupCache(unsigned int slotCount, LookupCache **cachePtr)
+{
+  LookupCache *cache;
+  int result = ALLOCATE(1, LookupCache, "lookup cache", &cache);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = allocateCacheAligned(slotCount * sizeof(LookupCacheSlot),
+                                "lookup cache slots", &cache->slots);
+  if (result != UDS_SUCCESS) {
+    FREE(cache);
+    return result;
+  }
+  cache->slotCount = slotCount;
+  *cachePtr = cache;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+void freeLookupCache(LookupCache *cache)
+{
+  if (cache == NULL) {
+    return;
+  }
+  FREE(cache->slots);
+  FREE(cache);
+}
+
+/**********************************************************************/
+static INLINE LookupCacheSlot *getSlot(const LookupCache  *cache,
+                                       const UdsChunkName *name)
+{
+  return &cache->slots[extractMasterIndexBytes(name) % cache->slotCount];
+}
+
+/**********************************************************************/
+unsigned int getLookupCacheEpoch(const LookupCache  *cache,
+                                 const UdsChunkName *name)
+{
+  return atomic_read_acquire(&getSlot(cache, name)->invalidations);
+}
+
+/**********************************************************************/
+void invalidateLookupCacheName(LookupCache *cache, const UdsChunkName *name)
+{
+  // The full barrier of the increment orders it before the request is
+  // enqueued, so the result of any query started later cannot be stored
+  // under the old epoch.
+  atomic_add_return(1, &getSlot(cache, name)->invalidations);
+}
+
+/**********************************************************************/
+bool searchLookupCache(LookupCache        *cache,
+                       const UdsChunkName *name,
+                       bool                update,
+                       UdsChunkData       *metadata,
+                       IndexRegion        *location)
+{
+  LookupCacheSlot *slot = getSlot(cache, name);
+  int sequence = atomic_read(&slot->sequence);
+  if ((sequence & 1) != 0) {
+    // The slot is being written; just go to the index.
+    return false;
+  }
+  smp_rmb();
+
+  // Copy everything before validating any of it.
+  UdsChunkName cachedName  = slot->name;
+  UdsChunkData cachedData  = slot->metadata;
+  IndexRegion  cachedWhere = slot->location;
+  unsigned int epoch       = slot->epoch;
+  AbsTime      stored      = slot->stored;
+
+  smp_rmb();
+  if (atomic_read(&slot->sequence) != sequence) {
+    return false;
+  }
+
+  if ((epoch != (unsigned int) atomic_read(&slot->invalidations))
+      || (memcmp(&cachedName, name, sizeof(UdsChunkName)) != 0)
+      || (update && (cachedWhere != LOC_UNAVAILABLE))) {
+    return false;
+  }
+  RelTime age = timeDifference(currentTime(CT_MONOTONIC), stored);
+  if (age > millisecondsToRelTime(LOOKUP_CACHE_MAX_AGE_MS)) {
+    return false;
+  }
+
+  *metadata = cachedData;
+  *location = cachedWhere;
+  return true;
+}
+
+/**********************************************************************/
+void updateLookupCache(LookupCache        *cache,
+                       const UdsChunkName *name,
+                       unsigned int        epoch,
+                       const UdsChunkData *metadata,
+                       IndexRegion         location)
+{
+  LookupCacheSlot *slot = getSlot(cache, name);
+  if (epoch != (unsigned int) atomic_read(&slot->invalidations)) {
+    // The name may have changed since the query was started.
+    return;
+  }
+
+  int sequence = atomic_read(&slot->sequence);
+  atomic_set(&slot->sequence, sequence + 1);
+  smp_wmb();
+  slot->name     = *name;
+  slot->metadata = *metadata;
+  slot->location = location;
+  slot->epoch    = epoch;
+  slot->stored   = currentTime(CT_MONOTONIC);
+  smp_wmb();
+  atomic_set(&slot->sequence, sequence + 2);
+}
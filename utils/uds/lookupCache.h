@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/lookupCache.h#1 $
+ */
+
+#ifndef LOOKUP_CACHE_H
+#define LOOKUP_CACHE_H
+
+#include "common.h"
+#include "request.h"
+
+/**
+ * A lookup cache remembers the recent results of the queries made on one
+ * block context, so that a client which queries the same chunk name again
+ * within a short time is answered without the request entering the index.
+ *
+ * The cache is a direct-mapped array of slots. Only the callback thread of
+ * the index session stores results, so each slot is guarded by a sequence
+ * number with a single writer, and the client threads which search the
+ * cache never write to it. A client thread which posts, updates, or
+ * deletes a name instead advances the invalidation epoch of the name's
+ * slot. A query notes the epoch of its slot when it is started, and its
+ * result is only ever returned from the cache if the epoch has not changed
+ * since, so that a result cannot outlive a change made through the same
+ * context. Changes made through other contexts are not seen, so results
+ * are also discarded once they are LOOKUP_CACHE_MAX_AGE_MS old.
+ **/
+enum {
+  /** The age at which cached results are no longer returned */
+  LOOKUP_CACHE_MAX_AGE_MS = 100,
+};
+
+typedef struct lookupCache LookupCache;
+
+/**
+ * Make a lookup cache.
+ *
+ * @param slotCount  The number of results the cache can hold
+ * @param cachePtr   A pointer to hold the new cache
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int makeLookupCache(unsigned int slotCount, LookupCache **cachePtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a lookup cache.
+ *
+ * @param cache  The cache to free (may be NULL)
+ **/
+void freeLookupCache(LookupCache *cache);
+
+/**
+ * Get the number of results a lookup cache can hold, as configured by the
+ * UDS_LOOKUP_CACHE_SIZE parameter.
+ *
+ * @return the number of slots for new lookup caches, or 0 if block contexts
+ *         should not have one
+ **/
+unsigned int getLookupCacheSize(void);
+
+/**
+ * Get the invalidation epoch of the slot for a chunk name, to be passed to
+ * updateLookupCache() when the result of a query for the name is known.
+ *
+ * @param cache  The lookup cache
+ * @param name   The chunk name being queried
+ *
+ * @return the epoch
+ **/
+unsigned int getLookupCacheEpoch(const LookupCache  *cache,
+                                 const UdsChunkName *name);
+
+/**
+ * Invalidate any cached result for a chunk name, because a request which
+ * may change its entry in the index is being started.
+ *
+ * @param cache  The lookup cache
+ * @param name   The chunk name
+ **/
+void invalidateLookupCacheName(LookupCache *cache, const UdsChunkName *name);
+
+/**
+ * Search a lookup cache for the result of an earlier query.
+ *
+ * @param [in]  cache     The lookup cache
+ * @param [in]  name      The chunk name being queried
+ * @param [in]  update    Whether the query should move a found entry to the
+ *                        open chapter, in which case only a cached negative
+ *                        result will do
+ * @param [out] metadata  The metadata of the found entry
+ * @param [out] location  The location of the entry, or LOC_UNAVAILABLE if
+ *                        the name was not found
+ *
+ * @return true if the cache held a usable result
+ **/
+bool searchLookupCache(LookupCache        *cache,
+                       const UdsChunkName *name,
+                       bool                update,
+                       UdsChunkData       *metadata,
+                       IndexRegion        *location)
+  __attribute__((warn_unused_result));
+
+/**
+ * Store the result of a query in a lookup cache. This must only be called
+ * on the callback thread.
+ *
+ * @param cache     The lookup cache
+ * @param name      The chunk name which was queried
+ * @param epoch     The epoch returned by getLookupCacheEpoch() when the
+ *                  query was started
+ * @param metadata  The metadata of the found entry
+ * @param location  The location of the entry, or LOC_UNAVAILABLE
+ **/
+void updateLookupCache(LookupCache        *cache,
+                       const UdsChunkName *name,
+                       unsigned int        epoch,
+                       const UdsChunkData *metadata,
+                       IndexRegion         location);
+
+#endif /* LOOKUP_CACHE_H */
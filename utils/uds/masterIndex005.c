@@ -59,6 +59,8 @@ typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) masterIndexZone {
   uint64_t virtualChapterLow;      // The lowest virtual chapter indexed
   uint64_t virtualChapterHigh;     // The highest virtual chapter indexed
   long     numEarlyFlushes;        // The number of early flushes
+  unsigned int sweepCursor;        // The next list to sweep, zone relative
+  unsigned int sweepRemaining;     // The lists the sweep may still visit
 } MasterIndexZone;
 
 typedef struct {
@@ -87,6 +89,15 @@ typedef struct chapterRange {
 static const byte masterIndexRecordMagic = 0xAA;
 static const byte badMagic = 0;
 
+// The number of times a lookup of a sampled name may find that a writer
+// modified the delta list it copied before it excludes the writers instead.
+enum { MAX_OPTIMISTIC_LOOKUPS = 8 };
+
+// The number of chapters over which the background sweep of expired
+// entries visits every delta list of a zone once.  A list which lookups
+// have flushed within that many chapters is left for them to flush.
+enum { SWEEP_PASS_CHAPTERS = 16 };
+
 /*
  * In production, the default value for minMasterIndexDeltaLists will be
  * replaced by MAX_ZONES*MAX_ZONES.  Some unit tests will replace
@@ -316,6 +327,41 @@ static int getMasterIndexEntry(MasterIndexRecord *record,
   return UDS_SUCCESS;
 }
 
+/***********************************************************************/
+/**
+ * Remove the entries of expired chapters from a delta list while finding
+ * the delta index entry, or the insertion point for a delta index entry,
+ * for a key.
+ *
+ * @param mi5         The master index
+ * @param record      Updated to describe the entry being looked for
+ * @param listNumber  The delta list number
+ * @param key         The address field being looked for
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int flushExpiredEntries(MasterIndex5      *mi5,
+                               MasterIndexRecord *record,
+                               unsigned int       listNumber,
+                               unsigned int       key)
+{
+  const MasterIndexZone *masterZone = getMasterZone(record);
+  uint64_t flushChapter = mi5->flushChapters[listNumber];
+  uint64_t flushCount = masterZone->virtualChapterLow - flushChapter;
+  ChapterRange range;
+  range.chapterStart = convertVirtualToIndex(mi5, flushChapter);
+  range.chapterCount = (flushCount > mi5->chapterMask
+                        ? mi5->chapterMask + 1
+                        : flushCount);
+  int result = getMasterIndexEntry(record, listNumber, key, &range);
+  flushChapter = convertIndexToVirtual(record, range.chapterStart);
+  if (flushChapter > masterZone->virtualChapterHigh) {
+    flushChapter = masterZone->virtualChapterHigh;
+  }
+  mi5->flushChapters[listNumber] = flushChapter;
+  return result;
+}
+
 /***********************************************************************/
 /**
  * Terminate and clean up the master index
@@ -788,6 +834,7 @@ static void setMasterIndexZoneOpenChapter_005(MasterIndex *masterIndex,
 {
   MasterIndex5 *mi5 = container_of(masterIndex, MasterIndex5, common);
   MasterIndexZone *masterZone = &mi5->masterZones[zoneNumber];
+  uint64_t oldVirtualLow = masterZone->virtualChapterLow;
   // Take care here to avoid underflow of an unsigned value.  Note that
   // this is the smallest valid virtual low.  We may or may not actually
   // use this value.
@@ -856,6 +903,68 @@ static void setMasterIndexZoneOpenChapter_005(MasterIndex *masterIndex,
       }
     }
   }
+  // Expiring chapters lets the sweep visit another share of the lists, so
+  // that a pass over the whole zone is spread across several chapters.
+  if (masterZone->virtualChapterLow != oldVirtualLow) {
+    unsigned int numLists = getDeltaIndexZoneNumLists(&mi5->deltaIndex,
+                                                      zoneNumber);
+    unsigned int share = ((numLists + SWEEP_PASS_CHAPTERS - 1)
+                          / SWEEP_PASS_CHAPTERS);
+    masterZone->sweepRemaining += share;
+    if (masterZone->sweepRemaining > numLists) {
+      masterZone->sweepRemaining = numLists;
+    }
+  }
+}
+
+/***********************************************************************/
+/**
+ * Remove the entries of expired chapters from some of the delta lists of a
+ * zone, continuing the sweep of the zone from where it last stopped.  Only
+ * lists which no lookup has flushed for a full pass of the sweep are
+ * flushed, since lookups flush the lists they search anyway.
+ *
+ * @param masterIndex  The master index
+ * @param zoneNumber   The zone number
+ * @param listCount    The maximum number of delta lists to examine
+ * @param finished     Set to true if the sweep of the zone is complete
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int sweepMasterIndexZone_005(MasterIndex  *masterIndex,
+                                    unsigned int  zoneNumber,
+                                    unsigned int  listCount,
+                                    bool         *finished)
+{
+  MasterIndex5 *mi5 = container_of(masterIndex, MasterIndex5, common);
+  MasterIndexZone *masterZone = &mi5->masterZones[zoneNumber];
+  unsigned int firstList = getDeltaIndexZoneFirstList(&mi5->deltaIndex,
+                                                      zoneNumber);
+  unsigned int numLists = getDeltaIndexZoneNumLists(&mi5->deltaIndex,
+                                                    zoneNumber);
+  UdsChunkName name;
+  memset(&name, 0, sizeof(UdsChunkName));
+  MasterIndexRecord record = (MasterIndexRecord) {
+    .magic       = masterIndexRecordMagic,
+    .masterIndex = masterIndex,
+    .name        = &name,
+    .zoneNumber  = zoneNumber,
+  };
+  for (; (listCount > 0) && (masterZone->sweepRemaining > 0); listCount--) {
+    unsigned int listNumber = firstList + masterZone->sweepCursor;
+    masterZone->sweepCursor = (masterZone->sweepCursor + 1) % numLists;
+    masterZone->sweepRemaining--;
+    if (mi5->flushChapters[listNumber] + SWEEP_PASS_CHAPTERS
+        > masterZone->virtualChapterLow) {
+      continue;
+    }
+    int result = flushExpiredEntries(mi5, &record, listNumber, 0);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+  *finished = (masterZone->sweepRemaining == 0);
+  return UDS_SUCCESS;
 }
 
 /***********************************************************************/
@@ -977,6 +1086,68 @@ static int lookupMasterIndexSampledName_005(const MasterIndex *masterIndex,
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+int lookupSharedMasterIndexSampledName005(const MasterIndex  *masterIndex,
+                                          const UdsChunkName *name,
+                                          SeqLock            *hookLock,
+                                          MasterIndexTriage  *triage)
+{
+  const MasterIndex5 *mi5 = const_container_of(masterIndex, MasterIndex5,
+                                               common);
+  unsigned int address = extractAddress(mi5, name);
+  unsigned int deltaListNumber = extractDListNum(mi5, name);
+  const MasterIndexZone *masterZone = &mi5->masterZones[triage->zone];
+
+  // Copy everything the lookup depends on, retrying until no writer
+  // intervened, and only then decode the copy.
+  DeltaListSnapshot snapshot;
+  uint64_t virtualChapterLow, virtualChapterHigh;
+  int result;
+  for (unsigned int attempt = 0; ; attempt++) {
+    if (attempt == MAX_OPTIMISTIC_LOOKUPS) {
+      readLockSeqLock(hookLock);
+      result = snapshotDeltaList(&mi5->deltaIndex, deltaListNumber,
+                                 &snapshot);
+      virtualChapterLow  = masterZone->virtualChapterLow;
+      virtualChapterHigh = masterZone->virtualChapterHigh;
+      readUnlockSeqLock(hookLock);
+      break;
+    }
+    int sequence;
+    if (!beginReadSeqLock(hookLock, &sequence)) {
+      continue;
+    }
+    result = snapshotDeltaList(&mi5->deltaIndex, deltaListNumber, &snapshot);
+    virtualChapterLow  = masterZone->virtualChapterLow;
+    virtualChapterHigh = masterZone->virtualChapterHigh;
+    if (endReadSeqLock(hookLock, sequence)) {
+      break;
+    }
+  }
+  if (result != UDS_SUCCESS) {
+    return logErrorWithStringError(result, "bad header for delta list %u",
+                                   deltaListNumber);
+  }
+
+  DeltaIndexEntry deltaEntry;
+  result = getDeltaListSnapshotEntry(&snapshot, address, name->name,
+                                     &deltaEntry);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  triage->inSampledChapter = !deltaEntry.atEnd && (deltaEntry.key == address);
+  if (triage->inSampledChapter) {
+    unsigned int indexChapter = getDeltaEntryValue(&deltaEntry);
+    unsigned int rollingChapter = ((indexChapter - virtualChapterLow)
+                                   & mi5->chapterMask);
+    triage->virtualChapter = virtualChapterLow + rollingChapter;
+    if (triage->virtualChapter > virtualChapterHigh) {
+      triage->inSampledChapter = false;
+    }
+  }
+  return UDS_SUCCESS;
+}
+
 /***********************************************************************/
 /**
  * Find the master index record associated with a block name
@@ -1014,25 +1185,14 @@ static int getMasterIndexRecord_005(MasterIndex *masterIndex,
   uint64_t flushChapter = mi5->flushChapters[deltaListNumber];
   record->magic       = masterIndexRecordMagic;
   record->masterIndex = masterIndex;
-  record->mutex       = NULL;
+  record->hookLock    = NULL;
   record->name        = name;
   record->zoneNumber  = getDeltaIndexZone(&mi5->deltaIndex, deltaListNumber);
   const MasterIndexZone *masterZone = getMasterZone(record);
 
   int result;
   if (flushChapter < masterZone->virtualChapterLow) {
-    ChapterRange range;
-    uint64_t flushCount = masterZone->virtualChapterLow - flushChapter;
-    range.chapterStart = convertVirtualToIndex(mi5, flushChapter);
-    range.chapterCount = (flushCount > mi5->chapterMask
-                          ? mi5->chapterMask + 1
-                          : flushCount);
-    result = getMasterIndexEntry(record, deltaListNumber, address, &range);
-    flushChapter = convertIndexToVirtual(record, range.chapterStart);
-    if (flushChapter > masterZone->virtualChapterHigh) {
-      flushChapter = masterZone->virtualChapterHigh;
-    }
-    mi5->flushChapters[deltaListNumber] = flushChapter;
+    result = flushExpiredEntries(mi5, record, deltaListNumber, address);
   } else {
     result = getDeltaIndexEntry(&mi5->deltaIndex, deltaListNumber, address,
                                 name->name, false, &record->deltaEntry);
@@ -1078,14 +1238,14 @@ int putMasterIndexRecord(MasterIndexRecord *record, uint64_t virtualChapter)
                                      masterZone->virtualChapterHigh);
   }
   unsigned int address = extractAddress(mi5, record->name);
-  if (unlikely(record->mutex != NULL)) {
-    lockMutex(record->mutex);
+  if (unlikely(record->hookLock != NULL)) {
+    writeLockSeqLock(record->hookLock);
   }
   int result = putDeltaIndexEntry(&record->deltaEntry, address,
                                   convertVirtualToIndex(mi5, virtualChapter),
                                   record->isFound ? record->name->name : NULL);
-  if (unlikely(record->mutex != NULL)) {
-    unlockMutex(record->mutex);
+  if (unlikely(record->hookLock != NULL)) {
+    writeUnlockSeqLock(record->hookLock);
   }
   switch (result) {
   case UDS_SUCCESS:
@@ -1134,12 +1294,12 @@ int removeMasterIndexRecord(MasterIndexRecord *record)
   }
   // Mark the record so that it cannot be used again
   record->magic = badMagic;
-  if (unlikely(record->mutex != NULL)) {
-    lockMutex(record->mutex);
+  if (unlikely(record->hookLock != NULL)) {
+    writeLockSeqLock(record->hookLock);
   }
   result = removeDeltaIndexEntry(&record->deltaEntry);
-  if (unlikely(record->mutex != NULL)) {
-    unlockMutex(record->mutex);
+  if (unlikely(record->hookLock != NULL)) {
+    writeUnlockSeqLock(record->hookLock);
   }
   return result;
 }
@@ -1172,13 +1332,13 @@ int setMasterIndexRecordChapter(MasterIndexRecord *record,
                                      masterZone->virtualChapterLow,
                                      masterZone->virtualChapterHigh);
   }
-  if (unlikely(record->mutex != NULL)) {
-    lockMutex(record->mutex);
+  if (unlikely(record->hookLock != NULL)) {
+    writeLockSeqLock(record->hookLock);
   }
   result = setDeltaEntryValue(&record->deltaEntry,
                               convertVirtualToIndex(mi5, virtualChapter));
-  if (unlikely(record->mutex != NULL)) {
-    unlockMutex(record->mutex);
+  if (unlikely(record->hookLock != NULL)) {
+    writeUnlockSeqLock(record->hookLock);
   }
   if (result != UDS_SUCCESS) {
     return result;
@@ -1240,6 +1400,110 @@ static void getMasterIndexStats_005(const MasterIndex *masterIndex,
   memset(sparse, 0, sizeof(MasterIndexStats));
 }
 
+/***********************************************************************/
+/**
+ * Get the summary of the sampling state of the master index.  This
+ * implementation does no sampling.
+ *
+ * @param masterIndex  The master index
+ * @param state        The sampling state to fill in
+ **/
+static void getMasterIndexSampling_005(const MasterIndex *masterIndex
+                                       __attribute__((unused)),
+                                       MasterIndexSampling *state)
+{
+  memset(state, 0, sizeof(MasterIndexSampling));
+}
+
+/***********************************************************************/
+/**
+ * Restore the sampling state of the master index.  This implementation
+ * does no sampling, so only an empty state is valid.
+ *
+ * @param masterIndex  The master index
+ * @param state        The saved sampling state
+ *
+ * @return UDS_SUCCESS or UDS_CORRUPT_COMPONENT
+ **/
+static int setMasterIndexSampling_005(MasterIndex *masterIndex
+                                      __attribute__((unused)),
+                                      const MasterIndexSampling *state)
+{
+  if ((state->thinnedCount > 0) || (state->currentShift > 0)) {
+    return logWarningWithStringError(UDS_CORRUPT_COMPONENT,
+                                     "dense master index has sample shifts");
+  }
+  return UDS_SUCCESS;
+}
+
+/***********************************************************************/
+/**
+ * Get the sampling statistics of the master index.  This implementation
+ * does no sampling.
+ *
+ * @param masterIndex  The master index
+ * @param stats        The statistics to fill in
+ **/
+static void getMasterIndexSamplingStats_005(const MasterIndex *masterIndex
+                                            __attribute__((unused)),
+                                            UdsSparseSamplingStats *stats)
+{
+  memset(stats, 0, sizeof(UdsSparseSamplingStats));
+}
+
+/***********************************************************************/
+/**
+ * Determine whether any chapter has been sampled at more than the sample
+ * rate.  This implementation does no sampling.
+ *
+ * @param masterIndex  The master index
+ *
+ * @return false
+ **/
+static bool hasThinnedMasterIndexChapters_005(const MasterIndex *masterIndex
+                                              __attribute__((unused)))
+{
+  return false;
+}
+
+/***********************************************************************/
+/**
+ * Determine whether a given chunk name is a sample of a chapter.
+ *
+ * @param masterIndex     The master index
+ * @param name            The block name
+ * @param virtualChapter  The chapter containing the name
+ *
+ * @return whether the name is a sample of the chapter
+ **/
+static bool isMasterIndexChapterSample_005(const MasterIndex  *masterIndex
+                                           __attribute__((unused)),
+                                           const UdsChunkName *name
+                                           __attribute__((unused)),
+                                           uint64_t            virtualChapter
+                                           __attribute__((unused)))
+{
+  return false;
+}
+
+/***********************************************************************/
+/**
+ * Record that a request found its chunk.  This implementation does no
+ * sampling, so there is nothing to adapt.
+ *
+ * @param masterIndex  The master index
+ * @param zoneNumber   The zone which processed the request
+ * @param inSparse     Whether the chunk was found in a sparse chapter
+ **/
+static void recordMasterIndexDedupe_005(MasterIndex  *masterIndex
+                                        __attribute__((unused)),
+                                        unsigned int  zoneNumber
+                                        __attribute__((unused)),
+                                        bool          inSparse
+                                        __attribute__((unused)))
+{
+}
+
 /***********************************************************************/
 /**
  * Determine whether a given chunk name is a hook.
@@ -1414,19 +1678,26 @@ int makeMasterIndex005(const Configuration *config, unsigned int numZones,
   mi5->common.freeMasterIndex               = freeMasterIndex_005;
   mi5->common.getMasterIndexMemoryUsed      = getMasterIndexMemoryUsed_005;
   mi5->common.getMasterIndexRecord          = getMasterIndexRecord_005;
+  mi5->common.getMasterIndexSampling        = getMasterIndexSampling_005;
+  mi5->common.getMasterIndexSamplingStats   = getMasterIndexSamplingStats_005;
   mi5->common.getMasterIndexStats           = getMasterIndexStats_005;
   mi5->common.getMasterIndexZone            = getMasterIndexZone_005;
+  mi5->common.hasThinnedMasterIndexChapters = hasThinnedMasterIndexChapters_005;
+  mi5->common.isMasterIndexChapterSample    = isMasterIndexChapterSample_005;
   mi5->common.isMasterIndexSample           = isMasterIndexSample_005;
   mi5->common.isRestoringMasterIndexDone    = isRestoringMasterIndexDone_005;
   mi5->common.isSavingMasterIndexDone       = isSavingMasterIndexDone_005;
   mi5->common.lookupMasterIndexName         = lookupMasterIndexName_005;
   mi5->common.lookupMasterIndexSampledName  = lookupMasterIndexSampledName_005;
+  mi5->common.recordMasterIndexDedupe       = recordMasterIndexDedupe_005;
   mi5->common.restoreDeltaListToMasterIndex = restoreDeltaListToMasterIndex_005;
   mi5->common.setMasterIndexOpenChapter     = setMasterIndexOpenChapter_005;
+  mi5->common.setMasterIndexSampling        = setMasterIndexSampling_005;
   mi5->common.setMasterIndexTag             = setMasterIndexTag_005;
   mi5->common.setMasterIndexZoneOpenChapter = setMasterIndexZoneOpenChapter_005;
   mi5->common.startRestoringMasterIndex     = startRestoringMasterIndex_005;
   mi5->common.startSavingMasterIndex        = startSavingMasterIndex_005;
+  mi5->common.sweepMasterIndexZone          = sweepMasterIndexZone_005;
 
   mi5->addressBits     = params.addressBits;
   mi5->addressMask     = (1u << params.addressBits) - 1;
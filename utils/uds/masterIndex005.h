@@ -23,6 +23,7 @@
 #define MASTERINDEX005_H 1
 
 #include "masterIndexOps.h"
+#include "seqLock.h"
 
 /**
  * Make a new master index.
@@ -51,4 +52,28 @@ int computeMasterIndexSaveBytes005(const Configuration *config,
                                    size_t *numBytes)
   __attribute__((warn_unused_result));
 
+/**
+ * Do a quick lookup of a sampled chunk name in a master index whose zone
+ * threads may be modifying it concurrently, as is the case for the hook
+ * index of a sparse master index. The delta list which would contain the
+ * name is copied under the protection of the zone's sequence lock, so the
+ * lookup normally writes no shared memory at all; a lookup which keeps
+ * colliding with writers falls back to excluding them with the mutex.
+ *
+ * @param masterIndex The master index
+ * @param name        The chunk name
+ * @param hookLock    The sequence lock which the writers of the zone hold
+ * @param triage      Information about the chunk name.  The zone and
+ *                    isSample fields are already filled in.  Set
+ *                    inSampledChapter and virtualChapter if the chunk
+ *                    name is found in the index.
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int lookupSharedMasterIndexSampledName005(const MasterIndex  *masterIndex,
+                                          const UdsChunkName *name,
+                                          SeqLock            *hookLock,
+                                          MasterIndexTriage  *triage)
+  __attribute__((warn_unused_result));
+
 #endif /* MASTERINDEX005_H */
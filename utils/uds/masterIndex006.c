@@ -20,15 +20,19 @@
  */
 #include "masterIndex006.h"
 
+#include "atomicDefs.h"
 #include "buffer.h"
 #include "compiler.h"
 #include "errors.h"
+#include "featureDefs.h"
 #include "hashUtils.h"
 #include "logger.h"
 #include "masterIndex005.h"
 #include "memoryAlloc.h"
+#include "numeric.h"
+#include "parameter.h"
 #include "permassert.h"
-#include "threads.h"
+#include "seqLock.h"
 #include "uds.h"
 
 /*
@@ -45,14 +49,63 @@
  * The only multithreaded operation supported by the sparse master index is
  * the lookupMasterIndexName() method.  It is called by the thread that
  * assigns an index request to the proper zone, and needs to do a master
- * index query for sampled chunk names.  The zone mutexes are used to make
- * this lookup operation safe.
+ * index query for sampled chunk names.  The zone sequence locks are used to
+ * make this lookup operation safe: the zone thread holds its lock for
+ * writing while it modifies the sampled index, and the lookup copies the
+ * delta list it needs and retries if a write intervened, so that lookups
+ * never write to memory shared with the zone threads or with each other.
+ *
+ * The configured sparse sample rate decides which names are hooks, and so
+ * which of the two sub-indexes (and which zone) a name belongs to; it never
+ * changes.  Each chapter, however, is assigned a sample shift when it is
+ * opened, and only the hooks which are also samples at the rate
+ * (sparseSampleRate << shift) remain in the master index once the chapter
+ * becomes sparse.  The shift is chosen by a controller which runs every
+ * SAMPLING_EPOCH_CHAPTERS chapters and compares the dedupe found through
+ * sparse chapters with all the dedupe found: when hooks find little of the
+ * dedupe they are thinned out, and when they find much of it they are
+ * restored.  A summary of the shifts is saved with the index state rather
+ * than with the master index, so that the saved master index is no larger
+ * than it was before the sample rate could adapt.
  */
 
+enum {
+  /** The largest shift applied to the sparse sample rate */
+  MAX_SAMPLE_SHIFT        = 3,
+  /** The number of chapters between adjustments of the sample rate */
+  SAMPLING_EPOCH_CHAPTERS = 16,
+  /** The fewest dedupe hits in an epoch that justify an adjustment */
+  MIN_EPOCH_HITS          = 1024,
+  /** Thin out hooks when the sparse share of hits is below this permille */
+  LOW_SPARSE_PERMILLE     = 20,
+  /** Add hooks back when the sparse share of hits is above this permille */
+  HIGH_SPARSE_PERMILLE    = 80,
+};
+
 typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) masterIndexZone {
-  Mutex hookMutex;          // Protects the sampled index in this zone
+  SeqLock    hookLock;      // Protects the sampled index in this zone
+  atomic64_t dedupeHits;    // Requests which found their chunk
+  atomic64_t sparseHits;    // Requests which found it in a sparse chapter
 } MasterIndexZone;
 
+/**
+ * The adaptive sampling state, which is shared by all the zones and is
+ * protected by its mutex, except as noted.  The count of thinned chapters
+ * is also read without the mutex, as a hint.
+ **/
+typedef struct {
+  Mutex        mutex;
+  uint64_t     samplingChapter;   // The newest chapter given a shift
+  unsigned int currentShift;      // The shift given to new chapters
+  uint64_t     rateChanges;       // The number of changes of the shift
+  uint64_t     epochDedupeHits;   // The dedupe hits when the epoch began
+  uint64_t     epochSparseHits;   // The sparse hits when the epoch began
+  unsigned int thinnedChapters;   // The chapters with a nonzero shift
+  unsigned int denseChapters;     // The number of dense chapters
+  unsigned int chaptersPerVolume; // The size of the shift table
+  byte         shifts[];          // The shift of each physical chapter
+} SampleShifts;
+
 typedef struct {
   MasterIndex      common;           // Common master index methods
   unsigned int     sparseSampleRate; // The sparse sample rate
@@ -60,6 +113,7 @@ typedef struct {
   MasterIndex     *miNonHook;        // The non-hook index
   MasterIndex     *miHook;           // The hook index == sample index
   MasterIndexZone *masterZones;      // The zones
+  SampleShifts    *sampling;         // The adaptive sampling state
 } MasterIndex6;
 
 /**
@@ -78,6 +132,48 @@ static INLINE bool isMasterIndexSample_006(const MasterIndex  *masterIndex,
   return (extractSamplingBytes(name) % mi6->sparseSampleRate) == 0;
 }
 
+/***********************************************************************/
+/**
+ * Determine whether a given chunk name is a sample of a chapter at the
+ * sample rate chosen for the chapter.
+ *
+ * @param masterIndex     The master index
+ * @param name            The block name
+ * @param virtualChapter  The chapter containing the name
+ *
+ * @return whether the name is a sample of the chapter
+ **/
+static bool isMasterIndexChapterSample_006(const MasterIndex  *masterIndex,
+                                           const UdsChunkName *name,
+                                           uint64_t            virtualChapter)
+{
+  const MasterIndex6 *mi6 = const_container_of(masterIndex, MasterIndex6,
+                                               common);
+  // The shift of a chapter is only written when a chapter a full volume
+  // later is opened, so it may be read without the sampling mutex.
+  const SampleShifts *sampling = mi6->sampling;
+  unsigned int shift
+    = sampling->shifts[virtualChapter % sampling->chaptersPerVolume];
+  uint64_t chapterRate = (uint64_t) mi6->sparseSampleRate << shift;
+  return (extractSamplingBytes(name) % chapterRate) == 0;
+}
+
+/***********************************************************************/
+/**
+ * Determine whether any chapter has been sampled at more than the
+ * configured sparse sample rate.
+ *
+ * @param masterIndex  The master index
+ *
+ * @return whether any chapter has a nonzero sample shift
+ **/
+static bool hasThinnedMasterIndexChapters_006(const MasterIndex *masterIndex)
+{
+  const MasterIndex6 *mi6 = const_container_of(masterIndex, MasterIndex6,
+                                               common);
+  return (READ_ONCE(mi6->sampling->thinnedChapters) > 0);
+}
+
 /***********************************************************************/
 /**
  * Get the subindex for the given chunk name
@@ -109,11 +205,16 @@ static void freeMasterIndex_006(MasterIndex *masterIndex)
     MasterIndex6 *mi6 = container_of(masterIndex, MasterIndex6, common);
     if (mi6->masterZones != NULL) {
       for (unsigned int zone = 0; zone < mi6->numZones; zone++) {
-        destroyMutex(&mi6->masterZones[zone].hookMutex);
+        destroySeqLock(&mi6->masterZones[zone].hookLock);
       }
       FREE(mi6->masterZones);
       mi6->masterZones = NULL;
     }
+    if (mi6->sampling != NULL) {
+      destroyMutex(&mi6->sampling->mutex);
+      FREE(mi6->sampling);
+      mi6->sampling = NULL;
+    }
     if (mi6->miNonHook != NULL) {
       freeMasterIndex(mi6->miNonHook);
       mi6->miNonHook = NULL;
@@ -431,11 +532,181 @@ static void abortRestoringMasterIndex_006(MasterIndex *masterIndex)
   abortRestoringMasterIndex(mi6->miHook);
 }
 
+/***********************************************************************/
+static UdsParameterValue getDefaultAdaptiveSparseSampling(void)
+{
+#if ENVIRONMENT
+  char *env = getenv(UDS_ADAPTIVE_SPARSE_SAMPLING);
+  if (env != NULL) {
+    UdsParameterValue tmp = {
+      .type = UDS_PARAM_TYPE_STRING,
+      .value.u_string = env,
+    };
+    UdsParameterValue value;
+    if (validateBoolean(&tmp, NULL, &value) == UDS_SUCCESS) {
+      return value;
+    }
+  }
+#endif // ENVIRONMENT
+  return UDS_PARAM_FALSE;
+}
+
+/***********************************************************************/
+int defineAdaptiveSparseSampling(ParameterDefinition *pd)
+{
+  pd->validate       = validateBoolean;
+  pd->validationData = NULL;
+  pd->currentValue   = getDefaultAdaptiveSparseSampling();
+  pd->update         = NULL;
+  return UDS_SUCCESS;
+}
+
+/***********************************************************************/
+/**
+ * Check whether the adaptive sampling of sparse chapters is enabled.
+ *
+ * @return true if the UDS_ADAPTIVE_SPARSE_SAMPLING parameter is true
+ **/
+static bool isAdaptiveSamplingEnabled(void)
+{
+  UdsParameterValue value;
+  if ((udsGetParameter(UDS_ADAPTIVE_SPARSE_SAMPLING, &value) == UDS_SUCCESS)
+      && (value.type == UDS_PARAM_TYPE_BOOL)) {
+    return value.value.u_bool;
+  }
+  return false;
+}
+
+/***********************************************************************/
+/**
+ * Choose the sample shift for the next epoch of chapters from the share of
+ * the dedupe hits of the last epoch which were found in sparse chapters.
+ * The sampling mutex must be held.
+ *
+ * @param mi6  The master index
+ **/
+static void adjustSampleShift(MasterIndex6 *mi6)
+{
+  uint64_t dedupeHits = 0;
+  uint64_t sparseHits = 0;
+  for (unsigned int z = 0; z < mi6->numZones; z++) {
+    dedupeHits += atomic64_read(&mi6->masterZones[z].dedupeHits);
+    sparseHits += atomic64_read(&mi6->masterZones[z].sparseHits);
+  }
+
+  SampleShifts *sampling = mi6->sampling;
+  unsigned int shift = sampling->currentShift;
+  if (!isAdaptiveSamplingEnabled()) {
+    shift = 0;
+  } else if ((dedupeHits - sampling->epochDedupeHits) >= MIN_EPOCH_HITS) {
+    uint64_t permille = (((sparseHits - sampling->epochSparseHits) * 1000)
+                         / (dedupeHits - sampling->epochDedupeHits));
+    if ((permille < LOW_SPARSE_PERMILLE) && (shift < MAX_SAMPLE_SHIFT)) {
+      shift++;
+    } else if ((permille > HIGH_SPARSE_PERMILLE) && (shift > 0)) {
+      shift--;
+    }
+    sampling->epochDedupeHits = dedupeHits;
+    sampling->epochSparseHits = sparseHits;
+  } else {
+    // Too few hits to judge by; keep accumulating them.
+    return;
+  }
+
+  if (shift != sampling->currentShift) {
+    logDebug("sparse sample rate changed from %u to %u",
+             mi6->sparseSampleRate << sampling->currentShift,
+             mi6->sparseSampleRate << shift);
+    sampling->currentShift = shift;
+    sampling->rateChanges++;
+  }
+}
+
+/***********************************************************************/
+/**
+ * Set the sample shift of a chapter, keeping count of the chapters with a
+ * nonzero shift.  The sampling mutex must be held.
+ *
+ * @param sampling  The sampling state
+ * @param chapter   The virtual chapter number
+ * @param shift     The new shift of the chapter
+ **/
+static void setChapterShift(SampleShifts *sampling,
+                            uint64_t      chapter,
+                            unsigned int  shift)
+{
+  byte *chapterShift = &sampling->shifts[chapter % sampling->chaptersPerVolume];
+  unsigned int thinned = sampling->thinnedChapters;
+  if (*chapterShift > 0) {
+    thinned--;
+  }
+  if (shift > 0) {
+    thinned++;
+  }
+  *chapterShift = shift;
+  WRITE_ONCE(sampling->thinnedChapters, thinned);
+}
+
+/***********************************************************************/
+/**
+ * Assign sample shifts to the chapters up to a newly opened chapter.
+ *
+ * @param mi6             The master index
+ * @param virtualChapter  The new open chapter number
+ * @param adapt           Whether to adjust the shift at epoch boundaries;
+ *                        otherwise the chapters get no shift at all, as is
+ *                        appropriate for chapters being replayed without
+ *                        a record of the shift they were sampled at
+ **/
+static void assignSampleShifts(MasterIndex6 *mi6,
+                               uint64_t      virtualChapter,
+                               bool          adapt)
+{
+  SampleShifts *sampling = mi6->sampling;
+  lockMutex(&sampling->mutex);
+  if (virtualChapter
+      > (sampling->samplingChapter + sampling->chaptersPerVolume)) {
+    sampling->samplingChapter = virtualChapter - sampling->chaptersPerVolume;
+  }
+  while (sampling->samplingChapter < virtualChapter) {
+    uint64_t chapter = ++sampling->samplingChapter;
+    if (!adapt) {
+      sampling->currentShift = 0;
+    } else if ((chapter % SAMPLING_EPOCH_CHAPTERS) == 0) {
+      adjustSampleShift(mi6);
+    }
+    setChapterShift(sampling, chapter, sampling->currentShift);
+  }
+  unlockMutex(&sampling->mutex);
+}
+
+/***********************************************************************/
+/**
+ * Set the open chapter number on a zone without assigning sample shifts.
+ *
+ * @param mi6             The master index
+ * @param zoneNumber      The zone number
+ * @param virtualChapter  The new open chapter number
+ **/
+static void setZoneOpenChapter(MasterIndex6 *mi6,
+                               unsigned int  zoneNumber,
+                               uint64_t      virtualChapter)
+{
+  setMasterIndexZoneOpenChapter(mi6->miNonHook, zoneNumber, virtualChapter);
+
+  // A lookupMasterIndexName() which overlaps our changing of the open
+  // chapter number must discard what it read and retry
+  SeqLock *hookLock = &mi6->masterZones[zoneNumber].hookLock;
+  writeLockSeqLock(hookLock);
+  setMasterIndexZoneOpenChapter(mi6->miHook, zoneNumber, virtualChapter);
+  writeUnlockSeqLock(hookLock);
+}
+
 /***********************************************************************/
 /**
  * Set the open chapter number on a zone.  The master index zone will be
  * modified to index the proper number of chapters ending with the new open
- * chapter.
+ * chapter.  The first zone to open a chapter chooses its sample shift.
  *
  * @param masterIndex     The master index
  * @param zoneNumber      The zone number
@@ -446,20 +717,51 @@ static void setMasterIndexZoneOpenChapter_006(MasterIndex *masterIndex,
                                               uint64_t virtualChapter)
 {
   MasterIndex6 *mi6 = container_of(masterIndex, MasterIndex6, common);
-  setMasterIndexZoneOpenChapter(mi6->miNonHook, zoneNumber, virtualChapter);
+  assignSampleShifts(mi6, virtualChapter, true);
+  setZoneOpenChapter(mi6, zoneNumber, virtualChapter);
+}
 
-  // We need to prevent a lookupMasterIndexName() happening while we are
-  // changing the open chapter number
-  Mutex *mutex = &mi6->masterZones[zoneNumber].hookMutex;
-  lockMutex(mutex);
-  setMasterIndexZoneOpenChapter(mi6->miHook, zoneNumber, virtualChapter);
-  unlockMutex(mutex);
+/***********************************************************************/
+/**
+ * Remove the entries of expired chapters from some of the delta lists of a
+ * zone, sweeping the non-hook index before the hook index.
+ *
+ * @param masterIndex  The master index
+ * @param zoneNumber   The zone number
+ * @param listCount    The maximum number of delta lists to examine
+ * @param finished     Set to true if the sweep of the zone is complete
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int sweepMasterIndexZone_006(MasterIndex  *masterIndex,
+                                    unsigned int  zoneNumber,
+                                    unsigned int  listCount,
+                                    bool         *finished)
+{
+  MasterIndex6 *mi6 = container_of(masterIndex, MasterIndex6, common);
+  bool nonHookFinished = false;
+  int result = sweepMasterIndexZone(mi6->miNonHook, zoneNumber, listCount,
+                                    &nonHookFinished);
+  if ((result != UDS_SUCCESS) || !nonHookFinished) {
+    *finished = false;
+    return result;
+  }
+
+  // A lookupMasterIndexName() which overlaps our flushing of the hook
+  // index must discard what it read and retry
+  SeqLock *hookLock = &mi6->masterZones[zoneNumber].hookLock;
+  writeLockSeqLock(hookLock);
+  result = sweepMasterIndexZone(mi6->miHook, zoneNumber, listCount, finished);
+  writeUnlockSeqLock(hookLock);
+  return result;
 }
 
 /***********************************************************************/
 /**
  * Set the open chapter number.  The master index will be modified to index
- * the proper number of chapters ending with the new open chapter.
+ * the proper number of chapters ending with the new open chapter.  This is
+ * only used while loading or rebuilding, so any chapters which were not
+ * assigned a sample shift before the index was saved are given none.
  *
  * @param masterIndex     The master index
  * @param virtualChapter  The new open chapter number
@@ -468,9 +770,94 @@ static void setMasterIndexOpenChapter_006(MasterIndex *masterIndex,
                                           uint64_t virtualChapter)
 {
   MasterIndex6 *mi6 = container_of(masterIndex, MasterIndex6, common);
+  assignSampleShifts(mi6, virtualChapter, false);
   for (unsigned int zone = 0; zone < mi6->numZones; zone++) {
-    setMasterIndexZoneOpenChapter_006(masterIndex, zone, virtualChapter);
+    setZoneOpenChapter(mi6, zone, virtualChapter);
+  }
+}
+
+/***********************************************************************/
+/**
+ * Get the summary of the adaptive sampling state which is saved with the
+ * index state.
+ *
+ * @param masterIndex  The master index
+ * @param state        The sampling state to fill in
+ **/
+static void getMasterIndexSampling_006(const MasterIndex   *masterIndex,
+                                       MasterIndexSampling *state)
+{
+  const MasterIndex6 *mi6 = const_container_of(masterIndex, MasterIndex6,
+                                               common);
+  SampleShifts *sampling = mi6->sampling;
+  memset(state, 0, sizeof(MasterIndexSampling));
+  // The zone threads may be opening chapters during a checkpoint.
+  lockMutex(&sampling->mutex);
+  state->samplingChapter = sampling->samplingChapter;
+  state->currentShift    = sampling->currentShift;
+  uint64_t chapter = 0;
+  if (sampling->samplingChapter >= sampling->chaptersPerVolume) {
+    chapter = sampling->samplingChapter - sampling->chaptersPerVolume + 1;
+  }
+  // The hooks of a dense chapter have not been pruned yet, and the zones
+  // do not save which of them to prune, so a dense chapter is saved as
+  // unthinned and keeps all of its hooks once the index is loaded.
+  for (; chapter + sampling->denseChapters <= sampling->samplingChapter;
+       chapter++) {
+    unsigned int shift
+      = sampling->shifts[chapter % sampling->chaptersPerVolume];
+    if (shift == 0) {
+      continue;
+    }
+    if (state->thinnedCount == 0) {
+      state->thinnedChapter = chapter;
+    }
+    state->thinnedCount = chapter - state->thinnedChapter + 1;
+    state->thinnedShift = maxUInt(state->thinnedShift, shift);
+  }
+  unlockMutex(&sampling->mutex);
+}
+
+/***********************************************************************/
+/**
+ * Restore the adaptive sampling state from the summary saved with the
+ * index state.  A chapter of the thinned range which was given a smaller
+ * shift than the largest one is treated as if it had the largest one,
+ * which at worst searches its chapter index for a hook which is still in
+ * the master index.
+ *
+ * @param masterIndex  The master index
+ * @param state        The saved sampling state
+ *
+ * @return UDS_SUCCESS or UDS_CORRUPT_COMPONENT
+ **/
+static int setMasterIndexSampling_006(MasterIndex               *masterIndex,
+                                      const MasterIndexSampling *state)
+{
+  MasterIndex6 *mi6 = container_of(masterIndex, MasterIndex6, common);
+  SampleShifts *sampling = mi6->sampling;
+  if ((state->currentShift > MAX_SAMPLE_SHIFT)
+      || (state->thinnedShift > MAX_SAMPLE_SHIFT)
+      || (state->thinnedCount > sampling->chaptersPerVolume)
+      || ((state->thinnedCount > 0)
+          && (state->thinnedChapter + state->thinnedCount - 1
+              > state->samplingChapter))) {
+    return logWarningWithStringError(UDS_CORRUPT_COMPONENT,
+                                     "invalid sparse sampling state");
+  }
+
+  lockMutex(&sampling->mutex);
+  memset(sampling->shifts, 0, sampling->chaptersPerVolume);
+  WRITE_ONCE(sampling->thinnedChapters, 0);
+  for (unsigned int i = 0; i < state->thinnedCount; i++) {
+    setChapterShift(sampling, state->thinnedChapter + i, state->thinnedShift);
   }
+  sampling->samplingChapter = state->samplingChapter;
+  sampling->currentShift    = state->currentShift;
+  sampling->epochDedupeHits = 0;
+  sampling->epochSparseHits = 0;
+  unlockMutex(&sampling->mutex);
+  return UDS_SUCCESS;
 }
 
 /***********************************************************************/
@@ -510,10 +897,9 @@ static int lookupMasterIndexName_006(const MasterIndex *masterIndex,
   triage->zone = getMasterIndexZone_006(masterIndex, name);
   int result = UDS_SUCCESS;
   if (triage->isSample) {
-    Mutex *mutex = &mi6->masterZones[triage->zone].hookMutex;
-    lockMutex(mutex);
-    result = lookupMasterIndexSampledName(mi6->miHook, name, triage);
-    unlockMutex(mutex);
+    SeqLock *hookLock = &mi6->masterZones[triage->zone].hookLock;
+    result = lookupSharedMasterIndexSampledName005(mi6->miHook, name,
+                                                   hookLock, triage);
   }
   return result;
 }
@@ -579,25 +965,73 @@ static int getMasterIndexRecord_006(MasterIndex *masterIndex,
   int result;
   if (isMasterIndexSample_006(masterIndex, name)) {
     /*
-     * We need to prevent a lookupMasterIndexName() happening while we are
-     * finding the master index record.  Remember that because of lazy LRU
-     * flushing of the master index, getMasterIndexRecord() is not a
-     * read-only operation.
+     * A lookupMasterIndexName() which overlaps our finding of the master
+     * index record must discard what it read and retry.  Remember that
+     * because of lazy LRU flushing of the master index,
+     * getMasterIndexRecord() is not a read-only operation.
      */
     unsigned int zone = getMasterIndexZone(mi6->miHook, name);
-    Mutex *mutex = &mi6->masterZones[zone].hookMutex;
-    lockMutex(mutex);
+    SeqLock *hookLock = &mi6->masterZones[zone].hookLock;
+    writeLockSeqLock(hookLock);
     result = getMasterIndexRecord(mi6->miHook, name, record);
-    unlockMutex(mutex);
-    // Remember the mutex so that other operations on the MasterIndexRecord
+    writeUnlockSeqLock(hookLock);
+    // Remember the lock so that other operations on the MasterIndexRecord
     // can use it
-    record->mutex = mutex;
+    record->hookLock = hookLock;
   } else {
     result = getMasterIndexRecord(mi6->miNonHook, name, record);
   }
   return result;
 }
 
+/***********************************************************************/
+/**
+ * Record that a request found its chunk in the index.
+ *
+ * @param masterIndex  The master index
+ * @param zoneNumber   The zone which processed the request
+ * @param inSparse     Whether the chunk was found in a sparse chapter
+ **/
+static void recordMasterIndexDedupe_006(MasterIndex  *masterIndex,
+                                        unsigned int  zoneNumber,
+                                        bool          inSparse)
+{
+  MasterIndex6 *mi6 = container_of(masterIndex, MasterIndex6, common);
+  MasterIndexZone *zone = &mi6->masterZones[zoneNumber];
+  // Only the zone thread writes these counters, so there is no need for
+  // an atomic increment.
+  atomic64_set(&zone->dedupeHits, atomic64_read(&zone->dedupeHits) + 1);
+  if (inSparse) {
+    atomic64_set(&zone->sparseHits, atomic64_read(&zone->sparseHits) + 1);
+  }
+}
+
+/***********************************************************************/
+/**
+ * Get the statistics of the adaptive sampling of the master index.
+ *
+ * @param masterIndex  The master index
+ * @param stats        The statistics to fill in
+ **/
+static void getMasterIndexSamplingStats_006(const MasterIndex *masterIndex,
+                                            UdsSparseSamplingStats *stats)
+{
+  const MasterIndex6 *mi6 = const_container_of(masterIndex, MasterIndex6,
+                                               common);
+  memset(stats, 0, sizeof(UdsSparseSamplingStats));
+  for (unsigned int z = 0; z < mi6->numZones; z++) {
+    stats->dedupeHits += atomic64_read(&mi6->masterZones[z].dedupeHits);
+    stats->sparseHits += atomic64_read(&mi6->masterZones[z].sparseHits);
+  }
+  SampleShifts *sampling = mi6->sampling;
+  lockMutex(&sampling->mutex);
+  stats->baseRate    = mi6->sparseSampleRate;
+  stats->currentRate = ((uint64_t) mi6->sparseSampleRate
+                        << sampling->currentShift);
+  stats->rateChanges = sampling->rateChanges;
+  unlockMutex(&sampling->mutex);
+}
+
 /***********************************************************************/
 /**
  * Get the number of bytes used for master index entries.
@@ -735,28 +1169,53 @@ int makeMasterIndex006(const Configuration *config, unsigned int numZones,
   mi6->common.freeMasterIndex               = freeMasterIndex_006;
   mi6->common.getMasterIndexMemoryUsed      = getMasterIndexMemoryUsed_006;
   mi6->common.getMasterIndexRecord          = getMasterIndexRecord_006;
+  mi6->common.getMasterIndexSampling        = getMasterIndexSampling_006;
+  mi6->common.getMasterIndexSamplingStats   = getMasterIndexSamplingStats_006;
   mi6->common.getMasterIndexStats           = getMasterIndexStats_006;
   mi6->common.getMasterIndexZone            = getMasterIndexZone_006;
+  mi6->common.hasThinnedMasterIndexChapters = hasThinnedMasterIndexChapters_006;
+  mi6->common.isMasterIndexChapterSample    = isMasterIndexChapterSample_006;
   mi6->common.isMasterIndexSample           = isMasterIndexSample_006;
   mi6->common.isRestoringMasterIndexDone    = isRestoringMasterIndexDone_006;
   mi6->common.isSavingMasterIndexDone       = isSavingMasterIndexDone_006;
   mi6->common.lookupMasterIndexName         = lookupMasterIndexName_006;
   mi6->common.lookupMasterIndexSampledName  = lookupMasterIndexSampledName_006;
+  mi6->common.recordMasterIndexDedupe       = recordMasterIndexDedupe_006;
   mi6->common.restoreDeltaListToMasterIndex = restoreDeltaListToMasterIndex_006;
   mi6->common.setMasterIndexOpenChapter     = setMasterIndexOpenChapter_006;
+  mi6->common.setMasterIndexSampling        = setMasterIndexSampling_006;
   mi6->common.setMasterIndexTag             = setMasterIndexTag_006;
   mi6->common.setMasterIndexZoneOpenChapter = setMasterIndexZoneOpenChapter_006;
   mi6->common.startRestoringMasterIndex     = startRestoringMasterIndex_006;
   mi6->common.startSavingMasterIndex        = startSavingMasterIndex_006;
+  mi6->common.sweepMasterIndexZone          = sweepMasterIndexZone_006;
 
   mi6->numZones         = numZones;
   mi6->sparseSampleRate = config->sparseSampleRate;
 
+  unsigned int chaptersPerVolume = config->geometry->chaptersPerVolume;
+  result = ALLOCATE_EXTENDED(SampleShifts, chaptersPerVolume, byte,
+                             "sparse sample shifts", &mi6->sampling);
+  if (result != UDS_SUCCESS) {
+    freeMasterIndex_006(&mi6->common);
+    return result;
+  }
+  mi6->sampling->denseChapters
+    = split.nonHookGeometry.chaptersPerVolume;
+  mi6->sampling->chaptersPerVolume = chaptersPerVolume;
+  result = initMutex(&mi6->sampling->mutex);
+  if (result != UDS_SUCCESS) {
+    FREE(mi6->sampling);
+    mi6->sampling = NULL;
+    freeMasterIndex_006(&mi6->common);
+    return result;
+  }
+
   result = ALLOCATE(numZones, MasterIndexZone, "master index zones",
                     &mi6->masterZones);
   for (unsigned int zone = 0; zone < numZones; zone++) {
     if (result == UDS_SUCCESS) {
-      result = initMutex(&mi6->masterZones[zone].hookMutex);
+      result = initSeqLock(&mi6->masterZones[zone].hookLock);
     }
   }
   if (result != UDS_SUCCESS) {
@@ -26,7 +26,7 @@
 #include "deltaIndex.h"
 #include "indexComponent.h"
 #include "indexConfig.h"
-#include "threads.h"
+#include "seqLock.h"
 #include "uds.h"
 
 extern const IndexComponentInfo *const MASTER_INDEX_INFO;
@@ -81,13 +81,28 @@ typedef struct {
   unsigned char       magic;       // The magic number for valid records
   unsigned int        zoneNumber;  // Zone that contains this block
   MasterIndex        *masterIndex; // The master index
-  Mutex              *mutex;       // Mutex that must be held while accessing
-                                   // this delta index entry; used only for
-                                   // a sampled index; otherwise is NULL
+  SeqLock            *hookLock;    // Lock that must be held for writing
+                                   // while modifying this delta index entry;
+                                   // used only for a sampled index;
+                                   // otherwise is NULL
   const UdsChunkName *name;        // The blockname to which this record refers
   DeltaIndexEntry     deltaEntry;  // The delta index entry for this record
 } MasterIndexRecord;
 
+/*
+ * The MasterIndexSampling structure summarizes the adaptive sampling state
+ * of a sparse master index so that it can be saved with the index state.
+ * Rather than the sample shift of every chapter, it holds the range of
+ * chapters which may have been thinned and the largest shift among them.
+ */
+typedef struct {
+  uint64_t     samplingChapter; // The newest chapter given a sample shift
+  uint64_t     thinnedChapter;  // The first chapter of the thinned range
+  unsigned int thinnedCount;    // The number of chapters in the range
+  unsigned int thinnedShift;    // The largest shift of those chapters
+  unsigned int currentShift;    // The shift given to new chapters
+} MasterIndexSampling;
+
 struct masterIndex {
   void (*abortRestoringMasterIndex)(MasterIndex *masterIndex);
   int (*abortSavingMasterIndex)(const MasterIndex *masterIndex,
@@ -99,11 +114,19 @@ struct masterIndex {
   int (*getMasterIndexRecord)(MasterIndex *masterIndex,
                               const UdsChunkName *name,
                               MasterIndexRecord *record);
+  void (*getMasterIndexSampling)(const MasterIndex *masterIndex,
+                                 MasterIndexSampling *state);
+  void (*getMasterIndexSamplingStats)(const MasterIndex *masterIndex,
+                                      UdsSparseSamplingStats *stats);
   void (*getMasterIndexStats)(const MasterIndex *masterIndex,
                               MasterIndexStats *dense,
                               MasterIndexStats *sparse);
   unsigned int (*getMasterIndexZone)(const MasterIndex *masterIndex,
                                      const UdsChunkName *name);
+  bool (*hasThinnedMasterIndexChapters)(const MasterIndex *masterIndex);
+  bool (*isMasterIndexChapterSample)(const MasterIndex *masterIndex,
+                                     const UdsChunkName *name,
+                                     uint64_t virtualChapter);
   bool (*isMasterIndexSample)(const MasterIndex *masterIndex,
                               const UdsChunkName *name);
   bool (*isRestoringMasterIndexDone)(const MasterIndex *masterIndex);
@@ -115,11 +138,16 @@ struct masterIndex {
   int (*lookupMasterIndexSampledName)(const MasterIndex *masterIndex,
                                       const UdsChunkName *name,
                                       MasterIndexTriage *triage);
+  void (*recordMasterIndexDedupe)(MasterIndex *masterIndex,
+                                  unsigned int zoneNumber,
+                                  bool inSparse);
   int (*restoreDeltaListToMasterIndex)(MasterIndex *masterIndex,
                                        const DeltaListSaveInfo *dlsi,
                                        const byte data[DELTA_LIST_MAX_BYTE_COUNT]);
   void (*setMasterIndexOpenChapter)(MasterIndex *masterIndex,
                                     uint64_t virtualChapter);
+  int (*setMasterIndexSampling)(MasterIndex *masterIndex,
+                                const MasterIndexSampling *state);
   void (*setMasterIndexTag)(MasterIndex *masterIndex, byte tag);
   void (*setMasterIndexZoneOpenChapter)(MasterIndex *masterIndex,
                                         unsigned int zoneNumber,
@@ -130,6 +158,10 @@ struct masterIndex {
   int (*startSavingMasterIndex)(const MasterIndex *masterIndex,
                                 unsigned int zoneNumber,
                                 BufferedWriter *bufferedWriter);
+  int (*sweepMasterIndexZone)(MasterIndex *masterIndex,
+                              unsigned int zoneNumber,
+                              unsigned int listCount,
+                              bool *finished);
 };
 
 /**
@@ -308,7 +340,49 @@ static INLINE unsigned int getMasterIndexZone(const MasterIndex *masterIndex,
 }
 
 /**
- * Determine whether a given chunk name is a hook.
+ * Get the summary of the adaptive sampling state of a master index which
+ * is saved with the index state.
+ *
+ * @param masterIndex  The master index
+ * @param state        The sampling state to fill in
+ **/
+static INLINE void getMasterIndexSampling(const MasterIndex *masterIndex,
+                                          MasterIndexSampling *state)
+{
+  masterIndex->getMasterIndexSampling(masterIndex, state);
+}
+
+/**
+ * Get the statistics of the adaptive sampling of a sparse master index.
+ *
+ * @param masterIndex  The master index
+ * @param stats        The statistics to fill in
+ **/
+static INLINE void getMasterIndexSamplingStats(const MasterIndex *masterIndex,
+                                               UdsSparseSamplingStats *stats)
+{
+  masterIndex->getMasterIndexSamplingStats(masterIndex, stats);
+}
+
+/**
+ * Determine whether any chapter of a master index has been sampled at more
+ * than the configured sparse sample rate, so that some hooks may be missing
+ * from the master index although their chapters are still indexed.
+ *
+ * @param masterIndex  The master index
+ *
+ * @return whether any chapter has a nonzero sample shift
+ **/
+static INLINE bool hasThinnedMasterIndexChapters(const MasterIndex *masterIndex)
+{
+  return masterIndex->hasThinnedMasterIndexChapters(masterIndex);
+}
+
+/**
+ * Determine whether a given chunk name is a hook, which is to say that it
+ * is kept in the sampled part of the master index.  A hook is kept in the
+ * master index for as long as its chapter is, unless it is not also a
+ * sample of its chapter (see isMasterIndexChapterSample()).
  *
  * @param masterIndex  The master index
  * @param name         The block name
@@ -321,6 +395,26 @@ static INLINE bool isMasterIndexSample(const MasterIndex *masterIndex,
   return masterIndex->isMasterIndexSample(masterIndex, name);
 }
 
+/**
+ * Determine whether a given chunk name is a sample of a particular
+ * chapter, at the sample rate chosen for that chapter.  Every such name is
+ * a hook, but a hook which is not a sample of its chapter is dropped from
+ * the master index when the chapter becomes sparse.
+ *
+ * @param masterIndex     The master index
+ * @param name            The block name
+ * @param virtualChapter  The chapter containing the name
+ *
+ * @return whether the name is a sample of the chapter
+ **/
+static INLINE bool isMasterIndexChapterSample(const MasterIndex *masterIndex,
+                                              const UdsChunkName *name,
+                                              uint64_t virtualChapter)
+{
+  return masterIndex->isMasterIndexChapterSample(masterIndex, name,
+                                                 virtualChapter);
+}
+
 /**
  * Have all the data been read while restoring a master index from an input
  * stream?
@@ -387,6 +481,22 @@ static INLINE int lookupMasterIndexSampledName(const MasterIndex *masterIndex,
   return masterIndex->lookupMasterIndexSampledName(masterIndex, name, triage);
 }
 
+/**
+ * Record that a request found its chunk in the index, so that a sparse
+ * master index can weigh the value of its hooks when it chooses the sample
+ * rate of later chapters.  This must be called on the zone thread.
+ *
+ * @param masterIndex  The master index
+ * @param zoneNumber   The zone which processed the request
+ * @param inSparse     Whether the chunk was found in a sparse chapter
+ **/
+static INLINE void recordMasterIndexDedupe(MasterIndex *masterIndex,
+                                           unsigned int zoneNumber,
+                                           bool inSparse)
+{
+  masterIndex->recordMasterIndexDedupe(masterIndex, zoneNumber, inSparse);
+}
+
 /**
  * Create a new record associated with a block name.
  *
@@ -462,6 +572,22 @@ static INLINE void setMasterIndexOpenChapter(MasterIndex *masterIndex,
 int setMasterIndexRecordChapter(MasterIndexRecord *record, uint64_t chapter)
   __attribute__((warn_unused_result));
 
+/**
+ * Restore the adaptive sampling state of a master index from the summary
+ * saved with the index state.  Every chapter of the thinned range is given
+ * its largest shift, and every other chapter is given none.
+ *
+ * @param masterIndex  The master index
+ * @param state        The saved sampling state
+ *
+ * @return UDS_SUCCESS or UDS_CORRUPT_COMPONENT if the state is invalid
+ **/
+static INLINE int setMasterIndexSampling(MasterIndex *masterIndex,
+                                         const MasterIndexSampling *state)
+{
+  return masterIndex->setMasterIndexSampling(masterIndex, state);
+}
+
 /**
  * Set the tag value used when saving and/or restoring a master index.
  *
@@ -524,4 +650,28 @@ static INLINE int startSavingMasterIndex(const MasterIndex *masterIndex,
                                              bufferedWriter);
 }
 
+/**
+ * Remove the entries of expired chapters from some of the delta lists of a
+ * zone which lookups have not flushed recently.  Each time chapters of the
+ * zone expire, the sweep may visit another share of the zone's delta
+ * lists, so a pass over the whole zone is spread across several chapters,
+ * and is done a few lists at a time by repeated calls.  This must only be
+ * called by the thread which owns the zone.
+ *
+ * @param masterIndex  The master index
+ * @param zoneNumber   The zone number
+ * @param listCount    The maximum number of delta lists to examine
+ * @param finished     Set to true if the sweep of the zone is complete
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static INLINE int sweepMasterIndexZone(MasterIndex  *masterIndex,
+                                       unsigned int  zoneNumber,
+                                       unsigned int  listCount,
+                                       bool         *finished)
+{
+  return masterIndex->sweepMasterIndexZone(masterIndex, zoneNumber,
+                                           listCount, finished);
+}
+
 #endif /* MASTERINDEXOPS_H */
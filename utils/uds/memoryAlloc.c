@@ -21,7 +21,11 @@
 
 #include "memoryAlloc.h"
 
+#include "atomicDefs.h"
+#include "logger.h"
 #include "stringUtils.h"
+#include "threadOnce.h"
+#include "threads.h"
 
 /**********************************************************************/
 int duplicateString(const char *string, const char *what, char **newString)
@@ -42,3 +46,77 @@ int memdup(const void *buffer, size_t size, const char *what, void *dupPtr)
   *((void **) dupPtr) = dup;
   return UDS_SUCCESS;
 }
+
+/*
+ * The memory currently allocated to each component, and the most it has
+ * been. The component charged by each thread is kept in thread-specific
+ * data; a thread which never sets one is charged to UDS_MEMORY_OTHER,
+ * which is zero.
+ */
+static atomic64_t    liveBytes[UDS_MEMORY_COMPONENT_COUNT];
+static atomic64_t    peakBytes[UDS_MEMORY_COMPONENT_COUNT];
+static OnceState     componentOnce = ONCE_STATE_INITIALIZER;
+static pthread_key_t componentKey;
+static bool          componentKeyValid = false;
+
+/**********************************************************************/
+static void initComponentKey(void)
+{
+  componentKeyValid = (createThreadKey(&componentKey, NULL) == UDS_SUCCESS);
+}
+
+/**********************************************************************/
+UdsMemoryComponent getMemoryComponent(void)
+{
+  if ((performOnce(&componentOnce, initComponentKey) != UDS_SUCCESS)
+      || !componentKeyValid) {
+    return UDS_MEMORY_OTHER;
+  }
+  void *component = getThreadSpecific(componentKey);
+  return (UdsMemoryComponent) (uintptr_t) component;
+}
+
+/**********************************************************************/
+UdsMemoryComponent setMemoryComponent(UdsMemoryComponent component)
+{
+  UdsMemoryComponent previous = getMemoryComponent();
+  if (componentKeyValid) {
+    // Failing to set the key just charges the memory to the wrong component.
+    setThreadSpecific(componentKey, (void *) (uintptr_t) component);
+  }
+  return previous;
+}
+
+/**********************************************************************/
+void recordAllocation(UdsMemoryComponent component, size_t size)
+{
+  long live = atomic64_add_return(size, &liveBytes[component]);
+  long peak = atomic64_read(&peakBytes[component]);
+  while (live > peak) {
+    long old = atomic64_cmpxchg(&peakBytes[component], peak, live);
+    if (old == peak) {
+      break;
+    }
+    peak = old;
+  }
+}
+
+/**********************************************************************/
+void recordFree(UdsMemoryComponent component, size_t size)
+{
+  atomic64_add(-(long) size, &liveBytes[component]);
+}
+
+/**********************************************************************/
+int udsGetMemoryStats(UdsMemoryStats *stats)
+{
+  if (stats == NULL) {
+    return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                   "received a NULL memory stats pointer");
+  }
+  for (unsigned int i = 0; i < UDS_MEMORY_COMPONENT_COUNT; i++) {
+    stats->components[i].liveBytes = atomic64_read(&liveBytes[i]);
+    stats->components[i].peakBytes = atomic64_read(&peakBytes[i]);
+  }
+  return UDS_SUCCESS;
+}
@@ -28,6 +28,42 @@
 #include "cpu.h"
 #include "memoryDefs.h"
 #include "permassert.h"
+#include "uds.h"
+
+/**
+ * Charge the allocations made by the calling thread to a component. The
+ * memory is credited back to the same component when it is freed, by
+ * whichever thread frees it. Calls nest: the caller restores the returned
+ * component when it is done, so the innermost component wins.
+ *
+ * @param component  The component to charge
+ *
+ * @return the component which was being charged before
+ **/
+UdsMemoryComponent setMemoryComponent(UdsMemoryComponent component);
+
+/**
+ * Get the component the calling thread's allocations are charged to.
+ *
+ * @return the current component
+ **/
+UdsMemoryComponent getMemoryComponent(void);
+
+/**
+ * Account for memory allocated by the platform allocator.
+ *
+ * @param component  The component the memory is charged to
+ * @param size       The number of bytes allocated
+ **/
+void recordAllocation(UdsMemoryComponent component, size_t size);
+
+/**
+ * Account for memory freed by the platform allocator.
+ *
+ * @param component  The component the memory was charged to
+ * @param size       The number of bytes freed
+ **/
+void recordFree(UdsMemoryComponent component, size_t size);
 
 /**
  * Allocate storage based on memory size and  alignment, logging an error if
@@ -22,10 +22,16 @@
 #ifndef LINUX_USER_MEMORY_DEFS_H
 #define LINUX_USER_MEMORY_DEFS_H 1
 
+enum {
+  /** The buffer, offset, and length alignment required for O_DIRECT I/O */
+  IO_BUFFER_ALIGNMENT = 4096,
+};
+
 /**
  * Allocate one or more elements of the indicated type, aligning them
  * on the boundary that will allow them to be used in I/O, logging an
- * error if the allocation fails. The memory will be zeroed.
+ * error if the allocation fails. The memory will be zeroed. The memory is
+ * page aligned so that it may be the target of an O_DIRECT read.
  *
  * @param COUNT  The number of objects to allocate
  * @param TYPE   The type of objects to allocate
@@ -35,6 +41,6 @@
  * @return UDS_SUCCESS or an error code
  **/
 #define ALLOCATE_IO_ALIGNED(COUNT, TYPE, WHAT, PTR) \
-  ALLOCATE(COUNT, TYPE, WHAT, PTR)
+  doAllocation(COUNT, sizeof(TYPE), 0, IO_BUFFER_ALIGNMENT, WHAT, PTR)
 
 #endif /* LINUX_USER_MEMORY_DEFS_H */
@@ -23,11 +23,39 @@
 
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "numeric.h"
 #include "stringUtils.h"
 
+/*
+ * Each allocation is preceded by a header recording its size and the
+ * component it is charged to, so that freeMemory() can credit it back. The
+ * header is placed immediately before the returned memory. An allocation
+ * aligned more strictly than the header is padded by its whole alignment so
+ * that the memory keeps that alignment.
+ */
+typedef struct allocationHeader {
+  /** The number of bytes requested */
+  size_t   size;
+  /** The UdsMemoryComponent charged for the allocation */
+  uint32_t component;
+  /** The distance from the start of the underlying block to the memory */
+  uint32_t offset;
+} AllocationHeader;
+
+enum {
+  DEFAULT_MALLOC_ALIGNMENT = 2 * sizeof(size_t), // glibc malloc
+};
+
+/**********************************************************************/
+static INLINE AllocationHeader *getHeader(void *ptr)
+{
+  return ((AllocationHeader *) ptr) - 1;
+}
+
 /**********************************************************************/
 int allocateMemory(size_t size, size_t align, const char *what, void *ptr)
 {
+  STATIC_ASSERT(sizeof(AllocationHeader) == DEFAULT_MALLOC_ALIGNMENT);
   if (ptr == NULL) {
     return UDS_INVALID_ARGUMENT;
   }
@@ -36,10 +64,18 @@ int allocateMemory(size_t size, size_t align, const char *what, void *ptr)
     *((void **) ptr) = NULL;
     return UDS_SUCCESS;
   }
+  size_t offset = ((align > DEFAULT_MALLOC_ALIGNMENT)
+                   ? align : sizeof(AllocationHeader));
+  if (size > SIZE_MAX - offset) {
+    if (what != NULL) {
+      logErrorWithStringError(ENOMEM, "failed to allocate %s (%zu bytes)",
+                              what, size);
+    }
+    return ENOMEM;
+  }
   void *p;
-  enum {DEFAULT_MALLOC_ALIGNMENT = 2 * sizeof(size_t)}; // glibc malloc
   if (align > DEFAULT_MALLOC_ALIGNMENT) {
-    int result = posix_memalign(&p, align, size);
+    int result = posix_memalign(&p, align, offset + size);
     if (result != 0) {
       if (what != NULL) {
         logErrorWithStringError(result,
@@ -49,7 +85,7 @@ int allocateMemory(size_t size, size_t align, const char *what, void *ptr)
       return result;
     }
   } else {
-    p = malloc(size);
+    p = malloc(offset + size);
     if (p == NULL) {
       int result = errno;
       if (what != NULL) {
@@ -59,24 +95,50 @@ int allocateMemory(size_t size, size_t align, const char *what, void *ptr)
       return result;
     }
   }
-  memset(p, 0, size);
-  *((void **) ptr) = p;
+  byte *memory = (byte *) p + offset;
+  AllocationHeader *header = getHeader(memory);
+  header->size      = size;
+  header->component = getMemoryComponent();
+  header->offset    = offset;
+  recordAllocation(header->component, size);
+  memset(memory, 0, size);
+  *((void **) ptr) = memory;
   return UDS_SUCCESS;
 }
 
 /**********************************************************************/
 void freeMemory(void *ptr)
 {
-  free(ptr);
+  if (ptr == NULL) {
+    return;
+  }
+  AllocationHeader *header = getHeader(ptr);
+  recordFree(header->component, header->size);
+  free((byte *) ptr - header->offset);
 }
 
 /**********************************************************************/
-int doPlatformVasprintf(const char  *what __attribute__((unused)),
+int doPlatformVasprintf(const char  *what,
                         char       **strp,
                         const char  *fmt,
                         va_list      ap)
 {
-  return vasprintf(strp, fmt, ap) == -1 ? ENOMEM : UDS_SUCCESS;
+  // The string must come from allocateMemory() so that FREE() can free it.
+  va_list copy;
+  va_copy(copy, ap);
+  int length = vsnprintf(NULL, 0, fmt, copy);
+  va_end(copy);
+  if (length < 0) {
+    return ENOMEM;
+  }
+  char *string;
+  int result = ALLOCATE(length + 1, char, what, &string);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  vsnprintf(string, length + 1, fmt, ap);
+  *strp = string;
+  return UDS_SUCCESS;
 }
 
 /**********************************************************************/
@@ -86,12 +148,19 @@ int reallocateMemory(void       *ptr,
                      const char *what,
                      void       *newPtr)
 {
-  void *new = realloc(ptr, size);
-  if ((new == NULL) && (size != 0)) {
-    return logErrorWithStringError(errno,
-                                   "failed to reallocate %s (%zu bytes)",
-                                   what, size);
+  // Allocate and copy so the new memory has its own header. It is charged
+  // to the component of the thread reallocating it.
+  void *new = NULL;
+  if (size > 0) {
+    int result = ALLOCATE(size, byte, what, &new);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    if (ptr != NULL) {
+      memcpy(new, ptr, minSizeT(getHeader(ptr)->size, size));
+    }
   }
+  FREE(ptr);
   *((void **) newPtr) = new;
   return UDS_SUCCESS;
 }
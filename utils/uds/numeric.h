@@ -169,6 +169,20 @@ static INLINE uint64_t minUInt64(uint64_t a, uint64_t b)
   return ((a < b) ? a : b);
 }
 
+/**
+ * Find the maximum of two uint64_ts.
+ *
+ * @param a The first uint64_t
+ * @param b The second uint64_t
+ *
+ * @return The greater of a and b
+ **/
+__attribute__((warn_unused_result))
+static INLINE uint64_t maxUInt64(uint64_t a, uint64_t b)
+{
+  return ((a > b) ? a : b);
+}
+
 /**
  * Determine the greatest common divisor of two numbers.
  *
@@ -374,6 +374,32 @@ void freePageCache(PageCache *cache)
   FREE(cache);
 }
 
+/**********************************************************************/
+int resizeReadQueue(PageCache *cache, unsigned int readQueueMaxSize)
+{
+  // We hold the readThreadsMutex.
+  int result = ASSERT(readQueueIsEmpty(cache),
+                      "read queue is empty when resized");
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  QueuedRead *readQueue;
+  result = ALLOCATE(readQueueMaxSize, QueuedRead, "volume read queue",
+                    &readQueue);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  FREE(cache->readQueue);
+  cache->readQueue         = readQueue;
+  cache->readQueueMaxSize  = readQueueMaxSize;
+  cache->readQueueFirst    = 0;
+  cache->readQueueLastRead = 0;
+  cache->readQueueLast     = 0;
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 int invalidatePageCacheForChapter(PageCache          *cache,
                                   unsigned int        chapter,
@@ -492,8 +518,8 @@ int enqueueRead(PageCache *cache, Request *request, unsigned int physicalPage)
 
   if ((cache->index[physicalPage] & VOLUME_CACHE_QUEUED_FLAG) == 0) {
     /* Not seen before, add this to the read queue and mark it as queued */
-    if (next == first) {
-      /* queue is full */
+    if ((next == first) || cache->readQueueFrozen) {
+      /* queue is full, or is being resized */
       return UDS_SUCCESS;
     }
     /* fill the read queue entry */
@@ -697,6 +723,30 @@ void cancelPageInCache(PageCache    *cache,
   WRITE_ONCE(cache->index[physicalPage], cache->numCacheEntries);
 }
 
+/**********************************************************************/
+bool isPageUncached(PageCache *cache, unsigned int physicalPage)
+{
+  // We hold the readThreadsMutex.
+  return (READ_ONCE(cache->index[physicalPage]) == cache->numCacheEntries);
+}
+
+/**********************************************************************/
+unsigned int getCachedPhysicalPages(PageCache    *cache,
+                                    unsigned int *pages,
+                                    unsigned int  maxPages)
+{
+  unsigned int count = 0;
+  for (unsigned int physicalPage = 0;
+       (physicalPage < cache->numIndexEntries) && (count < maxPages);
+       physicalPage++) {
+    // A queued page has the queued flag set, so it is never counted here.
+    if (READ_ONCE(cache->index[physicalPage]) < cache->numCacheEntries) {
+      pages[count++] = physicalPage;
+    }
+  }
+  return count;
+}
+
 /**********************************************************************/
 size_t getPageCacheSize(PageCache *cache)
 {
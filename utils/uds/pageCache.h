@@ -51,7 +51,10 @@ typedef struct cachedPage {
 enum {
   VOLUME_CACHE_MAX_ENTRIES              = (UINT16_MAX >> 1),
   VOLUME_CACHE_QUEUED_FLAG              = (1 << 15),
-  VOLUME_CACHE_DEFAULT_MAX_QUEUED_READS = 4096
+  VOLUME_CACHE_DEFAULT_MAX_QUEUED_READS = 4096,
+  VOLUME_CACHE_MIN_QUEUED_READS         = 32,
+  // Queue positions are stored in the index alongside the queued flag
+  VOLUME_CACHE_MAX_QUEUED_READS         = VOLUME_CACHE_QUEUED_FLAG,
 };
 
 typedef struct queuedRead {
@@ -143,6 +146,8 @@ typedef struct pageCache {
   uint16_t              readQueueLast;
   // The size of the read queue
   unsigned int          readQueueMaxSize;
+  // Whether new reads are held back while the read queue is resized
+  bool                  readQueueFrozen;
   // Page access counter
   atomic64_t            clock;
 } PageCache;
@@ -311,10 +316,24 @@ static INLINE bool readQueueIsEmpty(PageCache *cache)
  **/
 static INLINE bool readQueueIsFull(PageCache *cache)
 {
-  return (cache->readQueueFirst ==
-    (cache->readQueueLast + 1) % cache->readQueueMaxSize);
+  return (cache->readQueueFrozen
+          || (cache->readQueueFirst ==
+              (cache->readQueueLast + 1) % cache->readQueueMaxSize));
 }
 
+/**
+ * Replace the read queue of a page cache with one of a different size. The
+ * read queue must be empty, and must stay empty until this returns. The
+ * caller must hold the readThreadsMutex.
+ *
+ * @param cache             the page cache
+ * @param readQueueMaxSize  the new maximum size of the read queue
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int resizeReadQueue(PageCache *cache, unsigned int readQueueMaxSize)
+  __attribute__((warn_unused_result));
+
 /**
  * Selects a page in the cache to be used for a read.
  *
@@ -366,6 +385,34 @@ void cancelPageInCache(PageCache    *cache,
                        unsigned int  physicalPage,
                        CachedPage   *page);
 
+/**
+ * Check whether a page is neither in the cache nor queued to be read into
+ * it. The caller must hold the readThreadsMutex.
+ *
+ * @param cache         the page cache
+ * @param physicalPage  the page number
+ *
+ * @return true if the page is absent from the cache
+ **/
+bool isPageUncached(PageCache *cache, unsigned int physicalPage)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the physical page numbers of all the pages in the cache, in ascending
+ * order. The caller must ensure that the cache is not changing, as is the
+ * case when the index is quiescent for a save.
+ *
+ * @param cache     the page cache
+ * @param pages     an array to hold the page numbers
+ * @param maxPages  the capacity of the pages array
+ *
+ * @return the number of page numbers stored in the array
+ **/
+unsigned int getCachedPhysicalPages(PageCache    *cache,
+                                    unsigned int *pages,
+                                    unsigned int  maxPages)
+  __attribute__((warn_unused_result));
+
 /**
  * Get the page cache size
  *
@@ -38,7 +38,17 @@ const UdsParameterValue UDS_PARAM_FALSE = {
   .value.u_bool = false,
 };
 
+const char *const UDS_ADAPTIVE_SPARSE_SAMPLING
+                                           = "UDS_ADAPTIVE_SPARSE_SAMPLING";
+const char *const UDS_BUFFERED_IO_DEPTH    = "UDS_BUFFERED_IO_DEPTH";
+const char *const UDS_CACHE_WARMUP_RATE    = "UDS_CACHE_WARMUP_RATE";
+const char *const UDS_DECODE_SPARSE_CACHE  = "UDS_DECODE_SPARSE_CACHE";
+const char *const UDS_LOOKUP_CACHE_SIZE    = "UDS_LOOKUP_CACHE_SIZE";
 const char *const UDS_PARALLEL_FACTOR      = "UDS_PARALLEL_FACTOR";
+const char *const UDS_REQUEST_TRACING      = "UDS_REQUEST_TRACING";
+const char *const UDS_SCRUB_RATE           = "UDS_SCRUB_RATE";
+const char *const UDS_VOLUME_READ_QUEUE_DEPTH
+                                           = "UDS_VOLUME_READ_QUEUE_DEPTH";
 const char *const UDS_VOLUME_READ_THREADS  = "UDS_VOLUME_READ_THREADS";
 const char *const UDS_PARAMETER_TEST_PARAM = "UDS_PARAMETER_TEST_PARAM";
 
@@ -48,7 +58,15 @@ static const struct paramDef {
   const char * const *name;
   int               (*func)(ParameterDefinition *pd);
 } definitions[] = {
+  { &UDS_ADAPTIVE_SPARSE_SAMPLING, defineAdaptiveSparseSampling },
+  { &UDS_BUFFERED_IO_DEPTH,       defineBufferedIODepth       },
+  { &UDS_CACHE_WARMUP_RATE,       defineCacheWarmupRate       },
+  { &UDS_DECODE_SPARSE_CACHE,     defineDecodeSparseCache     },
+  { &UDS_LOOKUP_CACHE_SIZE,       defineLookupCacheSize       },
   { &UDS_PARALLEL_FACTOR,         defineParallelFactor        },
+  { &UDS_REQUEST_TRACING,         defineRequestTracing        },
+  { &UDS_SCRUB_RATE,              defineScrubRate             },
+  { &UDS_VOLUME_READ_QUEUE_DEPTH, defineVolumeReadQueueDepth  },
   { &UDS_VOLUME_READ_THREADS,     defineVolumeReadThreads     },
   { &UDS_PARAMETER_TEST_PARAM,    defineParameterTestParam    },
 };
@@ -259,12 +277,12 @@ int validateBoolean(const UdsParameterValue *input,
   } else if (input->type == UDS_PARAM_TYPE_STRING) {
     if (strcasecmp(input->value.u_string, "true") == 0 ||
         strcasecmp(input->value.u_string, "yes") == 0) {
-      output->type = UDS_PARAM_TYPE_UNSIGNED_INT;
+      output->type = UDS_PARAM_TYPE_BOOL;
       output->value.u_bool = true;
       return UDS_SUCCESS;
     } else if (strcasecmp(input->value.u_string, "false") == 0 ||
                strcasecmp(input->value.u_string, "no") == 0) {
-      output->type = UDS_PARAM_TYPE_UNSIGNED_INT;
+      output->type = UDS_PARAM_TYPE_BOOL;
       output->value.u_bool = false;
       return UDS_SUCCESS;
     }
@@ -59,7 +59,15 @@ struct parameterDefinition {
   void              (*update)(const UdsParameterValue *);
 };
 
+extern const char * const UDS_ADAPTIVE_SPARSE_SAMPLING;
+extern const char * const UDS_BUFFERED_IO_DEPTH;
+extern const char * const UDS_CACHE_WARMUP_RATE;
+extern const char * const UDS_DECODE_SPARSE_CACHE;
+extern const char * const UDS_LOOKUP_CACHE_SIZE;
 extern const char * const UDS_PARALLEL_FACTOR;
+extern const char * const UDS_REQUEST_TRACING;
+extern const char * const UDS_SCRUB_RATE;
+extern const char * const UDS_VOLUME_READ_QUEUE_DEPTH;
 extern const char * const UDS_VOLUME_READ_THREADS;
 extern const char * const UDS_PARAMETER_TEST_PARAM;
 
@@ -82,7 +90,15 @@ extern const char * const UDS_PARAMETER_TEST_PARAM;
  * is used in testing).
  **/
 
+extern int defineAdaptiveSparseSampling(ParameterDefinition *pd);
+extern int defineBufferedIODepth(ParameterDefinition *pd);
+extern int defineCacheWarmupRate(ParameterDefinition *pd);
+extern int defineDecodeSparseCache(ParameterDefinition *pd);
+extern int defineLookupCacheSize(ParameterDefinition *pd);
 extern int defineParallelFactor(ParameterDefinition *pd);
+extern int defineRequestTracing(ParameterDefinition *pd);
+extern int defineScrubRate(ParameterDefinition *pd);
+extern int defineVolumeReadQueueDepth(ParameterDefinition *pd);
 extern int defineVolumeReadThreads(ParameterDefinition *pd);
 extern int setTestParameterDefinitionFunc(int (*func)(ParameterDefinition *))
   __attribute__((warn_unused_result));
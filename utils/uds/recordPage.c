@@ -23,8 +23,114 @@
 
 #include "permassert.h"
 
+/*
+ * A packed record page begins with a base metadata value. Each record holds
+ * the difference between its metadata and the base, taken as unsigned
+ * little-endian integers, in its first packedMetadataBytes bytes. An offset
+ * of all ones marks a record whose metadata could not be packed.
+ */
+
+/**
+ * Compute the difference between two metadata values, each taken as an
+ * unsigned integer, and check whether it can be stored as a packed offset.
+ *
+ * @param high       The larger value
+ * @param low        The smaller value
+ * @param bigEndian  Whether the values are stored most significant byte
+ *                   first, rather than least significant byte first
+ * @param width      The number of bytes in a packed offset
+ * @param offset     An array to hold the least significant width bytes of
+ *                   the difference, least significant first, or NULL
+ *
+ * @return <code>true</code> if the difference is a valid packed offset
+ **/
+static bool computePackedOffset(const byte    high[],
+                                const byte    low[],
+                                bool          bigEndian,
+                                unsigned int  width,
+                                byte          offset[])
+{
+  bool allOnes = true;
+  int borrow = 0;
+  for (unsigned int i = 0; i < UDS_MAX_BLOCK_DATA_SIZE; i++) {
+    unsigned int k = (bigEndian ? (UDS_MAX_BLOCK_DATA_SIZE - 1 - i) : i);
+    int difference = high[k] - low[k] - borrow;
+    borrow = ((difference < 0) ? 1 : 0);
+    byte digit = (byte) (difference & 0xff);
+    if (i >= width) {
+      if (digit != 0) {
+        return false;
+      }
+    } else {
+      allOnes = (allOnes && (digit == 0xff));
+      if (offset != NULL) {
+        offset[i] = digit;
+      }
+    }
+  }
+  return ((borrow == 0) && !allOnes);
+}
+
+/**
+ * Choose the base metadata value for a packed record page, as the smallest
+ * value of the largest group of records whose metadata can all be packed
+ * relative to it.
+ *
+ * @param volume   The volume
+ * @param records  The records to be encoded
+ * @param base     The metadata to hold the base value
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int choosePackingBase(const Volume         *volume,
+                             const UdsChunkRecord  records[],
+                             UdsChunkData         *base)
+{
+  const Geometry *geometry = volume->geometry;
+  unsigned int recordsPerPage = geometry->recordsPerPage;
+  const byte **keys = volume->packingKeyPointers;
+
+  // Sort the metadata values as big-endian keys, so that their byte order
+  // is their numeric order.
+  for (unsigned int i = 0; i < recordsPerPage; i++) {
+    byte *key = &volume->packingKeys[i * UDS_MAX_BLOCK_DATA_SIZE];
+    for (unsigned int k = 0; k < UDS_MAX_BLOCK_DATA_SIZE; k++) {
+      key[k] = records[i].data.data[UDS_MAX_BLOCK_DATA_SIZE - 1 - k];
+    }
+    keys[i] = key;
+  }
+  int result = radixSort(volume->radixSorter, keys, recordsPerPage,
+                         UDS_MAX_BLOCK_DATA_SIZE);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  // Slide a window over the sorted values to find the longest run which
+  // fits within the range of a packed offset.
+  unsigned int bestStart = 0;
+  unsigned int bestCount = 0;
+  unsigned int start = 0;
+  for (unsigned int end = 0; end < recordsPerPage; end++) {
+    while (!computePackedOffset(keys[end], keys[start], true,
+                                geometry->packedMetadataBytes, NULL)) {
+      start++;
+    }
+    if (end - start + 1 > bestCount) {
+      bestStart = start;
+      bestCount = end - start + 1;
+    }
+  }
+
+  for (unsigned int k = 0; k < UDS_MAX_BLOCK_DATA_SIZE; k++) {
+    base->data[k] = keys[bestStart][UDS_MAX_BLOCK_DATA_SIZE - 1 - k];
+  }
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 static unsigned int encodeTree(byte                  recordPage[],
+                               const Geometry       *geometry,
+                               const UdsChunkData   *base,
                                const UdsChunkRecord *sortedPointers[],
                                unsigned int          nextRecord,
                                unsigned int          node,
@@ -32,18 +138,28 @@ static unsigned int encodeTree(byte                  recordPage[],
 {
   if (node < nodeCount) {
     unsigned int child = (2 * node) + 1;
-    nextRecord = encodeTree(recordPage, sortedPointers, nextRecord,
-                            child, nodeCount);
+    nextRecord = encodeTree(recordPage, geometry, base, sortedPointers,
+                            nextRecord, child, nodeCount);
 
     // In-order traversal: copy the contents of the next record
     // into the page at the node offset.
-    memcpy(&recordPage[node * BYTES_PER_RECORD],
-           sortedPointers[nextRecord],
-           BYTES_PER_RECORD);
+    const UdsChunkRecord *record = sortedPointers[nextRecord];
+    byte *stored = &recordPage[geometry->recordPageHeaderBytes
+                               + (node * geometry->bytesPerRecord)];
+    if (base == NULL) {
+      memcpy(stored, record, BYTES_PER_RECORD);
+    } else {
+      unsigned int width = geometry->packedMetadataBytes;
+      memcpy(stored, &record->name, UDS_CHUNK_NAME_SIZE);
+      if (!computePackedOffset(record->data.data, base->data, false, width,
+                               &stored[UDS_CHUNK_NAME_SIZE])) {
+        memset(&stored[UDS_CHUNK_NAME_SIZE], 0xff, width);
+      }
+    }
     ++nextRecord;
 
-    nextRecord = encodeTree(recordPage, sortedPointers, nextRecord,
-                            child + 1, nodeCount);
+    nextRecord = encodeTree(recordPage, geometry, base, sortedPointers,
+                            nextRecord, child + 1, nodeCount);
   }
   return nextRecord;
 }
@@ -51,9 +167,21 @@ static unsigned int encodeTree(byte                  recordPage[],
 /**********************************************************************/
 int encodeRecordPage(const Volume *volume, const UdsChunkRecord records[])
 {
-  unsigned int recordsPerPage = volume->geometry->recordsPerPage;
+  const Geometry *geometry = volume->geometry;
+  unsigned int recordsPerPage = geometry->recordsPerPage;
   const UdsChunkRecord **recordPointers = volume->recordPointers;
 
+  UdsChunkData base;
+  if (geometry->packedMetadataBytes > 0) {
+    int result = choosePackingBase(volume, records, &base);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    // A packed page need not fill the whole page, so clear any unused tail.
+    memset(volume->scratchPage, 0, geometry->bytesPerPage);
+    memcpy(volume->scratchPage, &base, PACKED_RECORD_PAGE_HEADER_BYTES);
+  }
+
   // Build an array of record pointers. We'll sort the pointers by the block
   // names in the records, which is less work than sorting the record values.
   for (unsigned int i = 0; i < recordsPerPage; i++) {
@@ -69,28 +197,71 @@ int encodeRecordPage(const Volume *volume, const UdsChunkRecord records[])
 
   // Use the sorted pointers to copy the records from the chapter to the
   // record page in tree order.
-  encodeTree(volume->scratchPage, recordPointers, 0, 0, recordsPerPage);
+  encodeTree(volume->scratchPage, geometry,
+             ((geometry->packedMetadataBytes > 0) ? &base : NULL),
+             recordPointers, 0, 0, recordsPerPage);
   return UDS_SUCCESS;
 }
 
+/**
+ * Recover the metadata of a record on a packed record page.
+ *
+ * @param recordPage The record page
+ * @param record     The stored record
+ * @param width      The number of bytes in a packed offset
+ * @param metadata   The metadata to fill in
+ *
+ * @return <code>true</code> if the record's metadata was stored
+ **/
+static bool unpackMetadata(const byte    recordPage[],
+                           const byte    record[],
+                           unsigned int  width,
+                           UdsChunkData *metadata)
+{
+  const byte *offset = &record[UDS_CHUNK_NAME_SIZE];
+  bool allOnes = true;
+  for (unsigned int i = 0; i < width; i++) {
+    allOnes = (allOnes && (offset[i] == 0xff));
+  }
+  if (allOnes) {
+    return false;
+  }
+
+  // The page header holds the base value.
+  unsigned int carry = 0;
+  for (unsigned int i = 0; i < UDS_MAX_BLOCK_DATA_SIZE; i++) {
+    unsigned int sum = recordPage[i] + ((i < width) ? offset[i] : 0) + carry;
+    metadata->data[i] = (byte) (sum & 0xff);
+    carry = sum >> 8;
+  }
+  return true;
+}
+
 /**********************************************************************/
 bool searchRecordPage(const byte          recordPage[],
                       const UdsChunkName *name,
                       const Geometry     *geometry,
                       UdsChunkData       *metadata)
 {
-  // The record page is just an array of chunk records.
-  const UdsChunkRecord *records = (const UdsChunkRecord *) recordPage;
-
   // The array of records is sorted by name and stored as a binary tree in
   // heap order, so the root of the tree is the first array element.
   unsigned int node = 0;
   while (node < geometry->recordsPerPage) {
-    const UdsChunkRecord *record = &records[node];
-    int result = memcmp(name, &record->name, UDS_CHUNK_NAME_SIZE);
+    const byte *record = getRecordPageRecord(recordPage, geometry, node);
+    int result = memcmp(name, record, UDS_CHUNK_NAME_SIZE);
     if (result == 0) {
-      if (metadata != NULL) {
-        *metadata = record->data;
+      if (geometry->packedMetadataBytes > 0) {
+        UdsChunkData unpacked;
+        if (!unpackMetadata(recordPage, record,
+                            geometry->packedMetadataBytes, &unpacked)) {
+          return false;
+        }
+        if (metadata != NULL) {
+          *metadata = unpacked;
+        }
+      } else if (metadata != NULL) {
+        memcpy(metadata, &record[UDS_CHUNK_NAME_SIZE],
+               UDS_MAX_BLOCK_DATA_SIZE);
       }
       return true;
     }
@@ -99,3 +270,42 @@ bool searchRecordPage(const byte          recordPage[],
   }
   return false;
 }
+
+/**********************************************************************/
+bool validateRecordPage(const byte recordPage[], const Geometry *geometry)
+{
+  unsigned int recordCount = geometry->recordsPerPage;
+  const byte *previous = NULL;
+
+  // Walk the tree in order without recursion; the names must never decrease.
+  // Descend to the leftmost node, then repeatedly visit the node, step to
+  // its right child if it has one and descend left again, or else climb
+  // until arriving from a left child.
+  unsigned int node = 0;
+  while ((2 * node) + 1 < recordCount) {
+    node = (2 * node) + 1;
+  }
+  for (unsigned int visited = 0; visited < recordCount; visited++) {
+    const byte *name = getRecordPageRecord(recordPage, geometry, node);
+    if ((previous != NULL)
+        && (memcmp(previous, name, UDS_CHUNK_NAME_SIZE) > 0)) {
+      return false;
+    }
+    previous = name;
+
+    unsigned int right = (2 * node) + 2;
+    if (right < recordCount) {
+      node = right;
+      while ((2 * node) + 1 < recordCount) {
+        node = (2 * node) + 1;
+      }
+    } else {
+      // Climb while this node is a right child; the parent of N is (N-1)/2.
+      while ((node > 0) && ((node % 2) == 0)) {
+        node = (node - 1) / 2;
+      }
+      node = (node > 0) ? (node - 1) / 2 : recordCount;
+    }
+  }
+  return true;
+}
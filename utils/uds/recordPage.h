@@ -25,9 +25,30 @@
 #include "common.h"
 #include "volume.h"
 
+/**
+ * Get the stored form of a record on a record page. The record begins with
+ * its block name, followed by its metadata or, on a packed record page, by
+ * its packed metadata offset.
+ *
+ * @param recordPage The record page
+ * @param geometry   The geometry of the volume
+ * @param node       The position of the record in the page's tree
+ *
+ * @return a pointer to the stored record
+ **/
+static INLINE const byte *getRecordPageRecord(const byte      recordPage[],
+                                              const Geometry *geometry,
+                                              unsigned int    node)
+{
+  return &recordPage[geometry->recordPageHeaderBytes
+                     + (node * geometry->bytesPerRecord)];
+}
+
 /**
  * Generate the on-disk encoding of a record page from the list of records
- * in the open chapter representation.
+ * in the open chapter representation. On a packed record page, records
+ * whose metadata is too far from the page's base value to be packed are
+ * stored without metadata.
  *
  * @param volume     The volume
  * @param records    The records to be encoded
@@ -45,11 +66,23 @@ int encodeRecordPage(const Volume *volume, const UdsChunkRecord records[]);
  * @param metadata   an array in which to place the metadata of the
  *                   record, if one was found
  *
- * @return <code>true</code> if the record was found
+ * @return <code>true</code> if the record was found (and, on a packed
+ *         record page, its metadata was stored)
  **/
 bool searchRecordPage(const byte          recordPage[],
                       const UdsChunkName *name,
                       const Geometry     *geometry,
                       UdsChunkData       *metadata);
 
+/**
+ * Check that a record page read from storage is a properly ordered binary
+ * tree of records, as written by encodeRecordPage().
+ *
+ * @param recordPage The record page
+ * @param geometry   The geometry of the volume
+ *
+ * @return <code>true</code> if the record names are in tree order
+ **/
+bool validateRecordPage(const byte recordPage[], const Geometry *geometry);
+
 #endif /* RECORDPAGE_H */
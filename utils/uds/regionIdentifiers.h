@@ -39,6 +39,7 @@ enum {
   RL_KIND_INDEX_PAGE_MAP = 301,
   RL_KIND_MASTER_INDEX   = 302,
   RL_KIND_OPEN_CHAPTER   = 303,
+  RL_KIND_CACHE_HOT_SET  = 304,
   RL_KIND_INDEX_STATE    = 401,         // not saved as region
 
   RL_SOLE_INSTANCE       = 65535,
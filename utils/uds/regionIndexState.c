@@ -267,6 +267,14 @@ int openRegionStateRegion(RegionIndexState  *ris,
       lr = isl->openChapter;
       break;
 
+    case RL_KIND_CACHE_HOT_SET:
+      if (isl->hotSet.numBlocks == 0) {
+        // not an error: only version 2 layouts have a hot set region
+        return UDS_UNSUPPORTED;
+      }
+      lr = &isl->hotSet;
+      break;
+
     case RL_KIND_MASTER_INDEX:
       if (isl->masterIndexZones == NULL || zone >= isl->numZones) {
         return logErrorWithStringError(UDS_UNEXPECTED_RESULT,
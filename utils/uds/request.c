@@ -25,9 +25,12 @@
 #include "grid.h"
 #include "indexSession.h"
 #include "logger.h"
+#include "lookupCache.h"
 #include "memoryAlloc.h"
 #include "parameter.h"
 #include "permassert.h"
+#include "requestPool.h"
+#include "requestTrace.h"
 #include "udsState.h"
 
 /**********************************************************************/
@@ -41,6 +44,28 @@ int launchAllocatedClientRequest(Request *request)
   request->action           = (RequestAction) request->type;
   request->isControlMessage = false;
   request->unbatched        = false;
+  request->pool             = NULL;
+  request->priority         = READ_ONCE(request->context->priority);
+  request->lookupCacheHit   = false;
+  request->traceID          = newRequestTraceID();
+
+  LookupCache *lookupCache = request->context->lookupCache;
+  if (lookupCache != NULL) {
+    if (request->action != REQUEST_QUERY) {
+      invalidateLookupCacheName(lookupCache, &request->hash);
+    } else {
+      request->lookupCacheEpoch = getLookupCacheEpoch(lookupCache,
+                                                      &request->hash);
+      if (searchLookupCache(lookupCache, &request->hash, request->update,
+                            &request->oldMetadata, &request->location)) {
+        // Answer the query from the cache on the callback thread.
+        request->lookupCacheHit = true;
+        request->status         = UDS_SUCCESS;
+        enqueueRequest(request, STAGE_CALLBACK);
+        return UDS_SUCCESS;
+      }
+    }
+  }
 
   request->router = selectGridRouter(request->context->indexSession->grid,
                                      &request->hash);
@@ -59,7 +84,7 @@ int launchAIPControlMessage(AIPContext     *serverContext,
                             Request       **requestPtr)
 {
   Request *request;
-  int result = ALLOCATE(1, Request, __func__, &request);
+  int result = allocatePooledRequest(__func__, &request);
   if (result != UDS_SUCCESS) {
     FREE(serverContext);
     return result;
@@ -82,7 +107,7 @@ int launchAIPControlMessage(AIPContext     *serverContext,
   SynchronousCallback synchronous;
   result = initializeSynchronousRequest(&synchronous);
   if (result != UDS_SUCCESS) {
-    FREE(request);
+    freePooledRequest(request);
     FREE(serverContext);
     return result;
   }
@@ -105,7 +130,7 @@ int launchClientControlMessage(UdsContext     *context,
                                Request       **requestPtr)
 {
   Request *request;
-  int result = ALLOCATE(1, Request, __func__, &request);
+  int result = allocatePooledRequest(__func__, &request);
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -126,7 +151,7 @@ int launchClientControlMessage(UdsContext     *context,
   SynchronousCallback synchronous;
   result = initializeSynchronousRequest(&synchronous);
   if (result != UDS_SUCCESS) {
-    FREE(request);
+    freePooledRequest(request);
     return result;
   }
   request->synchronous = &synchronous;
@@ -139,14 +164,25 @@ int launchClientControlMessage(UdsContext     *context,
   return result;
 }
 
-/**********************************************************************/
-int launchZoneControlMessage(RequestAction  action,
-                             ZoneMessage    message,
-                             unsigned int   zone,
-                             IndexRouter   *router)
+/**
+ * Allocate and initialize a control message for an index zone.
+ *
+ * @param action      The control action to perform
+ * @param message     The message to send
+ * @param zone        The zone number of the zone to receive the message
+ * @param router      The index router responsible for handling the message
+ * @param requestPtr  A pointer to hold the message request
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int makeZoneControlMessage(RequestAction   action,
+                                  ZoneMessage     message,
+                                  unsigned int    zone,
+                                  IndexRouter    *router,
+                                  Request       **requestPtr)
 {
   Request *request;
-  int result = ALLOCATE(1, Request, __func__, &request);
+  int result = allocatePooledRequest(__func__, &request);
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -157,11 +193,59 @@ int launchZoneControlMessage(RequestAction  action,
   request->action           = action;
   request->zoneNumber       = zone;
   request->zoneMessage      = message;
+  // Background sweeping must yield to the client requests.
+  if (action == REQUEST_SWEEP_EXPIRED_ENTRIES) {
+    request->priority = UDS_PRIORITY_BULK;
+  }
+
+  *requestPtr = request;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+int launchZoneControlMessage(RequestAction  action,
+                             ZoneMessage    message,
+                             unsigned int   zone,
+                             IndexRouter   *router)
+{
+  Request *request;
+  int result = makeZoneControlMessage(action, message, zone, router,
+                                      &request);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
 
   enqueueRequest(request, STAGE_INDEX);
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+int startSynchronousZoneControlMessage(RequestAction         action,
+                                       ZoneMessage           message,
+                                       unsigned int          zone,
+                                       IndexRouter          *router,
+                                       SynchronousCallback  *synchronous,
+                                       Request             **requestPtr)
+{
+  Request *request;
+  int result = makeZoneControlMessage(action, message, zone, router,
+                                      &request);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  result = initializeSynchronousRequest(synchronous);
+  if (result != UDS_SUCCESS) {
+    freeRequest(request);
+    return result;
+  }
+  request->synchronous = synchronous;
+
+  enqueueRequest(request, STAGE_INDEX);
+  *requestPtr = request;
+  return UDS_SUCCESS;
+}
+
 /**********************************************************************/
 void freeRequest(Request *request)
 {
@@ -173,7 +257,11 @@ void freeRequest(Request *request)
   UdsContext *context = request->context;
 
   FREE(request->serverContext);
-  FREE(request);
+  if (request->pool != NULL) {
+    freePooledRequest(request);
+  } else {
+    FREE(request);
+  }
   request = NULL;
 
   if (context == NULL) {
@@ -222,6 +310,7 @@ void enqueueRequest(Request *request, RequestStage nextStage)
     return;
   }
 
+  traceRequest(request, TRACE_ENQUEUE, nextStage);
   requestQueueEnqueue(nextQueue, request);
 }
 
@@ -298,6 +387,9 @@ void updateRequestContextStats(Request *request)
     } else {
       sessionStats->queriesNotFound++;
     }
+    if (request->lookupCacheHit) {
+      sessionStats->lookupCacheHits++;
+    }
     break;
 
   default:
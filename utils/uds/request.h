@@ -54,6 +54,16 @@ typedef enum {
   // has closed the current open chapter.
   REQUEST_ANNOUNCE_CHAPTER_CLOSED,
 
+  // REQUEST_SWEEP_EXPIRED_ENTRIES is the action for the control request
+  // used by an indexZone to remove the master index entries of expired
+  // chapters a few delta lists at a time, between client requests.
+  REQUEST_SWEEP_EXPIRED_ENTRIES,
+
+  // REQUEST_BULK_LOAD is the action for the synchronous control request
+  // used to add a batch of records to an indexZone without a request for
+  // each of them.
+  REQUEST_BULK_LOAD,
+
   // REQUEST_OPEN through REQUEST_FINISH are the actions for control requests
   // used by remoteIndexRouter.
   REQUEST_OPEN,
@@ -94,8 +104,8 @@ typedef enum {
 } RequestStage;
 
 /**
- * Control message fields for the barrier messages used to coordinate the
- * addition of a chapter to the sparse chapter index cache.
+ * Control message fields for the barrier messages used to ensure a chapter
+ * is in the sparse chapter index cache before a zone needs it.
  **/
 typedef struct barrierMessageData {
   /** virtual chapter number of the chapter index to add to the sparse cache */
@@ -111,6 +121,17 @@ typedef struct chapterClosedMessageData {
   uint64_t      virtualChapter;
 } ChapterClosedMessageData;
 
+/**
+ * Control message fields for the bulk load messages used to add a batch of
+ * records to a zone.
+ **/
+typedef struct bulkLoadMessageData {
+  /** the records to add, all of which belong to the receiving zone */
+  const UdsBulkRecord *records;
+  /** the number of records */
+  size_t               count;
+} BulkLoadMessageData;
+
 /**
  * Union of the all the zone control message fields. The RequestAction field
  * (or launch function argument) selects which of the members is valid.
@@ -118,6 +139,7 @@ typedef struct chapterClosedMessageData {
 typedef union zoneMessageData {
   BarrierMessageData barrier;             // for REQUEST_SPARSE_CACHE_BARRIER
   ChapterClosedMessageData chapterClosed; // for REQUEST_ANNOUNCE_CHAPTER_CLOSED
+  BulkLoadMessageData bulkLoad;           // for REQUEST_BULK_LOAD
 } ZoneMessageData;
 
 typedef struct zoneMessage {
@@ -169,6 +191,15 @@ struct request {
   IndexRegion      slLocation;      // location determined by slowlane
 
   SynchronousCallback *synchronous; // wait/wake object if request synchronous
+  struct requestPool  *pool;        // owning pool, if allocated by UDS
+
+  UdsRequestPriority priority;      // the priority class of the request
+  AbsTime            enqueueTime;   // when last put on a RequestQueue
+
+  bool         lookupCacheHit;    // answered from the context lookup cache
+  unsigned int lookupCacheEpoch;  // lookup cache epoch when the query began
+
+  uint64_t     traceID;           // non-zero if the request is being traced
 };
 
 typedef void (*RequestRestarter)(Request *);
@@ -251,6 +282,30 @@ int launchZoneControlMessage(RequestAction  action,
                              IndexRouter   *router)
   __attribute__((warn_unused_result));
 
+/**
+ * Make a synchronous control message for an index zone and enqueue it for
+ * processing. The caller must wait for the message to be processed by
+ * calling awaitSynchronousRequest() on the given callback, after which the
+ * request, with its status, belongs to the caller and must be freed with
+ * freeRequest(). Several such messages may be outstanding at once.
+ *
+ * @param action       The control action to perform
+ * @param message      The message to send
+ * @param zone         The zone number of the zone to receive the message
+ * @param router       The index router responsible for handling the message
+ * @param synchronous  The callback with which to wait for the message
+ * @param requestPtr   A pointer to hold the message request
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int startSynchronousZoneControlMessage(RequestAction         action,
+                                       ZoneMessage           message,
+                                       unsigned int          zone,
+                                       IndexRouter          *router,
+                                       SynchronousCallback  *synchronous,
+                                       Request             **requestPtr)
+  __attribute__((warn_unused_result));
+
 /**
  * Free an index request.
  *
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/requestPool.c#1 $
+ */
+
+#include "requestPool.h"
+
+#include "atomicDefs.h"
+#include "memoryAlloc.h"
+#include "request.h"
+#include "threadOnce.h"
+#include "threads.h"
+#include "util/funnelQueue.h"
+
+/*
+ * The per-thread pool. The reference count holds one reference for the
+ * owning thread and one for each request handed out and not yet returned,
+ * so whichever of the owner's exit and the final return comes last frees
+ * the pool.
+ */
+typedef struct requestPool {
+  /** requests returned by other threads; consumed only by the owner */
+  FunnelQueue      *returned;
+  /** the owner's private free list, linked through requestQueueLink */
+  FunnelQueueEntry *freeList;
+  /** the number of requests on the private free list */
+  unsigned int      freeCount;
+  /** the owner reference plus the number of outstanding requests */
+  atomic_t          references;
+} RequestPool;
+
+static OnceState     poolOnce = ONCE_STATE_INITIALIZER;
+static pthread_key_t poolKey;
+static bool          poolKeyValid = false;
+
+/**********************************************************************/
+static void destroyRequestPool(RequestPool *pool)
+{
+  while (pool->freeList != NULL) {
+    FunnelQueueEntry *entry = pool->freeList;
+    pool->freeList = entry->next;
+    FREE(container_of(entry, Request, requestQueueLink));
+  }
+
+  FunnelQueueEntry *entry;
+  while ((entry = funnelQueuePoll(pool->returned)) != NULL) {
+    FREE(container_of(entry, Request, requestQueueLink));
+  }
+
+  freeFunnelQueue(pool->returned);
+  FREE(pool);
+}
+
+/**********************************************************************/
+static void dropPoolReference(RequestPool *pool)
+{
+  if (atomic_add_return(-1, &pool->references) == 0) {
+    destroyRequestPool(pool);
+  }
+}
+
+/**
+ * Release the exiting thread's reference to its pool.
+ *
+ * @param arg  the RequestPool of the exiting thread
+ **/
+static void releaseThreadPool(void *arg)
+{
+  dropPoolReference((RequestPool *) arg);
+}
+
+/**********************************************************************/
+static void initPoolKey(void)
+{
+  poolKeyValid = (createThreadKey(&poolKey, releaseThreadPool)
+                  == UDS_SUCCESS);
+}
+
+/**
+ * Find or create the request pool of the calling thread.
+ *
+ * @param poolPtr  A pointer to hold the pool
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int getThreadPool(RequestPool **poolPtr)
+{
+  int result = performOnce(&poolOnce, initPoolKey);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  if (!poolKeyValid) {
+    return UDS_ENOTHREADS;
+  }
+
+  RequestPool *pool = getThreadSpecific(poolKey);
+  if (pool != NULL) {
+    *poolPtr = pool;
+    return UDS_SUCCESS;
+  }
+
+  result = ALLOCATE(1, RequestPool, "request pool", &pool);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = makeFunnelQueue(&pool->returned);
+  if (result != UDS_SUCCESS) {
+    FREE(pool);
+    return result;
+  }
+  atomic_set(&pool->references, 1);
+
+  result = setThreadSpecific(poolKey, pool);
+  if (result != UDS_SUCCESS) {
+    freeFunnelQueue(pool->returned);
+    FREE(pool);
+    return result;
+  }
+
+  *poolPtr = pool;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+int allocatePooledRequest(const char *what, Request **requestPtr)
+{
+  UdsMemoryComponent previous = setMemoryComponent(UDS_MEMORY_REQUEST_POOLS);
+  RequestPool *pool;
+  int result = getThreadPool(&pool);
+  if (result != UDS_SUCCESS) {
+    setMemoryComponent(previous);
+    return result;
+  }
+
+  Request *request;
+  FunnelQueueEntry *entry = pool->freeList;
+  if (entry != NULL) {
+    pool->freeList = entry->next;
+    pool->freeCount--;
+  } else {
+    entry = funnelQueuePoll(pool->returned);
+  }
+
+  if (entry != NULL) {
+    request = container_of(entry, Request, requestQueueLink);
+    memset(request, 0, sizeof(*request));
+  } else {
+    result = allocateCacheAligned(sizeof(Request), what, &request);
+    if (result != UDS_SUCCESS) {
+      setMemoryComponent(previous);
+      return result;
+    }
+  }
+  setMemoryComponent(previous);
+
+  atomic_inc(&pool->references);
+  request->pool = pool;
+  *requestPtr = request;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+void freePooledRequest(Request *request)
+{
+  RequestPool *pool = request->pool;
+  if (pool != getThreadSpecific(poolKey)) {
+    // The put must complete before the reference is dropped, since dropping
+    // the last reference frees the queue.
+    funnelQueuePut(pool->returned, &request->requestQueueLink);
+  } else if (pool->freeCount < REQUEST_POOL_CAPACITY) {
+    // The owning thread can use its private free list without any fences.
+    request->requestQueueLink.next = pool->freeList;
+    pool->freeList = &request->requestQueueLink;
+    pool->freeCount++;
+  } else {
+    FREE(request);
+  }
+  dropPoolReference(pool);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/requestPool.h#1 $
+ */
+
+#ifndef REQUEST_POOL_H
+#define REQUEST_POOL_H
+
+#include "opaqueTypes.h"
+
+/**
+ * Requests made by UDS itself (control messages such as the sparse cache
+ * barriers sent for every sparse lookup) are allocated from a pool owned by
+ * the allocating thread. A thread reuses requests from its own free list
+ * without locking. A request freed by any other thread (typically a zone or
+ * callback thread finishing a control message) is returned to its owner on
+ * a lock-free funnel queue, which only the owner consumes. A thread keeps at
+ * most REQUEST_POOL_CAPACITY requests on its own free list, and reuses
+ * returned requests before allocating new ones, so a pool never holds more
+ * requests than its thread has had in flight at once.
+ *
+ * A thread's pool outlives the thread until every request it handed out has
+ * been returned, at which point the last returning thread frees it.
+ **/
+enum {
+  REQUEST_POOL_CAPACITY = 256,
+};
+
+/**
+ * Get a zeroed, cache-aligned request from the calling thread's pool,
+ * allocating a new one if the pool is empty.
+ *
+ * @param what        What is being allocated (for error logging)
+ * @param requestPtr  A pointer to hold the request
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int allocatePooledRequest(const char *what, Request **requestPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Return a request to the pool it was allocated from. This may be called
+ * from any thread.
+ *
+ * @param request  A request obtained from allocatePooledRequest()
+ **/
+void freePooledRequest(Request *request);
+
+#endif /* REQUEST_POOL_H */
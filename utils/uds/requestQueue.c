@@ -25,6 +25,7 @@
 #include "logger.h"
 #include "permassert.h"
 #include "request.h"
+#include "requestTrace.h"
 #include "memoryAlloc.h"
 #include "threads.h"
 #include "timeUtils.h"
@@ -52,6 +53,21 @@
  * happening, and the enqueuing operations complete while the request
  * processing is still in progress, then the retry request(s) *will*
  * get processed next.  (This is used for testing.)
+ *
+ * Zone control messages (sparse cache barriers and chapter closed
+ * announcements) have their own queue, which is polled right after the
+ * retry queue. A barrier is always enqueued before the request that
+ * needs it, so taking these messages ahead of every client request
+ * keeps a barrier in front of its request whatever that request's
+ * priority class.
+ *
+ * Client requests, and any other control messages, are queued by the
+ * priority class of their block context. The worker serves the classes
+ * by weighted round robin: each class may take up to its weight in
+ * requests per round, the classes with work are polled in order of
+ * priority, and a new round starts once no class with work has any
+ * of its share left. An idle class never holds up a busy one, and a
+ * busy class never starves a less favored one.
  */
 
 /**
@@ -82,12 +98,41 @@ enum {
   MAXIMUM_BATCH = 64   // wait time decreases if batches are larger than this
 };
 
+/**
+ * The weighted round robin share of each priority class, and the order in
+ * which the classes are polled.
+ **/
+static const unsigned int CLASS_WEIGHTS[UDS_PRIORITY_CLASS_COUNT] = {
+  [UDS_PRIORITY_INTERACTIVE] = 8,
+  [UDS_PRIORITY_NORMAL]      = 4,
+  [UDS_PRIORITY_BULK]        = 1,
+};
+
+static const UdsRequestPriority POLL_ORDER[UDS_PRIORITY_CLASS_COUNT] = {
+  UDS_PRIORITY_INTERACTIVE,
+  UDS_PRIORITY_NORMAL,
+  UDS_PRIORITY_BULK,
+};
+
+/**
+ * The queue and statistics for one priority class. The enqueued count is
+ * shared by the producers; the rest is written only by the worker thread.
+ **/
+typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) classQueue {
+  FunnelQueue  *queue;              // requests of this class
+  atomic64_t    enqueued;           // requests ever put on the queue
+  uint64_t      dequeued;           // requests ever taken from the queue
+  uint64_t      waitNanoseconds;    // total time the dequeued requests waited
+  uint64_t      maxWaitNanoseconds; // longest time a request waited
+  unsigned int  credit;             // requests left in this round
+} ClassQueue;
+
 struct requestQueue {
   const char            *name;       // name of queue
   RequestQueueProcessor *processOne; // function to process 1 request
 
-  FunnelQueue *mainQueue;       // new incoming requests
   FunnelQueue *retryQueue;      // old requests to retry first
+  FunnelQueue *controlQueue;    // zone control messages, taken next
   EventCount  *workEvent;       // signal to wake the worker thread
 
   Thread thread;                // thread id of the worker thread
@@ -109,6 +154,9 @@ struct requestQueue {
 
   /** the relative time at which to wake when waiting with a timeout */
   RelTime wakeRelTime;
+
+  /** the client requests, by priority class */
+  ClassQueue classes[UDS_PRIORITY_CLASS_COUNT];
 };
 
 /**
@@ -175,9 +223,60 @@ static Request *removeHead(FunnelQueue *queue)
   return container_of(entry, Request, requestQueueLink);
 }
 
+/**
+ * Record the time a request waited in a priority class queue.
+ *
+ * @param class    the class queue the request was taken from
+ * @param request  the request
+ **/
+static void recordDequeue(ClassQueue *class, Request *request)
+{
+  RelTime elapsed = timeDifference(currentTime(CT_MONOTONIC),
+                                   request->enqueueTime);
+  int64_t waited = relTimeToNanoseconds(elapsed);
+  uint64_t wait = (waited > 0) ? waited : 0;
+  WRITE_ONCE(class->dequeued, class->dequeued + 1);
+  WRITE_ONCE(class->waitNanoseconds, class->waitNanoseconds + wait);
+  if (wait > class->maxWaitNanoseconds) {
+    WRITE_ONCE(class->maxWaitNanoseconds, wait);
+  }
+}
+
+/**
+ * Poll the priority class queues in weighted round robin order.
+ *
+ * @param queue  the RequestQueue being serviced
+ *
+ * @return a dequeued request, or NULL if no request was available
+ **/
+static Request *pollClassQueues(RequestQueue *queue)
+{
+  for (unsigned int round = 0; round < 2; round++) {
+    for (unsigned int i = 0; i < UDS_PRIORITY_CLASS_COUNT; i++) {
+      ClassQueue *class = &queue->classes[POLL_ORDER[i]];
+      if (class->credit == 0) {
+        continue;
+      }
+      Request *request = removeHead(class->queue);
+      if (request != NULL) {
+        class->credit--;
+        recordDequeue(class, request);
+        return request;
+      }
+    }
+
+    // Every class with work has used its share, so start a new round.
+    for (unsigned int i = 0; i < UDS_PRIORITY_CLASS_COUNT; i++) {
+      queue->classes[i].credit = CLASS_WEIGHTS[i];
+    }
+  }
+  return NULL;
+}
+
 /**
  * Poll the underlying lock-free queues for a request to process. Requests in
- * the retry queue have higher priority, so that queue is polled first.
+ * the retry queue have the highest priority, so that queue is polled first,
+ * followed by the zone control messages and then the client classes.
  *
  * @param queue  the RequestQueue being serviced
  *
@@ -187,7 +286,10 @@ static Request *pollQueues(RequestQueue *queue)
 {
   Request *request = removeHead(queue->retryQueue);
   if (request == NULL) {
-    request = removeHead(queue->mainQueue);
+    request = removeHead(queue->controlQueue);
+  }
+  if (request == NULL) {
+    request = pollClassQueues(queue);
   }
   return request;
 }
@@ -267,6 +369,7 @@ static void requestQueueWorker(void *arg)
   logDebug("%s queue starting", queue->name);
   Request *request;
   while ((request = dequeueRequest(queue)) != NULL) {
+    traceRequest(request, TRACE_DEQUEUE, 0);
     queue->processOne(request);
   }
   logDebug("%s queue done", queue->name);
@@ -283,16 +386,24 @@ static int initializeQueue(RequestQueue          *queue,
   queue->currentBatch    = 0;
   queue->waitNanoseconds = DEFAULT_WAIT_TIME;
 
-  int result = makeFunnelQueue(&queue->mainQueue);
+  int result = makeFunnelQueue(&queue->retryQueue);
   if (result != UDS_SUCCESS) {
     return result;
   }
 
-  result = makeFunnelQueue(&queue->retryQueue);
+  result = makeFunnelQueue(&queue->controlQueue);
   if (result != UDS_SUCCESS) {
     return result;
   }
 
+  for (unsigned int i = 0; i < UDS_PRIORITY_CLASS_COUNT; i++) {
+    result = makeFunnelQueue(&queue->classes[i].queue);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    queue->classes[i].credit = CLASS_WEIGHTS[i];
+  }
+
   result = makeEventCount(&queue->workEvent);
   if (result != UDS_SUCCESS) {
     return result;
@@ -328,12 +439,34 @@ int makeRequestQueue(const char             *queueName,
   return UDS_SUCCESS;
 }
 
+/**
+ * Check whether a request is a zone control message, which must be taken
+ * ahead of any client request enqueued after it.
+ *
+ * @param request  the request
+ *
+ * @return true if the request is a zone control message
+ **/
+static INLINE bool isZoneControlMessage(const Request *request)
+{
+  return ((request->action == REQUEST_SPARSE_CACHE_BARRIER)
+          || (request->action == REQUEST_ANNOUNCE_CHAPTER_CLOSED));
+}
+
 /**********************************************************************/
 void requestQueueEnqueue(RequestQueue *queue, Request *request)
 {
   bool unbatched = request->unbatched;
-  funnelQueuePut(request->requeued ? queue->retryQueue : queue->mainQueue,
-                 &request->requestQueueLink);
+  if (request->requeued) {
+    funnelQueuePut(queue->retryQueue, &request->requestQueueLink);
+  } else if (isZoneControlMessage(request)) {
+    funnelQueuePut(queue->controlQueue, &request->requestQueueLink);
+  } else {
+    ClassQueue *class = &queue->classes[request->priority];
+    request->enqueueTime = currentTime(CT_MONOTONIC);
+    atomic64_inc(&class->enqueued);
+    funnelQueuePut(class->queue, &request->requestQueueLink);
+  }
 
   /*
    * We must wake the worker thread when it is dormant (waiting with no
@@ -345,6 +478,38 @@ void requestQueueEnqueue(RequestQueue *queue, Request *request)
   }
 }
 
+/**********************************************************************/
+void getRequestQueueStats(RequestQueue *queue, UdsQueueClassStats *totals)
+{
+  UdsQueueClassStats stats[UDS_PRIORITY_CLASS_COUNT];
+  for (unsigned int i = 0; i < UDS_PRIORITY_CLASS_COUNT; i++) {
+    const ClassQueue *class = &queue->classes[i];
+    uint64_t dequeued = READ_ONCE(class->dequeued);
+    uint64_t enqueued = atomic64_read(&class->enqueued);
+    stats[i] = (UdsQueueClassStats) {
+      .depth              = (enqueued > dequeued) ? enqueued - dequeued : 0,
+      .dequeued           = dequeued,
+      .waitNanoseconds    = READ_ONCE(class->waitNanoseconds),
+      .maxWaitNanoseconds = READ_ONCE(class->maxWaitNanoseconds),
+    };
+  }
+  addQueueClassStats(totals, stats);
+}
+
+/**********************************************************************/
+void addQueueClassStats(UdsQueueClassStats       *totals,
+                        const UdsQueueClassStats *stats)
+{
+  for (unsigned int i = 0; i < UDS_PRIORITY_CLASS_COUNT; i++) {
+    totals[i].depth           += stats[i].depth;
+    totals[i].dequeued        += stats[i].dequeued;
+    totals[i].waitNanoseconds += stats[i].waitNanoseconds;
+    if (stats[i].maxWaitNanoseconds > totals[i].maxWaitNanoseconds) {
+      totals[i].maxWaitNanoseconds = stats[i].maxWaitNanoseconds;
+    }
+  }
+}
+
 /**********************************************************************/
 void requestQueueFinish(RequestQueue *queue)
 {
@@ -377,7 +542,10 @@ void requestQueueFinish(RequestQueue *queue)
   }
 
   freeEventCount(queue->workEvent);
-  freeFunnelQueue(queue->mainQueue);
   freeFunnelQueue(queue->retryQueue);
+  freeFunnelQueue(queue->controlQueue);
+  for (unsigned int i = 0; i < UDS_PRIORITY_CLASS_COUNT; i++) {
+    freeFunnelQueue(queue->classes[i].queue);
+  }
   FREE(queue);
 }
@@ -24,6 +24,7 @@
 
 #include "opaqueTypes.h"
 #include "typeDefs.h"
+#include "uds.h"
 
 /* void return value because this function will process its own errors */
 typedef void RequestQueueProcessor(Request *);
@@ -46,13 +47,32 @@ int makeRequestQueue(const char             *queueName,
 /**
  * Add a request to the end of the queue for processing by the worker thread.
  * If the requeued flag is set on the request, it will be processed before
- * any non-requeued requests under most circumstances.
+ * any non-requeued requests under most circumstances. Zone control messages
+ * are also processed ahead of client requests, and client requests are
+ * served in proportion to the weight of their priority class.
  *
  * @param queue    the request queue that should process the request
  * @param request  the request to be processed on the queue's worker thread
  **/
 void requestQueueEnqueue(RequestQueue *queue, Request *request);
 
+/**
+ * Add the per-class statistics of a request queue to a set of totals.
+ *
+ * @param queue   the request queue
+ * @param totals  the per-class totals, indexed by UdsRequestPriority
+ **/
+void getRequestQueueStats(RequestQueue *queue, UdsQueueClassStats *totals);
+
+/**
+ * Add one set of per-class request queue statistics to another.
+ *
+ * @param totals  the per-class totals to update
+ * @param stats   the per-class statistics to add to the totals
+ **/
+void addQueueClassStats(UdsQueueClassStats       *totals,
+                        const UdsQueueClassStats *stats);
+
 /**
  * Shut down the request queue worker thread, then destroy and free the queue.
  *
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/requestTrace.c#1 $
+ */
+
+#include "requestTrace.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "atomicDefs.h"
+#include "featureDefs.h"
+#include "fileUtils.h"
+#include "logger.h"
+#include "memoryAlloc.h"
+#include "numeric.h"
+#include "parameter.h"
+#include "threadOnce.h"
+#include "threads.h"
+#include "timeUtils.h"
+
+enum {
+  /** The number of events kept in each thread's ring */
+  TRACE_RING_CAPACITY = 4096,
+  /** The size of the buffer used to format a trace dump */
+  TRACE_DUMP_BUFFER_SIZE = 64 * 1024,
+  /** The longest formatted trace event or thread name record */
+  TRACE_DUMP_MAX_RECORD = 256,
+};
+
+static const char *const TRACE_POINT_NAMES[] = {
+  "enqueue",
+  "dequeue",
+  "masterIndexProbe",
+  "sparseCache",
+  "pageCacheMiss",
+  "readComplete",
+  "callback",
+};
+
+typedef struct traceEvent {
+  uint64_t nanoseconds;
+  uint64_t traceID;
+  uint32_t point;
+  uint32_t value;
+} TraceEvent;
+
+/*
+ * Each thread records events only into its own ring, so recording takes no
+ * locks. The head counts every event ever recorded, and is advanced only
+ * after the event is written, so a dump can copy a ring without stopping its
+ * thread and then discard any events overwritten while it was copying.
+ *
+ * Rings are never freed. When a thread exits its ring is marked as orphaned
+ * and is adopted by the next thread which needs one, so the number of rings
+ * is bounded by the number of threads alive at once.
+ */
+typedef struct traceRing {
+  /** the next ring in the list of all rings */
+  struct traceRing *next;
+  /** whether the owning thread has exited */
+  bool              orphaned;
+  /** the id of the owning thread */
+  ThreadId          threadId;
+  /** the name of the owning thread */
+  char              threadName[16];
+  /** the number of events recorded since the ring was adopted */
+  atomic64_t        head;
+  /** the most recent events */
+  TraceEvent        events[TRACE_RING_CAPACITY];
+} TraceRing;
+
+static OnceState     traceOnce    = ONCE_STATE_INITIALIZER;
+static pthread_key_t traceKey;
+static bool          traceKeyValid = false;
+static Mutex         ringsMutex;
+static TraceRing    *rings        = NULL;
+static atomic64_t    nextTraceID;
+static bool          tracingEnabled = false;
+
+/**
+ * Mark the ring of an exiting thread as available for adoption.
+ *
+ * @param arg  The TraceRing of the exiting thread
+ **/
+static void releaseTraceRing(void *arg)
+{
+  TraceRing *ring = arg;
+  lockMutex(&ringsMutex);
+  ring->orphaned = true;
+  unlockMutex(&ringsMutex);
+}
+
+/**********************************************************************/
+static void initTraceKey(void)
+{
+  traceKeyValid = ((initMutex(&ringsMutex) == UDS_SUCCESS)
+                   && (createThreadKey(&traceKey, releaseTraceRing)
+                       == UDS_SUCCESS));
+}
+
+/**
+ * Find or create the trace ring of the calling thread.
+ *
+ * @return the ring, or NULL if one could not be made
+ **/
+static TraceRing *getThreadRing(void)
+{
+  if ((performOnce(&traceOnce, initTraceKey) != UDS_SUCCESS)
+      || !traceKeyValid) {
+    return NULL;
+  }
+
+  TraceRing *ring = getThreadSpecific(traceKey);
+  if (ring != NULL) {
+    return ring;
+  }
+
+  lockMutex(&ringsMutex);
+  for (ring = rings; ring != NULL; ring = ring->next) {
+    if (ring->orphaned) {
+      break;
+    }
+  }
+  if (ring == NULL) {
+    if (ALLOCATE(1, TraceRing, "request trace ring", &ring) != UDS_SUCCESS) {
+      unlockMutex(&ringsMutex);
+      return NULL;
+    }
+    ring->next = rings;
+    rings = ring;
+  }
+  ring->orphaned = false;
+  ring->threadId = getThreadId();
+  getThreadName(ring->threadName);
+  atomic64_set(&ring->head, 0);
+  unlockMutex(&ringsMutex);
+
+  if (setThreadSpecific(traceKey, ring) != UDS_SUCCESS) {
+    releaseTraceRing(ring);
+    return NULL;
+  }
+  return ring;
+}
+
+/**********************************************************************/
+static UdsParameterValue getDefaultRequestTracing(void)
+{
+#if ENVIRONMENT
+  char *env = getenv(UDS_REQUEST_TRACING);
+  if (env != NULL) {
+    UdsParameterValue tmp = {
+      .type = UDS_PARAM_TYPE_STRING,
+      .value.u_string = env,
+    };
+    UdsParameterValue value;
+    if (validateBoolean(&tmp, NULL, &value) == UDS_SUCCESS) {
+      return value;
+    }
+  }
+#endif // ENVIRONMENT
+  return UDS_PARAM_FALSE;
+}
+
+/**********************************************************************/
+static void updateRequestTracing(const UdsParameterValue *value)
+{
+  WRITE_ONCE(tracingEnabled, value->value.u_bool);
+}
+
+/**********************************************************************/
+int defineRequestTracing(ParameterDefinition *pd)
+{
+  pd->validate       = validateBoolean;
+  pd->validationData = NULL;
+  pd->currentValue   = getDefaultRequestTracing();
+  pd->update         = updateRequestTracing;
+  updateRequestTracing(&pd->currentValue);
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+uint64_t newRequestTraceID(void)
+{
+  if (likely(!READ_ONCE(tracingEnabled))) {
+    return 0;
+  }
+  return atomic64_add_return(1, &nextTraceID);
+}
+
+/**********************************************************************/
+void recordRequestTrace(uint64_t          traceID,
+                        RequestTracePoint point,
+                        uint32_t          value)
+{
+  TraceRing *ring = getThreadRing();
+  if (ring == NULL) {
+    return;
+  }
+
+  AbsTime epoch = ABSTIME_EPOCH;
+  RelTime now = timeDifference(currentTime(CT_MONOTONIC), epoch);
+  uint64_t head = atomic64_read(&ring->head);
+  ring->events[head % TRACE_RING_CAPACITY] = (TraceEvent) {
+    .nanoseconds = relTimeToNanoseconds(now),
+    .traceID     = traceID,
+    .point       = point,
+    .value       = value,
+  };
+  // The event must be complete before the head shows it is there.
+  smp_wmb();
+  atomic64_set(&ring->head, head + 1);
+}
+
+/**
+ * Append formatted text to a dump buffer, writing the buffer out to the
+ * dump file first if it is nearly full.
+ *
+ * @param fd      The dump file
+ * @param buffer  The dump buffer
+ * @param length  The length of the text in the buffer
+ * @param format  The format of the text to append
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+__attribute__((format(printf, 4, 5)))
+static int appendToDump(int           fd,
+                        char         *buffer,
+                        size_t       *length,
+                        const char   *format,
+                        ...)
+{
+  if (*length + TRACE_DUMP_MAX_RECORD > TRACE_DUMP_BUFFER_SIZE) {
+    int result = writeBuffer(fd, buffer, *length);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    *length = 0;
+  }
+
+  va_list args;
+  va_start(args, format);
+  int count = vsnprintf(buffer + *length, TRACE_DUMP_MAX_RECORD, format,
+                        args);
+  va_end(args);
+  if (count > 0) {
+    *length += minSizeT((size_t) count, TRACE_DUMP_MAX_RECORD - 1);
+  }
+  return UDS_SUCCESS;
+}
+
+/**
+ * Write the events of one ring to a dump.
+ *
+ * @param fd        The dump file
+ * @param buffer    The dump buffer
+ * @param length    The length of the text in the buffer
+ * @param ring      The ring to dump
+ * @param snapshot  An array of TRACE_RING_CAPACITY events to copy into
+ * @param first     Whether no event has been written to the dump yet
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int dumpRing(int         fd,
+                    char       *buffer,
+                    size_t     *length,
+                    TraceRing  *ring,
+                    TraceEvent *snapshot,
+                    bool       *first)
+{
+  // Copy the ring while its thread may still be recording, then keep only
+  // the events which cannot have been overwritten during the copy.
+  uint64_t head = atomic64_read(&ring->head);
+  smp_rmb();
+  uint64_t start = ((head > TRACE_RING_CAPACITY)
+                    ? head - TRACE_RING_CAPACITY : 0);
+  for (uint64_t i = start; i < head; i++) {
+    snapshot[i % TRACE_RING_CAPACITY] = ring->events[i % TRACE_RING_CAPACITY];
+  }
+  smp_rmb();
+  uint64_t newHead = atomic64_read(&ring->head);
+  if (newHead >= start + TRACE_RING_CAPACITY) {
+    start = newHead - TRACE_RING_CAPACITY + 1;
+  }
+
+  int pid = getpid();
+  int result = appendToDump(fd, buffer, length,
+                            "%s\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                            "\"pid\":%d,\"tid\":%d,"
+                            "\"args\":{\"name\":\"%s\"}}",
+                            (*first ? "" : ","), pid, ring->threadId,
+                            ring->threadName);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  *first = false;
+
+  for (uint64_t i = start; i < head; i++) {
+    const TraceEvent *event = &snapshot[i % TRACE_RING_CAPACITY];
+    if (event->point >= TRACE_POINT_COUNT) {
+      continue;
+    }
+    result = appendToDump(fd, buffer, length,
+                          ",\n{\"name\":\"%s\",\"cat\":\"uds\",\"ph\":\"n\","
+                          "\"id\":\"%" PRIx64 "\",\"pid\":%d,\"tid\":%d,"
+                          "\"ts\":%" PRIu64 ".%03u,"
+                          "\"args\":{\"value\":%u}}",
+                          TRACE_POINT_NAMES[event->point], event->traceID,
+                          pid, ring->threadId, event->nanoseconds / 1000,
+                          (unsigned int) (event->nanoseconds % 1000),
+                          event->value);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+int udsDumpRequestTrace(const char *path)
+{
+  int result = performOnce(&traceOnce, initTraceKey);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  if (!traceKeyValid) {
+    return UDS_ENOTHREADS;
+  }
+
+  char *buffer;
+  result = ALLOCATE(TRACE_DUMP_BUFFER_SIZE, char, "trace dump buffer",
+                    &buffer);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  TraceEvent *snapshot;
+  result = ALLOCATE(TRACE_RING_CAPACITY, TraceEvent, "trace dump snapshot",
+                    &snapshot);
+  if (result != UDS_SUCCESS) {
+    FREE(buffer);
+    return result;
+  }
+
+  int fd;
+  result = openFile(path, FU_CREATE_WRITE_ONLY, &fd);
+  if (result != UDS_SUCCESS) {
+    FREE(snapshot);
+    FREE(buffer);
+    return logErrorWithStringError(result, "cannot open trace dump %s",
+                                   path);
+  }
+
+  size_t length = 0;
+  bool first = true;
+  result = appendToDump(fd, buffer, &length, "{\"traceEvents\":[");
+  lockMutex(&ringsMutex);
+  for (TraceRing *ring = rings;
+       (ring != NULL) && (result == UDS_SUCCESS);
+       ring = ring->next) {
+    if (atomic64_read(&ring->head) > 0) {
+      result = dumpRing(fd, buffer, &length, ring, snapshot, &first);
+    }
+  }
+  unlockMutex(&ringsMutex);
+  if (result == UDS_SUCCESS) {
+    result = appendToDump(fd, buffer, &length, "\n]}\n");
+  }
+  if (result == UDS_SUCCESS) {
+    result = writeBuffer(fd, buffer, length);
+  }
+  if (result == UDS_SUCCESS) {
+    result = closeFile(fd, "cannot close trace dump");
+  } else {
+    tryCloseFile(fd);
+  }
+
+  FREE(snapshot);
+  FREE(buffer);
+  return result;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/requestTrace.h#1 $
+ */
+
+#ifndef REQUEST_TRACE_H
+#define REQUEST_TRACE_H
+
+#include "compiler.h"
+#include "request.h"
+#include "typeDefs.h"
+
+/**
+ * The points in the life of a client request at which a trace event may be
+ * recorded.
+ **/
+typedef enum {
+  /* put on a request queue; the value is the RequestStage */
+  TRACE_ENQUEUE,
+  /* taken from a request queue by its worker thread */
+  TRACE_DEQUEUE,
+  /* looked up in the master index; the value is 1 if an entry was found */
+  TRACE_MASTER_INDEX_PROBE,
+  /* searched in the sparse cache; the value is 1 if the name was found */
+  TRACE_SPARSE_CACHE,
+  /* queued to read a volume page; the value is the physical page */
+  TRACE_PAGE_CACHE_MISS,
+  /* restarted after a volume page read; the value is the physical page */
+  TRACE_READ_COMPLETE,
+  /* handed to the client callback; the value is the request status */
+  TRACE_CALLBACK,
+  TRACE_POINT_COUNT,
+} RequestTracePoint;
+
+/**
+ * Get the trace identifier for a new client request.
+ *
+ * @return a new identifier if the UDS_REQUEST_TRACING parameter is set, or
+ *         zero if requests are not being traced
+ **/
+uint64_t newRequestTraceID(void);
+
+/**
+ * Record a trace event in the ring of the calling thread.
+ *
+ * @param traceID  The identifier of the traced request
+ * @param point    The trace point reached
+ * @param value    A value describing the event
+ **/
+void recordRequestTrace(uint64_t          traceID,
+                        RequestTracePoint point,
+                        uint32_t          value);
+
+/**
+ * Record a trace event for a request if the request is being traced. This
+ * is cheap enough to leave in the request path when tracing is disabled.
+ *
+ * @param request  The request
+ * @param point    The trace point reached
+ * @param value    A value describing the event
+ **/
+static INLINE void traceRequest(const Request     *request,
+                                RequestTracePoint  point,
+                                uint32_t           value)
+{
+  if (unlikely(request->traceID != 0)) {
+    recordRequestTrace(request->traceID, point, value);
+  }
+}
+
+#endif /* REQUEST_TRACE_H */
@@ -202,8 +202,9 @@ static INLINE uint8_t rotateSearchList(SearchList *searchList,
  * skippable, and dead--while maintaining the LRU ordering that already
  * existed (a stable sort).
  *
- * This operation must only be called during the critical section in
- * updateSparseCache() since it effectively changes cache membership.
+ * This operation must only be called by updateSparseCache() on the list
+ * that will become the next cache directory, since it effectively changes
+ * cache membership.
  *
  * @param searchList            the chapter index search list to purge
  * @param chapters              the chapter index cache entries
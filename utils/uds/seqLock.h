@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/seqLock.h#1 $
+ */
+
+#ifndef SEQ_LOCK_H
+#define SEQ_LOCK_H
+
+#include "atomicDefs.h"
+#include "compiler.h"
+#include "threads.h"
+#include "typeDefs.h"
+
+/**
+ * A sequence lock lets readers examine data without writing to any shared
+ * memory. Writers serialize on a mutex and increment the sequence number
+ * both before and after they modify the protected data, so the sequence is
+ * odd exactly while a write is in progress. A reader notes the sequence
+ * before it copies the data and checks it again afterwards; if a writer
+ * began or was active in the meantime, the copy may be inconsistent and the
+ * reader must discard it and try again.
+ *
+ * Readers must therefore only copy the protected data before validating
+ * it, never follow pointers or make decisions on it, and must tolerate
+ * seeing values that are torn or out of range.
+ **/
+typedef struct seqLock {
+  Mutex    mutex;     // Serializes the writers
+  atomic_t sequence;  // Odd while a writer is modifying the data
+} SeqLock;
+
+/**
+ * Initialize a sequence lock.
+ *
+ * @param lock  The lock to initialize
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static INLINE int initSeqLock(SeqLock *lock)
+{
+  atomic_set(&lock->sequence, 0);
+  return initMutex(&lock->mutex);
+}
+
+/**
+ * Destroy a sequence lock.
+ *
+ * @param lock  The lock to destroy
+ **/
+static INLINE void destroySeqLock(SeqLock *lock)
+{
+  destroyMutex(&lock->mutex);
+}
+
+/**
+ * Acquire a sequence lock for writing, excluding other writers and marking
+ * the protected data as being in flux for readers.
+ *
+ * @param lock  The lock to acquire
+ **/
+static INLINE void writeLockSeqLock(SeqLock *lock)
+{
+  lockMutex(&lock->mutex);
+  atomic_set(&lock->sequence, atomic_read(&lock->sequence) + 1);
+  // The odd sequence must be visible before any of the modifications.
+  smp_wmb();
+}
+
+/**
+ * Release a sequence lock acquired by writeLockSeqLock().
+ *
+ * @param lock  The lock to release
+ **/
+static INLINE void writeUnlockSeqLock(SeqLock *lock)
+{
+  // All of the modifications must be visible before the even sequence.
+  smp_wmb();
+  atomic_set(&lock->sequence, atomic_read(&lock->sequence) + 1);
+  unlockMutex(&lock->mutex);
+}
+
+/**
+ * Acquire a sequence lock for reading by excluding writers, for a reader
+ * which has failed to complete an optimistic read.
+ *
+ * @param lock  The lock to acquire
+ **/
+static INLINE void readLockSeqLock(SeqLock *lock)
+{
+  lockMutex(&lock->mutex);
+}
+
+/**
+ * Release a sequence lock acquired by readLockSeqLock().
+ *
+ * @param lock  The lock to release
+ **/
+static INLINE void readUnlockSeqLock(SeqLock *lock)
+{
+  unlockMutex(&lock->mutex);
+}
+
+/**
+ * Begin an optimistic read of the data protected by a sequence lock.
+ *
+ * @param [in]  lock      The lock
+ * @param [out] sequence  The sequence to pass to endReadSeqLock()
+ *
+ * @return true if no write was in progress, so that the read may proceed;
+ *         false if the caller should retry or fall back to the mutex
+ **/
+static INLINE bool beginReadSeqLock(const SeqLock *lock, int *sequence)
+{
+  *sequence = atomic_read(&lock->sequence);
+  // The sequence must be read before any of the protected data.
+  smp_rmb();
+  return ((*sequence & 1) == 0);
+}
+
+/**
+ * Finish an optimistic read of the data protected by a sequence lock.
+ *
+ * @param lock      The lock
+ * @param sequence  The sequence returned by beginReadSeqLock()
+ *
+ * @return true if no writer intervened and the data read is consistent
+ **/
+static INLINE bool endReadSeqLock(const SeqLock *lock, int sequence)
+{
+  // All reads of the protected data must complete before the sequence is
+  // checked again.
+  smp_rmb();
+  return (atomic_read(&lock->sequence) == sequence);
+}
+
+#endif /* SEQ_LOCK_H */
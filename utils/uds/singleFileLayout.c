@@ -28,6 +28,7 @@
 #include "buffer.h"
 #include "bufferedReaderInternals.h"
 #include "bufferedWriterInternals.h"
+#include "cacheHotSet.h"
 #include "compiler.h"
 #include "config.h"
 #include "indexConfig.h"
@@ -55,6 +56,18 @@ enum {
   SINGLE_FILE_MAGIC_1_LENGTH = sizeof(SINGLE_FILE_MAGIC_1),
 };
 
+/*
+ * Version 1 super blocks describe the fixed layout computed by
+ * udsComputeIndexSize().  Version 2 super blocks describe a layout which
+ * was created with enough extra space to give each save a cache hot set
+ * region, and record the size of that region in what was alignment padding
+ * in version 1.
+ */
+enum {
+  SUPER_BLOCK_VERSION         = 1,
+  SUPER_BLOCK_VERSION_HOT_SET = 2,
+};
+
 /*****************************************************************************/
 static INLINE uint64_t blockCount(uint64_t bytes, uint32_t blockSize)
 {
@@ -115,6 +128,30 @@ static int computeSizes(SaveLayoutSizes        *sls,
   return UDS_SUCCESS;
 }
 
+/*****************************************************************************/
+/**
+ * Add a cache hot set region to each save of a layout if the space given for
+ * the layout exceeds the fixed layout by enough to hold them.  The hot set is
+ * never part of the size computed by udsComputeIndexSize().
+ *
+ * @param sls      the layout sizes, which will be updated if there is room
+ * @param newSize  the number of blocks available for the layout
+ **/
+static void addHotSetToSizes(SaveLayoutSizes *sls, uint64_t newSize)
+{
+  uint64_t hotSetBlocks = blockCount(computeSavedCacheHotSetSize(),
+                                     sls->blockSize);
+  uint64_t extraBlocks = sls->numSaves * hotSetBlocks;
+  if (newSize < sls->totalBlocks + extraBlocks) {
+    return;
+  }
+
+  sls->hotSetBlocks    = hotSetBlocks;
+  sls->saveBlocks     += hotSetBlocks;
+  sls->subIndexBlocks += extraBlocks;
+  sls->totalBlocks    += extraBlocks;
+}
+
 /*****************************************************************************/
 static void recomputeSizes(SaveLayoutSizes *sls, uint64_t newSize)
 {
@@ -407,7 +444,12 @@ static int decodeSuperBlockData(Buffer *buffer, SuperBlockData *super)
   if (result != UDS_SUCCESS) {
     return result;
   }
-  result = skipForward(buffer, 4);      // aligment
+  if (super->version >= SUPER_BLOCK_VERSION_HOT_SET) {
+    result = getUInt32LEFromBuffer(buffer, &super->hotSetBlocks);
+  } else {
+    super->hotSetBlocks = 0;
+    result = skipForward(buffer, 4);      // aligment
+  }
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -473,7 +515,8 @@ static int readSuperBlockData(BufferedReader *reader,
                                    "unknown superblock magic label");
   }
 
-  if (super->version != 1) {
+  if ((super->version != SUPER_BLOCK_VERSION)
+      && (super->version != SUPER_BLOCK_VERSION_HOT_SET)) {
     return logErrorWithStringError(UDS_UNSUPPORTED_VERSION,
                                    "unknown superblock version number %"
                                    PRIu32,
@@ -750,7 +793,8 @@ static void populateIndexSaveLayout(IndexSaveLayout *isl,
 
   uint64_t blocksAvail = (isl->indexSave.numBlocks -
                           (nextBlock - isl->indexSave.startBlock) -
-                          super->openChapterBlocks);
+                          super->openChapterBlocks -
+                          super->hotSetBlocks);
 
   if (numZones > 0) {
     uint64_t miBlockCount = blocksAvail / numZones;
@@ -764,6 +808,12 @@ static void populateIndexSaveLayout(IndexSaveLayout *isl,
     setupLayout(isl->openChapter, &nextBlock, super->openChapterBlocks,
                 RL_KIND_OPEN_CHAPTER, RL_SOLE_INSTANCE);
   }
+  if (saveType == IS_SAVE && super->hotSetBlocks > 0) {
+    setupLayout(&isl->hotSet, &nextBlock, super->hotSetBlocks,
+                RL_KIND_CACHE_HOT_SET, RL_SOLE_INSTANCE);
+  } else {
+    memset(&isl->hotSet, 0, sizeof(isl->hotSet));
+  }
   setupLayout(&isl->freeSpace, &nextBlock,
               (isl->indexSave.numBlocks -
                (nextBlock - isl->indexSave.startBlock)),
@@ -778,6 +828,7 @@ static int reconstructIndexSave(IndexSaveLayout *isl,
                                 RegionTable     *table)
 {
   isl->numZones = 0;
+  memset(&isl->hotSet, 0, sizeof(isl->hotSet));
   isl->saveData = *saveData;
   isl->read     = false;
   isl->written  = false;
@@ -841,6 +892,10 @@ static int reconstructIndexSave(IndexSaveLayout *isl,
   if (isl->saveType == IS_SAVE) {
     expectLayout(true, isl->openChapter, &iter, 0,
                  RL_KIND_OPEN_CHAPTER, RL_SOLE_INSTANCE);
+    if (super->version >= SUPER_BLOCK_VERSION_HOT_SET) {
+      expectLayout(false, &isl->hotSet, &iter, 0,
+                   RL_KIND_CACHE_HOT_SET, RL_SOLE_INSTANCE);
+    }
   }
   if (!expectLayout(false, &isl->freeSpace, &iter, 0,
                     RL_KIND_SCRATCH, RL_SOLE_INSTANCE))
@@ -1025,6 +1080,7 @@ static void generateSuperBlockData(size_t          blockSize,
                                    unsigned int    maxSaves,
                                    uint64_t        openChapterBlocks,
                                    uint64_t        pageMapBlocks,
+                                   uint64_t        hotSetBlocks,
                                    SuperBlockData *super)
 {
   memset(super, 0, sizeof(*super));
@@ -1033,12 +1089,15 @@ static void generateSuperBlockData(size_t          blockSize,
 
   super->nonce             = generateMasterNonce(super->nonceInfo,
                                                  sizeof(super->nonceInfo));
-  super->version           = 1;
+  super->version           = ((hotSetBlocks > 0)
+                              ? SUPER_BLOCK_VERSION_HOT_SET
+                              : SUPER_BLOCK_VERSION);
   super->blockSize         = blockSize;
   super->numIndexes        = 1;
   super->maxSaves          = maxSaves;
   super->openChapterBlocks = openChapterBlocks;
   super->pageMapBlocks     = pageMapBlocks;
+  super->hotSetBlocks      = hotSetBlocks;
 }
 
 /*****************************************************************************/
@@ -1172,7 +1231,7 @@ static int initSingleFileLayout(SingleFileLayout *sfl,
   }
 
   generateSuperBlockData(sls->blockSize, sls->numSaves, sls->openChapterBlocks,
-                         sls->pageMapBlocks, &sfl->super);
+                         sls->pageMapBlocks, sls->hotSetBlocks, &sfl->super);
 
   result = allocateSingleFileParts(sfl, &sfl->super);
   if (result != UDS_SUCCESS) {
@@ -1474,7 +1533,11 @@ static int encodeSuperBlockData(Buffer *buffer, SuperBlockData *super)
   if (result != UDS_SUCCESS) {
     return result;
   }
-  result = zeroBytes(buffer, 4);      // aligment
+  if (super->version >= SUPER_BLOCK_VERSION_HOT_SET) {
+    result = putUInt32LEIntoBuffer(buffer, super->hotSetBlocks);
+  } else {
+    result = zeroBytes(buffer, 4);      // aligment
+  }
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -2156,6 +2219,9 @@ static int makeIndexSaveRegionTable(IndexSaveLayout  *isl,
     isl->numZones +             // master index zones
     (bool) isl->openChapter;    // open chapter if needed
 
+  if (isl->hotSet.numBlocks > 0) {
+    numRegions++;
+  }
   if (isl->freeSpace.numBlocks > 0) {
     numRegions++;
   }
@@ -2176,6 +2242,9 @@ static int makeIndexSaveRegionTable(IndexSaveLayout  *isl,
   if (isl->openChapter) {
     *lr++ = *isl->openChapter;
   }
+  if (isl->hotSet.numBlocks > 0) {
+    *lr++ = isl->hotSet;
+  }
   if (isl->freeSpace.numBlocks > 0) {
     *lr++ = isl->freeSpace;
   }
@@ -2422,6 +2491,9 @@ int createSingleFileLayout(IORegion                *region,
                                    size, sizes.blockSize);
   }
 
+  if (size > sizes.totalBlocks * sizes.blockSize) {
+    addHotSetToSizes(&sizes, size / sizes.blockSize);
+  }
   if (size > sizes.totalBlocks * sizes.blockSize) {
     recomputeSizes(&sizes, size / sizes.blockSize);
   }
@@ -96,6 +96,7 @@ typedef struct indexSaveLayout {
   LayoutRegion     freeSpace;
   LayoutRegion    *masterIndexZones;
   LayoutRegion    *openChapter;
+  LayoutRegion     hotSet;
   IndexSaveType    saveType;
   IndexSaveData    saveData;
   Buffer          *indexStateBuffer;
@@ -114,10 +115,11 @@ typedef struct superBlockData_v1 {
   byte       magicLabel[32];
   byte       nonceInfo[32];
   uint64_t   nonce;
-  uint32_t   version;                   // 1
+  uint32_t   version;                   // 1, or 2 with a hot set
   uint32_t   blockSize;                 // for verification
   uint16_t   numIndexes;                // 1
   uint16_t   maxSaves;
+  uint32_t   hotSetBlocks;              // version 2 only, else padding
   uint64_t   openChapterBlocks;
   uint64_t   pageMapBlocks;
 } SuperBlockData;
@@ -155,6 +157,7 @@ typedef struct saveLayoutSizes {
   uint64_t      masterIndexBlocks;      // per save
   uint64_t      pageMapBlocks;          // per save
   uint64_t      openChapterBlocks;      // per save
+  uint64_t      hotSetBlocks;           // per save
   uint64_t      saveBlocks;             // per sub-index
   uint64_t      subIndexBlocks;         // per sub-index
   uint64_t      totalBlocks;            // for whole layout
@@ -27,45 +27,43 @@
  * allows the LRU order to be maintained by shifting entries in an array list.
  *
  * The most important property of this cache is the absence of synchronization
- * for read operations. Safe concurrent access to the cache by the zone
- * threads is controlled by the triage queue and the barrier requests it
- * issues to the zone queues. The set of cached chapters does not and must not
- * change between the carefully coordinated calls to updateSparseCache() from
- * the zone threads.
+ * for read operations. The set of cached chapters is described by a
+ * directory: a versioned search list naming the cache entries that are
+ * members of the cache. Directories are copy-on-write. A zone thread which
+ * needs a chapter that is not cached takes the update mutex, reads the
+ * chapter index into the one cache entry that no directory names (the spare),
+ * builds a new directory naming it in place of the evicted entry, and
+ * publishes that directory with a single pointer store. The evicted entry
+ * becomes the new spare. The other zone threads never wait for an update;
+ * they keep searching whichever directory they find when they start a search.
  *
- * The critical invariant for that coordination is the cache membership must
- * not change between those updates; the calls to sparseCacheContains() from
- * the zone threads must all receive the same results for any virtual chapter
- * number. To ensure that critical invariant, state changes such as "that
- * virtual chapter is no longer in the volume" and "skip searching that
- * chapter because it has had too many cache misses" are represented
- * separately from the cache membership information (the virtual chapter
- * number).
+ * The spare entry and the unpublished directory are reclaimed by epoch. Each
+ * search records the cache epoch in a per-zone slot before it loads the
+ * directory pointer, and clears the slot when it is done. Every publication
+ * advances the epoch. Before the next update overwrites the spare entry or
+ * the old directory, it waits for every zone to be either idle or searching
+ * with an epoch at least as new as the last publication, at which point no
+ * search can still be using them. Searches never block, so this wait is
+ * short, and it usually finds nothing to wait for since updates are far
+ * apart.
  *
- * As a result of this invariant, we have the guarantee that every zone thread
- * will call updateSparseCache() once and exactly once to request a chapter
- * that is not in the cache, and the serialization of the barrier requests
- * from the triage queue ensures they will all request the same chapter
- * number. This means the only synchronization we need can be provided by a
- * pair of thread barriers used only in the updateSparseCache() call,
- * providing a critical section where a single zone thread can drive the cache
- * update while all the other zone threads are known to be blocked, waiting in
- * the second barrier. Outside that critical section, all the zone threads
- * implicitly hold a shared lock. Inside it, the "captain" (the thread that
- * was uniquely flagged when passing through the first barrier) holds an
- * exclusive lock. No other threads may access or modify the cache, except for
- * accessing cache statistics and similar queries.
+ * Unlike the rendezvous it replaces, this means different zones may briefly
+ * disagree about which chapters are cached. That is harmless: each zone
+ * requests any chapter it needs through its own sparse cache message, and a
+ * chapter evicted between a zone's membership check and its search merely
+ * costs that search a possible deduplication.
  *
  * Cache statistics must only be modified by a single thread, conventionally
- * the zone zero thread. All fields that might be frequently updated by that
- * thread are kept in separate cache-aligned structures so they will not cause
+ * the zone zero thread, except for the eviction counts, which are modified
+ * only under the update mutex. All fields that might be frequently updated
+ * are kept in separate cache-aligned structures so they will not cause
  * cache contention via "false sharing" with the fields that are frequently
  * accessed by all of the zone threads.
  *
- * LRU order is kept independently by each zone thread, and each zone uses its
- * own list for searching and cache membership queries. The zone zero list is
- * used to decide which chapter to evict when the cache is updated, and its
- * search list is copied to the other threads at that time.
+ * LRU order is kept independently by each zone thread in a private copy of
+ * the directory's search list, which is refreshed whenever the zone sees a
+ * new directory version. The updating zone's order decides which chapter to
+ * evict, and becomes the order of the new directory.
  *
  * The virtual chapter number field of the cache entry is the single field
  * indicating whether a chapter is a member of the cache or not. The value
@@ -73,19 +71,18 @@
  * chapter number. When present in the virtual chapter number field
  * CachedChapterIndex, it indicates that the cache entry is dead, and all
  * the other fields of that entry (other than immutable pointers to cache
- * memory) are undefined and irrelevant. Any cache entry that is not marked as
- * dead is fully defined and a member of the cache--sparseCacheContains()
- * must always return true for any virtual chapter number that appears in any
- * of the cache entries.
+ * memory) are undefined and irrelevant. The fields of an entry named by a
+ * published directory never change except for its search statistics and the
+ * skipSearch flag.
  *
  * A chapter index that is a member of the cache may be marked for different
- * treatment (disabling search) between calls to updateSparseCache() in two
- * different ways. When a chapter falls off the end of the volume, its virtual
- * chapter number will be less that the oldest virtual chapter number. Since
- * that chapter is no longer part of the volume, there's no point in continuing
- * to search that chapter index. Once invalidated, that virtual chapter will
- * still be considered a member of the cache, but it will no longer be searched
- * for matching chunk names.
+ * treatment (disabling search) between cache updates in two different ways.
+ * When a chapter falls off the end of the volume, its virtual chapter number
+ * will be less that the oldest virtual chapter number. Since that chapter is
+ * no longer part of the volume, there's no point in continuing to search that
+ * chapter index. Once invalidated, that virtual chapter will still be
+ * considered a member of the cache, but it will no longer be searched for
+ * matching chunk names.
  *
  * The second mechanism for disabling search is the heuristic based on keeping
  * track of the number of consecutive search misses in a given chapter index.
@@ -93,26 +90,32 @@
  * true, causing the chapter to be skipped in the fallback search of the
  * entire cache, but still allowing it to be found when searching for a hook
  * in that specific chapter. Finding a hook will clear the skipSearch flag,
- * once again allowing the non-hook searches to use the cache entry. Again,
- * regardless of the state of the skipSearch flag, the virtual chapter must
- * still considered to be a member of the cache for sparseCacheContains().
+ * once again allowing the non-hook searches to use the cache entry.
  *
- * Barrier requests and the sparse chapter index cache are also described in
- *
- * https://intranet.permabit.com/wiki/Chapter_Index_Cache_supports_concurrent_access
- *
- * and in a message to the albireo mailing list on 5/28/2011 titled "true
- * barriers with a hook resolution queue".
+ * If UDS_DECODE_SPARSE_CACHE is set, the cache also holds a few decoded
+ * chapter indexes, one for every DECODED_CHAPTER_RATIO entries, which are
+ * lent to the entries with the most search hits. Lending one is like a
+ * publication: the decoded form is filled in while no entry points at it,
+ * and is stored in the entry with a single pointer store. Taking one back
+ * clears that pointer and advances the epoch, and the decoded form is not
+ * reused until every search which might have seen the old pointer is done.
+ * Both happen under the update mutex, when a chapter is added to the cache
+ * or when zone zero finds that an entry without a decoded form has become
+ * hot.
  **/
 
 #include "sparseCache.h"
 
+#include "atomicDefs.h"
 #include "cachedChapterIndex.h"
 #include "chapterIndex.h"
 #include "common.h"
+#include "featureDefs.h"
 #include "index.h"
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "numeric.h"
+#include "parameter.h"
 #include "permassert.h"
 #include "searchList.h"
 #include "threads.h"
@@ -123,7 +126,19 @@ enum {
   SKIP_SEARCH_THRESHOLD = 20000,
 
   /** a named constant to use when identifying zone zero */
-  ZONE_ZERO = 0
+  ZONE_ZERO = 0,
+
+  /** the epoch slot value of a zone which is not searching the cache */
+  ZONE_IDLE = 0,
+
+  /** the number of cache entries for each decoded chapter index */
+  DECODED_CHAPTER_RATIO = 4,
+
+  /** the search hits needed before an entry is worth decoding */
+  HOT_CHAPTER_HITS = 64,
+
+  /** zone zero looks for a hot entry to decode every this many hits */
+  HOT_CHAPTER_CHECK_INTERVAL = 1024,
 };
 
 /**
@@ -152,11 +167,38 @@ typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) sparseCacheCounters {
   uint64_t      evictions;
 } SparseCacheCounters;
 
+/**
+ * A published description of the cache membership. A directory is never
+ * modified while it is published, or while any search may still be using it.
+ **/
+typedef struct sparseCacheDirectory {
+  /** the number of times a directory has been published before this one */
+  uint64_t    version;
+
+  /** the member cache entries, in LRU order */
+  SearchList *searchList;
+} SparseCacheDirectory;
+
+/**
+ * The per-zone search state. Each zone gets its own cache line since the
+ * epoch slot is written by every search.
+ **/
+typedef struct __attribute__((aligned(CACHE_LINE_BYTES))) zoneSearchState {
+  /** the epoch in which the current search started, or ZONE_IDLE */
+  atomic64_t  epoch;
+
+  /** the version of the directory the private search list was copied from */
+  uint64_t    version;
+
+  /** the zone's private chapter search order */
+  SearchList *searchList;
+} ZoneSearchState;
+
 /**
  * This is the private structure definition of a SparseCache.
  **/
 struct sparseCache {
-  /** the number of cache entries, which is the size of the chapters array */
+  /** the number of cache entries named by each directory */
   unsigned int           capacity;
 
   /** the number of zone threads using the cache */
@@ -168,20 +210,87 @@ struct sparseCache {
   /** the number of search misses in zone zero that will disable searching */
   unsigned int           skipSearchThreshold;
 
-  /** pointers to the cache-aligned chapter search order for each zone */
-  SearchList            *searchLists[MAX_ZONES];
+  /** the number of decoded chapter indexes lent to the hottest entries */
+  unsigned int           decodedCount;
+
+  /** serializes cache updates, and protects the fields below it */
+  Mutex                  updateMutex;
+
+  /** the decoded chapter indexes */
+  DecodedChapterIndex   *decoded;
+
+  /** the cache entry each decoded chapter index is lent to, or NULL */
+  CachedChapterIndex   **decodedOwners;
+
+  /** the entry in the chapters array which no directory names */
+  uint8_t                spare;
+
+  /** the epoch after which the spare and the old directory are unused */
+  uint64_t               retireEpoch;
+
+  /** the two directories, one published and one being rebuilt */
+  SparseCacheDirectory   directories[2];
 
-  /** the thread barriers used to synchronize the zone threads for update */
-  Barrier                beginCacheUpdate;
-  Barrier                endCacheUpdate;
+  /** the published directory */
+  SparseCacheDirectory  *directory;
+
+  /** the reclamation epoch, advanced by each directory publication */
+  atomic64_t             epoch;
+
+  /** the search state of each zone (cache-aligned) */
+  ZoneSearchState        zones[MAX_ZONES];
 
   /** frequently-updated counter fields (cache-aligned) */
   SparseCacheCounters    counters;
 
-  /** the counted array of chapter index cache entries (cache-aligned) */
+  /** the chapter index cache entries, one more than the capacity */
   CachedChapterIndex     chapters[];
 };
 
+/**********************************************************************/
+static UdsParameterValue getDefaultDecodeSparseCache(void)
+{
+#if ENVIRONMENT
+  char *env = getenv(UDS_DECODE_SPARSE_CACHE);
+  if (env != NULL) {
+    UdsParameterValue tmp = {
+      .type = UDS_PARAM_TYPE_STRING,
+      .value.u_string = env,
+    };
+    UdsParameterValue value;
+    if (validateBoolean(&tmp, NULL, &value) == UDS_SUCCESS) {
+      return value;
+    }
+  }
+#endif // ENVIRONMENT
+  return UDS_PARAM_FALSE;
+}
+
+/**********************************************************************/
+int defineDecodeSparseCache(ParameterDefinition *pd)
+{
+  pd->validate       = validateBoolean;
+  pd->validationData = NULL;
+  pd->currentValue   = getDefaultDecodeSparseCache();
+  pd->update         = NULL;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Check whether sparse caches should keep decoded chapter indexes.
+ *
+ * @return the value of the UDS_DECODE_SPARSE_CACHE parameter
+ **/
+static bool shouldDecodeSparseCache(void)
+{
+  UdsParameterValue value;
+  if ((udsGetParameter(UDS_DECODE_SPARSE_CACHE, &value) == UDS_SUCCESS)
+      && (value.type == UDS_PARAM_TYPE_BOOL)) {
+    return value.value.u_bool;
+  }
+  return false;
+}
+
 /**
  * Initialize a sparse chapter index cache.
  *
@@ -206,24 +315,54 @@ static int initializeSparseCache(SparseCache    *cache,
   // chapter search misses only in zone zero.
   cache->skipSearchThreshold = (SKIP_SEARCH_THRESHOLD / zoneCount);
 
-  int result = initializeBarrier(&cache->beginCacheUpdate, zoneCount);
+  int result = initMutex(&cache->updateMutex);
   if (result != UDS_SUCCESS) {
     return result;
   }
-  result = initializeBarrier(&cache->endCacheUpdate, zoneCount);
-  if (result != UDS_SUCCESS) {
-    return result;
-  }
-  for (unsigned int i = 0; i < capacity; i++) {
+  for (unsigned int i = 0; i <= capacity; i++) {
     result = initializeCachedChapterIndex(&cache->chapters[i], geometry);
     if (result != UDS_SUCCESS) {
       return result;
     }
   }
 
+  if (shouldDecodeSparseCache()) {
+    unsigned int count = maxUInt(1, capacity / DECODED_CHAPTER_RATIO);
+    result = ALLOCATE(count, DecodedChapterIndex, "decoded chapter indexes",
+                      &cache->decoded);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    cache->decodedCount = count;
+    result = ALLOCATE(count, CachedChapterIndex *, "decoded chapter owners",
+                      &cache->decodedOwners);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+      result = initializeDecodedChapterIndex(&cache->decoded[i], geometry);
+      if (result != UDS_SUCCESS) {
+        return result;
+      }
+    }
+  }
+
+  // Every directory starts out naming the first capacity entries, all dead,
+  // so the last entry is the spare.
+  for (unsigned int i = 0; i < 2; i++) {
+    result = makeSearchList(capacity, &cache->directories[i].searchList);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+  cache->spare       = capacity;
+  cache->directory   = &cache->directories[0];
+  cache->retireEpoch = 1;
+  atomic64_set(&cache->epoch, 1);
+
   // Allocate each zone's independent LRU order.
   for (unsigned int i = 0; i < zoneCount; i++) {
-    result = makeSearchList(capacity, &cache->searchLists[i]);
+    result = makeSearchList(capacity, &cache->zones[i].searchList);
     if (result != UDS_SUCCESS) {
       return result;
     }
@@ -237,8 +376,15 @@ int makeSparseCache(const Geometry  *geometry,
                     unsigned int     zoneCount,
                     SparseCache    **cachePtr)
 {
+  if (capacity >= UINT8_MAX) {
+    // The spare entry number must also fit in a search list entry.
+    return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                   "sparse cache capacity %u is too large",
+                                   capacity);
+  }
+
   unsigned int bytes
-    = (sizeof(SparseCache) + (capacity * sizeof(CachedChapterIndex)));
+    = (sizeof(SparseCache) + ((capacity + 1) * sizeof(CachedChapterIndex)));
 
   SparseCache *cache;
   int result = allocateCacheAligned(bytes, "sparse cache", &cache);
@@ -262,7 +408,9 @@ size_t getSparseCacheMemorySize(const SparseCache *cache)
   // Count the ChapterIndexPage as cache memory, but ignore all other overhead.
   size_t pageSize = (sizeof(ChapterIndexPage) + cache->geometry->bytesPerPage);
   size_t chapterSize = (pageSize * cache->geometry->indexPagesPerChapter);
-  return (cache->capacity * chapterSize);
+  return (((cache->capacity + 1) * chapterSize)
+          + (cache->decodedCount
+             * getDecodedChapterIndexSize(cache->geometry)));
 }
 
 /**
@@ -354,16 +502,25 @@ void freeSparseCache(SparseCache *cache)
   }
 
   for (unsigned int i = 0; i < cache->zoneCount; i++) {
-    freeSearchList(&cache->searchLists[i]);
+    freeSearchList(&cache->zones[i].searchList);
+  }
+  for (unsigned int i = 0; i < 2; i++) {
+    freeSearchList(&cache->directories[i].searchList);
   }
 
-  for (unsigned int i = 0; i < cache->capacity; i++) {
+  for (unsigned int i = 0; i <= cache->capacity; i++) {
     CachedChapterIndex *chapter = &cache->chapters[i];
     destroyCachedChapterIndex(chapter);
   }
+  if (cache->decoded != NULL) {
+    for (unsigned int i = 0; i < cache->decodedCount; i++) {
+      destroyDecodedChapterIndex(&cache->decoded[i]);
+    }
+    FREE(cache->decoded);
+  }
+  FREE(cache->decodedOwners);
 
-  destroyBarrier(&cache->beginCacheUpdate);
-  destroyBarrier(&cache->endCacheUpdate);
+  destroyMutex(&cache->updateMutex);
   FREE(cache);
 }
 
@@ -386,22 +543,192 @@ CacheCounters getSparseCacheCounters(const SparseCache *cache)
 }
 
 /**********************************************************************/
-bool sparseCacheContains(SparseCache  *cache,
-                         uint64_t      virtualChapter,
-                         unsigned int  zoneNumber)
+unsigned int getSparseCacheChapters(SparseCache  *cache,
+                                    uint64_t     *chapters,
+                                    unsigned int  maxChapters)
 {
-  /*
-   * The correctness of the barriers depends on the invariant that between
-   * calls to updateSparseCache(), the answers this function returns must
-   * never vary--the result for a given chapter must be identical across
-   * zones. That invariant must be maintained even if the chapter falls off
-   * the end of the volume, or if searching it is disabled because of too many
-   * search misses.
-   */
+  unsigned int count = 0;
+  lockMutex(&cache->updateMutex);
+  SearchListIterator iterator
+    = iterateSearchList(cache->directory->searchList, cache->chapters);
+  while (hasNextChapter(&iterator) && (count < maxChapters)) {
+    CachedChapterIndex *chapter = getNextChapter(&iterator);
+    if (chapter->virtualChapter != UINT64_MAX) {
+      chapters[count++] = chapter->virtualChapter;
+    }
+  }
+  unlockMutex(&cache->updateMutex);
+  return count;
+}
+
+/**
+ * Begin a search of the cache by a zone thread, making the zone's private
+ * search list reflect the currently published directory. The cache entries
+ * named by that list will not be reused until endSearch() is called.
+ *
+ * @param cache       the cache to be searched
+ * @param zoneNumber  the zone number of the calling thread
+ *
+ * @return the zone's search list
+ **/
+static SearchList *beginSearch(SparseCache *cache, unsigned int zoneNumber)
+{
+  ZoneSearchState *state = &cache->zones[zoneNumber];
+  atomic64_set(&state->epoch, atomic64_read(&cache->epoch));
+  // Publish our epoch before looking at the directory. This pairs with the
+  // barrier between publishing a directory and checking the zone epochs.
+  smp_mb();
+  const SparseCacheDirectory *directory = READ_ONCE(cache->directory);
+  smp_read_barrier_depends();
+  if (state->version != directory->version) {
+    copySearchList(directory->searchList, state->searchList);
+    state->version = directory->version;
+  }
+  return state->searchList;
+}
+
+/**
+ * End a search of the cache by a zone thread.
+ *
+ * @param cache       the cache which was searched
+ * @param zoneNumber  the zone number of the calling thread
+ **/
+static void endSearch(SparseCache *cache, unsigned int zoneNumber)
+{
+  // The release ensures our reads of the cache entries are complete before
+  // any updater can see that they may be reused.
+  atomic64_set_release(&cache->zones[zoneNumber].epoch, ZONE_IDLE);
+}
+
+/**
+ * Wait until no zone can still be searching the spare cache entry or the
+ * unpublished directory. Must be called with the update mutex held.
+ *
+ * @param cache  the cache being updated
+ **/
+static void waitForRetiredSearches(SparseCache *cache)
+{
+  smp_mb();
+  for (unsigned int zone = 0; zone < cache->zoneCount; zone++) {
+    for (;;) {
+      uint64_t epoch = atomic64_read_acquire(&cache->zones[zone].epoch);
+      if ((epoch == ZONE_IDLE) || (epoch >= cache->retireEpoch)) {
+        break;
+      }
+      yieldScheduler();
+    }
+  }
+}
+
+/**
+ * Take back the decoded chapter index lent to a cache entry, if any. Must be
+ * called with the update mutex held, and the decoded chapter index must not
+ * be reused until waitForRetiredSearches() has returned after the epoch is
+ * next advanced, unless no search can see the entry.
+ *
+ * @param cache    the cache being updated
+ * @param chapter  the entry to take the decoded chapter index from
+ **/
+static void reclaimDecodedChapter(SparseCache        *cache,
+                                  CachedChapterIndex *chapter)
+{
+  if (chapter->decoded == NULL) {
+    return;
+  }
+  unsigned int slot = chapter->decoded - cache->decoded;
+  cache->decodedOwners[slot] = NULL;
+  WRITE_ONCE(chapter->decoded, NULL);
+}
 
-  // Get the chapter search order for this zone thread.
+/**
+ * Lend a decoded chapter index to the hottest cache entry that has none, if
+ * one is free or if that entry has had many more search hits than the
+ * coldest entry that has one. At most one chapter is decoded per call. Must
+ * be called with the update mutex held.
+ *
+ * @param cache  the cache being updated
+ **/
+static void decodeHotChapter(SparseCache *cache)
+{
+  if (cache->decodedCount == 0) {
+    return;
+  }
+
+  // Find the hottest live entry which could use a decoded chapter index.
+  CachedChapterIndex *hottest = NULL;
+  uint64_t hottestHits = HOT_CHAPTER_HITS - 1;
   SearchListIterator iterator
-    = iterateSearchList(cache->searchLists[zoneNumber], cache->chapters);
+    = iterateSearchList(cache->directory->searchList, cache->chapters);
+  while (hasNextChapter(&iterator)) {
+    CachedChapterIndex *chapter = getNextChapter(&iterator);
+    uint64_t hits = READ_ONCE(chapter->counters.searchHits);
+    if ((chapter->virtualChapter != UINT64_MAX) && (chapter->decoded == NULL)
+        && !chapter->undecodable && (hits > hottestHits)) {
+      hottest     = chapter;
+      hottestHits = hits;
+    }
+  }
+  if (hottest == NULL) {
+    return;
+  }
+
+  // Use a free decoded chapter index, or else the coldest lent one.
+  unsigned int slot = 0;
+  for (unsigned int i = 0; i < cache->decodedCount; i++) {
+    CachedChapterIndex *owner = cache->decodedOwners[i];
+    if (owner == NULL) {
+      slot = i;
+      break;
+    }
+    if (owner->counters.searchHits
+        < cache->decodedOwners[slot]->counters.searchHits) {
+      slot = i;
+    }
+  }
+  CachedChapterIndex *coldest = cache->decodedOwners[slot];
+  if (coldest != NULL) {
+    if (hottestHits <= 2 * READ_ONCE(coldest->counters.searchHits)) {
+      return;
+    }
+    reclaimDecodedChapter(cache, coldest);
+    cache->retireEpoch = atomic64_inc_return(&cache->epoch);
+    waitForRetiredSearches(cache);
+  }
+
+  DecodedChapterIndex *decoded = &cache->decoded[slot];
+  int result = decodeChapterIndexPages(decoded, cache->geometry,
+                                       hottest->indexPages);
+  if (result != UDS_SUCCESS) {
+    // The index pages will report the problem when they are searched.
+    hottest->undecodable = true;
+    return;
+  }
+  if (!decoded->valid) {
+    hottest->undecodable = true;
+    return;
+  }
+
+  cache->decodedOwners[slot] = hottest;
+  smp_wmb();
+  WRITE_ONCE(hottest->decoded, decoded);
+}
+
+/**
+ * Search a zone's private search list for a virtual chapter.
+ *
+ * @param cache           the cache to search
+ * @param searchList      the zone's search list
+ * @param virtualChapter  the virtual chapter number of the chapter index
+ * @param zoneNumber      the zone number of the calling thread
+ *
+ * @return <code>true</code> iff the sparse chapter index is cached
+ **/
+static bool searchListContains(SparseCache  *cache,
+                               SearchList   *searchList,
+                               uint64_t      virtualChapter,
+                               unsigned int  zoneNumber)
+{
+  SearchListIterator iterator = iterateSearchList(searchList, cache->chapters);
   while (hasNextChapter(&iterator)) {
     CachedChapterIndex *chapter = getNextChapter(&iterator);
     if (virtualChapter == chapter->virtualChapter) {
@@ -422,6 +749,18 @@ bool sparseCacheContains(SparseCache  *cache,
   return false;
 }
 
+/**********************************************************************/
+bool sparseCacheContains(SparseCache  *cache,
+                         uint64_t      virtualChapter,
+                         unsigned int  zoneNumber)
+{
+  SearchList *searchList = beginSearch(cache, zoneNumber);
+  bool found = searchListContains(cache, searchList, virtualChapter,
+                                  zoneNumber);
+  endSearch(cache, zoneNumber);
+  return found;
+}
+
 /**********************************************************************/
 int updateSparseCache(IndexZone *zone, uint64_t virtualChapter)
 {
@@ -434,52 +773,81 @@ int updateSparseCache(IndexZone *zone, uint64_t virtualChapter)
     return UDS_SUCCESS;
   }
 
-  // Wait for every zone thread to have reached its corresponding barrier
-  // request and invoked this function before starting to modify the cache.
-  enterBarrier(&cache->beginCacheUpdate, NULL);
+  // First check that the desired chapter is still in the volume. If it's
+  // not, the hook fell out of the index and there's nothing to do for it.
+  if (virtualChapter < index->oldestVirtualChapter) {
+    return UDS_SUCCESS;
+  }
 
-  /*
-   * This is the start of the critical section: the zone zero thread is
-   * captain, effectively holding an exclusive lock on the sparse cache. All
-   * the other zone threads must do nothing between the two barriers. They
-   * will wait at the endCacheUpdate barrier for the captain to finish the
-   * update.
-   */
+  // A chapter the scrubber found corrupt is never cached, so its sparse
+  // lookups miss rather than fail.
+  unsigned int physicalChapter
+    = mapToPhysicalChapter(index->volume->geometry, virtualChapter);
+  if (isChapterMarkedBad(index->volume, physicalChapter)) {
+    return UDS_SUCCESS;
+  }
 
-  int result = UDS_SUCCESS;
-  if (zone->id == ZONE_ZERO) {
-    // Purge invalid chapters from the LRU search list.
-    SearchList *zoneZeroList = cache->searchLists[ZONE_ZERO];
-    purgeSearchList(zoneZeroList, cache->chapters, zone->oldestVirtualChapter);
-
-    // First check that the desired chapter is still in the volume. If it's
-    // not, the hook fell out of the index and there's nothing to do for it.
-    if (virtualChapter >= index->oldestVirtualChapter) {
-      // Evict the least recently used live chapter, or replace a dead cache
-      // entry, all by rotating the the last list entry to the front.
-      CachedChapterIndex *victim
-        = &cache->chapters[rotateSearchList(zoneZeroList, cache->capacity)];
-
-      // Check if the victim is already dead, and if it's not, add to the
-      // tally of evicted or invalidated cache entries.
-      scoreEviction(zone, cache, victim);
-
-      // Read the index page bytes and initialize the page array.
-      result = cacheChapterIndex(victim, virtualChapter, index->volume);
-    }
+  lockMutex(&cache->updateMutex);
 
-    // Copy the new search list state to all the other zone threads so they'll
-    // get the result of pruning and see the new chapter.
-    for (unsigned int zone = 1; zone < cache->zoneCount; zone++) {
-      copySearchList(zoneZeroList, cache->searchLists[zone]);
+  /*
+   * Start from the newest directory, keeping our own LRU order if we have
+   * already seen it. Another zone may have cached the chapter while we
+   * waited for the mutex. Nothing else can publish a directory while we hold
+   * the mutex, so our search list stays current without an epoch.
+   */
+  ZoneSearchState *state = &cache->zones[zone->id];
+  SparseCacheDirectory *directory = cache->directory;
+  if (state->version != directory->version) {
+    copySearchList(directory->searchList, state->searchList);
+    state->version = directory->version;
+  }
+  SearchList *searchList = state->searchList;
+  SearchListIterator iterator = iterateSearchList(searchList, cache->chapters);
+  while (hasNextChapter(&iterator)) {
+    if (getNextChapter(&iterator)->virtualChapter == virtualChapter) {
+      rotateSearchList(searchList, iterator.nextEntry);
+      unlockMutex(&cache->updateMutex);
+      return UDS_SUCCESS;
     }
   }
 
-  // This is the end of the critical section. All cache invariants must have
-  // been restored--it will be shared/read-only again beyond the barrier.
+  // Make sure the spare entry and the old directory are no longer in use.
+  waitForRetiredSearches(cache);
+  reclaimDecodedChapter(cache, &cache->chapters[cache->spare]);
+
+  // Purge invalid chapters from the LRU search list.
+  purgeSearchList(searchList, cache->chapters, zone->oldestVirtualChapter);
+
+  // Read the index page bytes into the spare entry. No search can see it.
+  CachedChapterIndex *spare = &cache->chapters[cache->spare];
+  int result = cacheChapterIndex(spare, virtualChapter, index->volume);
+  if (result != UDS_SUCCESS) {
+    unlockMutex(&cache->updateMutex);
+    return result;
+  }
 
-  enterBarrier(&cache->endCacheUpdate, NULL);
-  return result;
+  // Evict the least recently used live chapter, or replace a dead cache
+  // entry, all by rotating the the last list entry to the front, and put the
+  // spare in its place. The victim becomes the new spare.
+  uint8_t victim = rotateSearchList(searchList, cache->capacity);
+  scoreEviction(zone, cache, &cache->chapters[victim]);
+  searchList->entries[0] = cache->spare;
+  cache->spare = victim;
+
+  // Build and publish the new directory, then advance the epoch so the old
+  // directory and the victim can be reclaimed once every zone has moved on.
+  SparseCacheDirectory *next
+    = &cache->directories[(directory == &cache->directories[0]) ? 1 : 0];
+  copySearchList(searchList, next->searchList);
+  next->version  = directory->version + 1;
+  state->version = next->version;
+  smp_wmb();
+  WRITE_ONCE(cache->directory, next);
+  cache->retireEpoch = atomic64_inc_return(&cache->epoch);
+
+  decodeHotChapter(cache);
+  unlockMutex(&cache->updateMutex);
+  return UDS_SUCCESS;
 }
 
 
@@ -494,12 +862,16 @@ int searchSparseCache(IndexZone          *zone,
   unsigned int zoneNumber = zone->id;
   // If the caller did not specify a virtual chapter, search the entire cache.
   bool searchAll = (*virtualChapterPtr == UINT64_MAX);
+  // A hook missing from the master index can only be in a chapter of which
+  // it is not a sample.
+  MasterIndex *masterIndex = zone->index->masterIndex;
+  bool isHook = (searchAll && isMasterIndexSample(masterIndex, name));
   unsigned int chaptersSearched = 0;
 
   // Get the chapter search order for this zone thread, searching the chapters
   // from most recently hit to least recently hit.
   SearchListIterator iterator
-    = iterateSearchList(cache->searchLists[zoneNumber], cache->chapters);
+    = iterateSearchList(beginSearch(cache, zoneNumber), cache->chapters);
   while (hasNextChapter(&iterator)) {
     CachedChapterIndex *chapter = getNextChapter(&iterator);
 
@@ -507,19 +879,28 @@ int searchSparseCache(IndexZone          *zone,
     if (shouldSkipChapterIndex(zone, chapter, *virtualChapterPtr)) {
       continue;
     }
+    if (isHook && isMasterIndexChapterSample(masterIndex, name,
+                                             chapter->virtualChapter)) {
+      continue;
+    }
 
     int result = searchCachedChapterIndex(chapter, cache->geometry,
                                           volume->indexPageMap, name,
                                           recordPagePtr);
     if (result != UDS_SUCCESS) {
+      endSearch(cache, zoneNumber);
       return result;
     }
     chaptersSearched += 1;
 
     // Did we find an index entry for the name?
     if (*recordPagePtr != NO_CHAPTER_INDEX_ENTRY) {
+      bool checkHot = false;
       if (zoneNumber == ZONE_ZERO) {
         scoreSearchHit(cache, chapter);
+        checkHot = ((cache->decodedCount > 0) && (chapter->decoded == NULL)
+                    && ((chapter->counters.searchHits
+                         % HOT_CHAPTER_CHECK_INTERVAL) == HOT_CHAPTER_HITS));
       }
 
       // Move the chapter to the front of the search list.
@@ -529,6 +910,15 @@ int searchSparseCache(IndexZone          *zone,
       // collision that has a true match in another chapter, but that's a very
       // rare case and not worth the extra search cost or complexity.
       *virtualChapterPtr = chapter->virtualChapter;
+      endSearch(cache, zoneNumber);
+
+      // The chapter has become hot without a decoded chapter index. This
+      // must be after endSearch() since it may wait for other searches.
+      if (checkHot) {
+        lockMutex(&cache->updateMutex);
+        decodeHotChapter(cache);
+        unlockMutex(&cache->updateMutex);
+      }
       return UDS_SUCCESS;
     }
 
@@ -542,6 +932,7 @@ int searchSparseCache(IndexZone          *zone,
       break;
     }
   }
+  endSearch(cache, zoneNumber);
 
   // The name was not found in the cache.
   *recordPagePtr = NO_CHAPTER_INDEX_ENTRY;
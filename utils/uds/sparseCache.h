@@ -34,10 +34,9 @@
  * and single index pages used for resolving hooks are kept in the volume page
  * cache.
  *
- * Searching the cache is an unsynchronized operation. Changing the contents
- * of the cache is a coordinated process requiring the coordinated
- * participation of all zone threads via the careful use of barrier messages
- * sent to all the index zones by the triage queue worker thread.
+ * Searching the cache is an unsynchronized operation. A zone thread which
+ * needs a chapter that is not cached adds it by publishing a new copy of the
+ * cache directory; the other zone threads carry on searching without waiting.
  **/
 typedef struct sparseCache SparseCache;
 
@@ -83,6 +82,20 @@ size_t getSparseCacheMemorySize(const SparseCache *cache);
  **/
 CacheCounters getSparseCacheCounters(const SparseCache *cache);
 
+/**
+ * Get the virtual chapter numbers of the sparse chapter indexes currently in
+ * the cache, most recently used first.
+ *
+ * @param cache        the cache to examine
+ * @param chapters     an array to receive the virtual chapter numbers
+ * @param maxChapters  the size of the chapters array
+ *
+ * @return the number of chapter numbers stored in the array
+ **/
+unsigned int getSparseCacheChapters(SparseCache  *cache,
+                                    uint64_t     *chapters,
+                                    unsigned int  maxChapters);
+
 /**
  * Check whether a sparse chapter index is present in the chapter cache. This
  * is only intended for use by the zone threads.
@@ -98,11 +111,9 @@ bool sparseCacheContains(SparseCache  *cache,
                          unsigned int  zoneNumber);
 
 /**
- * Update the sparse cache to contain a chapter index.
- *
- * This function must be called by all the zone threads with the same chapter
- * numbers to correctly enter the thread barriers used to synchronize the
- * cache updates.
+ * Update the sparse cache to contain a chapter index. This is only intended
+ * for use by the zone threads. Only the calling zone thread waits while the
+ * chapter index is read.
  *
  * @param zone            the index zone
  * @param virtualChapter  the virtual chapter number of the chapter index
@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/sparseCachePrefetch.c#1 $
+ */
+
+#include "sparseCachePrefetch.h"
+
+#include "logger.h"
+#include "memoryAlloc.h"
+#include "numeric.h"
+
+enum {
+  /** the number of entries in the chapter successor table (a power of 2) */
+  SUCCESSOR_TABLE_SIZE   = 4096,
+  /** the confidence a successor needs before it is prefetched */
+  PREDICT_CONFIDENCE     = 2,
+  /** the largest confidence a successor can accumulate */
+  MAX_CONFIDENCE         = 3,
+  /** the number of prefetched chapters waiting to be used */
+  PENDING_PREFETCHES     = 8,
+  /** the number of prefetch outcomes in each adaptation window */
+  OUTCOME_WINDOW         = 16,
+  /** the number of hooks between trial prefetches when prefetch is off */
+  TRIAL_INTERVAL         = 64,
+};
+
+/**
+ * The chapter most recently seen to follow a chapter, with a saturating
+ * count of how consistently it has done so.
+ **/
+typedef struct successor {
+  uint64_t virtualChapter;
+  uint64_t next;
+  unsigned int confidence;
+} Successor;
+
+struct sparseCachePrefetcher {
+  /** the number of chapters in the sparse cache */
+  unsigned int  capacity;
+  /** the current number of chapters to prefetch for each hook */
+  unsigned int  depth;
+  /** the largest depth allowed for this cache capacity */
+  unsigned int  maxDepth;
+  /** the sparse chapter of the previous hook */
+  uint64_t      lastChapter;
+  /** prefetched chapters not yet used, in a ring */
+  uint64_t      pending[PENDING_PREFETCHES];
+  unsigned int  nextPending;
+  /** prefetch outcomes in the current adaptation window */
+  unsigned int  used;
+  unsigned int  wasted;
+  /** hooks seen since the last trial prefetch while prefetch is off */
+  unsigned int  sinceTrial;
+  /** the most recent distinct chapters barriered, approximating the cache */
+  uint64_t     *recent;
+  unsigned int  nextRecent;
+  /** statistics, logged when the prefetcher is freed */
+  uint64_t      prefetchesIssued;
+  uint64_t      prefetchesUsed;
+  /** the chapter successor table, indexed by virtual chapter */
+  Successor     successors[SUCCESSOR_TABLE_SIZE];
+};
+
+/**********************************************************************/
+int makeSparseCachePrefetcher(unsigned int            capacity,
+                              SparseCachePrefetcher **prefetcherPtr)
+{
+  SparseCachePrefetcher *prefetcher;
+  int result = ALLOCATE(1, SparseCachePrefetcher, "sparse cache prefetcher",
+                        &prefetcher);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = ALLOCATE(capacity, uint64_t, "sparse prefetch recent chapters",
+                    &prefetcher->recent);
+  if (result != UDS_SUCCESS) {
+    FREE(prefetcher);
+    return result;
+  }
+
+  prefetcher->capacity = capacity;
+  // Never let prefetching claim more than half the cache.
+  prefetcher->maxDepth = minUInt64(MAX_SPARSE_PREFETCH_DEPTH, capacity / 2);
+  prefetcher->depth    = minUInt64(1, prefetcher->maxDepth);
+  prefetcher->lastChapter = UINT64_MAX;
+  for (unsigned int i = 0; i < capacity; i++) {
+    prefetcher->recent[i] = UINT64_MAX;
+  }
+  for (unsigned int i = 0; i < PENDING_PREFETCHES; i++) {
+    prefetcher->pending[i] = UINT64_MAX;
+  }
+  for (unsigned int i = 0; i < SUCCESSOR_TABLE_SIZE; i++) {
+    prefetcher->successors[i].virtualChapter = UINT64_MAX;
+  }
+
+  *prefetcherPtr = prefetcher;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+void freeSparseCachePrefetcher(SparseCachePrefetcher *prefetcher)
+{
+  if (prefetcher == NULL) {
+    return;
+  }
+  logDebug("sparse cache prefetch: %" PRIu64 " chapters prefetched, %"
+           PRIu64 " used", prefetcher->prefetchesIssued,
+           prefetcher->prefetchesUsed);
+  FREE(prefetcher->recent);
+  FREE(prefetcher);
+}
+
+/**********************************************************************/
+static INLINE Successor *getSuccessor(SparseCachePrefetcher *prefetcher,
+                                      uint64_t               virtualChapter)
+{
+  return &prefetcher->successors[virtualChapter
+                                 & (SUCCESSOR_TABLE_SIZE - 1)];
+}
+
+/**
+ * Record that one chapter was followed by another.
+ *
+ * @param prefetcher  the prefetcher
+ * @param from        the earlier chapter
+ * @param to          the chapter which followed it
+ **/
+static void learnSuccessor(SparseCachePrefetcher *prefetcher,
+                           uint64_t               from,
+                           uint64_t               to)
+{
+  Successor *successor = getSuccessor(prefetcher, from);
+  if (successor->virtualChapter != from) {
+    *successor = (Successor) {
+      .virtualChapter = from,
+      .next           = to,
+      .confidence     = 1,
+    };
+  } else if (successor->next == to) {
+    if (successor->confidence < MAX_CONFIDENCE) {
+      successor->confidence++;
+    }
+  } else if (successor->confidence > 1) {
+    successor->confidence--;
+  } else {
+    successor->next = to;
+  }
+}
+
+/**
+ * Get the predicted successor of a chapter.
+ *
+ * @param prefetcher      the prefetcher
+ * @param virtualChapter  the chapter
+ *
+ * @return the predicted next chapter, or UINT64_MAX if there is none
+ **/
+static uint64_t predictSuccessor(SparseCachePrefetcher *prefetcher,
+                                 uint64_t               virtualChapter)
+{
+  Successor *successor = getSuccessor(prefetcher, virtualChapter);
+  if ((successor->virtualChapter != virtualChapter)
+      || (successor->confidence < PREDICT_CONFIDENCE)) {
+    return UINT64_MAX;
+  }
+  return successor->next;
+}
+
+/**
+ * Record the outcome of a prefetch, and adjust the prefetch depth at the end
+ * of each window of outcomes.
+ *
+ * @param prefetcher  the prefetcher
+ * @param wasUsed     whether the prefetched chapter was used
+ **/
+static void scorePrefetch(SparseCachePrefetcher *prefetcher, bool wasUsed)
+{
+  if (wasUsed) {
+    prefetcher->used++;
+    prefetcher->prefetchesUsed++;
+  } else {
+    prefetcher->wasted++;
+  }
+  if (prefetcher->used + prefetcher->wasted < OUTCOME_WINDOW) {
+    return;
+  }
+  if ((prefetcher->used * 4 >= OUTCOME_WINDOW * 3)
+      && (prefetcher->depth < prefetcher->maxDepth)) {
+    prefetcher->depth++;
+  } else if ((prefetcher->used * 4 < OUTCOME_WINDOW)
+             && (prefetcher->depth > 0)) {
+    prefetcher->depth--;
+  }
+  prefetcher->used   = 0;
+  prefetcher->wasted = 0;
+}
+
+/**********************************************************************/
+static void addPending(SparseCachePrefetcher *prefetcher,
+                       uint64_t               virtualChapter)
+{
+  uint64_t *slot = &prefetcher->pending[prefetcher->nextPending];
+  if (*slot != UINT64_MAX) {
+    scorePrefetch(prefetcher, false);
+  }
+  *slot = virtualChapter;
+  prefetcher->nextPending = (prefetcher->nextPending + 1) % PENDING_PREFETCHES;
+  prefetcher->prefetchesIssued++;
+}
+
+/**********************************************************************/
+static void usePending(SparseCachePrefetcher *prefetcher,
+                       uint64_t               virtualChapter)
+{
+  for (unsigned int i = 0; i < PENDING_PREFETCHES; i++) {
+    if (prefetcher->pending[i] == virtualChapter) {
+      prefetcher->pending[i] = UINT64_MAX;
+      scorePrefetch(prefetcher, true);
+      return;
+    }
+  }
+}
+
+/**********************************************************************/
+static bool containsChapter(const uint64_t *chapters,
+                            unsigned int    count,
+                            uint64_t        virtualChapter)
+{
+  for (unsigned int i = 0; i < count; i++) {
+    if (chapters[i] == virtualChapter) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**********************************************************************/
+static void addRecent(SparseCachePrefetcher *prefetcher,
+                      uint64_t               virtualChapter)
+{
+  if (containsChapter(prefetcher->recent, prefetcher->capacity,
+                      virtualChapter)) {
+    return;
+  }
+  prefetcher->recent[prefetcher->nextRecent] = virtualChapter;
+  prefetcher->nextRecent = (prefetcher->nextRecent + 1) % prefetcher->capacity;
+}
+
+/**********************************************************************/
+unsigned int planSparseCacheBarriers(SparseCachePrefetcher *prefetcher,
+                                     const IndexZone       *zone,
+                                     uint64_t               virtualChapter,
+                                     uint64_t              *chapters)
+{
+  if (virtualChapter != prefetcher->lastChapter) {
+    if (prefetcher->lastChapter != UINT64_MAX) {
+      learnSuccessor(prefetcher, prefetcher->lastChapter, virtualChapter);
+    }
+    prefetcher->lastChapter = virtualChapter;
+    usePending(prefetcher, virtualChapter);
+  }
+
+  unsigned int depth = prefetcher->depth;
+  if ((depth == 0) && (prefetcher->maxDepth > 0)
+      && (++prefetcher->sinceTrial >= TRIAL_INTERVAL)) {
+    // Try an occasional prefetch so that a workload which develops locality
+    // can turn prefetching back on.
+    prefetcher->sinceTrial = 0;
+    depth = 1;
+  }
+
+  unsigned int count = 0;
+  uint64_t from = virtualChapter;
+  for (unsigned int i = 0; i < depth; i++) {
+    uint64_t next = predictSuccessor(prefetcher, from);
+    if ((next == UINT64_MAX) || (next == virtualChapter)
+        || !isZoneChapterSparse(zone, next)) {
+      break;
+    }
+    if (!containsChapter(prefetcher->recent, prefetcher->capacity, next)
+        && !containsChapter(chapters, count, next)) {
+      chapters[count++] = next;
+      addPending(prefetcher, next);
+    }
+    from = next;
+  }
+
+  chapters[count++] = virtualChapter;
+  for (unsigned int i = 0; i < count; i++) {
+    addRecent(prefetcher, chapters[i]);
+  }
+  return count;
+}
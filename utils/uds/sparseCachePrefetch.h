@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/sparseCachePrefetch.h#1 $
+ */
+
+#ifndef SPARSE_CACHE_PREFETCH_H
+#define SPARSE_CACHE_PREFETCH_H
+
+#include "common.h"
+#include "indexZone.h"
+
+/**
+ * A SparseCachePrefetcher decides which sparse cache barrier messages the
+ * triage stage issues for a hook found in a sparse chapter. It learns which
+ * chapters tend to be hit one after another so that the chapters predicted to
+ * come next can be loaded into the sparse cache along with the chapter of the
+ * hook, before any request needs them.
+ *
+ * The number of chapters prefetched for each hook adapts to how many recent
+ * prefetches were actually used, so a workload with no chapter locality
+ * stops displacing useful chapters from the cache.
+ *
+ * A prefetcher is only used by the single thread doing the triage (the
+ * triage queue thread, or the zone thread of a single-zone index), and so
+ * needs no synchronization.
+ **/
+typedef struct sparseCachePrefetcher SparseCachePrefetcher;
+
+enum {
+  /** the largest number of chapters prefetched for one hook */
+  MAX_SPARSE_PREFETCH_DEPTH = 2,
+  /** the largest number of barriers issued for one hook */
+  MAX_SPARSE_CACHE_BARRIERS = MAX_SPARSE_PREFETCH_DEPTH + 1,
+};
+
+/**
+ * Create a sparse cache prefetcher.
+ *
+ * @param capacity       the number of chapters in the sparse cache
+ * @param prefetcherPtr  where to store the new prefetcher
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int makeSparseCachePrefetcher(unsigned int            capacity,
+                              SparseCachePrefetcher **prefetcherPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Free a sparse cache prefetcher.
+ *
+ * @param prefetcher  the prefetcher to free (may be NULL)
+ **/
+void freeSparseCachePrefetcher(SparseCachePrefetcher *prefetcher);
+
+/**
+ * Choose the sparse cache barriers to issue for a hook in a sparse chapter.
+ * The chapter containing the hook is always the last chapter returned, so it
+ * becomes the most recently used chapter in the cache.
+ *
+ * @param prefetcher      the prefetcher
+ * @param zone            the zone of the request, used to check that
+ *                        predicted chapters are still sparse
+ * @param virtualChapter  the sparse chapter containing the hook
+ * @param chapters        an array of MAX_SPARSE_CACHE_BARRIERS entries to
+ *                        receive the chapters needing barriers
+ *
+ * @return the number of chapters needing barriers
+ **/
+unsigned int planSparseCacheBarriers(SparseCachePrefetcher *prefetcher,
+                                     const IndexZone       *zone,
+                                     uint64_t               virtualChapter,
+                                     uint64_t              *chapters);
+
+#endif /* SPARSE_CACHE_PREFETCH_H */
@@ -0,0 +1,878 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/stripedIORegion.c#1 $
+ */
+
+#include "stripedIORegion.h"
+
+#include "buffer.h"
+#include "compiler.h"
+#include "logger.h"
+#include "memoryAlloc.h"
+#include "nonce.h"
+#include "numeric.h"
+#include "permassert.h"
+#include "threads.h"
+
+static const byte STRIPE_MAGIC[16] = "*UDS*STRIPE*001*";
+
+enum {
+  STRIPE_MAGIC_LENGTH = sizeof(STRIPE_MAGIC),
+  /** The number of bytes at the start of each member holding its header */
+  STRIPE_HEADER_SIZE  = 4096,
+};
+
+/**
+ * The header at the start of each member of a striped region. It records
+ * the geometry of the region, so that a member given in the wrong place,
+ * with the wrong stripe size, or from another striped region is rejected
+ * instead of being read as scrambled data.
+ **/
+typedef struct stripeHeader {
+  byte     magic[STRIPE_MAGIC_LENGTH];
+  uint64_t nonce;       // the same for every member of the region
+  uint64_t stripeSize;
+  uint32_t count;       // the number of members
+  uint32_t position;    // the position of this member
+} StripeHeader;
+
+typedef enum {
+  STRIPE_READ,
+  STRIPE_WRITE,
+  STRIPE_SYNC,
+} StripeOperation;
+
+/**
+ * A single read, write, or sync of a striped region. A transfer which is
+ * split between the member threads lives on the stack of the thread which
+ * started it until every member has finished its share.
+ **/
+typedef struct stripeTransfer {
+  StripeOperation  operation;
+  off_t            offset;      // offset in the striped region
+  byte            *buffer;      // the buffer being read into
+  const byte      *data;        // the data being written
+  size_t           size;        // the size of the buffer
+  size_t           length;      // the length of the data being written
+  bool             partial;     // whether a short read is acceptable
+  // The remaining fields are protected by the region mutex while the
+  // transfer is shared.
+  unsigned int     pending;     // the number of unfinished member shares
+  int              result;      // the first error from any member
+  size_t           readLength;  // the length of the contiguous data read
+} StripeTransfer;
+
+/** One member's share of a transfer, queued for the member's thread */
+typedef struct stripeJob {
+  struct stripeJob *next;
+  StripeTransfer   *transfer;
+} StripeJob;
+
+typedef struct stripeMember {
+  IORegion                *region;
+  struct stripedIORegion  *sior;
+  StripeJob               *head;    // the oldest queued share
+  StripeJob               *tail;    // the newest queued share
+  CondVar                  cond;    // signalled when a share is queued
+  Thread                   thread;
+} StripeMember;
+
+typedef struct stripedIORegion {
+  IORegion      common;
+  Mutex         mutex;           // protects the queues and shared transfers
+  CondVar       doneCond;        // signalled when a shared transfer is done
+  bool          stop;            // tells the member threads to exit
+  unsigned int  count;           // the number of members
+  unsigned int  startedThreads;  // the number of member threads started
+  size_t        stripeSize;
+  size_t        blockSize;
+  uint64_t      nonce;           // the nonce in the member headers
+  StripeMember  members[];
+} StripedIORegion;
+
+/*****************************************************************************/
+static INLINE StripedIORegion *asStripedIORegion(IORegion *region)
+{
+  return container_of(region, StripedIORegion, common);
+}
+
+/*****************************************************************************/
+off_t computeStripedMemberLimit(off_t        limit,
+                                unsigned int count,
+                                size_t       stripeSize)
+{
+  off_t rowSize = (off_t) stripeSize * count;
+  return (((limit + rowSize - 1) / rowSize) * (off_t) stripeSize
+          + STRIPE_HEADER_SIZE);
+}
+
+/*****************************************************************************/
+__attribute__((warn_unused_result))
+static int encodeStripeHeader(Buffer *buffer, const StripeHeader *header)
+{
+  int result = putBytes(buffer, STRIPE_MAGIC_LENGTH, header->magic);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putUInt64LEIntoBuffer(buffer, header->nonce);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putUInt64LEIntoBuffer(buffer, header->stripeSize);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putUInt32LEIntoBuffer(buffer, header->count);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = putUInt32LEIntoBuffer(buffer, header->position);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  return ASSERT_LOG_ONLY(contentLength(buffer) == sizeof(*header),
+                         "%zu bytes encoded of %zu expected",
+                         contentLength(buffer), sizeof(*header));
+}
+
+/*****************************************************************************/
+__attribute__((warn_unused_result))
+static int decodeStripeHeader(Buffer *buffer, StripeHeader *header)
+{
+  int result = getBytesFromBuffer(buffer, STRIPE_MAGIC_LENGTH, header->magic);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = getUInt64LEFromBuffer(buffer, &header->nonce);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = getUInt64LEFromBuffer(buffer, &header->stripeSize);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = getUInt32LEFromBuffer(buffer, &header->count);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  return getUInt32LEFromBuffer(buffer, &header->position);
+}
+
+/**
+ * Write the header of every member of a new striped region.
+ *
+ * @param members     The member regions
+ * @param count       The number of member regions
+ * @param stripeSize  The number of bytes in each stripe
+ * @param nonce       The nonce identifying the striped region
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int writeStripeHeaders(IORegion     **members,
+                              unsigned int   count,
+                              size_t         stripeSize,
+                              uint64_t       nonce)
+{
+  byte *block;
+  int result = ALLOCATE_IO_ALIGNED(STRIPE_HEADER_SIZE, byte, "stripe header",
+                                   &block);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  StripeHeader header = {
+    .nonce      = nonce,
+    .stripeSize = stripeSize,
+    .count      = count,
+  };
+  memcpy(header.magic, STRIPE_MAGIC, STRIPE_MAGIC_LENGTH);
+  for (unsigned int i = 0; i < count; i++) {
+    header.position = i;
+    Buffer *buffer;
+    result = wrapBuffer(block, STRIPE_HEADER_SIZE, 0, &buffer);
+    if (result != UDS_SUCCESS) {
+      break;
+    }
+    result = encodeStripeHeader(buffer, &header);
+    freeBuffer(&buffer);
+    if (result != UDS_SUCCESS) {
+      break;
+    }
+    result = writeToRegion(members[i], 0, block, STRIPE_HEADER_SIZE,
+                           STRIPE_HEADER_SIZE);
+    if (result != UDS_SUCCESS) {
+      logErrorWithStringError(result,
+                              "cannot write header of striped index file %u",
+                              i + 1);
+      break;
+    }
+  }
+  FREE(block);
+  return result;
+}
+
+/**
+ * Read the header of every member of an existing striped region, and check
+ * that the members are all from the same region, are given in the order in
+ * which they were created, and use the expected stripe size.
+ *
+ * @param [in]  members     The member regions
+ * @param [in]  count       The number of member regions
+ * @param [in]  stripeSize  The number of bytes in each stripe
+ * @param [out] noncePtr    The nonce identifying the striped region
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int checkStripeHeaders(IORegion     **members,
+                              unsigned int   count,
+                              size_t         stripeSize,
+                              uint64_t      *noncePtr)
+{
+  byte *block;
+  int result = ALLOCATE_IO_ALIGNED(STRIPE_HEADER_SIZE, byte, "stripe header",
+                                   &block);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  uint64_t nonce = 0;
+  for (unsigned int i = 0; i < count; i++) {
+    result = readFromRegion(members[i], 0, block, STRIPE_HEADER_SIZE, NULL);
+    if (result != UDS_SUCCESS) {
+      logErrorWithStringError(result,
+                              "cannot read header of striped index file %u",
+                              i + 1);
+      break;
+    }
+    StripeHeader header;
+    Buffer *buffer;
+    result = wrapBuffer(block, STRIPE_HEADER_SIZE, STRIPE_HEADER_SIZE,
+                        &buffer);
+    if (result != UDS_SUCCESS) {
+      break;
+    }
+    result = decodeStripeHeader(buffer, &header);
+    freeBuffer(&buffer);
+    if (result != UDS_SUCCESS) {
+      break;
+    }
+
+    if (memcmp(header.magic, STRIPE_MAGIC, STRIPE_MAGIC_LENGTH) != 0) {
+      result = logErrorWithStringError(UDS_CORRUPT_COMPONENT,
+                                       "index file %u is not part of a"
+                                       " striped index", i + 1);
+      break;
+    }
+    if (i == 0) {
+      nonce = header.nonce;
+    } else if (header.nonce != nonce) {
+      result = logErrorWithStringError(UDS_WRONG_INDEX_CONFIG,
+                                       "index files 1 and %u are from"
+                                       " different striped indexes", i + 1);
+      break;
+    }
+    if (header.count != count) {
+      result = logErrorWithStringError(UDS_WRONG_INDEX_CONFIG,
+                                       "striped index has %u files, not %u",
+                                       header.count, count);
+      break;
+    }
+    if (header.position != i) {
+      result = logErrorWithStringError(UDS_WRONG_INDEX_CONFIG,
+                                       "index file %u was given in place of"
+                                       " striped index file %u",
+                                       header.position + 1, i + 1);
+      break;
+    }
+    if (header.stripeSize != stripeSize) {
+      result = logErrorWithStringError(UDS_WRONG_INDEX_CONFIG,
+                                       "striped index has stripe size %"
+                                       PRIu64 ", not %zu",
+                                       header.stripeSize, stripeSize);
+      break;
+    }
+  }
+  FREE(block);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  *noncePtr = nonce;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Perform one member's share of a transfer. The share consists of every
+ * stripe of the transfer which lies on the member; these are contiguous on
+ * the member but spaced a row apart in the transfer buffer.
+ *
+ * @param [in]  sior        The striped region
+ * @param [in]  transfer    The transfer
+ * @param [in]  member      The number of the member
+ * @param [out] readLength  The offset in the transfer buffer of the first
+ *                            byte this member failed to read
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int doMemberShare(StripedIORegion *sior,
+                         StripeTransfer  *transfer,
+                         unsigned int     member,
+                         size_t          *readLength)
+{
+  IORegion *region = sior->members[member].region;
+  *readLength = transfer->size;
+  if (transfer->operation == STRIPE_SYNC) {
+    return syncRegionContents(region);
+  }
+
+  uint64_t stripeSize  = sior->stripeSize;
+  uint64_t count       = sior->count;
+  uint64_t start       = transfer->offset;
+  uint64_t end         = start + transfer->size;
+  uint64_t firstStripe = start / stripeSize;
+  uint64_t lastStripe  = (end - 1) / stripeSize;
+  for (uint64_t stripe = firstStripe + ((member + count - firstStripe % count)
+                                        % count);
+       stripe <= lastStripe;
+       stripe += count) {
+    uint64_t stripeStart = stripe * stripeSize;
+    uint64_t chunkStart  = maxUInt64(start, stripeStart);
+    uint64_t chunkEnd    = minUInt64(end, stripeStart + stripeSize);
+    size_t   chunkSize   = chunkEnd - chunkStart;
+    size_t   position    = chunkStart - start;
+    off_t    memberOffset = (STRIPE_HEADER_SIZE + (stripe / count) * stripeSize
+                             + (chunkStart - stripeStart));
+
+    int result;
+    if (transfer->operation == STRIPE_WRITE) {
+      if (position >= transfer->length) {
+        break;
+      }
+      result = writeToRegion(region, memberOffset, transfer->data + position,
+                             chunkSize,
+                             minSizeT(chunkSize, transfer->length - position));
+    } else if (transfer->partial) {
+      size_t n = 0;
+      result = readFromRegion(region, memberOffset,
+                              transfer->buffer + position, chunkSize, &n);
+      if ((result == UDS_SUCCESS) && (n < chunkSize)) {
+        // Nothing this member holds past the end of its data can count.
+        *readLength = position + n;
+        break;
+      }
+    } else {
+      result = readFromRegion(region, memberOffset,
+                              transfer->buffer + position, chunkSize, NULL);
+    }
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+  }
+  return UDS_SUCCESS;
+}
+
+/**
+ * Record the completion of one member's share of a shared transfer. The
+ * caller must hold the region mutex.
+ *
+ * @param sior        The striped region
+ * @param transfer    The transfer
+ * @param result      The result of the member's share
+ * @param readLength  The read length reported by the member's share
+ **/
+static void finishShare(StripedIORegion *sior,
+                        StripeTransfer  *transfer,
+                        int              result,
+                        size_t           readLength)
+{
+  if (transfer->result == UDS_SUCCESS) {
+    transfer->result = result;
+  }
+  transfer->readLength = minSizeT(transfer->readLength, readLength);
+  if (--transfer->pending == 0) {
+    broadcastCond(&sior->doneCond);
+  }
+}
+
+/**
+ * The driver function for the thread of a member, which performs the
+ * member's share of each transfer queued for it until told to stop.
+ *
+ * @param arg  The StripeMember
+ **/
+static void memberThread(void *arg)
+{
+  StripeMember    *member = arg;
+  StripedIORegion *sior   = member->sior;
+  unsigned int     number = member - sior->members;
+  lockMutex(&sior->mutex);
+  for (;;) {
+    while ((member->head == NULL) && !sior->stop) {
+      waitCond(&member->cond, &sior->mutex);
+    }
+    StripeJob *job = member->head;
+    if (job == NULL) {
+      break;
+    }
+    member->head = job->next;
+    if (member->head == NULL) {
+      member->tail = NULL;
+    }
+    unlockMutex(&sior->mutex);
+
+    size_t readLength;
+    int result = doMemberShare(sior, job->transfer, number, &readLength);
+
+    lockMutex(&sior->mutex);
+    finishShare(sior, job->transfer, result, readLength);
+  }
+  unlockMutex(&sior->mutex);
+}
+
+/**
+ * Perform a transfer on a striped region. A transfer which fits in a
+ * single stripe, or which touches only one member, is done entirely by the
+ * calling thread, since handing small transfers to other threads would
+ * cost more than it saves. Otherwise the shares of all but the first
+ * member touched are handed to the member threads, and the calling thread
+ * does the first share itself.
+ *
+ * @param sior      The striped region
+ * @param transfer  The transfer
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int runTransfer(StripedIORegion *sior, StripeTransfer *transfer)
+{
+  transfer->result     = UDS_SUCCESS;
+  transfer->readLength = transfer->size;
+
+  unsigned int first   = 0;
+  unsigned int touched = sior->count;
+  bool         split   = true;
+  if (transfer->operation != STRIPE_SYNC) {
+    if (transfer->size == 0) {
+      return UDS_SUCCESS;
+    }
+    uint64_t firstStripe = transfer->offset / sior->stripeSize;
+    uint64_t lastStripe  = ((transfer->offset + transfer->size - 1)
+                            / sior->stripeSize);
+    first   = firstStripe % sior->count;
+    touched = minUInt64(lastStripe - firstStripe + 1, sior->count);
+    split   = (transfer->size > sior->stripeSize);
+  }
+
+  if (!split || (touched == 1)) {
+    for (unsigned int i = 0; i < touched; i++) {
+      size_t readLength;
+      int result = doMemberShare(sior, transfer, (first + i) % sior->count,
+                                 &readLength);
+      if (result != UDS_SUCCESS) {
+        return result;
+      }
+      transfer->readLength = minSizeT(transfer->readLength, readLength);
+    }
+    return UDS_SUCCESS;
+  }
+
+  StripeJob jobs[MAX_STRIPE_MEMBERS];
+  lockMutex(&sior->mutex);
+  transfer->pending = touched;
+  for (unsigned int i = 1; i < touched; i++) {
+    StripeMember *member = &sior->members[(first + i) % sior->count];
+    jobs[i].next     = NULL;
+    jobs[i].transfer = transfer;
+    if (member->tail == NULL) {
+      member->head = &jobs[i];
+    } else {
+      member->tail->next = &jobs[i];
+    }
+    member->tail = &jobs[i];
+    signalCond(&member->cond);
+  }
+  unlockMutex(&sior->mutex);
+
+  size_t readLength;
+  int result = doMemberShare(sior, transfer, first, &readLength);
+
+  lockMutex(&sior->mutex);
+  finishShare(sior, transfer, result, readLength);
+  while (transfer->pending > 0) {
+    waitCond(&sior->doneCond, &sior->mutex);
+  }
+  unlockMutex(&sior->mutex);
+  return transfer->result;
+}
+
+/*****************************************************************************/
+static int validateIO(StripedIORegion *sior,
+                      off_t            offset,
+                      size_t           size,
+                      size_t           length)
+{
+  if (offset % sior->blockSize != 0) {
+    return logErrorWithStringError(UDS_INCORRECT_ALIGNMENT,
+                                   "alignment %zd not multiple of %zd", offset,
+                                   sior->blockSize);
+  }
+
+  if (size % sior->blockSize != 0) {
+    return logErrorWithStringError(UDS_BUFFER_ERROR,
+                                   "buffer size %zd not a multiple of %zd",
+                                   size, sior->blockSize);
+  }
+
+  if (length > size) {
+    return logErrorWithStringError(UDS_BUFFER_ERROR,
+                                   "length %zd exceeds buffer size %zd",
+                                   length, size);
+  }
+
+  return UDS_SUCCESS;
+}
+
+/*****************************************************************************/
+static void stopMemberThreads(StripedIORegion *sior)
+{
+  lockMutex(&sior->mutex);
+  sior->stop = true;
+  for (unsigned int i = 0; i < sior->startedThreads; i++) {
+    broadcastCond(&sior->members[i].cond);
+  }
+  unlockMutex(&sior->mutex);
+  for (unsigned int i = 0; i < sior->startedThreads; i++) {
+    joinThreads(sior->members[i].thread);
+  }
+  sior->startedThreads = 0;
+}
+
+/*****************************************************************************/
+static int sior_close(IORegion *region)
+{
+  StripedIORegion *sior = asStripedIORegion(region);
+  stopMemberThreads(sior);
+
+  int result = UDS_SUCCESS;
+  for (unsigned int i = 0; i < sior->count; i++) {
+    int closeResult = closeIORegion(&sior->members[i].region);
+    if (result == UDS_SUCCESS) {
+      result = closeResult;
+    }
+    destroyCond(&sior->members[i].cond);
+  }
+  destroyCond(&sior->doneCond);
+  destroyMutex(&sior->mutex);
+  FREE(sior);
+  return result;
+}
+
+/*****************************************************************************/
+static int sior_getLimit(IORegion *region, off_t *limit)
+{
+  StripedIORegion *sior = asStripedIORegion(region);
+
+  off_t memberLimit = INT64_MAX;
+  for (unsigned int i = 0; i < sior->count; i++) {
+    off_t temp = INT64_MAX;
+    int result = getRegionLimit(sior->members[i].region, &temp);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    if (temp < memberLimit) {
+      memberLimit = temp;
+    }
+  }
+
+  if (memberLimit == INT64_MAX) {
+    *limit = INT64_MAX;
+  } else if (memberLimit <= STRIPE_HEADER_SIZE) {
+    *limit = 0;
+  } else {
+    off_t rows = (memberLimit - STRIPE_HEADER_SIZE) / sior->stripeSize;
+    *limit = rows * sior->stripeSize * sior->count;
+  }
+  return UDS_SUCCESS;
+}
+
+/*****************************************************************************/
+static int sior_getDataSize(IORegion *region, off_t *extent)
+{
+  StripedIORegion *sior = asStripedIORegion(region);
+
+  off_t end = 0;
+  for (unsigned int i = 0; i < sior->count; i++) {
+    off_t size = 0;
+    int result = getRegionDataSize(sior->members[i].region, &size);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    if (size <= STRIPE_HEADER_SIZE) {
+      continue;
+    }
+    size -= STRIPE_HEADER_SIZE;
+    // Map the last byte of the member back to the striped region.
+    off_t row   = (size - 1) / sior->stripeSize;
+    off_t phase = (size - 1) % sior->stripeSize;
+    off_t last  = ((row * sior->count + i) * sior->stripeSize) + phase;
+    if (last + 1 > end) {
+      end = last + 1;
+    }
+  }
+  *extent = end;
+  return UDS_SUCCESS;
+}
+
+/*****************************************************************************/
+static int sior_clear(IORegion *region)
+{
+  StripedIORegion *sior = asStripedIORegion(region);
+
+  IORegion *members[MAX_STRIPE_MEMBERS];
+  for (unsigned int i = 0; i < sior->count; i++) {
+    int result = clearRegion(sior->members[i].region);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    members[i] = sior->members[i].region;
+  }
+  // Clearing the members erased their headers as well.
+  return writeStripeHeaders(members, sior->count, sior->stripeSize,
+                            sior->nonce);
+}
+
+/*****************************************************************************/
+static int sior_write(IORegion   *region,
+                      off_t       offset,
+                      const void *data,
+                      size_t      size,
+                      size_t      length)
+{
+  StripedIORegion *sior = asStripedIORegion(region);
+
+  int result = validateIO(sior, offset, size, length);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  StripeTransfer transfer = {
+    .operation = STRIPE_WRITE,
+    .offset    = offset,
+    .data      = data,
+    .size      = size,
+    .length    = length,
+  };
+  return runTransfer(sior, &transfer);
+}
+
+/*****************************************************************************/
+static int sior_read(IORegion *region,
+                     off_t     offset,
+                     void     *buffer,
+                     size_t    size,
+                     size_t   *length)
+{
+  StripedIORegion *sior = asStripedIORegion(region);
+
+  size_t len = (length == NULL) ? size : *length;
+
+  int result = validateIO(sior, offset, size, len);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  StripeTransfer transfer = {
+    .operation = STRIPE_READ,
+    .offset    = offset,
+    .buffer    = buffer,
+    .size      = size,
+    .partial   = (length != NULL),
+  };
+  result = runTransfer(sior, &transfer);
+  if ((result != UDS_SUCCESS) || (length == NULL)) {
+    return result;
+  }
+
+  if (transfer.readLength < len) {
+    if (transfer.readLength == 0) {
+      return logErrorWithStringError(UDS_END_OF_FILE,
+                                     "expected at least %zd bytes, got EOF",
+                                     len);
+    } else {
+      return logErrorWithStringError(UDS_SHORT_READ,
+                                     "expected at least %zd bytes, got %zu",
+                                     len, transfer.readLength);
+    }
+  }
+  *length = transfer.readLength;
+  return UDS_SUCCESS;
+}
+
+/*****************************************************************************/
+static int sior_getBlockSize(IORegion *region, size_t *blockSize)
+{
+  *blockSize = asStripedIORegion(region)->blockSize;
+  return UDS_SUCCESS;
+}
+
+/*****************************************************************************/
+static int sior_getBestSize(IORegion *region, size_t *bufferSize)
+{
+  StripedIORegion *sior = asStripedIORegion(region);
+  *bufferSize = sior->stripeSize * sior->count;
+  return UDS_SUCCESS;
+}
+
+/*****************************************************************************/
+static int sior_syncContents(IORegion *region)
+{
+  StripedIORegion *sior = asStripedIORegion(region);
+
+  StripeTransfer transfer = {
+    .operation = STRIPE_SYNC,
+  };
+  return runTransfer(sior, &transfer);
+}
+
+/*****************************************************************************/
+static void closeMembers(IORegion **members, unsigned int count)
+{
+  for (unsigned int i = 0; i < count; i++) {
+    closeIORegion(&members[i]);
+  }
+}
+
+/*****************************************************************************/
+int makeStripedRegion(IORegion     **members,
+                      unsigned int   count,
+                      size_t         stripeSize,
+                      bool           newRegion,
+                      IORegion     **regionPtr)
+{
+  if ((count == 0) || (count > MAX_STRIPE_MEMBERS)) {
+    closeMembers(members, count);
+    return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                   "cannot stripe across %u regions", count);
+  }
+
+  size_t blockSize = 0;
+  for (unsigned int i = 0; i < count; i++) {
+    size_t memberBlockSize = 0;
+    int result = getRegionBlockSize(members[i], &memberBlockSize);
+    if (result != UDS_SUCCESS) {
+      closeMembers(members, count);
+      return result;
+    }
+    if ((stripeSize == 0) || (stripeSize % memberBlockSize != 0)) {
+      closeMembers(members, count);
+      return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                     "stripe size %zu not a multiple of"
+                                     " block size %zu", stripeSize,
+                                     memberBlockSize);
+    }
+    if (STRIPE_HEADER_SIZE % memberBlockSize != 0) {
+      closeMembers(members, count);
+      return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                     "stripe header size %u not a multiple"
+                                     " of block size %zu", STRIPE_HEADER_SIZE,
+                                     memberBlockSize);
+    }
+    blockSize = maxSizeT(blockSize, memberBlockSize);
+  }
+
+  uint64_t nonce;
+  int result;
+  if (newRegion) {
+    byte nonceData[32];
+    createUniqueNonceData(nonceData, sizeof(nonceData));
+    nonce = generateMasterNonce(nonceData, sizeof(nonceData));
+    result = writeStripeHeaders(members, count, stripeSize, nonce);
+  } else {
+    result = checkStripeHeaders(members, count, stripeSize, &nonce);
+  }
+  if (result != UDS_SUCCESS) {
+    closeMembers(members, count);
+    return result;
+  }
+
+  StripedIORegion *sior;
+  result = ALLOCATE_EXTENDED(StripedIORegion, count, StripeMember,
+                                 "striped region", &sior);
+  if (result != UDS_SUCCESS) {
+    closeMembers(members, count);
+    return result;
+  }
+  sior->common.clear        = sior_clear;
+  sior->common.close        = sior_close;
+  sior->common.getBestSize  = sior_getBestSize;
+  sior->common.getBlockSize = sior_getBlockSize;
+  sior->common.getDataSize  = sior_getDataSize;
+  sior->common.getLimit     = sior_getLimit;
+  sior->common.read         = sior_read;
+  sior->common.syncContents = sior_syncContents;
+  sior->common.write        = sior_write;
+  sior->count      = count;
+  sior->stripeSize = stripeSize;
+  sior->blockSize  = blockSize;
+  sior->nonce      = nonce;
+
+  result = initMutex(&sior->mutex);
+  if (result != UDS_SUCCESS) {
+    closeMembers(members, count);
+    FREE(sior);
+    return result;
+  }
+  result = initCond(&sior->doneCond);
+  if (result != UDS_SUCCESS) {
+    destroyMutex(&sior->mutex);
+    closeMembers(members, count);
+    FREE(sior);
+    return result;
+  }
+  for (unsigned int i = 0; i < count; i++) {
+    result = initCond(&sior->members[i].cond);
+    if (result != UDS_SUCCESS) {
+      while (i-- > 0) {
+        destroyCond(&sior->members[i].cond);
+      }
+      destroyCond(&sior->doneCond);
+      destroyMutex(&sior->mutex);
+      closeMembers(members, count);
+      FREE(sior);
+      return result;
+    }
+  }
+
+  // From here on, closing the striped region cleans everything up.
+  for (unsigned int i = 0; i < count; i++) {
+    sior->members[i].region = members[i];
+    sior->members[i].sior   = sior;
+    members[i] = NULL;
+  }
+  for (unsigned int i = 0; i < count; i++) {
+    result = createThread(memberThread, &sior->members[i], "stripeIO",
+                          &sior->members[i].thread);
+    if (result != UDS_SUCCESS) {
+      sior_close(&sior->common);
+      return result;
+    }
+    sior->startedThreads++;
+  }
+
+  *regionPtr = &sior->common;
+  return UDS_SUCCESS;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/uds-releases/homer/src/uds/stripedIORegion.h#1 $
+ */
+
+#ifndef STRIPED_IO_REGION_H
+#define STRIPED_IO_REGION_H
+
+#include "ioRegion.h"
+
+enum {
+  /** The maximum number of member regions in a striped region */
+  MAX_STRIPE_MEMBERS  = 16,
+  /** The default number of bytes placed on a member before the next one */
+  DEFAULT_STRIPE_SIZE = 256 * 1024,
+};
+
+/**
+ * Make an IORegion which stripes its contents across several member
+ * regions, so that large transfers are spread over several files or
+ * devices. Consecutive runs of stripeSize bytes are placed on the members
+ * in turn. A transfer larger than one stripe which touches several members
+ * is split up, and each member's share is read or written by a thread
+ * dedicated to that member, in parallel with the others. Syncing the
+ * region syncs all of the members in parallel.
+ *
+ * The best buffer size of the striped region is one full row of stripes,
+ * so that buffered readers and writers keep every member busy.
+ *
+ * Each member begins with a header recording the stripe size, the number
+ * of members, and the position of the member. The headers of a new region
+ * are written here; those of an existing region are checked, so that
+ * opening it with a different stripe size or with its members in another
+ * order fails.
+ *
+ * @param [in]  members     The member regions, which the striped region
+ *                            takes ownership of, even on failure
+ * @param [in]  count       The number of member regions
+ * @param [in]  stripeSize  The number of bytes in each stripe; must be a
+ *                            multiple of the block size of every member
+ * @param [in]  newRegion   Whether the striped region is being created
+ * @param [out] regionPtr   The new region
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int makeStripedRegion(IORegion     **members,
+                      unsigned int   count,
+                      size_t         stripeSize,
+                      bool           newRegion,
+                      IORegion     **regionPtr)
+  __attribute__((warn_unused_result));
+
+/**
+ * Compute the number of bytes each member of a striped region must hold,
+ * including its header, so that the striped region can hold a given
+ * number of bytes.
+ *
+ * @param limit       The required size of the striped region
+ * @param count       The number of member regions
+ * @param stripeSize  The number of bytes in each stripe
+ *
+ * @return the required size of each member
+ **/
+off_t computeStripedMemberLimit(off_t        limit,
+                                unsigned int count,
+                                size_t       stripeSize)
+  __attribute__((warn_unused_result));
+
+#endif // STRIPED_IO_REGION_H
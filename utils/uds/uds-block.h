@@ -113,6 +113,19 @@ int udsCloseBlockContext(UdsBlockContext context);
  **/
 UDS_ATTR_WARN_UNUSED_RESULT
 int udsFlushBlockContext(UdsBlockContext context);
+
+/**
+ * Sets the priority class of the requests started on a block context.
+ * The new class applies to requests started after this call returns.
+ *
+ * @param [in] context   The block context
+ * @param [in] priority  The priority class for the context's requests
+ *
+ * @return              Either #UDS_SUCCESS or an error code
+ **/
+UDS_ATTR_WARN_UNUSED_RESULT
+int udsSetBlockContextPriority(UdsBlockContext    context,
+                               UdsRequestPriority priority);
 /** @} */
 
 /** @{ */
@@ -239,6 +252,49 @@ UDS_ATTR_WARN_UNUSED_RESULT
 int udsStartChunkOperation(UdsRequest *request);
 /** @} */
 
+/** @{ */
+/** @name Bulk Loading */
+
+/**
+ * A block name and the metadata to associate with it, as passed to
+ * #udsBulkLoadChunks.
+ **/
+typedef struct udsBulkRecord {
+  /** The name of the block */
+  UdsChunkName        name;
+  /** The metadata to associate with the name */
+  struct udsChunkData metadata;
+} UdsBulkRecord;
+
+/**
+ * Adds a batch of block names and their metadata to an index without
+ * starting a request for each of them.  The records are indexed as if each
+ * had been the subject of a #UDS_UPDATE, in the order given, but the
+ * chapters holding them are filled directly by the index zones, so this is
+ * much faster than calling #udsStartChunkOperation for each record.  It is
+ * intended for pre-seeding a new index from the data already on a volume,
+ * and may be called any number of times with successive batches of a larger
+ * stream of records, which need not be sorted.  A name given more than once
+ * keeps the metadata of its last record.
+ *
+ * The records array is not modified.  During the call to
+ * #udsBulkLoadChunks, there should be no calls to #udsStartChunkOperation
+ * and no other call to #udsBulkLoadChunks or #udsSaveIndex for the same
+ * session.  If an error is returned, some of the records may have been
+ * indexed.
+ *
+ * @param [in] session  The session that has the open index
+ * @param [in] records  The records to index
+ * @param [in] count    The number of records
+ *
+ * @return Either #UDS_SUCCESS or an error code
+ **/
+UDS_ATTR_WARN_UNUSED_RESULT
+int udsBulkLoadChunks(UdsIndexSession      session,
+                      const UdsBulkRecord *records,
+                      size_t               count);
+/** @} */
+
 /** @{ */
 /** @name Monitoring */
 
@@ -94,6 +94,61 @@ extern const UdsParameterValue UDS_PARAM_FALSE;
  *      the validation function will accept strings as well. This parameter
  *      may be changed at any time.
  *
+ * UDS_ADAPTIVE_SPARSE_SAMPLING
+ *      BOOL                                                    [false]
+ *      STRING          "true", "false"
+ *      Whether a sparse index periodically adjusts the rate at which it
+ *      keeps the hooks of chapters which are about to become sparse,
+ *      keeping fewer of them while little dedupe is found in sparse chapters
+ *      and more of them again when much is. The configured sparse sample
+ *      rate is the most frequent rate used. When false, every chapter is
+ *      sampled at the configured rate. A name missing from the master
+ *      index is then looked for in the cached sparse chapters only if it is
+ *      not a hook, or if it is a hook which a thinned chapter may have
+ *      dropped. This parameter affects chapters opened after it is changed.
+ *
+ * UDS_BUFFERED_IO_DEPTH
+ *      UNSIGNED INT    1-8                                     [2]
+ *      STRING          "[number]"
+ *      The number of buffers each buffered reader or writer keeps in flight
+ *      while saving or loading index state, so that encoding and decoding
+ *      overlap with IO. A value of 1 makes all such IO synchronous. Although
+ *      stored as an unsigned int, the validation function will accept
+ *      strings as well. This parameter affects saves and loads started
+ *      after it is changed.
+ *
+ * UDS_CACHE_WARMUP_RATE
+ *      UNSIGNED INT    0-4096                                  [64]
+ *      STRING          "[number]"
+ *      The rate, in megabytes per second, at which a loaded index reads the
+ *      volume pages that were cached when it was saved back into its page
+ *      cache. A value of 0 disables this warmup. Although stored as an
+ *      unsigned int, the validation function will accept strings as well.
+ *      This parameter affects indexes loaded after it is changed.
+ *
+ * UDS_DECODE_SPARSE_CACHE
+ *      BOOL                                                    [false]
+ *      STRING          "true", "false"
+ *      Whether the sparse chapter index cache also keeps its hottest
+ *      chapter indexes, one for every four cached chapters, decoded into
+ *      flat arrays, which are searched several keys at a time instead of
+ *      decoding delta lists bit by bit. This adds about half again to the
+ *      memory used by the sparse cache. This parameter affects indexes
+ *      created or loaded after it is changed.
+ *
+ * UDS_LOOKUP_CACHE_SIZE
+ *      UNSIGNED INT    0-65536                                 [0]
+ *      STRING          "[number]"
+ *      The number of recent query results each block context remembers, so
+ *      that a query for a name queried moments before on the same context
+ *      is answered without entering the index. Posts, updates, and deletes
+ *      on the context invalidate the remembered result for their name, and
+ *      results are forgotten after 100 milliseconds, since changes made on
+ *      other contexts are not seen. A value of 0 disables the cache.
+ *      Although stored as an unsigned int, the validation function will
+ *      accept strings as well. This parameter affects block contexts opened
+ *      after it is changed.
+ *
  * UDS_PARALLEL_FACTOR
  *      UNSIGNED INT    1-16                                    [see below]
  *      STRING          "[number]"
@@ -104,22 +159,53 @@ extern const UdsParameterValue UDS_PARAM_FALSE;
  *      validation function will accept strings as well. This parameter affect
  *      how local index sessions operate.
  *
+ * UDS_REQUEST_TRACING
+ *      BOOL                                                    [false]
+ *      STRING          "true", "false"
+ *      Whether each client request records its progress through the index
+ *      (enqueued, dequeued, master index probes, sparse cache searches,
+ *      page cache misses, completed page reads, and the callback) as
+ *      timestamped events in a ring buffer of recent events kept by each
+ *      thread. The events may be written out with udsDumpRequestTrace().
+ *      This parameter affects requests started after it is changed.
+ *
+ * UDS_SCRUB_RATE
+ *      UNSIGNED INT    0-4096                                  [0]
+ *      STRING          "[number]"
+ *      The rate, in megabytes per second, at which a background thread
+ *      rereads the chapters of the volume and verifies their index and
+ *      record pages. Chapters which fail verification are reported in the
+ *      index statistics and skipped by lookups until they are overwritten.
+ *      A value of 0 disables scrubbing. Although stored as an unsigned int,
+ *      the validation function will accept strings as well. This parameter
+ *      may be changed at any time.
+ *
+ * UDS_VOLUME_READ_QUEUE_DEPTH
+ *      UNSIGNED INT    32-32768                                [4096]
+ *      STRING          "[number]"
+ *      The number of distinct volume pages that may be queued for the read
+ *      threads.  Although stored as an unsigned int, the validation function
+ *      will accept strings as well. This parameter may be changed at any
+ *      time; open local index sessions drain their queued reads and then
+ *      switch to the new size.
+ *
  * UDS_VOLUME_READ_THREADS
  *      UNSIGNED INT    1-16                                    [2]
  *      STRING          "[number]"
  *      The number of threads used to read chapters.  Although stored as an
  *      unsigned int, the validation function will accept strings as well.
- *      This parameter affect how local index sessions operate.
+ *      This parameter may be changed at any time; open local index sessions
+ *      start or retire read threads to match.
  **/
 
 /**
  * Set a run-time parameter prior to accessing an index.
  *
- * A change to a parameter value will not have an effect on contexts or
- * index sessions which have already been created, therefore best practice
- * is to set them as early as possible before the index sessions are
- * started. These parameters are not persistent across program or system
- * restarts.
+ * Unless its description above says otherwise, a change to a parameter
+ * value will not have an effect on contexts or index sessions which have
+ * already been created, therefore best practice is to set them as early as
+ * possible before the index sessions are started. These parameters are not
+ * persistent across program or system restarts.
  *
  * @param name          The parameter name.
  * @param value         The parameter value.
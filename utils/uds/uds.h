@@ -121,6 +121,148 @@ typedef struct udsIndexSession {
 typedef struct udsConfiguration *UdsConfiguration;
 typedef uint64_t UdsNonce;
 
+/**
+ * The priority classes of client requests. Each block context submits its
+ * requests in one class, which is #UDS_PRIORITY_NORMAL unless changed with
+ * #udsSetBlockContextPriority. The index request queues serve the classes
+ * in proportion to a fixed weight, favoring interactive requests over normal
+ * ones and normal requests over bulk ones, without starving any class.
+ **/
+typedef enum {
+  /** The default class */
+  UDS_PRIORITY_NORMAL = 0,
+  /** Latency-sensitive requests, such as foreground deduplication queries */
+  UDS_PRIORITY_INTERACTIVE,
+  /** Background traffic, such as bulk ingest or scrubbing */
+  UDS_PRIORITY_BULK,
+  /** The number of priority classes */
+  UDS_PRIORITY_CLASS_COUNT
+} UdsRequestPriority;
+
+/**
+ * Request queue statistics for one priority class, summed over all the
+ * request queues of the index.
+ **/
+typedef struct udsQueueClassStats {
+  /** The number of requests currently waiting in the queues */
+  uint64_t depth;
+  /** The number of requests taken from the queues */
+  uint64_t dequeued;
+  /** The total time the dequeued requests spent waiting, in nanoseconds */
+  uint64_t waitNanoseconds;
+  /** The longest time any request spent waiting, in nanoseconds */
+  uint64_t maxWaitNanoseconds;
+} UdsQueueClassStats;
+
+/**
+ * Statistics of the background volume scrubber, which rereads the chapters
+ * on storage and verifies their structure (see UDS_SCRUB_RATE).
+ **/
+typedef struct udsScrubStats {
+  /** The number of chapters verified since the index was loaded */
+  uint64_t chaptersScrubbed;
+  /** The number of complete passes over the volume */
+  uint64_t passes;
+  /** The number of chapters which failed verification */
+  uint64_t errors;
+  /** The number of chapters currently marked bad and skipped by lookups */
+  uint64_t badChapters;
+} UdsScrubStats;
+
+/**
+ * The number of windows over which dedupe estimates are reported.
+ **/
+enum {
+  UDS_DEDUPE_WINDOW_COUNT = 4
+};
+
+/**
+ * An estimate of how much the chunks posted to the index in some window
+ * deduplicate. The dedupe ratio is chunks / distinctChunks. Distinct counts
+ * are estimated with HyperLogLog sketches and have a standard error of
+ * about 1.6%, but unlike entriesIndexed they are not limited to what the
+ * index still remembers.
+ **/
+typedef struct udsDedupeWindow {
+  /**
+   * The number of most recent chapters covered by the window, or zero for
+   * the window covering everything since the index was opened
+   **/
+  uint64_t chapters;
+  /** The number of post and update requests in the window */
+  uint64_t chunks;
+  /** The estimated number of distinct chunk names among those requests */
+  uint64_t distinctChunks;
+} UdsDedupeWindow;
+
+/**
+ * Statistics of the adaptive sampling of a sparse index (see
+ * UDS_ADAPTIVE_SPARSE_SAMPLING). Each chapter is sampled at the configured
+ * sparse sample rate multiplied by a power of two chosen when the chapter
+ * is opened, from the share of recent dedupe hits which came from sparse
+ * chapters. All fields are zero for a dense index.
+ **/
+typedef struct udsSparseSamplingStats {
+  /** The configured sparse sample rate, the densest rate which is used */
+  uint64_t baseRate;
+  /** The sample rate of the open chapter */
+  uint64_t currentRate;
+  /** The number of times the sample rate has changed */
+  uint64_t rateChanges;
+  /** The number of requests which found their chunk in a sparse chapter */
+  uint64_t sparseHits;
+  /** The number of requests which found their chunk anywhere in the index */
+  uint64_t dedupeHits;
+  /** The number of hooks (sampled entries) in the master index */
+  uint64_t hookEntries;
+  /**
+   * The number of hooks removed from the master index when their chapters
+   * became sparse because they were not samples at those chapters' rates
+   **/
+  uint64_t hooksPruned;
+} UdsSparseSamplingStats;
+
+/**
+ * The parts of UDS which memory allocations are charged to.
+ **/
+typedef enum {
+  /** Allocations not made on behalf of any of the components below */
+  UDS_MEMORY_OTHER = 0,
+  /** The master index, apart from its delta memory */
+  UDS_MEMORY_MASTER_INDEX,
+  /** The delta lists of the master index and the open chapter indexes */
+  UDS_MEMORY_DELTA_MEMORY,
+  /** The volume page cache and its read queue */
+  UDS_MEMORY_PAGE_CACHE,
+  /** The open chapter records of each zone */
+  UDS_MEMORY_OPEN_CHAPTER,
+  /** The sparse chapter index cache */
+  UDS_MEMORY_SPARSE_CACHE,
+  /** The chapter writer, apart from its delta memory */
+  UDS_MEMORY_CHAPTER_WRITER,
+  /** The per-thread pools of internal requests */
+  UDS_MEMORY_REQUEST_POOLS,
+  /** The number of memory components */
+  UDS_MEMORY_COMPONENT_COUNT
+} UdsMemoryComponent;
+
+/**
+ * Memory usage of one component, summed over every index in the process.
+ **/
+typedef struct udsMemoryComponentStats {
+  /** The number of bytes currently allocated */
+  uint64_t liveBytes;
+  /** The largest number of bytes allocated at any one time */
+  uint64_t peakBytes;
+} UdsMemoryComponentStats;
+
+/**
+ * Memory usage statistics, indexed by #UdsMemoryComponent.
+ **/
+typedef struct udsMemoryStats {
+  UdsMemoryComponentStats components[UDS_MEMORY_COMPONENT_COUNT];
+} UdsMemoryStats;
+
 /**
  * Index statistics
  *
@@ -140,6 +282,17 @@ typedef struct udsIndexStats {
   uint64_t      entriesDiscarded;
   /** The number of checkpoints done this session */
   uint64_t      checkpoints;
+  /** Request queue statistics, indexed by #UdsRequestPriority */
+  UdsQueueClassStats queueClasses[UDS_PRIORITY_CLASS_COUNT];
+  /** Volume scrubber statistics */
+  UdsScrubStats      scrub;
+  /**
+   * Dedupe estimates covering the most recent 1, 8, and 64 chapters, and
+   * the whole time the index has been open
+   **/
+  UdsDedupeWindow    dedupeWindows[UDS_DEDUPE_WINDOW_COUNT];
+  /** Adaptive sparse sampling statistics */
+  UdsSparseSamplingStats sampling;
 } UdsIndexStats;
 
 /**
@@ -209,6 +362,13 @@ typedef struct udsContextStats {
    * did not find an entry
    **/
   uint64_t queriesNotFound;
+  /**
+   * The number of query calls since context statistics were last reset that
+   * were answered from the lookup cache of a block context without entering
+   * the index (see UDS_LOOKUP_CACHE_SIZE). These are also counted as found
+   * or not found queries.
+   **/
+  uint64_t lookupCacheHits;
   /**
    * The total number of library requests (the sum of posts, updates,
    * deletions, and queries) since context
@@ -270,6 +430,45 @@ void udsConfigurationSetNonce(UdsConfiguration conf, UdsNonce nonce);
 UDS_ATTR_WARN_UNUSED_RESULT
 UdsNonce udsConfigurationGetNonce(UdsConfiguration conf);
 
+/**
+ * Sets whether an index configuration uses packed record pages, and if so,
+ * how many bytes of each record's metadata are stored.
+ *
+ * A packed record page stores one base metadata value and, for each record,
+ * the difference between the record's metadata and that base, as an
+ * unsigned little-endian integer of the given number of bytes. Packed pages
+ * hold more records, so the same volume and page cache cover more blocks.
+ * Metadata values which are far apart, such as block addresses without
+ * locality, do not pack well: a record whose metadata cannot be stored is
+ * kept on its page, but will no longer be found by queries.
+ *
+ * The default of zero stores complete metadata. Indexes with packed record
+ * pages cannot be loaded by versions of UDS which do not support them.
+ *
+ * @param [in,out] conf         The configuration to change
+ * @param [in] packedBytes      The number of bytes of each packed metadata
+ *                              offset, which must be less than
+ *                              #UDS_MAX_METADATA_SIZE, or zero to store
+ *                              complete metadata
+ *
+ * @return                      Either #UDS_SUCCESS or an error code
+ **/
+UDS_ATTR_WARN_UNUSED_RESULT
+int udsConfigurationSetPackedMetadataBytes(UdsConfiguration conf,
+                                           unsigned int     packedBytes);
+
+/**
+ * Gets the number of bytes of metadata stored in each record of a packed
+ * record page.
+ *
+ * @param [in] conf  The configuration to check
+ *
+ * @return  The number of bytes of each packed metadata offset, or zero if
+ *          record pages are not packed
+ **/
+UDS_ATTR_WARN_UNUSED_RESULT
+unsigned int udsConfigurationGetPackedMetadataBytes(UdsConfiguration conf);
+
 /**
  * Sets an index configuration's checkpoint frequency.
  *
@@ -326,7 +525,9 @@ void udsFreeConfiguration(UdsConfiguration conf);
  * Compute the size required to store the index on persistent storage.  This
  * size is valid for any index stored in a single file or on a single block
  * device.  This size should be used when configuring a block device on which
- * to store an index.
+ * to store an index.  An index created in more space than this uses the
+ * extra space to save its cache hot set, which lets a restarted index warm
+ * its caches quickly, and then for additional saves.
  *
  * @param [in]  config          A UdsConfiguration for an index.
  * @param [in]  numCheckpoints  The maximum number of checkpoints.
@@ -362,7 +563,28 @@ const char *udsGetVersion(void);
  * contain size and/or offset options which give the number of bytes in the
  * index and the byte offset to the start of the index.  For example, the name
  * "file=/dev/sda8 offset=409600 size=2048000000" is an index that is stored in
- * 2040000000 bytes of /dev/sda8 starting at byte 409600.
+ * 2040000000 bytes of /dev/sda8 starting at byte 409600.  The option
+ * "direct=1" reads volume pages with O_DIRECT, so that they are cached only
+ * by the index page cache and not also by the kernel; if the file cannot be
+ * opened for direct I/O, buffered reads are used instead.
+ *
+ * A single index may be striped across several files or block devices by
+ * giving a comma-separated list of names as the path, for example
+ * "file=/dev/nvme0n1,/dev/nvme1n1 stripe=262144".  Runs of "stripe" bytes
+ * (262144 by default) are placed on each device in turn, and large reads
+ * and writes are spread over all of the devices in parallel.  The size and
+ * offset options apply to the index as a whole.  Each file records its
+ * place in the list and the stripe size, so the same list, in the same
+ * order, and the same stripe size must be given whenever the index is
+ * loaded or rebuilt; otherwise the index will not be opened.
+ *
+ * A local index may be sharded across several files or block devices by
+ * giving the name of each shard, separated by semicolons.  For example, the
+ * name "file=/dev/nvme0n1;file=/dev/nvme1n1" is an index with two shards.
+ * Each shard is a complete index with its own volume, cache, and zone
+ * threads, sized by the configuration given to udsCreateLocalIndex, and
+ * chunk names are distributed evenly across the shards.  The shards must be
+ * named in the same order whenever the index is loaded or rebuilt.
  **/
 
 /**
@@ -522,6 +744,33 @@ int udsGetIndexConfiguration(UdsIndexSession session, UdsConfiguration *conf);
 UDS_ATTR_WARN_UNUSED_RESULT
 int udsGetIndexStats(UdsIndexSession session, UdsIndexStats *stats);
 
+/**
+ * Fetches the memory allocated by UDS in this process, broken down by
+ * component. Unlike the memoryUsed index statistic, which is an estimate,
+ * these counts are kept by the allocator as memory is allocated and freed.
+ *
+ * @param [out] stats   The memory statistics structure to fill
+ *
+ * @return              Either #UDS_SUCCESS or an error code
+ **/
+UDS_ATTR_WARN_UNUSED_RESULT
+int udsGetMemoryStats(UdsMemoryStats *stats);
+
+/**
+ * Writes the request trace events recorded by every thread in this process
+ * (see UDS_REQUEST_TRACING) to a file, in the JSON format of the Chrome
+ * trace event viewer. Each event is an asynchronous instant event whose id
+ * identifies the request, so the events of one request can be followed
+ * across the threads which handled it. Only the most recent events of each
+ * thread are kept.
+ *
+ * @param [in] path     The name of the file to write
+ *
+ * @return              Either #UDS_SUCCESS or an error code
+ **/
+UDS_ATTR_WARN_UNUSED_RESULT
+int udsDumpRequestTrace(const char *path);
+
 /**
  * The possible status that an index server can return.
  **/
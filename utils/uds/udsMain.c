@@ -29,8 +29,12 @@
 #include "indexSession.h"
 #include "logger.h"
 #include "memoryAlloc.h"
+#include "stringUtils.h"
 #include "udsState.h"
 
+// The separator between the names of the shards of a sharded local index
+static const char *SHARD_NAME_DELIMITERS = ";";
+
 const UdsMemoryConfigSize UDS_MEMORY_CONFIG_MAX   = 1024;
 const UdsMemoryConfigSize UDS_MEMORY_CONFIG_256MB = (UdsMemoryConfigSize) -256;
 const UdsMemoryConfigSize UDS_MEMORY_CONFIG_512MB = (UdsMemoryConfigSize) -512;
@@ -102,6 +106,7 @@ int udsInitializeConfiguration(UdsConfiguration    *userConfig,
   (*userConfig)->bytesPerPage            = DEFAULT_BYTES_PER_PAGE;
   (*userConfig)->sparseSampleRate        = DEFAULT_SPARSE_SAMPLE_RATE;
   (*userConfig)->nonce                   = 0;
+  (*userConfig)->packedMetadataBytes     = 0;
   return UDS_SUCCESS;
 }
 
@@ -146,6 +151,27 @@ UdsNonce udsConfigurationGetNonce(UdsConfiguration userConfig)
   return userConfig->nonce;
 }
 
+/**********************************************************************/
+int udsConfigurationSetPackedMetadataBytes(UdsConfiguration userConfig,
+                                           unsigned int     packedBytes)
+{
+  if (packedBytes >= UDS_MAX_BLOCK_DATA_SIZE) {
+    return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                   "packed metadata must be smaller than"
+                                   " %u bytes",
+                                   UDS_MAX_BLOCK_DATA_SIZE);
+  }
+  userConfig->packedMetadataBytes = packedBytes;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+unsigned int udsConfigurationGetPackedMetadataBytes(
+  UdsConfiguration userConfig)
+{
+  return userConfig->packedMetadataBytes;
+}
+
 /**********************************************************************/
 int udsConfigurationSetCheckpointFrequency(
   UdsConfiguration userConfig,
@@ -199,6 +225,59 @@ void udsFreeConfiguration(UdsConfiguration userConfig)
   FREE(userConfig);
 }
 
+/**
+ * Make a local grid with one index shard for each location in a grid
+ * configuration.
+ *
+ * @param indexSession  The index session which will own the grid
+ * @param gridConfig    The locations of the index shards
+ * @param loadType      How to load the index
+ * @param userConfig    The configuration of the index
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int makeLocalIndexGrid(IndexSession     *indexSession,
+                              UdsGridConfig     gridConfig,
+                              LoadType          loadType,
+                              UdsConfiguration  userConfig)
+{
+  unsigned int numLayouts = gridConfig->numLocations;
+  IndexLayout **layouts;
+  int result = ALLOCATE(numLayouts, IndexLayout *, "index layouts", &layouts);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  for (unsigned int i = 0; i < numLayouts; i++) {
+    result = makeIndexLayout(gridConfig->locations[i].directory,
+                             loadType == LOAD_CREATE, userConfig,
+                             &layouts[i]);
+    if (result != UDS_SUCCESS) {
+      break;
+    }
+  }
+
+  if (result == UDS_SUCCESS) {
+    result = makeLocalGrid(layouts, numLayouts, loadType, userConfig,
+                           enterCallbackStage, &indexSession->grid);
+  }
+
+  if (result == UDS_SUCCESS) {
+    // on success, the layouts become owned by the grid...
+    for (unsigned int i = 0; (i < numLayouts) && (result == UDS_SUCCESS);
+         i++) {
+      result = removeSafetySeal(layouts[i]);
+    }
+  } else {
+    // on failure, we must free the layouts
+    for (unsigned int i = 0; i < numLayouts; i++) {
+      freeIndexLayout(&layouts[i]);
+    }
+  }
+  FREE(layouts);
+  return result;
+}
+
 /**********************************************************************/
 static int initializeIndexSession(IndexSession     *indexSession,
                                   UdsGridConfig     gridConfig,
@@ -225,20 +304,8 @@ static int initializeIndexSession(IndexSession     *indexSession,
       return result;
     }
   } else {
-    IndexLayout *layout;
-    result = makeIndexLayout(gridConfig->locations[0].directory,
-                             loadType == LOAD_CREATE, userConfig, &layout);
-    if (result == UDS_SUCCESS) {
-      result = makeLocalGrid(layout, loadType, userConfig, enterCallbackStage,
-                             &indexSession->grid);
-      if (result == UDS_SUCCESS) {
-        // on success, the layout becomes owned by the grid...
-        result = removeSafetySeal(layout);
-      } else {
-        // on failure, we must free the layout
-        freeIndexLayout(&layout);
-      }
-    }
+    result = makeLocalIndexGrid(indexSession, gridConfig, loadType,
+                                userConfig);
     if (result != UDS_SUCCESS) {
       logErrorWithStringError(result, "Failed %s", getLoadType(loadType));
       return result;
@@ -351,7 +418,25 @@ static int makeLocalIndex(const char       *name,
     return result;
   }
 
-  result = addGridServer(gridConfig, NULL, NULL, name);
+  // Each index shard of a sharded local index is named separately, with
+  // the names separated by semicolons.
+  char *names;
+  result = duplicateString(name, "index names", &names);
+  if (result != UDS_SUCCESS) {
+    udsFreeGridConfig(gridConfig);
+    return result;
+  }
+
+  char *state = NULL;
+  for (char *shard = nextToken(names, SHARD_NAME_DELIMITERS, &state);
+       shard != NULL;
+       shard = nextToken(NULL, SHARD_NAME_DELIMITERS, &state)) {
+    result = addGridServer(gridConfig, NULL, NULL, shard);
+    if (result != UDS_SUCCESS) {
+      break;
+    }
+  }
+  FREE(names);
   if (result != UDS_SUCCESS) {
     udsFreeGridConfig(gridConfig);
     return result;
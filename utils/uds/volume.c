@@ -35,14 +35,25 @@
 #include "permassert.h"
 #include "recordPage.h"
 #include "request.h"
+#include "requestTrace.h"
 #include "sparseCache.h"
 #include "stringUtils.h"
 #include "threads.h"
+#include "timeUtils.h"
 #include "volumeInternals.h"
 
 enum {
   MAX_BAD_CHAPTERS    = 100,   // max number of contiguous bad chapters
-  VOLUME_READ_THREADS = 2      // Number of reader threads
+  VOLUME_READ_THREADS = 2,     // Number of reader threads
+  CACHE_WARMUP_RATE   = 64,    // Default warmup read rate in MB/s
+  MAX_WARMUP_RATE     = 4096,  // Maximum warmup read rate in MB/s
+  WARMUP_RUN_PAGES    = 64,    // Maximum pages read by one warmup IO
+  WARMUP_GAP_PAGES    = 4,     // Maximum unwanted pages read to merge IOs
+  SCRUB_RATE          = 0,     // Default scrub read rate in MB/s (disabled)
+  MAX_SCRUB_RATE      = 4096,  // Maximum scrub read rate in MB/s
+  SCRUB_IDLE_MS       = 1000,  // Wait after a pass which found no chapters
+  // Number of chapters probed at once when finding the chapter boundaries
+  CHAPTER_PROBE_THREADS = MAX_CHAPTER_PROBE_WIDTH,
 };
 
 static const NumericValidationData validRange = {
@@ -50,6 +61,17 @@ static const NumericValidationData validRange = {
   .maxValue = MAX_VOLUME_READ_THREADS,
 };
 
+/*
+ * The volumes with running read threads, so that changes to the read thread
+ * and read queue parameters can be applied to them. The mutex also
+ * serializes those changes.
+ */
+static Mutex   liveVolumesMutex = MUTEX_INITIALIZER;
+static Volume *liveVolumes      = NULL;
+
+static int setVolumeReadThreads(Volume *volume, unsigned int threadCount);
+static int setVolumeReadQueueDepth(Volume *volume, unsigned int depth);
+
 /**********************************************************************/
 static UdsParameterValue getDefaultReadThreads(void)
 {
@@ -71,16 +93,201 @@ static UdsParameterValue getDefaultReadThreads(void)
   return value;
 }
 
+/**
+ * Apply a new read thread count to every live volume.
+ *
+ * @param value  the new value of the UDS_VOLUME_READ_THREADS parameter
+ **/
+static void updateReadThreads(const UdsParameterValue *value)
+{
+  lockMutex(&liveVolumesMutex);
+  for (Volume *volume = liveVolumes; volume != NULL;
+       volume = volume->nextLiveVolume) {
+    int result = setVolumeReadThreads(volume, value->value.u_uint);
+    if (result != UDS_SUCCESS) {
+      logWarningWithStringError(result, "could not change read threads");
+    }
+  }
+  unlockMutex(&liveVolumesMutex);
+}
+
 /**********************************************************************/
 int defineVolumeReadThreads(ParameterDefinition *pd)
 {
   pd->validate       = validateNumericRange;
   pd->validationData = &validRange;
   pd->currentValue   = getDefaultReadThreads();
+  pd->update         = updateReadThreads;
+  return UDS_SUCCESS;
+}
+
+static const NumericValidationData readQueueDepthRange = {
+  .minValue = VOLUME_CACHE_MIN_QUEUED_READS,
+  .maxValue = VOLUME_CACHE_MAX_QUEUED_READS,
+};
+
+/**********************************************************************/
+static UdsParameterValue getDefaultReadQueueDepth(void)
+{
+  UdsParameterValue value;
+#if ENVIRONMENT
+  char *env = getenv(UDS_VOLUME_READ_QUEUE_DEPTH);
+  if (env != NULL) {
+    UdsParameterValue tmp = {
+      .type = UDS_PARAM_TYPE_STRING,
+      .value.u_string = env,
+    };
+    if (validateNumericRange(&tmp, &readQueueDepthRange, &value)
+        == UDS_SUCCESS) {
+      return value;
+    }
+  }
+#endif // ENVIRONMENT
+  value.type = UDS_PARAM_TYPE_UNSIGNED_INT;
+  value.value.u_uint = VOLUME_CACHE_DEFAULT_MAX_QUEUED_READS;
+  return value;
+}
+
+/**
+ * Apply a new read queue size to every live volume.
+ *
+ * @param value  the new value of the UDS_VOLUME_READ_QUEUE_DEPTH parameter
+ **/
+static void updateReadQueueDepth(const UdsParameterValue *value)
+{
+  lockMutex(&liveVolumesMutex);
+  for (Volume *volume = liveVolumes; volume != NULL;
+       volume = volume->nextLiveVolume) {
+    int result = setVolumeReadQueueDepth(volume, value->value.u_uint);
+    if (result != UDS_SUCCESS) {
+      logWarningWithStringError(result, "could not resize read queue");
+    }
+  }
+  unlockMutex(&liveVolumesMutex);
+}
+
+/**********************************************************************/
+int defineVolumeReadQueueDepth(ParameterDefinition *pd)
+{
+  pd->validate       = validateNumericRange;
+  pd->validationData = &readQueueDepthRange;
+  pd->currentValue   = getDefaultReadQueueDepth();
+  pd->update         = updateReadQueueDepth;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+unsigned int getVolumeReadQueueDepth(void)
+{
+  UdsParameterValue value;
+  if ((udsGetParameter(UDS_VOLUME_READ_QUEUE_DEPTH, &value) == UDS_SUCCESS)
+      && (value.type == UDS_PARAM_TYPE_UNSIGNED_INT)) {
+    return value.value.u_uint;
+  }
+  return VOLUME_CACHE_DEFAULT_MAX_QUEUED_READS;
+}
+
+static const NumericValidationData warmupRateRange = {
+  .minValue = 0,
+  .maxValue = MAX_WARMUP_RATE,
+};
+
+/**********************************************************************/
+static UdsParameterValue getDefaultWarmupRate(void)
+{
+  UdsParameterValue value;
+#if ENVIRONMENT
+  char *env = getenv(UDS_CACHE_WARMUP_RATE);
+  if (env != NULL) {
+    UdsParameterValue tmp = {
+      .type = UDS_PARAM_TYPE_STRING,
+      .value.u_string = env,
+    };
+    if (validateNumericRange(&tmp, &warmupRateRange, &value) == UDS_SUCCESS) {
+      return value;
+    }
+  }
+#endif // ENVIRONMENT
+  value.type = UDS_PARAM_TYPE_UNSIGNED_INT;
+  value.value.u_uint = CACHE_WARMUP_RATE;
+  return value;
+}
+
+/**********************************************************************/
+int defineCacheWarmupRate(ParameterDefinition *pd)
+{
+  pd->validate       = validateNumericRange;
+  pd->validationData = &warmupRateRange;
+  pd->currentValue   = getDefaultWarmupRate();
   pd->update         = NULL;
   return UDS_SUCCESS;
 }
 
+static const NumericValidationData scrubRateRange = {
+  .minValue = 0,
+  .maxValue = MAX_SCRUB_RATE,
+};
+
+/**********************************************************************/
+static UdsParameterValue getDefaultScrubRate(void)
+{
+  UdsParameterValue value;
+#if ENVIRONMENT
+  char *env = getenv(UDS_SCRUB_RATE);
+  if (env != NULL) {
+    UdsParameterValue tmp = {
+      .type = UDS_PARAM_TYPE_STRING,
+      .value.u_string = env,
+    };
+    if (validateNumericRange(&tmp, &scrubRateRange, &value) == UDS_SUCCESS) {
+      return value;
+    }
+  }
+#endif // ENVIRONMENT
+  value.type = UDS_PARAM_TYPE_UNSIGNED_INT;
+  value.value.u_uint = SCRUB_RATE;
+  return value;
+}
+
+/**
+ * Wake the scrubbers of the open volumes so they notice a new scrub rate.
+ *
+ * @param value  The new scrub rate (unused; the scrubbers reread it)
+ **/
+static void updateScrubRate(const UdsParameterValue *value
+                            __attribute__((unused)))
+{
+  lockMutex(&liveVolumesMutex);
+  for (Volume *volume = liveVolumes; volume != NULL;
+       volume = volume->nextLiveVolume) {
+    lockMutex(&volume->readThreadsMutex);
+    broadcastCond(&volume->scrubCond);
+    unlockMutex(&volume->readThreadsMutex);
+  }
+  unlockMutex(&liveVolumesMutex);
+}
+
+/**********************************************************************/
+int defineScrubRate(ParameterDefinition *pd)
+{
+  pd->validate       = validateNumericRange;
+  pd->validationData = &scrubRateRange;
+  pd->currentValue   = getDefaultScrubRate();
+  pd->update         = updateScrubRate;
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+static unsigned int getScrubRate(void)
+{
+  UdsParameterValue value;
+  if ((udsGetParameter(UDS_SCRUB_RATE, &value) == UDS_SUCCESS) &&
+      (value.type == UDS_PARAM_TYPE_UNSIGNED_INT)) {
+    return value.value.u_uint;
+  }
+  return SCRUB_RATE;
+}
+
 /**********************************************************************/
 int formatVolume(IORegion *region, const Geometry *geometry)
 {
@@ -172,6 +379,7 @@ int enqueuePageRead(Volume *volume, Request *request, int physicalPage)
     logInfo("failed to queue read while shutting down");
     return UDS_SHUTTINGDOWN;
   }
+  traceRequest(request, TRACE_PAGE_CACHE_MISS, physicalPage);
 
   // Mark the page as queued in the volume cache, for chapter invalidation to
   // be able to cancel a read.
@@ -192,13 +400,22 @@ int enqueuePageRead(Volume *volume, Request *request, int physicalPage)
 }
 
 /**********************************************************************/
-static INLINE void waitToReserveReadQueueEntry(Volume       *volume,
+static INLINE bool readerShouldExit(const ReaderThread *reader)
+{
+  const Volume *volume = reader->volume;
+  return (((volume->readerState & READER_STATE_EXIT) != 0)
+          || (reader->number >= volume->numReadThreads));
+}
+
+/**********************************************************************/
+static INLINE void waitToReserveReadQueueEntry(ReaderThread *reader,
                                                unsigned int *queuePos,
                                                UdsQueueHead *queuedRequests,
                                                unsigned int *physicalPage,
                                                bool         *invalid)
 {
-  while (((volume->readerState & READER_STATE_EXIT) == 0)
+  Volume *volume = reader->volume;
+  while (!readerShouldExit(reader)
          && (((volume->readerState & READER_STATE_STOP) != 0)
              || !reserveReadQueueEntry(volume->pageCache, queuePos,
                                        queuedRequests, physicalPage,
@@ -275,7 +492,8 @@ static int initializeIndexPage(const Volume *volume,
 /**********************************************************************/
 static void readThreadFunction(void *arg)
 {
-  Volume       *volume  = arg;
+  ReaderThread *reader  = arg;
+  Volume       *volume  = reader->volume;
   unsigned int  queuePos;
   UdsQueueHead  queuedRequests;
   unsigned int  physicalPage;
@@ -284,9 +502,9 @@ static void readThreadFunction(void *arg)
   logDebug("reader starting");
   lockMutex(&volume->readThreadsMutex);
   while (true) {
-    waitToReserveReadQueueEntry(volume, &queuePos, &queuedRequests,
+    waitToReserveReadQueueEntry(reader, &queuePos, &queuedRequests,
                                 &physicalPage, &invalid);
-    if ((volume->readerState & READER_STATE_EXIT) != 0) {
+    if (readerShouldExit(reader)) {
       break;
     }
 
@@ -369,6 +587,7 @@ static void readThreadFunction(void *arg)
 
       // reflect any read failures in the request status
       request->status = result;
+      traceRequest(request, TRACE_READ_COMPLETE, physicalPage);
       restartRequest(request);
     }
 
@@ -662,6 +881,11 @@ int searchCachedRecordPage(Volume             *volume,
     return UDS_SUCCESS;
   }
 
+  if (isChapterMarkedBad(volume, chapter)) {
+    // The scrubber found the chapter corrupt, so treat its records as gone.
+    return UDS_SUCCESS;
+  }
+
   Geometry *geometry = volume->geometry;
   int result = ASSERT(((recordPageNumber >= 0)
                        && ((unsigned int) recordPageNumber
@@ -736,6 +960,11 @@ int searchVolumePageCache(Volume             *volume,
 {
   unsigned int physicalChapter
     = mapToPhysicalChapter(volume->geometry, virtualChapter);
+  if (isChapterMarkedBad(volume, physicalChapter)) {
+    *found = false;
+    return UDS_SUCCESS;
+  }
+
   unsigned int indexPageNumber;
   int result = findIndexPageNumber(volume->indexPageMap, name, physicalChapter,
                                    &indexPageNumber);
@@ -767,10 +996,29 @@ int forgetChapter(Volume             *volume,
     = invalidatePageCacheForChapter(volume->pageCache, physicalChapter,
                                     volume->geometry->pagesPerChapter,
                                     reason);
+  volume->forgottenChapters++;
   unlockMutex(&volume->readThreadsMutex);
   return result;
 }
 
+/**
+ * Write out any pages gathered in the write batch of a volume.
+ *
+ * @param volume  The volume
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int flushWriteBatch(Volume *volume)
+{
+  if (volume->writeBatchCount == 0) {
+    return UDS_SUCCESS;
+  }
+  size_t size = volume->writeBatchCount * volume->geometry->bytesPerPage;
+  volume->writeBatchCount = 0;
+  return writeToRegion(volume->region, volume->writeBatchOffset,
+                       volume->writeBatch, size, size);
+}
+
 /**********************************************************************/
 static int writeScratchPage(Volume *volume, off_t *offset)
 {
@@ -781,6 +1029,36 @@ static int writeScratchPage(Volume *volume, off_t *offset)
   return result;
 }
 
+/**
+ * Write the scratch page to the volume as the next page of a run of
+ * consecutive pages. If the volume has a write batch, the page is only
+ * copied into the batch, which is written when it is full or flushed.
+ *
+ * @param volume  The volume
+ * @param offset  The offset at which to write the page, which is advanced
+ *                past it
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int batchScratchPage(Volume *volume, off_t *offset)
+{
+  if (volume->writeBatch == NULL) {
+    return writeScratchPage(volume, offset);
+  }
+
+  size_t bytesPerPage = volume->geometry->bytesPerPage;
+  if (volume->writeBatchCount == 0) {
+    volume->writeBatchOffset = *offset;
+  }
+  memcpy(volume->writeBatch + (volume->writeBatchCount * bytesPerPage),
+         volume->scratchPage, bytesPerPage);
+  *offset += bytesPerPage;
+  if (++volume->writeBatchCount < volume->writeBatchPages) {
+    return UDS_SUCCESS;
+  }
+  return flushWriteBatch(volume);
+}
+
 /**********************************************************************/
 void updateVolumeSize(Volume *volume, off_t size)
 {
@@ -915,6 +1193,8 @@ int writeRecordPages(Volume                *volume,
   off_t pageOffset = chapterOffset + geometry->recordPageOffset;
   // The record array from the open chapter is 1-based.
   const UdsChunkRecord *nextRecord = &records[1];
+  // Discard anything left in the write batch by an earlier failure.
+  volume->writeBatchCount = 0;
 
   for (unsigned int recordPageNumber = 0;
        recordPageNumber < geometry->recordPagesPerChapter;
@@ -930,7 +1210,7 @@ int writeRecordPages(Volume                *volume,
     nextRecord += geometry->recordsPerPage;
 
     // Write the scratch page to the volume as the next record page.
-    result = writeScratchPage(volume, &pageOffset);
+    result = batchScratchPage(volume, &pageOffset);
     if (result != UDS_SUCCESS) {
       return logWarningWithStringError(result, "failed to write record page %u",
                                        recordPageNumber);
@@ -942,6 +1222,11 @@ int writeRecordPages(Volume                *volume,
     }
   }
 
+  int result = flushWriteBatch(volume);
+  if (result != UDS_SUCCESS) {
+    return logWarningWithStringError(result, "failed to write record pages");
+  }
+
   return ASSERT((pageOffset
                  == (chapterOffset + (off_t) geometry->bytesPerChapter)),
                 "unexpected page offset");
@@ -959,6 +1244,20 @@ int writeChapter(Volume                 *volume,
   int physicalPage = mapToPhysicalPage(geometry, physicalChapterNumber, 0);
   off_t chapterOffset = (off_t) physicalPage * (off_t) geometry->bytesPerPage;
 
+  // Retire the chapter being overwritten before its pages change, so that a
+  // scrub of it which overlaps this write is discarded.
+  uint64_t virtualChapter = chapterIndex->virtualChapterNumber;
+  lockMutex(&volume->readThreadsMutex);
+  if (virtualChapter + 1 > volume->scrubOldest + geometry->chaptersPerVolume) {
+    volume->scrubOldest = virtualChapter + 1 - geometry->chaptersPerVolume;
+  }
+  if ((volume->badChapters != NULL)
+      && volume->badChapters[physicalChapterNumber]) {
+    volume->badChapters[physicalChapterNumber] = false;
+    volume->scrubStats.badChapters--;
+  }
+  unlockMutex(&volume->readThreadsMutex);
+
   // Pack and write the delta chapter index pages to the volume.
   int result = writeIndexPages(volume, chapterOffset, chapterIndex, NULL);
   if (result != UDS_SUCCESS) {
@@ -970,6 +1269,12 @@ int writeChapter(Volume                 *volume,
     return result;
   }
   updateVolumeSize(volume, chapterOffset + geometry->bytesPerChapter);
+
+  lockMutex(&volume->readThreadsMutex);
+  if (virtualChapter + 1 > volume->scrubNewest) {
+    volume->scrubNewest = virtualChapter + 1;
+  }
+  unlockMutex(&volume->readThreadsMutex);
   return UDS_SUCCESS;
 }
 
@@ -1007,24 +1312,37 @@ off_t offsetForChapter(const Geometry *geometry,
     (((off_t) chapter) * geometry->bytesPerChapter);    // chapter span
 }
 
-/**********************************************************************/
-static int probeChapter(Volume       *volume,
-                        unsigned int  chapterNumber,
-                        uint64_t     *virtualChapterNumber)
+/**
+ * Verify the index pages of a chapter which have been read into memory,
+ * and determine which virtual chapter they belong to.
+ *
+ * @param volume                The volume.
+ * @param buffer                The index pages of the chapter.
+ * @param chapterNumber         The physical chapter number.
+ * @param virtualChapterNumber  A pointer to hold the virtual chapter number.
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int validateChapterIndexBuffer(const Volume *volume,
+                                      byte         *buffer,
+                                      unsigned int  chapterNumber,
+                                      uint64_t     *virtualChapterNumber)
 {
   const Geometry *geometry = volume->geometry;
   unsigned int expectedListNumber = 0;
   uint64_t lastVCN = UINT64_MAX;
+  int result;
 
   for (unsigned int i = 0; i < geometry->indexPagesPerChapter; ++i) {
-    ChapterIndexPage *page;
-    int result = getPage(volume, chapterNumber, i, CACHE_PROBE_INDEX_FIRST,
-                         NULL, &page);
+    ChapterIndexPage page;
+    result = initializeChapterIndexPage(&page, geometry,
+                                        buffer + i * geometry->bytesPerPage,
+                                        volume->nonce);
     if (result != UDS_SUCCESS) {
       return result;
     }
 
-    uint64_t vcn = getChapterIndexVirtualChapterNumber(page);
+    uint64_t vcn = getChapterIndexVirtualChapterNumber(&page);
     if (lastVCN == UINT64_MAX) {
       lastVCN = vcn;
     } else if (vcn != lastVCN) {
@@ -1034,16 +1352,16 @@ static int probeChapter(Volume       *volume,
       return UDS_CORRUPT_COMPONENT;
     }
 
-    if (expectedListNumber != getChapterIndexLowestListNumber(page)) {
+    if (expectedListNumber != getChapterIndexLowestListNumber(&page)) {
       logError("inconsistent chapter %u index page %u: expected list number %u"
                ", got list number %u",
                chapterNumber, i, expectedListNumber,
-               getChapterIndexLowestListNumber(page));
+               getChapterIndexLowestListNumber(&page));
       return UDS_CORRUPT_COMPONENT;
     }
-    expectedListNumber = getChapterIndexHighestListNumber(page) + 1;
+    expectedListNumber = getChapterIndexHighestListNumber(&page) + 1;
 
-    result = validateChapterIndexPage(page, geometry);
+    result = validateChapterIndexPage(&page, geometry);
     if (result != UDS_SUCCESS) {
       return result;
     }
@@ -1063,21 +1381,212 @@ static int probeChapter(Volume       *volume,
 }
 
 /**********************************************************************/
-static int probeWrapper(void         *aux,
+static int probeChapter(Volume       *volume,
+                        byte         *buffer,
                         unsigned int  chapterNumber,
                         uint64_t     *virtualChapterNumber)
 {
-  Volume *volume = aux;
-  int result = probeChapter(volume, chapterNumber, virtualChapterNumber);
-  if ((result == UDS_CORRUPT_COMPONENT) || (result == UDS_CORRUPT_DATA)) {
-    *virtualChapterNumber = UINT64_MAX;
-    return UDS_SUCCESS;
+  // The index pages lead the chapter, so read them all with a single IO.
+  int result = readChapterIndexToBuffer(volume, chapterNumber, buffer);
+  if (result != UDS_SUCCESS) {
+    return result;
   }
-  return result;
+  return validateChapterIndexBuffer(volume, buffer, chapterNumber,
+                                    virtualChapterNumber);
+}
+
+/**
+ * The state of one chapter probe. The first probe of each batch runs on the
+ * calling thread; the others run on helper threads which are started the
+ * first time they are needed and then reused for every later batch.
+ **/
+typedef struct chapterProbe {
+  struct chapterProber *prober;
+  Volume               *volume;
+  byte                 *buffer;
+  unsigned int          chapter;
+  uint64_t              vcn;
+  int                   result;
+  bool                  assigned;  // Set while a helper owes this probe
+} ChapterProbe;
+
+/**
+ * The buffers, helper threads, and probe state used to find the volume
+ * chapter boundaries.
+ **/
+typedef struct chapterProber {
+  Mutex         mutex;
+  CondVar       workCond;     // Signalled when probes are assigned
+  CondVar       doneCond;     // Signalled when the last helper finishes
+  unsigned int  width;        // Number of probe buffers
+  unsigned int  threadCount;  // Number of helper threads started
+  unsigned int  pending;      // Number of assigned probes not yet done
+  bool          exiting;
+  ChapterProbe  probes[CHAPTER_PROBE_THREADS];
+  Thread        threads[CHAPTER_PROBE_THREADS];
+} ChapterProber;
+
+/**********************************************************************/
+static void runChapterProbe(ChapterProbe *probe)
+{
+  probe->result = probeChapter(probe->volume, probe->buffer, probe->chapter,
+                               &probe->vcn);
+  if ((probe->result == UDS_CORRUPT_COMPONENT)
+      || (probe->result == UDS_CORRUPT_DATA)) {
+    probe->vcn    = UINT64_MAX;
+    probe->result = UDS_SUCCESS;
+  }
+}
+
+/**********************************************************************/
+static void probeThreadFunction(void *arg)
+{
+  ChapterProbe  *probe  = arg;
+  ChapterProber *prober = probe->prober;
+  lockMutex(&prober->mutex);
+  for (;;) {
+    while (!probe->assigned && !prober->exiting) {
+      waitCond(&prober->workCond, &prober->mutex);
+    }
+    if (!probe->assigned) {
+      break;
+    }
+    unlockMutex(&prober->mutex);
+    runChapterProbe(probe);
+    lockMutex(&prober->mutex);
+    probe->assigned = false;
+    if (--prober->pending == 0) {
+      signalCond(&prober->doneCond);
+    }
+  }
+  unlockMutex(&prober->mutex);
+}
+
+/**********************************************************************/
+static int startProbeThreads(ChapterProber *prober, unsigned int count)
+{
+  // Probe 0 always runs on the calling thread.
+  while (prober->threadCount + 1 < count) {
+    unsigned int i = prober->threadCount + 1;
+    int result = createThread(probeThreadFunction, &prober->probes[i],
+                              "probe", &prober->threads[i]);
+    if (result != UDS_SUCCESS) {
+      return result;
+    }
+    prober->threadCount++;
+  }
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+static int probeChapters(void               *aux,
+                         const unsigned int *chapters,
+                         unsigned int        count,
+                         uint64_t           *vcns)
+{
+  ChapterProber *prober = aux;
+  int result = ASSERT((count <= prober->width),
+                      "probe batch of %u exceeds width %u",
+                      count, prober->width);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  result = startProbeThreads(prober, count);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  for (unsigned int i = 0; i < count; i++) {
+    prober->probes[i].chapter = chapters[i];
+  }
+  if (count > 1) {
+    lockMutex(&prober->mutex);
+    for (unsigned int i = 1; i < count; i++) {
+      prober->probes[i].assigned = true;
+    }
+    prober->pending = count - 1;
+    broadcastCond(&prober->workCond);
+    unlockMutex(&prober->mutex);
+  }
+
+  runChapterProbe(&prober->probes[0]);
+
+  if (count > 1) {
+    lockMutex(&prober->mutex);
+    while (prober->pending > 0) {
+      waitCond(&prober->doneCond, &prober->mutex);
+    }
+    unlockMutex(&prober->mutex);
+  }
+
+  for (unsigned int i = 0; i < count; i++) {
+    if (prober->probes[i].result != UDS_SUCCESS) {
+      return prober->probes[i].result;
+    }
+    vcns[i] = prober->probes[i].vcn;
+  }
+  return UDS_SUCCESS;
+}
+
+/**********************************************************************/
+static void freeChapterProber(ChapterProber *prober)
+{
+  lockMutex(&prober->mutex);
+  prober->exiting = true;
+  broadcastCond(&prober->workCond);
+  unlockMutex(&prober->mutex);
+  for (unsigned int i = 1; i <= prober->threadCount; i++) {
+    joinThreads(prober->threads[i]);
+  }
+  for (unsigned int i = 0; i < prober->width; i++) {
+    FREE(prober->probes[i].buffer);
+  }
+  destroyCond(&prober->doneCond);
+  destroyCond(&prober->workCond);
+  destroyMutex(&prober->mutex);
+}
+
+/**********************************************************************/
+static int initializeChapterProber(ChapterProber *prober, Volume *volume)
+{
+  memset(prober, 0, sizeof(*prober));
+  int result = initMutex(&prober->mutex);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  result = initCond(&prober->workCond);
+  if (result != UDS_SUCCESS) {
+    destroyMutex(&prober->mutex);
+    return result;
+  }
+  result = initCond(&prober->doneCond);
+  if (result != UDS_SUCCESS) {
+    destroyCond(&prober->workCond);
+    destroyMutex(&prober->mutex);
+    return result;
+  }
+
+  size_t bufferSize = (volume->geometry->indexPagesPerChapter
+                       * volume->geometry->bytesPerPage);
+  for (unsigned int i = 0; i < CHAPTER_PROBE_THREADS; i++) {
+    ChapterProbe *probe = &prober->probes[i];
+    probe->prober = prober;
+    probe->volume = volume;
+    result = ALLOCATE_IO_ALIGNED(bufferSize, byte, "chapter probe buffer",
+                                 &probe->buffer);
+    if (result != UDS_SUCCESS) {
+      freeChapterProber(prober);
+      return result;
+    }
+    prober->width = i + 1;
+  }
+  return UDS_SUCCESS;
 }
 
 /**********************************************************************/
 static int findRealEndOfVolume(Volume       *volume,
+                               byte         *buffer,
                                unsigned int  limit,
                                unsigned int *limitPtr)
 {
@@ -1092,7 +1601,7 @@ static int findRealEndOfVolume(Volume       *volume,
   while (limit > 0) {
     unsigned int chapter = (span > limit) ? 0 : limit - span;
     uint64_t vcn = 0;
-    int result = probeChapter(volume, chapter, &vcn);
+    int result = probeChapter(volume, buffer, chapter, &vcn);
     if (result == UDS_SUCCESS) {
       if (span == 1) {
         break;
@@ -1157,12 +1666,21 @@ int findVolumeChapterBoundaries(Volume   *volume,
     chapterLimit = geometry->chaptersPerVolume;
   }
 
-  result = findRealEndOfVolume(volume, chapterLimit, &chapterLimit);
+  ChapterProber prober;
+  result = initializeChapterProber(&prober, volume);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
+  result = findRealEndOfVolume(volume, prober.probes[0].buffer, chapterLimit,
+                               &chapterLimit);
   if (result != UDS_SUCCESS) {
+    freeChapterProber(&prober);
     return logErrorWithStringError(result, "cannot find end of volume");
   }
 
   if (chapterLimit == 0) {
+    freeChapterProber(&prober);
     *lowestVCN = 0;
     *highestVCN = 0;
     *isEmpty = true;
@@ -1170,20 +1688,22 @@ int findVolumeChapterBoundaries(Volume   *volume,
   }
 
   *isEmpty = false;
-  return findVolumeChapterBoundariesImpl(chapterLimit, MAX_BAD_CHAPTERS,
-                                         lowestVCN, highestVCN, probeWrapper,
-                                         volume);
+  result = findVolumeChapterBoundariesImpl(chapterLimit, MAX_BAD_CHAPTERS,
+                                           prober.width, lowestVCN,
+                                           highestVCN, probeChapters,
+                                           &prober);
+  freeChapterProber(&prober);
+  return result;
 }
 
 /**********************************************************************/
-int findVolumeChapterBoundariesImpl(unsigned int  chapterLimit,
-                                    unsigned int  maxBadChapters,
-                                    uint64_t     *lowestVCN,
-                                    uint64_t     *highestVCN,
-                                    int (*probeFunc)(void         *aux,
-                                                     unsigned int  chapter,
-                                                     uint64_t     *vcn),
-                                    void *aux)
+int findVolumeChapterBoundariesImpl(unsigned int      chapterLimit,
+                                    unsigned int      maxBadChapters,
+                                    unsigned int      probeWidth,
+                                    uint64_t         *lowestVCN,
+                                    uint64_t         *highestVCN,
+                                    ChapterProbeFunc  probeFunc,
+                                    void             *aux)
 {
   if (chapterLimit == 0) {
     *lowestVCN = 0;
@@ -1191,6 +1711,13 @@ int findVolumeChapterBoundariesImpl(unsigned int  chapterLimit,
     return UDS_SUCCESS;
   }
 
+  int result = ASSERT(((probeWidth > 0)
+                       && (probeWidth <= MAX_CHAPTER_PROBE_WIDTH)),
+                      "probe width %u is valid", probeWidth);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+
   /*
    * This method assumes there is at most one run of contiguous bad chapters
    * caused by unflushed writes. Either the bad spot is at the beginning and
@@ -1203,39 +1730,57 @@ int findVolumeChapterBoundariesImpl(unsigned int  chapterLimit,
   uint64_t firstVCN = UINT64_MAX;
 
   // doesn't matter if this results in a bad spot (UINT64_MAX)
-  int result = (*probeFunc)(aux, 0, &firstVCN);
+  unsigned int zero = 0;
+  result = (*probeFunc)(aux, &zero, 1, &firstVCN);
   if (result != UDS_SUCCESS) {
     return UDS_SUCCESS;
   }
 
   /*
-   * Binary search for end of the discontinuity in the monotonically
-   * increasing virtual chapter numbers; bad spots are treated as a span of
-   * UINT64_MAX values. In effect we're searching for the index of the
-   * smallest value less than firstVCN. In the case we go off the end it means
-   * that chapter 0 has the lowest vcn.
+   * Search for end of the discontinuity in the monotonically increasing
+   * virtual chapter numbers; bad spots are treated as a span of UINT64_MAX
+   * values. In effect we're searching for the index of the smallest value
+   * less than firstVCN. In the case we go off the end it means that chapter 0
+   * has the lowest vcn. Each round probes up to probeWidth chapters at once,
+   * splitting the remaining range into probeWidth + 1 parts; with a width of
+   * one this is a plain binary search.
    */
 
   unsigned int leftChapter = 0;
   unsigned int rightChapter = chapterLimit;
+  unsigned int chapters[MAX_CHAPTER_PROBE_WIDTH];
+  uint64_t     vcns[MAX_CHAPTER_PROBE_WIDTH];
 
   while (leftChapter < rightChapter) {
-    unsigned int chapter = (leftChapter + rightChapter) / 2;
-    uint64_t probeVCN;
+    unsigned int span = rightChapter - leftChapter;
+    unsigned int count = 0;
+    for (unsigned int i = 1; i <= probeWidth; i++) {
+      unsigned int chapter
+        = leftChapter + (unsigned int) (((uint64_t) span * i)
+                                        / (probeWidth + 1));
+      if ((count == 0) || (chapter > chapters[count - 1])) {
+        chapters[count++] = chapter;
+      }
+    }
 
-    result = (*probeFunc)(aux, chapter, &probeVCN);
+    result = (*probeFunc)(aux, chapters, count, vcns);
     if (result != UDS_SUCCESS) {
       return result;
     }
-    if (firstVCN <= probeVCN) {
-      leftChapter = chapter + 1;
-    } else {
-      rightChapter = chapter;
+
+    unsigned int i = 0;
+    while ((i < count) && (firstVCN <= vcns[i])) {
+      i++;
+    }
+    if (i < count) {
+      rightChapter = chapters[i];
+    }
+    if (i > 0) {
+      leftChapter = chapters[i - 1] + 1;
     }
   }
 
   uint64_t lowest = UINT64_MAX;
-  uint64_t highest = UINT64_MAX;
 
   result = ASSERT(leftChapter == rightChapter, "leftChapter == rightChapter");
   if (result != UDS_SUCCESS) {
@@ -1247,7 +1792,7 @@ int findVolumeChapterBoundariesImpl(unsigned int  chapterLimit,
   // At this point, leftChapter is the chapter with the lowest virtual chapter
   // number.
 
-  result = (*probeFunc)(aux, leftChapter, &lowest);
+  result = (*probeFunc)(aux, &leftChapter, 1, &lowest);
   if (result != UDS_SUCCESS) {
     return result;
   }
@@ -1259,30 +1804,458 @@ int findVolumeChapterBoundariesImpl(unsigned int  chapterLimit,
 
   // We now circularly scan backwards, moving over any bad chapters until we
   // find the chapter with the highest vcn (the first good chapter we
-  // encounter).
+  // encounter). Usually the first chapter probed is good, so only probe a
+  // full batch of chapters at a time once it has turned out to be bad.
 
   unsigned int badChapters = 0;
+  unsigned int batchSize = 1;
 
   for (;;) {
-    rightChapter = (rightChapter + chapterLimit - 1) % chapterLimit;
-    result = (*probeFunc)(aux, rightChapter, &highest);
+    unsigned int count = 0;
+    while (count < batchSize) {
+      rightChapter = (rightChapter + chapterLimit - 1) % chapterLimit;
+      chapters[count++] = rightChapter;
+    }
+
+    result = (*probeFunc)(aux, chapters, count, vcns);
     if (result != UDS_SUCCESS) {
       return result;
     }
-    if (highest != UINT64_MAX) {
+    for (unsigned int i = 0; i < count; i++) {
+      if (vcns[i] != UINT64_MAX) {
+        *lowestVCN = lowest;
+        *highestVCN = vcns[i];
+        return UDS_SUCCESS;
+      }
+      if (++badChapters >= maxBadChapters) {
+        logError("too many bad chapters in volume: %u", badChapters);
+        return UDS_CORRUPT_COMPONENT;
+      }
+    }
+    batchSize = probeWidth;
+  }
+}
+
+/**********************************************************************/
+/**
+ * Install the wanted pages of a warmup run into the page cache. Must be
+ * called with the readThreadsMutex held.
+ *
+ * @param volume     The volume.
+ * @param pages      The wanted physical pages of the run.
+ * @param count      The number of wanted pages.
+ * @param runBuffer  The data of the run, starting with pages[0].
+ * @param limit      The maximum number of pages to install.
+ *
+ * @return the number of pages installed
+ **/
+static unsigned int installWarmupRun(Volume             *volume,
+                                     const unsigned int *pages,
+                                     unsigned int        count,
+                                     const byte         *runBuffer,
+                                     unsigned int        limit)
+{
+  size_t bytesPerPage = volume->geometry->bytesPerPage;
+  unsigned int installed = 0;
+  for (unsigned int i = 0; (i < count) && (installed < limit); i++) {
+    unsigned int physicalPage = pages[i];
+    if (!isPageUncached(volume->pageCache, physicalPage)) {
+      // a query already read it in, or has a read of it queued
+      continue;
+    }
+
+    CachedPage *page = NULL;
+    int result = selectVictimInCache(volume->pageCache, &page);
+    if (result != UDS_SUCCESS) {
+      logWarning("Error selecting cache victim for warmup page %u",
+                 physicalPage);
+      break;
+    }
+    memcpy(page->data, runBuffer + (physicalPage - pages[0]) * bytesPerPage,
+           bytesPerPage);
+    if (!isRecordPage(volume->geometry, physicalPage)) {
+      result = initializeIndexPage(volume, physicalPage, page);
+      if (result != UDS_SUCCESS) {
+        cancelPageInCache(volume->pageCache, physicalPage, page);
+        continue;
+      }
+    }
+    result = putPageInCache(volume->pageCache, physicalPage, page);
+    if (result != UDS_SUCCESS) {
+      logWarning("Error putting warmup page %u in cache", physicalPage);
+      cancelPageInCache(volume->pageCache, physicalPage, page);
       break;
     }
-    if (++badChapters >= maxBadChapters) {
-      logError("too many bad chapters in volume: %u", badChapters);
+    installed++;
+  }
+  return installed;
+}
+
+/**********************************************************************/
+static void warmupThreadFunction(void *arg)
+{
+  Volume             *volume       = arg;
+  const unsigned int *pages        = volume->warmupPages;
+  unsigned int        pageCount    = volume->warmupPageCount;
+  size_t              bytesPerPage = volume->geometry->bytesPerPage;
+  // Never install more pages than the cache holds, or the tail of the hot
+  // set would just evict its head.
+  unsigned int        limit        = volume->pageCache->numCacheEntries;
+
+  unsigned int rate = CACHE_WARMUP_RATE;
+  UdsParameterValue value;
+  if ((udsGetParameter(UDS_CACHE_WARMUP_RATE, &value) == UDS_SUCCESS) &&
+      (value.type == UDS_PARAM_TYPE_UNSIGNED_INT)) {
+    rate = value.value.u_uint;
+  }
+
+  byte *runBuffer;
+  int result = ALLOCATE_IO_ALIGNED(WARMUP_RUN_PAGES * bytesPerPage, byte,
+                                   "cache warmup buffer", &runBuffer);
+  if (result != UDS_SUCCESS) {
+    logWarningWithStringError(result, "cannot warm up page cache");
+    return;
+  }
+
+  logInfo("warming up page cache with %u pages", pageCount);
+  AbsTime      start      = currentTime(CT_MONOTONIC);
+  uint64_t     bytesRead  = 0;
+  unsigned int installed  = 0;
+  unsigned int nextReport = 1;
+  unsigned int first      = 0;
+  while ((first < pageCount) && (installed < limit)) {
+    // Gather nearby pages so they can be read with a single IO.
+    unsigned int last = first + 1;
+    while ((last < pageCount)
+           && (pages[last] - pages[first] < WARMUP_RUN_PAGES)
+           && (pages[last] - pages[last - 1] <= WARMUP_GAP_PAGES + 1)) {
+      last++;
+    }
+    unsigned int runPages = pages[last - 1] - pages[first] + 1;
+
+    lockMutex(&volume->readThreadsMutex);
+    bool     stop      = volume->warmupStop;
+    uint64_t forgotten = volume->forgottenChapters;
+    unlockMutex(&volume->readThreadsMutex);
+    if (stop) {
+      break;
+    }
+
+    result = readFromRegion(volume->region,
+                            (off_t) pages[first] * bytesPerPage, runBuffer,
+                            runPages * bytesPerPage, NULL);
+    if (result != UDS_SUCCESS) {
+      logWarningWithStringError(result, "error reading warmup page %u",
+                                pages[first]);
+      break;
+    }
+    bytesRead += runPages * bytesPerPage;
+
+    lockMutex(&volume->readThreadsMutex);
+    // If any chapter was forgotten during the read, the data may be stale.
+    if (!volume->warmupStop && (volume->forgottenChapters == forgotten)) {
+      installed += installWarmupRun(volume, &pages[first], last - first,
+                                    runBuffer, limit - installed);
+    }
+    if (rate > 0) {
+      int64_t targetMs = bytesRead * 1000 / ((uint64_t) rate << 20);
+      int64_t elapsedMs
+        = relTimeToMilliseconds(timeDifference(currentTime(CT_MONOTONIC),
+                                               start));
+      if (!volume->warmupStop && (elapsedMs < targetMs)) {
+        AbsTime deadline
+          = futureTime(CT_REALTIME,
+                       millisecondsToRelTime(targetMs - elapsedMs));
+        timedWaitCond(&volume->warmupCond, &volume->readThreadsMutex,
+                      &deadline);
+      }
+    }
+    unlockMutex(&volume->readThreadsMutex);
+
+    first = last;
+    if (first * 4 >= nextReport * pageCount) {
+      logInfo("page cache warmup %u%% done", nextReport * 25);
+      while (first * 4 >= nextReport * pageCount) {
+        nextReport++;
+      }
+    }
+  }
+  FREE(runBuffer);
+
+  RelTime elapsed = timeDifference(currentTime(CT_MONOTONIC), start);
+  logInfo("page cache warmup installed %u pages in %" PRId64 " ms",
+          installed, relTimeToMilliseconds(elapsed));
+}
+
+/**********************************************************************/
+int startVolumeWarmup(Volume             *volume,
+                      const unsigned int *pages,
+                      unsigned int        pageCount)
+{
+  if ((pageCount == 0) || volume->warmupStarted) {
+    return UDS_SUCCESS;
+  }
+
+  UdsParameterValue value;
+  if ((udsGetParameter(UDS_CACHE_WARMUP_RATE, &value) == UDS_SUCCESS) &&
+      (value.type == UDS_PARAM_TYPE_UNSIGNED_INT) &&
+      (value.value.u_uint == 0)) {
+    logInfo("page cache warmup disabled");
+    return UDS_SUCCESS;
+  }
+
+  int result = ALLOCATE(pageCount, unsigned int, "cache warmup pages",
+                        &volume->warmupPages);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  memcpy(volume->warmupPages, pages, pageCount * sizeof(*pages));
+  volume->warmupPageCount = pageCount;
+
+  result = createThread(warmupThreadFunction, volume, "warmup",
+                        &volume->warmupThread);
+  if (result != UDS_SUCCESS) {
+    FREE(volume->warmupPages);
+    volume->warmupPages = NULL;
+    return result;
+  }
+  volume->warmupStarted = true;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Find the virtual chapter stored in a physical chapter, if any. Must be
+ * called with the readThreadsMutex held.
+ *
+ * @param volume          The volume.
+ * @param physicalChapter The physical chapter number.
+ * @param virtualChapter  A pointer to hold the virtual chapter number.
+ *
+ * @return <code>true</code> if a chapter in the scrub window is stored there
+ **/
+static bool findScrubChapter(const Volume *volume,
+                             unsigned int  physicalChapter,
+                             uint64_t     *virtualChapter)
+{
+  unsigned int chaptersPerVolume = volume->geometry->chaptersPerVolume;
+  if (volume->scrubNewest <= volume->scrubOldest) {
+    return false;
+  }
+  uint64_t newest = volume->scrubNewest - 1;
+  uint64_t distance = ((newest % chaptersPerVolume) + chaptersPerVolume
+                       - physicalChapter) % chaptersPerVolume;
+  if ((distance > newest) || (newest - distance < volume->scrubOldest)) {
+    return false;
+  }
+  *virtualChapter = newest - distance;
+  return true;
+}
+
+/**
+ * Verify a chapter read from storage.
+ *
+ * @param volume          The volume.
+ * @param buffer          The whole chapter.
+ * @param physicalChapter The physical chapter number.
+ * @param virtualChapter  The virtual chapter expected to be stored there.
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int verifyChapter(const Volume *volume,
+                         byte         *buffer,
+                         unsigned int  physicalChapter,
+                         uint64_t      virtualChapter)
+{
+  const Geometry *geometry = volume->geometry;
+  uint64_t vcn;
+  int result = validateChapterIndexBuffer(volume, buffer, physicalChapter,
+                                          &vcn);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  if (vcn != virtualChapter) {
+    logError("chapter %u holds vcn %" PRIu64 ", expected vcn %" PRIu64,
+             physicalChapter, vcn, virtualChapter);
+    return UDS_CORRUPT_COMPONENT;
+  }
+
+  // Record pages carry no checksum, so check that each is a sorted tree.
+  for (unsigned int i = 0; i < geometry->recordPagesPerChapter; i++) {
+    const byte *recordPage
+      = buffer + (geometry->indexPagesPerChapter + i) * geometry->bytesPerPage;
+    if (!validateRecordPage(recordPage, geometry)) {
+      logError("chapter %u record page %u is out of order",
+               physicalChapter, i);
       return UDS_CORRUPT_COMPONENT;
     }
   }
+  return UDS_SUCCESS;
+}
+
+/**
+ * Record the outcome of a chapter scrub. Must be called with the
+ * readThreadsMutex held.
+ *
+ * @param volume          The volume.
+ * @param physicalChapter The physical chapter number.
+ * @param virtualChapter  The virtual chapter which was verified.
+ * @param result          The result of reading and verifying the chapter.
+ **/
+static void recordScrubResult(Volume       *volume,
+                              unsigned int  physicalChapter,
+                              uint64_t      virtualChapter,
+                              int           result)
+{
+  // If the chapter was overwritten during the read, the data is stale.
+  if (virtualChapter < volume->scrubOldest) {
+    return;
+  }
+
+  volume->scrubStats.chaptersScrubbed++;
+  bool wasBad = volume->badChapters[physicalChapter];
+  if (result != UDS_SUCCESS) {
+    volume->scrubStats.errors++;
+    if (!wasBad) {
+      logErrorWithStringError(result, "scrub of chapter %u (vcn %" PRIu64
+                              ") failed, lookups will skip it",
+                              physicalChapter, virtualChapter);
+      volume->badChapters[physicalChapter] = true;
+      volume->scrubStats.badChapters++;
+    }
+  } else if (wasBad) {
+    // The earlier failure must have been a transient read error.
+    volume->badChapters[physicalChapter] = false;
+    volume->scrubStats.badChapters--;
+  }
+}
+
+/**********************************************************************/
+static void scrubThreadFunction(void *arg)
+{
+  Volume         *volume   = arg;
+  const Geometry *geometry = volume->geometry;
+
+  byte *buffer;
+  int result = ALLOCATE_IO_ALIGNED(geometry->bytesPerChapter, byte,
+                                   "volume scrub buffer", &buffer);
+  if (result != UDS_SUCCESS) {
+    logWarningWithStringError(result, "cannot scrub volume");
+    return;
+  }
+
+  AbsTime      start        = currentTime(CT_MONOTONIC);
+  uint64_t     bytesRead    = 0;
+  unsigned int lastRate     = 0;
+  unsigned int nextChapter  = 0;
+  bool         passVerified = false;
+  lockMutex(&volume->readThreadsMutex);
+  while (!volume->scrubStop) {
+    unsigned int rate = getScrubRate();
+    if (rate == 0) {
+      waitCond(&volume->scrubCond, &volume->readThreadsMutex);
+      continue;
+    }
+    if (rate != lastRate) {
+      // Pace from now on at the new rate.
+      start     = currentTime(CT_MONOTONIC);
+      bytesRead = 0;
+      lastRate  = rate;
+    }
+
+    unsigned int chapter = nextChapter;
+    nextChapter = (nextChapter + 1) % geometry->chaptersPerVolume;
+
+    uint64_t virtualChapter;
+    if (findScrubChapter(volume, chapter, &virtualChapter)) {
+      // Read the whole chapter with a single IO.
+      unlockMutex(&volume->readThreadsMutex);
+      result = readFromRegion(volume->region,
+                              offsetForChapter(geometry, chapter), buffer,
+                              geometry->bytesPerChapter, NULL);
+      if (result == UDS_SUCCESS) {
+        result = verifyChapter(volume, buffer, chapter, virtualChapter);
+      }
+      bytesRead += geometry->bytesPerChapter;
+      lockMutex(&volume->readThreadsMutex);
+      recordScrubResult(volume, chapter, virtualChapter, result);
+      passVerified = true;
+
+      int64_t targetMs = bytesRead * 1000 / ((uint64_t) rate << 20);
+      int64_t elapsedMs
+        = relTimeToMilliseconds(timeDifference(currentTime(CT_MONOTONIC),
+                                               start));
+      if (!volume->scrubStop && (elapsedMs < targetMs)) {
+        AbsTime deadline
+          = futureTime(CT_REALTIME,
+                       millisecondsToRelTime(targetMs - elapsedMs));
+        timedWaitCond(&volume->scrubCond, &volume->readThreadsMutex,
+                      &deadline);
+      }
+    }
+
+    if (nextChapter == 0) {
+      if (passVerified) {
+        volume->scrubStats.passes++;
+        passVerified = false;
+      } else if (!volume->scrubStop) {
+        // No chapter has been written yet, so check back later.
+        AbsTime deadline
+          = futureTime(CT_REALTIME, millisecondsToRelTime(SCRUB_IDLE_MS));
+        timedWaitCond(&volume->scrubCond, &volume->readThreadsMutex,
+                      &deadline);
+      }
+    }
+  }
+  unlockMutex(&volume->readThreadsMutex);
+  FREE(buffer);
+}
+
+/**********************************************************************/
+int startVolumeScrubber(Volume   *volume,
+                        uint64_t  oldest,
+                        uint64_t  newest)
+{
+  if (volume->scrubStarted || (volume->badChapters == NULL)) {
+    return UDS_SUCCESS;
+  }
+
+  lockMutex(&volume->readThreadsMutex);
+  volume->scrubOldest = oldest;
+  volume->scrubNewest = newest;
+  unlockMutex(&volume->readThreadsMutex);
 
-  *lowestVCN = lowest;
-  *highestVCN = highest;
+  // The thread idles while the scrub rate is zero, so start it regardless in
+  // case scrubbing is enabled later.
+  int result = createThread(scrubThreadFunction, volume, "scrubber",
+                            &volume->scrubThread);
+  if (result != UDS_SUCCESS) {
+    return result;
+  }
+  volume->scrubStarted = true;
   return UDS_SUCCESS;
 }
 
+/**********************************************************************/
+void getVolumeScrubStats(Volume *volume, UdsScrubStats *stats)
+{
+  if (volume->badChapters == NULL) {
+    memset(stats, 0, sizeof(*stats));
+    return;
+  }
+  lockMutex(&volume->readThreadsMutex);
+  *stats = volume->scrubStats;
+  unlockMutex(&volume->readThreadsMutex);
+}
+
+/**********************************************************************/
+bool isChapterMarkedBad(const Volume *volume, unsigned int physicalChapter)
+{
+  // An unlocked read suffices: a chapter marked bad a moment ago is merely
+  // searched once more.
+  return ((volume->badChapters != NULL)
+          && volume->badChapters[physicalChapter]);
+}
+
 /**********************************************************************/
 int makeVolume(const Configuration  *config,
                IndexLayout          *layout,
@@ -1327,30 +2300,133 @@ int makeVolume(const Configuration  *config,
     freeVolume(volume);
     return result;
   }
+  result = initCond(&volume->warmupCond);
+  if (result != UDS_SUCCESS) {
+    freeVolume(volume);
+    return result;
+  }
+  result = initCond(&volume->scrubCond);
+  if (result != UDS_SUCCESS) {
+    freeVolume(volume);
+    return result;
+  }
+  result = ALLOCATE(volume->geometry->chaptersPerVolume, bool, "bad chapters",
+                    &volume->badChapters);
+  if (result != UDS_SUCCESS) {
+    freeVolume(volume);
+    return result;
+  }
 
   // Start the reader threads.  If this allocation succeeds, freeVolume knows
   // that it needs to try and stop those threads.
-  result = ALLOCATE(volumeReadThreads, Thread, "reader threads",
+  result = ALLOCATE(MAX_VOLUME_READ_THREADS, ReaderThread, "reader threads",
                     &volume->readerThreads);
   if (result != UDS_SUCCESS) {
     freeVolume(volume);
     return result;
   }
-  for (unsigned int i = 0; i < volumeReadThreads; i++) {
-    result = createThread(readThreadFunction, (void *) volume, "reader",
-                          &volume->readerThreads[i]);
+  lockMutex(&liveVolumesMutex);
+  result = setVolumeReadThreads(volume, volumeReadThreads);
+  if (result == UDS_SUCCESS) {
+    volume->nextLiveVolume = liveVolumes;
+    liveVolumes = volume;
+  }
+  unlockMutex(&liveVolumesMutex);
+  if (result != UDS_SUCCESS) {
+    freeVolume(volume);
+    return result;
+  }
+
+  *newVolume = volume;
+  return UDS_SUCCESS;
+}
+
+/**
+ * Start or stop read threads so that the given number are running. The
+ * caller must hold the liveVolumesMutex.
+ *
+ * @param volume       The volume
+ * @param threadCount  The number of read threads wanted
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int setVolumeReadThreads(Volume *volume, unsigned int threadCount)
+{
+  lockMutex(&volume->readThreadsMutex);
+  if (threadCount >= volume->pageCache->readQueueMaxSize) {
+    unlockMutex(&volume->readThreadsMutex);
+    return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                   "Number of read threads must be smaller"
+                                   " than read queue");
+  }
+  // Threads numbered at or above the new count exit once they are idle.
+  volume->numReadThreads = threadCount;
+  broadcastCond(&volume->readThreadsCond);
+  unlockMutex(&volume->readThreadsMutex);
+
+  while (volume->startedReadThreads > threadCount) {
+    volume->startedReadThreads--;
+    joinThreads(volume->readerThreads[volume->startedReadThreads].thread);
+  }
+
+  while (volume->startedReadThreads < threadCount) {
+    ReaderThread *reader = &volume->readerThreads[volume->startedReadThreads];
+    reader->volume = volume;
+    reader->number = volume->startedReadThreads;
+    int result = createThread(readThreadFunction, reader, "reader",
+                              &reader->thread);
     if (result != UDS_SUCCESS) {
-      freeVolume(volume);
+      lockMutex(&volume->readThreadsMutex);
+      volume->numReadThreads = volume->startedReadThreads;
+      unlockMutex(&volume->readThreadsMutex);
       return result;
     }
     // We only stop as many threads as actually got started.
-    volume->numReadThreads = i + 1;
+    volume->startedReadThreads++;
   }
-
-  *newVolume = volume;
   return UDS_SUCCESS;
 }
 
+/**
+ * Replace the read queue of a volume with one of a different size. New
+ * reads wait as though the queue were full while the queued reads drain.
+ * The caller must hold the liveVolumesMutex.
+ *
+ * @param volume  The volume
+ * @param depth   The new maximum size of the read queue
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+static int setVolumeReadQueueDepth(Volume *volume, unsigned int depth)
+{
+  PageCache *cache = volume->pageCache;
+  lockMutex(&volume->readThreadsMutex);
+  if (depth <= volume->numReadThreads) {
+    unlockMutex(&volume->readThreadsMutex);
+    return logErrorWithStringError(UDS_INVALID_ARGUMENT,
+                                   "Number of read threads must be smaller"
+                                   " than read queue");
+  }
+  if (depth == cache->readQueueMaxSize) {
+    unlockMutex(&volume->readThreadsMutex);
+    return UDS_SUCCESS;
+  }
+
+  cache->readQueueFrozen = true;
+  while (!readQueueIsEmpty(cache)) {
+    signalCond(&volume->readThreadsCond);
+    waitCond(&volume->readThreadsReadDoneCond, &volume->readThreadsMutex);
+  }
+  UdsMemoryComponent previous = setMemoryComponent(UDS_MEMORY_PAGE_CACHE);
+  int result = resizeReadQueue(cache, depth);
+  setMemoryComponent(previous);
+  cache->readQueueFrozen = false;
+  // Wake any index threads waiting for room in the queue.
+  broadcastCond(&volume->readThreadsReadDoneCond);
+  unlockMutex(&volume->readThreadsMutex);
+  return result;
+}
+
 /**********************************************************************/
 void freeVolume(Volume *volume)
 {
@@ -1358,15 +2434,45 @@ void freeVolume(Volume *volume)
     return;
   }
 
+  if (volume->warmupStarted) {
+    lockMutex(&volume->readThreadsMutex);
+    volume->warmupStop = true;
+    broadcastCond(&volume->warmupCond);
+    unlockMutex(&volume->readThreadsMutex);
+    joinThreads(volume->warmupThread);
+    volume->warmupStarted = false;
+  }
+  FREE(volume->warmupPages);
+
+  if (volume->scrubStarted) {
+    lockMutex(&volume->readThreadsMutex);
+    volume->scrubStop = true;
+    broadcastCond(&volume->scrubCond);
+    unlockMutex(&volume->readThreadsMutex);
+    joinThreads(volume->scrubThread);
+    volume->scrubStarted = false;
+  }
+
   // If readerThreads is NULL, then we haven't set up the reader threads.
   if (volume->readerThreads != NULL) {
+    // Stop parameter changes from reaching this volume.
+    lockMutex(&liveVolumesMutex);
+    for (Volume **link = &liveVolumes; *link != NULL;
+         link = &(*link)->nextLiveVolume) {
+      if (*link == volume) {
+        *link = volume->nextLiveVolume;
+        break;
+      }
+    }
+    unlockMutex(&liveVolumesMutex);
+
     // Stop the reader threads.  It is ok if there aren't any of them.
     lockMutex(&volume->readThreadsMutex);
     volume->readerState |= READER_STATE_EXIT;
     broadcastCond(&volume->readThreadsCond);
     unlockMutex(&volume->readThreadsMutex);
-    for (unsigned int i = 0; i < volume->numReadThreads; i++) {
-      joinThreads(volume->readerThreads[i]);
+    for (unsigned int i = 0; i < volume->startedReadThreads; i++) {
+      joinThreads(volume->readerThreads[i].thread);
     }
     FREE(volume->readerThreads);
     volume->readerThreads = NULL;
@@ -1382,6 +2488,8 @@ void freeVolume(Volume *volume)
 
   destroyCond(&volume->readThreadsCond);
   destroyCond(&volume->readThreadsReadDoneCond);
+  destroyCond(&volume->warmupCond);
+  destroyCond(&volume->scrubCond);
   destroyMutex(&volume->readThreadsMutex);
   freeIndexPageMap(volume->indexPageMap);
   freePageCache(volume->pageCache);
@@ -1389,6 +2497,10 @@ void freeVolume(Volume *volume)
   freeSparseCache(volume->sparseCache);
   FREE(volume->geometry);
   FREE(volume->recordPointers);
+  FREE(volume->packingKeys);
+  FREE(volume->packingKeyPointers);
   FREE(volume->scratchPage);
+  FREE(volume->writeBatch);
+  FREE(volume->badChapters);
   FREE(volume);
 }
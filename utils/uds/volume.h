@@ -36,7 +36,8 @@
 #include "util/radixSort.h"
 
 enum {
-  MAX_VOLUME_READ_THREADS = 16
+  MAX_VOLUME_READ_THREADS = 16,
+  MAX_CHAPTER_PROBE_WIDTH = 8
 };
 
 typedef enum {
@@ -63,7 +64,23 @@ typedef enum indexLookupMode {
   LOOKUP_FOR_REBUILD
 } IndexLookupMode;
 
-typedef struct volume {
+typedef struct volume Volume;
+
+/**
+ * A volume read thread and the position it holds in the volume's array of
+ * read threads. A thread whose position is at or beyond the number of read
+ * threads the volume wants exits once it is idle.
+ **/
+typedef struct readerThread {
+  /* The volume the thread reads for */
+  Volume       *volume;
+  /* The position of the thread in the volume's array */
+  unsigned int  number;
+  /* The thread */
+  Thread        thread;
+} ReaderThread;
+
+struct volume {
   /* The layout of the volume */
   Geometry              *geometry;
   /* The configuration of the volume */
@@ -78,10 +95,22 @@ typedef struct volume {
   uint64_t               nonce;
   /* A single page sized scratch buffer */
   byte                  *scratchPage;
+  /* Consecutive written pages, gathered when the region prefers big writes */
+  byte                  *writeBatch;
+  /* The number of pages the write batch can hold */
+  unsigned int           writeBatchPages;
+  /* The number of pages in the write batch */
+  unsigned int           writeBatchCount;
+  /* The volume offset of the first page in the write batch */
+  off_t                  writeBatchOffset;
   /* A single page's records, for sorting */
   const UdsChunkRecord **recordPointers;
   /* For sorting record pages */
   RadixSorter           *radixSorter;
+  /* A single page's metadata as sort keys, for packing record pages */
+  byte                  *packingKeys;
+  /* Pointers to the packing keys, for sorting */
+  const byte           **packingKeyPointers;
   /* The sparse chapter index cache */
   SparseCache           *sparseCache;
   /* The page cache */
@@ -94,8 +123,8 @@ typedef struct volume {
   CondVar                readThreadsCond;
   /* Condvar to indicate when a read thread has finished a read */
   CondVar                readThreadsReadDoneCond;
-  /* Threads to read data from disk */
-  Thread                *readerThreads;
+  /* Threads to read data from disk, with room for the maximum number */
+  ReaderThread          *readerThreads;
   /* Number of threads busy with reads */
   unsigned int           busyReaderThreads;
   /* The state of the reader threads */
@@ -104,7 +133,49 @@ typedef struct volume {
   IndexLookupMode        lookupMode;
   /* Number of read threads to use (run-time parameter) */
   unsigned int           numReadThreads;
-} Volume;
+  /* Number of read threads started and not yet joined */
+  unsigned int           startedReadThreads;
+  /* The next volume with running read threads, for parameter updates */
+  Volume                *nextLiveVolume;
+  /* Number of chapters forgotten, so warmup can detect stale reads */
+  uint64_t               forgottenChapters;
+  /* Condvar to wake the warmup thread when it should stop */
+  CondVar                warmupCond;
+  /* Thread preloading the saved page cache hot set */
+  Thread                 warmupThread;
+  /* Whether the warmup thread was started */
+  bool                   warmupStarted;
+  /* Whether the warmup thread should stop */
+  bool                   warmupStop;
+  /* The physical pages to preload, in ascending order */
+  unsigned int          *warmupPages;
+  /* The number of physical pages to preload */
+  unsigned int           warmupPageCount;
+  /* Condvar to wake the scrubber when it should stop or its rate changes */
+  CondVar                scrubCond;
+  /* Thread verifying the chapters on storage */
+  Thread                 scrubThread;
+  /* Whether the scrubber thread was started */
+  bool                   scrubStarted;
+  /* Whether the scrubber thread should stop */
+  bool                   scrubStop;
+  /* The oldest virtual chapter which may be on storage */
+  uint64_t               scrubOldest;
+  /* One past the newest virtual chapter written to storage */
+  uint64_t               scrubNewest;
+  /* Which physical chapters failed verification, so lookups skip them */
+  bool                  *badChapters;
+  /* Scrubber statistics, protected by the readThreadsMutex */
+  UdsScrubStats          scrubStats;
+};
+
+/**
+ * Get the size of the read queue a new volume should use, from the
+ * UDS_VOLUME_READ_QUEUE_DEPTH parameter.
+ *
+ * @return the maximum size of the read queue
+ **/
+unsigned int getVolumeReadQueueDepth(void);
 
 /**
  * Create a volume.
@@ -124,6 +195,61 @@ int makeVolume(const Configuration  *config,
                Volume              **newVolume)
   __attribute__((warn_unused_result));
 
+/**
+ * Start a background thread that reads a set of volume pages into the page
+ * cache, so that a freshly loaded index does not have to fault in its
+ * working set one query at a time. Adjacent pages are read with a single IO,
+ * and the read rate is limited by the UDS_CACHE_WARMUP_RATE parameter. Pages
+ * which are already cached, or whose chapter is forgotten while they are
+ * being read, are skipped.
+ *
+ * @param volume     The volume.
+ * @param pages      The physical page numbers to read, in ascending order.
+ * @param pageCount  The number of physical page numbers.
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int startVolumeWarmup(Volume             *volume,
+                      const unsigned int *pages,
+                      unsigned int        pageCount)
+  __attribute__((warn_unused_result));
+
+/**
+ * Start a background thread that repeatedly reads every chapter on storage
+ * with large sequential IOs and verifies its index and record pages. A
+ * chapter which fails verification is logged, counted, and marked bad so
+ * that lookups skip it until it is overwritten. The read rate is limited by
+ * the UDS_SCRUB_RATE parameter, and the thread idles while it is zero.
+ *
+ * @param volume  The volume.
+ * @param oldest  The oldest virtual chapter on storage.
+ * @param newest  One past the newest virtual chapter on storage.
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int startVolumeScrubber(Volume   *volume,
+                        uint64_t  oldest,
+                        uint64_t  newest)
+  __attribute__((warn_unused_result));
+
+/**
+ * Get the statistics of the volume scrubber.
+ *
+ * @param volume  The volume.
+ * @param stats   The structure to fill in.
+ **/
+void getVolumeScrubStats(Volume *volume, UdsScrubStats *stats);
+
+/**
+ * Check whether a chapter has been marked bad by the volume scrubber.
+ *
+ * @param volume          The volume.
+ * @param physicalChapter The physical chapter number.
+ *
+ * @return <code>true</code> if lookups should skip the chapter
+ **/
+bool isChapterMarkedBad(const Volume *volume, unsigned int physicalChapter);
+
 /**
  * Clean up a volume and its memory.
  *
@@ -168,7 +294,9 @@ int formatVolume(IORegion *region, const Geometry *geometry)
  *
  * @note        This routine does something similar to a binary search to find
  *              the location in the volume file where the discontinuity of
- *              chapter numbers occurs.  In a good save, the discontinuity is
+ *              chapter numbers occurs, probing several chapters at once and
+ *              reading each chapter index with a single large read which
+ *              bypasses the page cache.  In a good save, the discontinuity is
  *              a sharp cliff, but if write failures occured during saving
  *              there may be one or more chapters which are partially written.
  *
@@ -438,14 +566,45 @@ off_t offsetForChapter(const Geometry *geometry,
 void getCacheCounters(Volume *volume, CacheCounters *counters);
 
 /**********************************************************************/
-int findVolumeChapterBoundariesImpl(unsigned int  chapterLimit,
-                                    unsigned int  maxBadChapters,
-                                    uint64_t     *lowestVCN,
-                                    uint64_t     *highestVCN,
-                                    int (*probeFunc)(void         *aux,
-                                                     unsigned int  chapter,
-                                                     uint64_t     *vcn),
-                                    void *aux)
+/**
+ * A function to probe a batch of physical chapters for their virtual chapter
+ * numbers, which may probe them concurrently.
+ *
+ * @param aux       The probe context.
+ * @param chapters  The physical chapter numbers to probe.
+ * @param count     The number of chapters to probe.
+ * @param vcns      The virtual chapter number of each chapter, or UINT64_MAX
+ *                  for a chapter which is not valid.
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+typedef int (*ChapterProbeFunc)(void               *aux,
+                                const unsigned int *chapters,
+                                unsigned int        count,
+                                uint64_t           *vcns);
+
+/**
+ * Find the lowest and highest virtual chapter numbers in a volume, probing
+ * up to probeWidth chapters in each step of the search.
+ *
+ * @param chapterLimit    The number of physical chapters to search.
+ * @param maxBadChapters  The most contiguous bad chapters to tolerate.
+ * @param probeWidth      The most chapters to pass to one probe call, at
+ *                        most MAX_CHAPTER_PROBE_WIDTH.
+ * @param lowestVCN       Receives the lowest virtual chapter number.
+ * @param highestVCN      Receives the highest virtual chapter number.
+ * @param probeFunc       The function used to probe chapters.
+ * @param aux             The context passed to probeFunc.
+ *
+ * @return UDS_SUCCESS or an error code
+ **/
+int findVolumeChapterBoundariesImpl(unsigned int      chapterLimit,
+                                    unsigned int      maxBadChapters,
+                                    unsigned int      probeWidth,
+                                    uint64_t         *lowestVCN,
+                                    uint64_t         *highestVCN,
+                                    ChapterProbeFunc  probeFunc,
+                                    void             *aux)
   __attribute__((warn_unused_result));
 
 #endif /* VOLUME_H */
@@ -109,18 +109,57 @@ int allocateVolume(const Configuration  *config,
     freeVolume(volume);
     return result;
   }
+  if (config->geometry->packedMetadataBytes > 0) {
+    result = ALLOCATE(config->geometry->recordsPerPage
+                      * UDS_MAX_BLOCK_DATA_SIZE,
+                      byte, "packing keys", &volume->packingKeys);
+    if (result != UDS_SUCCESS) {
+      freeVolume(volume);
+      return result;
+    }
+    result = ALLOCATE(config->geometry->recordsPerPage, const byte *,
+                      "packing key pointers", &volume->packingKeyPointers);
+    if (result != UDS_SUCCESS) {
+      freeVolume(volume);
+      return result;
+    }
+  }
 
   if (!readOnly) {
+    // A region which prefers buffers of several pages, such as one striped
+    // across several devices, gets chapters written in batches that large.
+    size_t bestSize = 0;
+    result = getRegionBestBufferSize(region, &bestSize);
+    if (result != UDS_SUCCESS) {
+      freeVolume(volume);
+      return result;
+    }
+    unsigned int batchPages = bestSize / config->geometry->bytesPerPage;
+    if (batchPages > 1) {
+      result = ALLOCATE_IO_ALIGNED(batchPages * config->geometry->bytesPerPage,
+                                   byte, "write batch", &volume->writeBatch);
+      if (result != UDS_SUCCESS) {
+        freeVolume(volume);
+        return result;
+      }
+      volume->writeBatchPages = batchPages;
+    }
+
     if (isSparse(volume->geometry)) {
+      UdsMemoryComponent previous
+        = setMemoryComponent(UDS_MEMORY_SPARSE_CACHE);
       result = makeSparseCache(volume->geometry, config->cacheChapters,
                                zoneCount, &volume->sparseCache);
+      setMemoryComponent(previous);
       if (result != UDS_SUCCESS) {
         freeVolume(volume);
         return result;
       }
     }
+    UdsMemoryComponent previous = setMemoryComponent(UDS_MEMORY_PAGE_CACHE);
     result = makePageCache(volume->geometry, config->cacheChapters,
                            readQueueMaxSize, zoneCount, &volume->pageCache);
+    setMemoryComponent(previous);
     if (result != UDS_SUCCESS) {
       freeVolume(volume);
       return result;
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/user/crc32.c#1 $
+ */
+
+#include "crc32.h"
+
+#include <zlib.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+typedef CRC32Checksum CRC32Function(CRC32Checksum  crc,
+                                    const byte    *buffer,
+                                    size_t         length);
+
+/**********************************************************************/
+static CRC32Checksum zlibCRC32(CRC32Checksum  crc,
+                               const byte    *buffer,
+                               size_t         length)
+{
+  return crc32(crc, buffer, length);
+}
+
+#if defined(__x86_64__)
+
+enum {
+  /* The smallest buffer worth folding; shorter ones go to zlib */
+  FOLDING_MINIMUM_LENGTH = 64,
+  FOLDING_BLOCK_SIZE     = 16,
+};
+
+/*
+ * Constants for folding a bit-reflected CRC-32 with PCLMULQDQ, from
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+ * Instruction" (Intel, 2009): k1 and k2 fold 512 bits, k3 and k4 fold 128
+ * bits, k5 folds 64 bits to 32, and the last pair are the polynomial and
+ * the Barrett reduction constant.
+ */
+static const uint64_t K1K2[]  __attribute__((aligned(16)))
+  = { 0x0154442bd4, 0x01c6e41596 };
+static const uint64_t K3K4[]  __attribute__((aligned(16)))
+  = { 0x01751997d0, 0x00ccaa009e };
+static const uint64_t K5K0[]  __attribute__((aligned(16)))
+  = { 0x0163cd6124, 0x0000000000 };
+static const uint64_t POLY_MU[] __attribute__((aligned(16)))
+  = { 0x01db710641, 0x01f7011641 };
+
+/**
+ * Fold a buffer into a CRC-32 register with carry-less multiplication.
+ *
+ * @param buffer  the data, at least 64 bytes long
+ * @param length  the length of the data, a multiple of 16
+ * @param crc     the uninverted CRC register
+ *
+ * @return the uninverted CRC register
+ **/
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t foldCRC32(const byte *buffer, size_t length, uint32_t crc)
+{
+  __m128i x1 = _mm_loadu_si128((const __m128i *) (buffer + 0x00));
+  __m128i x2 = _mm_loadu_si128((const __m128i *) (buffer + 0x10));
+  __m128i x3 = _mm_loadu_si128((const __m128i *) (buffer + 0x20));
+  __m128i x4 = _mm_loadu_si128((const __m128i *) (buffer + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+  buffer += 64;
+  length -= 64;
+
+  // Fold four lanes of 128 bits in parallel while 64 bytes remain.
+  __m128i k = _mm_load_si128((const __m128i *) K1K2);
+  while (length >= 64) {
+    __m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    __m128i x6 = _mm_clmulepi64_si128(x2, k, 0x00);
+    __m128i x7 = _mm_clmulepi64_si128(x3, k, 0x00);
+    __m128i x8 = _mm_clmulepi64_si128(x4, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                       _mm_loadu_si128((const __m128i *) (buffer + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+                       _mm_loadu_si128((const __m128i *) (buffer + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+                       _mm_loadu_si128((const __m128i *) (buffer + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+                       _mm_loadu_si128((const __m128i *) (buffer + 0x30)));
+    buffer += 64;
+    length -= 64;
+  }
+
+  // Fold the four lanes into one, then fold in any remaining blocks.
+  k = _mm_load_si128((const __m128i *) K3K4);
+  __m128i lanes[] = { x2, x3, x4 };
+  for (unsigned int i = 0; i < 3; i++) {
+    __m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, lanes[i]), x5);
+  }
+  while (length >= FOLDING_BLOCK_SIZE) {
+    __m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                       _mm_loadu_si128((const __m128i *) buffer));
+    buffer += FOLDING_BLOCK_SIZE;
+    length -= FOLDING_BLOCK_SIZE;
+  }
+
+  // Fold 128 bits to 64, then 64 to 32.
+  __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+  x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  k = _mm_loadl_epi64((const __m128i *) K5K0);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits.
+  k = _mm_load_si128((const __m128i *) POLY_MU);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), k, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return (uint32_t) _mm_extract_epi32(x1, 1);
+}
+
+/**********************************************************************/
+static CRC32Checksum foldingCRC32(CRC32Checksum  crc,
+                                  const byte    *buffer,
+                                  size_t         length)
+{
+  if (length < FOLDING_MINIMUM_LENGTH) {
+    return zlibCRC32(crc, buffer, length);
+  }
+
+  // zlib's checksum is the inverted register, so the fold works on the
+  // uninverted one; zlib then finishes any partial block at the end.
+  size_t folded = length & ~((size_t) FOLDING_BLOCK_SIZE - 1);
+  crc = ~foldCRC32(buffer, folded, ~crc);
+  return zlibCRC32(crc, buffer + folded, length - folded);
+}
+#endif /* __x86_64__ */
+
+/**
+ * Choose the fastest implementation this CPU supports.
+ *
+ * @return the CRC-32 function to use
+ **/
+static CRC32Function *selectCRC32(void)
+{
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+    return foldingCRC32;
+  }
+#endif
+  return zlibCRC32;
+}
+
+/**********************************************************************/
+CRC32Checksum updateCRC32(CRC32Checksum  crc,
+                          const byte    *buffer,
+                          size_t         length)
+{
+  // Selecting more than once is harmless, since every thread gets the same
+  // answer.
+  static CRC32Function *implementation = NULL;
+  if (implementation == NULL) {
+    implementation = selectCRC32();
+  }
+  return implementation(crc, buffer, length);
+}
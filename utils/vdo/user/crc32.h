@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ *
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/user/crc32.h#1 $
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include "types.h"
+
+/**
+ * Update a CRC-32 checksum (the zlib polynomial) with the contents of a
+ * buffer. The checksum is computed with carry-less multiplication when the
+ * CPU supports it, and with zlib otherwise; both give identical results.
+ *
+ * @param crc     the checksum so far
+ * @param buffer  the data to add to the checksum
+ * @param length  the length of the data
+ *
+ * @return the updated checksum
+ **/
+CRC32Checksum updateCRC32(CRC32Checksum  crc,
+                          const byte    *buffer,
+                          size_t         length);
+
+#endif // CRC32_H
@@ -24,7 +24,6 @@
 #include <linux/fs.h>
 #include <string.h>
 #include <sys/ioctl.h>
-#include <zlib.h>
 
 #include "fileUtils.h"
 #include "logger.h"
@@ -35,6 +34,8 @@
 #include "constants.h"
 #include "statusCodes.h"
 
+#include "crc32.h"
+
 typedef struct fileLayer {
   PhysicalLayer common;
   BlockCount    blockCount;
@@ -49,14 +50,6 @@ static inline FileLayer *asFileLayer(PhysicalLayer *layer)
   return (FileLayer *) layer;
 }
 
-/**********************************************************************/
-static CRC32Checksum updateCRC32(CRC32Checksum  crc,
-                                 const byte    *buffer,
-                                 size_t         length)
-{
-  return crc32(crc, buffer, length);
-}
-
 /**********************************************************************/
 static BlockCount getBlockCount(PhysicalLayer *header)
 {
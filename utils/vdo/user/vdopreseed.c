@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2018 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA. 
+ * $Id: //eng/vdo-releases/aluminum/src/c++/vdo/user/vdoPreseed.c#1 $
+ */
+
+#include <ctype.h>
+#include <err.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uds.h"
+#include "uds-block.h"
+
+#include "errors.h"
+#include "logger.h"
+
+enum {
+  /** The number of records passed to the index at once */
+  PRESEED_BATCH_SIZE = 65536,
+};
+
+static const char usageString[] =
+  " [--help] [options...] indexName hashFile";
+
+static const char helpString[] =
+  "vdopreseed - pre-seed a deduplication index from a file of hashes\n"
+  "\n"
+  "SYNOPSIS\n"
+  "  vdopreseed [options] indexName hashFile\n"
+  "\n"
+  "DESCRIPTION\n"
+  "  vdopreseed loads the existing deduplication index named by indexName\n"
+  "  and adds each block name listed in hashFile to it, without starting\n"
+  "  an index request for each name. The index is saved when all of the\n"
+  "  names have been added. No other program may use the index while\n"
+  "  vdopreseed runs.\n"
+  "\n"
+  "  Each line of hashFile holds a block name of 32 hexadecimal digits,\n"
+  "  optionally followed by white space and up to 32 hexadecimal digits of\n"
+  "  metadata to associate with the name. Missing metadata is zero. Empty\n"
+  "  lines and lines starting with '#' are ignored. A hashFile of '-'\n"
+  "  reads the names from standard input.\n"
+  "\n"
+  "OPTIONS\n"
+  "    --help\n"
+  "       Print this help message and exit.\n"
+  "\n"
+  "    --verbose\n"
+  "       Report the number of names added.\n"
+  "\n"
+  "    --version\n"
+  "       Show the version of vdopreseed.\n"
+  "\n";
+
+// N.B. the option array must be in sync with the option string.
+static struct option options[] = {
+  { "help",    no_argument, NULL, 'h' },
+  { "verbose", no_argument, NULL, 'v' },
+  { "version", no_argument, NULL, 'V' },
+  { NULL,      0,           NULL,  0  },
+};
+static char optionString[] = "hvV";
+
+/**********************************************************************/
+static void usage(const char *progname, const char *usageOptionsString)
+{
+  errx(1, "Usage: %s%s\n", progname, usageOptionsString);
+}
+
+/**
+ * Parse a string of hexadecimal digits into bytes.
+ *
+ * @param [in]  hex       The digits, which end at the first character which
+ *                        is not a hexadecimal digit
+ * @param [out] bytes     The buffer for the bytes
+ * @param [in]  maxBytes  The size of the buffer
+ * @param [out] endPtr    A pointer to hold the end of the digits
+ *
+ * @return the number of bytes parsed, or -1 if there are too many digits
+ *         or an odd number of them
+ **/
+static int parseHex(const char     *hex,
+                    unsigned char  *bytes,
+                    size_t          maxBytes,
+                    const char    **endPtr)
+{
+  size_t count = 0;
+  while (isxdigit((unsigned char) hex[0])) {
+    if (!isxdigit((unsigned char) hex[1]) || (count == maxBytes)) {
+      return -1;
+    }
+    char digits[3] = { hex[0], hex[1], '\0' };
+    bytes[count++] = strtoul(digits, NULL, 16);
+    hex += 2;
+  }
+  *endPtr = hex;
+  return count;
+}
+
+/**
+ * Parse a line of the hash file into a record.
+ *
+ * @param [in]  line    The line, without its newline
+ * @param [out] record  The record to fill in
+ *
+ * @return true if the line is valid
+ **/
+static bool parseRecord(const char *line, UdsBulkRecord *record)
+{
+  memset(record, 0, sizeof(*record));
+  const char *end;
+  if (parseHex(line, record->name.name, UDS_CHUNK_NAME_SIZE, &end)
+      != UDS_CHUNK_NAME_SIZE) {
+    return false;
+  }
+  line = end;
+  while (isspace((unsigned char) *line)) {
+    line++;
+  }
+  if (parseHex(line, record->metadata.data, UDS_MAX_BLOCK_DATA_SIZE, &end)
+      < 0) {
+    return false;
+  }
+  while (isspace((unsigned char) *end)) {
+    end++;
+  }
+  return (*end == '\0');
+}
+
+/**
+ * Pass a batch of records to the index, exiting on failure.
+ *
+ * @param session  The index session
+ * @param records  The records
+ * @param count    The number of records
+ **/
+static void loadBatch(UdsIndexSession      session,
+                      const UdsBulkRecord *records,
+                      size_t               count)
+{
+  int result = udsBulkLoadChunks(session, records, count);
+  if (result != UDS_SUCCESS) {
+    char errorBuffer[ERRBUF_SIZE];
+    errx(1, "udsBulkLoadChunks failed: %s",
+         stringError(result, errorBuffer, sizeof(errorBuffer)));
+  }
+}
+
+/**********************************************************************/
+int main(int argc, char *argv[])
+{
+  static bool verbose = false;
+
+  int c;
+  while ((c = getopt_long(argc, argv, optionString, options, NULL)) != -1) {
+    switch (c) {
+    case 'h':
+      printf("%s", helpString);
+      exit(0);
+      break;
+
+    case 'v':
+      verbose = true;
+      break;
+
+    case 'V':
+      fprintf(stdout, "vdopreseed version is: %s\n", CURRENT_VERSION);
+      exit(0);
+      break;
+
+    default:
+      usage(argv[0], usageString);
+      break;
+    };
+  }
+
+  if (optind != (argc - 2)) {
+    usage(argv[0], usageString);
+  }
+
+  const char *indexName = argv[optind];
+  const char *hashFile  = argv[optind + 1];
+
+  openLogger();
+
+  FILE *input = stdin;
+  if (strcmp(hashFile, "-") != 0) {
+    input = fopen(hashFile, "r");
+    if (input == NULL) {
+      err(1, "unable to open %s", hashFile);
+    }
+  }
+
+  UdsBulkRecord *records = calloc(PRESEED_BATCH_SIZE, sizeof(*records));
+  if (records == NULL) {
+    errx(1, "unable to allocate %u records", PRESEED_BATCH_SIZE);
+  }
+
+  char errorBuffer[ERRBUF_SIZE];
+  UdsIndexSession session;
+  int result = udsLoadLocalIndex(indexName, &session);
+  if (result != UDS_SUCCESS) {
+    errx(1, "unable to load index '%s': %s", indexName,
+         stringError(result, errorBuffer, sizeof(errorBuffer)));
+  }
+
+  char *line = NULL;
+  size_t lineSize = 0;
+  unsigned long lineNumber = 0;
+  unsigned long total = 0;
+  size_t count = 0;
+  ssize_t length;
+  while ((length = getline(&line, &lineSize, input)) != -1) {
+    lineNumber++;
+    if ((length > 0) && (line[length - 1] == '\n')) {
+      line[length - 1] = '\0';
+    }
+    if ((line[0] == '\0') || (line[0] == '#')) {
+      continue;
+    }
+    if (!parseRecord(line, &records[count])) {
+      errx(1, "%s:%lu: invalid block name or metadata", hashFile,
+           lineNumber);
+    }
+    if (++count == PRESEED_BATCH_SIZE) {
+      loadBatch(session, records, count);
+      total += count;
+      count = 0;
+    }
+  }
+  if (ferror(input)) {
+    err(1, "error reading %s", hashFile);
+  }
+  loadBatch(session, records, count);
+  total += count;
+
+  result = udsCloseIndexSession(session);
+  if (result != UDS_SUCCESS) {
+    errx(1, "unable to save index '%s': %s", indexName,
+         stringError(result, errorBuffer, sizeof(errorBuffer)));
+  }
+
+  if (verbose) {
+    printf("Added %lu block names to '%s'.\n", total, indexName);
+  }
+
+  free(line);
+  free(records);
+  if (input != stdin) {
+    fclose(input);
+  }
+  exit(0);
+}